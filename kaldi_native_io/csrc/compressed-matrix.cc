@@ -11,10 +11,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <istream>
+#include <limits>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
+#include "kaldi_native_io/csrc/half-matrix.h"
 #include "kaldi_native_io/csrc/log.h"
 
 namespace kaldiio {
@@ -46,6 +51,47 @@ void CompressedMatrix::Scale(float alpha) {
   }
 }
 
+// Sets *min_value to mat.Min() and *max_value to mat.Max(), in a single pass
+// that the compiler can vectorize.
+template <typename Real>
+static void ComputeMinAndMax(const MatrixBase<Real> &mat, Real *min_value,
+                             Real *max_value) {
+  // We keep kNumLanes independent minima and maxima; their elements are
+  // updated with the same comparisons that Min() and Max() use, so the result
+  // is the same, NaN's included, unless the min or max is zero (see below).
+  const int32 kNumLanes = 8;
+  Real mins[kNumLanes], maxs[kNumLanes];
+  std::fill(mins, mins + kNumLanes, mat(0, 0));
+  std::fill(maxs, maxs + kNumLanes, mat(0, 0));
+  int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
+  for (int32 r = 0; r < num_rows; r++) {
+    const Real *row_data = mat.RowData(r);
+    int32 c = 0;
+    for (; c + kNumLanes <= num_cols; c += kNumLanes) {
+      for (int32 i = 0; i < kNumLanes; i++) {
+        Real x = row_data[c + i];
+        mins[i] = (x < mins[i]) ? x : mins[i];
+        maxs[i] = (x > maxs[i]) ? x : maxs[i];
+      }
+    }
+    for (; c < num_cols; c++) {
+      Real x = row_data[c];
+      mins[0] = (x < mins[0]) ? x : mins[0];
+      maxs[0] = (x > maxs[0]) ? x : maxs[0];
+    }
+  }
+  *min_value = mins[0];
+  *max_value = maxs[0];
+  for (int32 i = 1; i < kNumLanes; i++) {
+    if (mins[i] < *min_value) *min_value = mins[i];
+    if (maxs[i] > *max_value) *max_value = maxs[i];
+  }
+  // Min() and Max() return the first of equal elements, which matters only
+  // for the sign of zero; let them work it out.
+  if (*min_value == 0) *min_value = mat.Min();
+  if (*max_value == 0) *max_value = mat.Max();
+}
+
 template <typename Real>  // static inline
 void CompressedMatrix::ComputeGlobalHeader(const MatrixBase<Real> &mat,
                                            CompressionMethod method,
@@ -82,7 +128,9 @@ void CompressedMatrix::ComputeGlobalHeader(const MatrixBase<Real> &mat,
     case kSpeechFeature:
     case kTwoByteAuto:
     case kOneByteAuto: {
-      float min_value = mat.Min(), max_value = mat.Max();
+      Real min_real, max_real;
+      ComputeMinAndMax(mat, &min_real, &max_real);
+      float min_value = min_real, max_value = max_real;
       // ensure that max_value is strictly greater than min_value, even if
       // matrix is constant; this avoids crashes in ComputeColHeader when
       // compressing speech featupres.
@@ -123,15 +171,31 @@ void CompressedMatrix::ComputeGlobalHeader(const MatrixBase<Real> &mat,
   // won't be robust across platforms.
 }
 
+// CopyFromMat() does not use more threads than the number of elements divided
+// by this.
+static const int32 kMinElementsPerThread = 65536;
+
+// Calls func(begin, end) for a partition of [0, n) into at most num_threads
+// contiguous ranges, running all but the first range in new threads.
+template <typename F>
+static void ParallelFor(int32 n, int32 num_threads, F func) {
+  num_threads = std::max<int32>(1, std::min<int32>(num_threads, n));
+  std::vector<std::thread> threads;
+  for (int32 t = 1; t < num_threads; t++) {
+    int32 begin = static_cast<int64_t>(n) * t / num_threads,
+          end = static_cast<int64_t>(n) * (t + 1) / num_threads;
+    threads.push_back(std::thread(func, begin, end));
+  }
+  func(0, n / num_threads);
+  for (auto &thread : threads) thread.join();
+}
+
 template <typename Real>
 void CompressedMatrix::CopyFromMat(const MatrixBase<Real> &mat,
-                                   CompressionMethod method) {
-  if (data_ != NULL) {
-    delete[] static_cast<float *>(
-        data_);  // call delete [] because was allocated with new float[]
-    data_ = NULL;
-  }
+                                   CompressionMethod method,
+                                   int32 num_threads) {
   if (mat.NumRows() == 0) {
+    Clear();
     return;
   }  // Zero-size matrix stored as zero pointer.
 
@@ -140,55 +204,66 @@ void CompressedMatrix::CopyFromMat(const MatrixBase<Real> &mat,
 
   int32 data_size = DataSize(global_header);
 
-  data_ = AllocateData(data_size);
+  Reallocate(data_size);
 
   *(reinterpret_cast<GlobalHeader *>(data_)) = global_header;
 
+  // Small matrices are not worth starting threads for.
+  int64_t num_elements = static_cast<int64_t>(mat.NumRows()) * mat.NumCols();
+  num_threads = std::max<int64_t>(
+      1, std::min<int64_t>(num_threads, num_elements / kMinElementsPerThread));
+
   DataFormat format = static_cast<DataFormat>(global_header.format);
   if (format == kOneByteWithColHeaders) {
     PerColHeader *header_data = reinterpret_cast<PerColHeader *>(
         static_cast<char *>(data_) + sizeof(GlobalHeader));
     uint8 *byte_data =
         reinterpret_cast<uint8 *>(header_data + global_header.num_cols);
-
-    const Real *matrix_data = mat.Data();
-
-    for (int32 col = 0; col < global_header.num_cols; col++) {
-      CompressColumn(global_header, matrix_data + col, mat.Stride(),
-                     global_header.num_rows, header_data, byte_data);
-      header_data++;
-      byte_data += global_header.num_rows;
-    }
+    // Each thread compresses a contiguous range of columns.
+    ParallelFor(global_header.num_cols, num_threads,
+                [&](int32 col_begin, int32 col_end) {
+                  CompressColumns(global_header, mat, col_begin, col_end,
+                                  header_data, byte_data);
+                });
   } else if (format == kTwoByte) {
     uint16 *data = reinterpret_cast<uint16 *>(static_cast<char *>(data_) +
                                               sizeof(GlobalHeader));
-    int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
-    for (int32 r = 0; r < num_rows; r++) {
-      const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
-        data[c] = FloatToUint16(global_header, row_data[c]);
-      data += num_cols;
-    }
+    int32 num_cols = mat.NumCols();
+    // Each thread compresses a contiguous range of rows.
+    ParallelFor(mat.NumRows(), num_threads,
+                [&](int32 row_begin, int32 row_end) {
+                  for (int32 r = row_begin; r < row_end; r++) {
+                    const Real *row_data = mat.RowData(r);
+                    uint16 *this_data = data + r * num_cols;
+                    for (int32 c = 0; c < num_cols; c++)
+                      this_data[c] = FloatToUint16(global_header, row_data[c]);
+                  }
+                });
   } else {
     KALDIIO_ASSERT(format == kOneByte);
     uint8 *data = reinterpret_cast<uint8 *>(static_cast<char *>(data_) +
                                             sizeof(GlobalHeader));
-    int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
-    for (int32 r = 0; r < num_rows; r++) {
-      const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
-        data[c] = FloatToUint8(global_header, row_data[c]);
-      data += num_cols;
-    }
+    int32 num_cols = mat.NumCols();
+    ParallelFor(mat.NumRows(), num_threads,
+                [&](int32 row_begin, int32 row_end) {
+                  for (int32 r = row_begin; r < row_end; r++) {
+                    const Real *row_data = mat.RowData(r);
+                    uint8 *this_data = data + r * num_cols;
+                    for (int32 c = 0; c < num_cols; c++)
+                      this_data[c] = FloatToUint8(global_header, row_data[c]);
+                  }
+                });
   }
 }
 
 // Instantiate the template for float and double.
 template void CompressedMatrix::CopyFromMat(const MatrixBase<float> &mat,
-                                            CompressionMethod method);
+                                            CompressionMethod method,
+                                            int32 num_threads);
 
 template void CompressedMatrix::CopyFromMat(const MatrixBase<double> &mat,
-                                            CompressionMethod method);
+                                            CompressionMethod method,
+                                            int32 num_threads);
 
 CompressedMatrix::CompressedMatrix(const CompressedMatrix &cmat,
                                    const MatrixIndexT row_offset,
@@ -196,7 +271,7 @@ CompressedMatrix::CompressedMatrix(const CompressedMatrix &cmat,
                                    const MatrixIndexT col_offset,
                                    const MatrixIndexT num_cols,
                                    bool allow_padding)
-    : data_(NULL) {
+    : data_(NULL), capacity_(0), allocator_(NULL) {
   int32 old_num_rows = cmat.NumRows(), old_num_cols = cmat.NumCols();
 
   if (old_num_rows == 0) {
@@ -233,7 +308,7 @@ CompressedMatrix::CompressedMatrix(const CompressedMatrix &cmat,
   // is needed, we will do this below by creating a temporary Matrix.
   new_global_header.format = old_global_header->format;
 
-  data_ = AllocateData(DataSize(new_global_header));  // allocate memory
+  Reallocate(DataSize(new_global_header));  // allocate memory
   *(reinterpret_cast<GlobalHeader *>(data_)) = new_global_header;
 
   DataFormat format = static_cast<DataFormat>(old_global_header->format);
@@ -365,11 +440,68 @@ inline float CompressedMatrix::Uint16ToFloat(const GlobalHeader &global_header,
          global_header.range * 1.52590218966964e-05F * value;
 }
 
+// static
+void CompressedMatrix::SetColHeader(uint16 percentile_0, uint16 percentile_25,
+                                    uint16 percentile_75,
+                                    uint16 percentile_100,
+                                    PerColHeader *header) {
+  // The percentiles must be strictly increasing.
+  header->percentile_0 = std::min<uint16>(percentile_0, 65532);
+  header->percentile_25 = std::min<uint16>(
+      std::max<uint16>(percentile_25,
+                       header->percentile_0 + static_cast<uint16>(1)),
+      65533);
+  header->percentile_75 = std::min<uint16>(
+      std::max<uint16>(percentile_75,
+                       header->percentile_25 + static_cast<uint16>(1)),
+      65534);
+  header->percentile_100 = std::max<uint16>(
+      percentile_100, header->percentile_75 + static_cast<uint16>(1));
+}
+
+// ComputeColHeader() selects the percentiles with histograms instead of
+// std::nth_element for columns with at least this many rows.
+static const int32 kMinRowsForHistogram = 64;
+
+// Returns the element that would be at position 'rank' if 'codes' was sorted,
+// given the histogram 'high_counts' of the high bytes of its elements.
+static uint16 SelectUint16(const std::vector<uint16> &codes,
+                           const int32 *high_counts, int32 rank) {
+  int32 high = 0;
+  while (rank >= high_counts[high]) rank -= high_counts[high++];
+  int32 low_counts[256] = {0};
+  for (uint16 code : codes) low_counts[code & 255] += ((code >> 8) == high);
+  int32 low = 0;
+  while (rank >= low_counts[low]) rank -= low_counts[low++];
+  return static_cast<uint16>((high << 8) | low);
+}
+
 template <typename Real>  // static
 void CompressedMatrix::ComputeColHeader(
     const GlobalHeader &global_header, const Real *data, MatrixIndexT stride,
     int32 num_rows, CompressedMatrix::PerColHeader *header) {
   KALDIIO_ASSERT(num_rows > 0);
+  if (num_rows >= kMinRowsForHistogram) {
+    // The header only stores FloatToUint16() of the percentiles, and that
+    // function is monotonic, so we can select from the uint16 codes of the
+    // data instead of the data: counting their bytes in histograms is faster
+    // than std::nth_element, and gives the same result.
+    std::vector<uint16> codes(num_rows);
+    int32 high_counts[256] = {0};
+    uint16 min_code = 65535, max_code = 0;
+    for (int32 i = 0; i < num_rows; i++) {
+      uint16 code = FloatToUint16(global_header, data[i * stride]);
+      codes[i] = code;
+      high_counts[code >> 8]++;
+      min_code = std::min(min_code, code);
+      max_code = std::max(max_code, code);
+    }
+    int quarter_nr = num_rows / 4;
+    SetColHeader(min_code, SelectUint16(codes, high_counts, quarter_nr),
+                 SelectUint16(codes, high_counts, 3 * quarter_nr), max_code,
+                 header);
+    return;
+  }
   std::vector<Real> sdata(num_rows);  // the sorted data.
   for (size_t i = 0, size = sdata.size(); i < size; i++)
     sdata[i] = data[i * stride];
@@ -396,20 +528,10 @@ void CompressedMatrix::ComputeColHeader(
     // 3*quarter_nr, and sdata.end() - 1, contain the elements that would appear
     // at those positions in sorted order.
 
-    header->percentile_0 =
-        std::min<uint16>(FloatToUint16(global_header, sdata[0]), 65532);
-    header->percentile_25 = std::min<uint16>(
-        std::max<uint16>(FloatToUint16(global_header, sdata[quarter_nr]),
-                         header->percentile_0 + static_cast<uint16>(1)),
-        65533);
-    header->percentile_75 = std::min<uint16>(
-        std::max<uint16>(FloatToUint16(global_header, sdata[3 * quarter_nr]),
-                         header->percentile_25 + static_cast<uint16>(1)),
-        65534);
-    header->percentile_100 =
-        std::max<uint16>(FloatToUint16(global_header, sdata[num_rows - 1]),
-                         header->percentile_75 + static_cast<uint16>(1));
-
+    SetColHeader(FloatToUint16(global_header, sdata[0]),
+                 FloatToUint16(global_header, sdata[quarter_nr]),
+                 FloatToUint16(global_header, sdata[3 * quarter_nr]),
+                 FloatToUint16(global_header, sdata[num_rows - 1]), header);
   } else {  // handle this pathological case.
     std::sort(sdata.begin(), sdata.end());
     // Note: we know num_rows is at least 1.
@@ -440,32 +562,23 @@ void CompressedMatrix::ComputeColHeader(
 // static
 inline uint8 CompressedMatrix::FloatToChar(float p0, float p25, float p75,
                                            float p100, float value) {
-  int ans;
-  if (value < p25) {  // range [ p0, p25 ) covered by
-    // characters 0 .. 64.  We round to the closest int.
-    float f = (value - p0) / (p25 - p0);
-    ans = static_cast<int>(f * 64 + 0.5);
-    // Note: the checks on the next two lines
-    // are necessary in pathological cases when all the elements in a row
-    // are the same and the percentile_* values are separated by one.
-    if (ans < 0) ans = 0;
-    if (ans > 64) ans = 64;
-  } else if (value < p75) {  // range [ p25, p75 )covered
-    // by characters 64 .. 192.  We round to the closest int.
-    float f = (value - p25) / (p75 - p25);
-    ans = 64 + static_cast<int>(f * 128 + 0.5);
-    if (ans < 64) ans = 64;
-    if (ans > 192) ans = 192;
-  } else {  // range [ p75, p100 ] covered by
-    // characters 192 .. 255.  Note: this last range
-    // has fewer characters than the left range, because
-    // we go up to 255, not 256.
-    float f = (value - p75) / (p100 - p75);
-    ans = 192 + static_cast<int>(f * 63 + 0.5);
-    if (ans < 192) ans = 192;
-    if (ans > 255) ans = 255;
-  }
-  return static_cast<uint8>(ans);
+  // The range [ p0, p25 ) is covered by characters 0 .. 64, [ p25, p75 ) by
+  // characters 64 .. 192 and [ p75, p100 ] by characters 192 .. 255 (this last
+  // range has fewer characters than the left range, because we go up to 255,
+  // not 256).  We round to the closest int.  The segment is selected without
+  // branches so that the loop in CompressColumn() vectorizes.
+  bool below_p25 = (value < p25), below_p75 = (value < p75);
+  float begin = below_p25 ? p0 : (below_p75 ? p25 : p75),
+        end = below_p25 ? p25 : (below_p75 ? p75 : p100),
+        scale = below_p25 ? 64.0f : (below_p75 ? 128.0f : 63.0f);
+  int offset = below_p25 ? 0 : (below_p75 ? 64 : 192);
+  float f = (value - begin) / (end - begin);
+  int ans = static_cast<int>(f * scale + 0.5);
+  // Note: the clamping is necessary in pathological cases when all the
+  // elements in a row are the same and the percentile_* values are separated
+  // by one.
+  ans = std::max(std::min(ans, static_cast<int>(scale)), 0);
+  return static_cast<uint8>(offset + ans);
 }
 
 // static
@@ -499,12 +612,43 @@ void CompressedMatrix::CompressColumn(const GlobalHeader &global_header,
   }
 }
 
-// static
-void *CompressedMatrix::AllocateData(int32 num_bytes) {
+// The number of columns CompressColumns() copies out of the matrix at a time.
+static const int32 kColBlockSize = 16;
+
+template <typename Real>  // static
+void CompressedMatrix::CompressColumns(const GlobalHeader &global_header,
+                                       const MatrixBase<Real> &mat,
+                                       int32 col_begin, int32 col_end,
+                                       PerColHeader *header_data,
+                                       uint8 *byte_data) {
+  // Reading a column of 'mat' touches a cache line per element, so we copy
+  // blocks of kColBlockSize columns into 'block', which is column-major, in a
+  // single pass over the rows and compress the columns from there.
+  int32 num_rows = mat.NumRows();
+  std::vector<Real> block(static_cast<size_t>(kColBlockSize) * num_rows);
+  for (int32 col = col_begin; col < col_end; col += kColBlockSize) {
+    int32 block_size = std::min(kColBlockSize, col_end - col);
+    for (int32 r = 0; r < num_rows; r++) {
+      const Real *row_data = mat.RowData(r) + col;
+      for (int32 c = 0; c < block_size; c++)
+        block[static_cast<size_t>(c) * num_rows + r] = row_data[c];
+    }
+    for (int32 c = 0; c < block_size; c++)
+      CompressColumn(global_header, &block[static_cast<size_t>(c) * num_rows],
+                     1, num_rows, header_data + col + c,
+                     byte_data + static_cast<size_t>(col + c) * num_rows);
+  }
+}
+
+void CompressedMatrix::Reallocate(int32 num_bytes) {
+  if (data_ != NULL && num_bytes <= capacity_) return;
+  Clear();
   KALDIIO_ASSERT(num_bytes > 0);
-  static_assert(sizeof(float) == 4, "");
-  // round size up to nearest number of floats.
-  return reinterpret_cast<void *>(new float[(num_bytes / 3) + 4]);
+  allocator_ = GetMemoryAllocator();
+  data_ = allocator_->Allocate(num_bytes);  // Throws on failure.
+  capacity_ = static_cast<int32>(
+      std::min<size_t>(allocator_->UsableSize(num_bytes),
+                       std::numeric_limits<int32>::max()));
 }
 
 void CompressedMatrix::Write(std::ostream &os, bool binary) const {
@@ -541,36 +685,17 @@ void CompressedMatrix::Write(std::ostream &os, bool binary) const {
 }
 
 void CompressedMatrix::Read(std::istream &is, bool binary) {
-  if (data_ != NULL) {
-    delete[](static_cast<float *>(data_));
-    data_ = NULL;
-  }
   if (binary) {
     int peekval = Peek(is, binary);
     if (peekval == 'C') {
-      std::string tok;  // Should be CM (format 1) or CM2 (format 2)
-      ReadToken(is, binary, &tok);
       GlobalHeader h;
-      if (tok == "CM") {
-        //  kOneByteWithColHeaders
-        h.format = 1;
-      } else if (tok == "CM2") {
-        // kTwoByte
-        h.format = 2;
-      } else if (tok == "CM3") {
-        // kOneByte
-        h.format = 3;
-      } else {
-        KALDIIO_ERR << "Unexpected token " << tok
-                    << ", expecting CM, CM2 or CM3";
-      }
-      // don't read the "format" -> hence + 4, - 4.
-      is.read(reinterpret_cast<char *>(&h) + 4, sizeof(h) - 4);
-      if (is.fail()) KALDIIO_ERR << "Failed to read header";
-      if (h.num_cols == 0)  // empty matrix.
+      ReadGlobalHeader(is, &h);
+      if (h.num_cols == 0) {  // empty matrix.
+        Clear();
         return;
+      }
       int32 size = DataSize(h), remaining_size = size - sizeof(GlobalHeader);
-      data_ = AllocateData(size);
+      Reallocate(size);
       *(reinterpret_cast<GlobalHeader *>(data_)) = h;
       is.read(reinterpret_cast<char *>(data_) + sizeof(GlobalHeader),
               remaining_size);
@@ -592,61 +717,284 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
   if (is.fail()) KALDIIO_ERR << "Failed to read data.";
 }
 
-template <typename Real>
-void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
-                                 MatrixTransposeType trans) const {
-  if (trans == kTrans) {
-    Matrix<Real> temp(this->NumCols(), this->NumRows());
-    CopyToMat(&temp, kNoTrans);
-    mat->CopyFromMat(temp, kTrans);
-    return;
+void CompressedMatrix::ReadGlobalHeader(std::istream &is,
+                                        GlobalHeader *h) {
+  std::string tok;  // Should be CM (format 1) or CM2 (format 2)
+  ReadToken(is, true, &tok);
+  if (tok == "CM") {
+    //  kOneByteWithColHeaders
+    h->format = 1;
+  } else if (tok == "CM2") {
+    // kTwoByte
+    h->format = 2;
+  } else if (tok == "CM3") {
+    // kOneByte
+    h->format = 3;
+  } else {
+    KALDIIO_ERR << "Unexpected token " << tok << ", expecting CM, CM2 or CM3";
   }
+  // don't read the "format" -> hence + 4, - 4.
+  is.read(reinterpret_cast<char *>(h) + 4, sizeof(*h) - 4);
+  if (is.fail()) KALDIIO_ERR << "Failed to read header";
+}
 
-  if (data_ == NULL) {
-    KALDIIO_ASSERT(mat->NumRows() == 0);
-    KALDIIO_ASSERT(mat->NumCols() == 0);
-    return;
+bool CompressedMatrix::ReadSize(std::istream &is, int32 *num_rows,
+                                int32 *num_cols) {
+  std::streampos start = is.tellg();
+  if (start == std::streampos(-1) || is.peek() != 'C') return false;
+  GlobalHeader h;
+  bool ans = true;
+  try {
+    ReadGlobalHeader(is, &h);
+    *num_rows = h.num_rows;
+    *num_cols = h.num_cols;
+  } catch (const std::exception &) {
+    ans = false;
   }
-  GlobalHeader *h = reinterpret_cast<GlobalHeader *>(data_);
-  int32 num_cols = h->num_cols, num_rows = h->num_rows;
-  KALDIIO_ASSERT(mat->NumRows() == num_rows);
-  KALDIIO_ASSERT(mat->NumCols() == num_cols);
+  is.clear();
+  is.seekg(start);
+  return ans && !is.fail();
+}
 
-  DataFormat format = static_cast<DataFormat>(h->format);
+// Moves 'is' forward by 'num_bytes'.  We read over short gaps rather than seek
+// over them, as seeking discards what the stream has buffered.
+static void SkipBytes(std::istream &is, int64_t num_bytes) {
+  if (num_bytes == 0) return;
+  if (num_bytes < 4096)
+    is.ignore(num_bytes);
+  else
+    is.seekg(num_bytes, std::ios::cur);
+}
+
+void CompressedMatrix::ReadRows(std::istream &is, int32 row_offset,
+                                int32 num_rows) {
+  GlobalHeader h;
+  ReadGlobalHeader(is, &h);
+  KALDIIO_ASSERT(row_offset >= 0 && num_rows > 0 &&
+                 row_offset + num_rows <= h.num_rows && h.num_cols > 0);
+  GlobalHeader new_h = h;
+  new_h.num_rows = num_rows;
+  Reallocate(DataSize(new_h));
+  *(reinterpret_cast<GlobalHeader *>(data_)) = new_h;
+  // The number of rows after the ones we read.
+  int32 rows_after = h.num_rows - row_offset - num_rows;
+
+  DataFormat format = static_cast<DataFormat>(h.format);
   if (format == kOneByteWithColHeaders) {
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader *>(h + 1);
-    uint8 *byte_data = reinterpret_cast<uint8 *>(per_col_header + h->num_cols);
-    for (int32 i = 0; i < num_cols; i++, per_col_header++) {
+    // The data is stored column by column, so we read part of each column.
+    PerColHeader *per_col_header = reinterpret_cast<PerColHeader *>(
+        reinterpret_cast<GlobalHeader *>(data_) + 1);
+    is.read(reinterpret_cast<char *>(per_col_header),
+            sizeof(PerColHeader) * h.num_cols);
+    char *byte_data = reinterpret_cast<char *>(per_col_header + h.num_cols);
+    for (int32 i = 0; i < h.num_cols; i++, byte_data += num_rows) {
+      SkipBytes(is, row_offset);
+      is.read(byte_data, num_rows);
+      SkipBytes(is, rows_after);
+    }
+  } else {
+    // The data is stored row by row.
+    int64_t row_bytes =
+        static_cast<int64_t>(h.num_cols) * (format == kTwoByte ? 2 : 1);
+    SkipBytes(is, row_offset * row_bytes);
+    is.read(reinterpret_cast<char *>(data_) + sizeof(GlobalHeader),
+            num_rows * row_bytes);
+    SkipBytes(is, rows_after * row_bytes);
+  }
+  if (is.fail()) KALDIIO_ERR << "Failed to read data.";
+}
+
+// For columns shorter than this, filling the table of ComputeCharToFloatTable()
+// would cost more than it saves.
+static const int32 kMinRowsForTable = 64;
+
+void CompressedMatrix::ComputeCharToFloatTable(
+    const GlobalHeader &global_header, const PerColHeader &col_header,
+    float *table) {
+  float p0 = Uint16ToFloat(global_header, col_header.percentile_0),
+        p25 = Uint16ToFloat(global_header, col_header.percentile_25),
+        p75 = Uint16ToFloat(global_header, col_header.percentile_75),
+        p100 = Uint16ToFloat(global_header, col_header.percentile_100);
+  // These are the expressions in CharToFloat(), without the branches so that
+  // the loops can be vectorized.  In the first two, multiplying by 1/64 or
+  // 1/128 is exact, and adding two floats in double precision and rounding
+  // the result to float gives the same as adding them in float, so we can use
+  // float arithmetic and get the same results.
+  float scale0 = p25 - p0, scale1 = p75 - p25, scale2 = p100 - p75;
+  for (int32 i = 0; i <= 64; i++)
+    table[i] = p0 + scale0 * static_cast<float>(i) * (1 / 64.0f);
+  for (int32 i = 65; i <= 192; i++)
+    table[i] = p25 + scale1 * static_cast<float>(i - 64) * (1 / 128.0f);
+  for (int32 i = 193; i < 256; i++)
+    table[i] = p75 + scale2 * (i - 192) * (1 / 63.0);
+}
+
+// Stores a decompressed element as the type CopyToData() writes; uint16 means
+// IEEE half precision.
+static inline void SetElement(float value, float *dest) { *dest = value; }
+
+static inline void SetElement(float value, double *dest) { *dest = value; }
+
+static inline void SetElement(float value, uint16 *dest) {
+  *dest = FloatToHalf(value);
+}
+
+template <typename T>
+void CompressedMatrix::CopyColHeaderFormatToData(
+    int32 row_offset, int32 col_offset, int32 num_rows, int32 num_cols,
+    T *data, MatrixIndexT stride, MatrixTransposeType trans) const {
+  GlobalHeader *h = reinterpret_cast<GlobalHeader *>(data_);
+  int32 total_rows = h->num_rows;
+  PerColHeader *per_col_header =
+      reinterpret_cast<PerColHeader *>(h + 1) + col_offset;
+  const uint8 *byte_data =
+      reinterpret_cast<uint8 *>(reinterpret_cast<PerColHeader *>(h + 1) +
+                                h->num_cols) +
+      col_offset * total_rows + row_offset;
+
+  if (trans == kTrans) {
+    // The data is stored column by column, so each row of the output is a
+    // contiguous run of bytes.
+    float table[256];
+    for (int32 i = 0; i < num_cols; i++, byte_data += total_rows) {
+      T *row_data = data + i * stride;
+      if (num_rows < kMinRowsForTable) {
+        float p0 = Uint16ToFloat(*h, per_col_header[i].percentile_0),
+              p25 = Uint16ToFloat(*h, per_col_header[i].percentile_25),
+              p75 = Uint16ToFloat(*h, per_col_header[i].percentile_75),
+              p100 = Uint16ToFloat(*h, per_col_header[i].percentile_100);
+        for (int32 j = 0; j < num_rows; j++)
+          SetElement(CharToFloat(p0, p25, p75, p100, byte_data[j]),
+                     row_data + j);
+      } else {
+        ComputeCharToFloatTable(*h, per_col_header[i], table);
+        for (int32 j = 0; j < num_rows; j++)
+          SetElement(table[byte_data[j]], row_data + j);
+      }
+    }
+    return;
+  }
+
+  if (num_rows < kMinRowsForTable) {
+    for (int32 i = 0; i < num_cols;
+         i++, per_col_header++, byte_data += total_rows) {
       float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
             p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
             p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
             p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < num_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*mat)(j, i) = f;
-      }
+      T *dest_data = data + i;
+      for (int32 j = 0; j < num_rows; j++)
+        SetElement(CharToFloat(p0, p25, p75, p100, byte_data[j]),
+                   dest_data + j * stride);
+    }
+    return;
+  }
+
+  std::vector<float> tables(static_cast<size_t>(num_cols) * 256);
+  for (int32 i = 0; i < num_cols; i++)
+    ComputeCharToFloatTable(*h, per_col_header[i], &tables[i * 256]);
+
+  // The data is stored column by column and the output is row-major, so we go
+  // over it in blocks of rows, small enough that the rows of the output in a
+  // block stay in the cache while we fill in one column after another.
+  const int32 kRowBlock = 64;
+  for (int32 r0 = 0; r0 < num_rows; r0 += kRowBlock) {
+    int32 r1 = std::min(r0 + kRowBlock, num_rows);
+    for (int32 i = 0; i < num_cols; i++) {
+      const float *table = &tables[i * 256];
+      const uint8 *col_data = byte_data + i * total_rows;
+      T *dest_data = data + i;
+      for (int32 j = r0; j < r1; j++)
+        SetElement(table[col_data[j]], dest_data + j * stride);
+    }
+  }
+}
+
+// The number of rows of the input that RowMajorToData() transposes at a time,
+// so that it writes to the rows of the output in runs instead of one element
+// at a time, while the rows of the input it reads stay in the cache.
+static const int32 kTransRowBlock = 16;
+
+// Decompresses the formats kTwoByte (I = uint16) and kOneByte (I = uint8),
+// which are stored row by row with 'src_stride' elements per row.
+template <typename I, typename T>
+static void RowMajorToData(const I *src, int32 src_stride, int32 num_rows,
+                           int32 num_cols, float min_value, float increment,
+                           T *data, MatrixIndexT stride,
+                           MatrixTransposeType trans) {
+  if (trans == kNoTrans) {
+    for (int32 r = 0; r < num_rows; r++, src += src_stride, data += stride) {
+      for (int32 c = 0; c < num_cols; c++)
+        SetElement(min_value + src[c] * increment, data + c);
+    }
+    return;
+  }
+  for (int32 r0 = 0; r0 < num_rows; r0 += kTransRowBlock) {
+    int32 r1 = std::min(r0 + kTransRowBlock, num_rows);
+    for (int32 c = 0; c < num_cols; c++) {
+      T *dest_data = data + c * stride;
+      for (int32 r = r0; r < r1; r++)
+        SetElement(min_value + src[r * src_stride + c] * increment,
+                   dest_data + r);
     }
+  }
+}
+
+template <typename T>
+void CompressedMatrix::CopyToData(int32 row_offset, int32 col_offset,
+                                  int32 num_rows, int32 num_cols, T *data,
+                                  MatrixIndexT stride,
+                                  MatrixTransposeType trans) const {
+  KALDIIO_ASSERT(row_offset >= 0 && col_offset >= 0);
+  KALDIIO_ASSERT(num_rows >= 0 && num_cols >= 0);
+  KALDIIO_ASSERT(row_offset + num_rows <= this->NumRows());
+  KALDIIO_ASSERT(col_offset + num_cols <= this->NumCols());
+  if (num_rows == 0 || num_cols == 0) return;
+
+  GlobalHeader *h = reinterpret_cast<GlobalHeader *>(data_);
+  int32 total_cols = h->num_cols;
+  DataFormat format = static_cast<DataFormat>(h->format);
+  if (format == kOneByteWithColHeaders) {
+    CopyColHeaderFormatToData(row_offset, col_offset, num_rows, num_cols, data,
+                              stride, trans);
   } else if (format == kTwoByte) {
-    const uint16 *data = reinterpret_cast<const uint16 *>(h + 1);
+    const uint16 *src = reinterpret_cast<const uint16 *>(h + 1) + col_offset +
+                        (total_cols * row_offset);
     float min_value = h->min_value, increment = h->range * (1.0 / 65535.0);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
-      data += num_cols;
-    }
+    RowMajorToData(src, total_cols, num_rows, num_cols, min_value, increment,
+                   data, stride, trans);
   } else {
     KALDIIO_ASSERT(format == kOneByte);
+    const uint8 *src = reinterpret_cast<const uint8 *>(h + 1) + col_offset +
+                       (total_cols * row_offset);
     float min_value = h->min_value, increment = h->range * (1.0 / 255.0);
+    RowMajorToData(src, total_cols, num_rows, num_cols, min_value, increment,
+                   data, stride, trans);
+  }
+}
 
-    const uint8 *data = reinterpret_cast<const uint8 *>(h + 1);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
-      data += num_cols;
-    }
+// Instantiate the template for float, double and half precision.
+template void CompressedMatrix::CopyToData(int32, int32, int32, int32,
+                                           float *, MatrixIndexT,
+                                           MatrixTransposeType) const;
+template void CompressedMatrix::CopyToData(int32, int32, int32, int32,
+                                           double *, MatrixIndexT,
+                                           MatrixTransposeType) const;
+template void CompressedMatrix::CopyToData(int32, int32, int32, int32,
+                                           uint16 *, MatrixIndexT,
+                                           MatrixTransposeType) const;
+
+template <typename Real>
+void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
+                                 MatrixTransposeType trans) const {
+  if (trans == kNoTrans) {
+    KALDIIO_ASSERT(mat->NumRows() == this->NumRows());
+    KALDIIO_ASSERT(mat->NumCols() == this->NumCols());
+  } else {
+    KALDIIO_ASSERT(mat->NumRows() == this->NumCols());
+    KALDIIO_ASSERT(mat->NumCols() == this->NumRows());
   }
+  CopyToData(mat->Data(), mat->Stride(), trans);
 }
 
 // Instantiate the template for float and double.
@@ -755,60 +1103,8 @@ void CompressedMatrix::CopyToMat(int32 row_offset, int32 col_offset,
   KALDIIO_PARANOID_ASSERT(col_offset < this->NumCols());
   KALDIIO_PARANOID_ASSERT(row_offset >= 0);
   KALDIIO_PARANOID_ASSERT(col_offset >= 0);
-  KALDIIO_ASSERT(row_offset + dest->NumRows() <= this->NumRows());
-  KALDIIO_ASSERT(col_offset + dest->NumCols() <= this->NumCols());
-  // everything is OK
-  GlobalHeader *h = reinterpret_cast<GlobalHeader *>(data_);
-  int32 num_rows = h->num_rows, num_cols = h->num_cols,
-        tgt_cols = dest->NumCols(), tgt_rows = dest->NumRows();
-
-  DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader *>(h + 1);
-    uint8 *byte_data = reinterpret_cast<uint8 *>(per_col_header + h->num_cols);
-
-    uint8 *start_of_subcol = byte_data + row_offset;  // skip appropriate
-    // number of columns
-    start_of_subcol +=
-        col_offset * num_rows;  // skip appropriate number of rows
-
-    per_col_header += col_offset;  // skip the appropriate number of headers
-
-    for (int32 i = 0; i < tgt_cols;
-         i++, per_col_header++, start_of_subcol += num_rows) {
-      byte_data = start_of_subcol;
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-            p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-            p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-            p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < tgt_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*dest)(j, i) = f;
-      }
-    }
-  } else if (format == kTwoByte) {
-    const uint16 *data = reinterpret_cast<const uint16 *>(h + 1) + col_offset +
-                         (num_cols * row_offset);
-    float min_value = h->min_value, increment = h->range * (1.0 / 65535.0);
-
-    for (int32 row = 0; row < tgt_rows; row++) {
-      Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
-        dest_row[col] = min_value + increment * data[col];
-      data += num_cols;
-    }
-  } else {
-    KALDIIO_ASSERT(format == kOneByte);
-    const uint8 *data = reinterpret_cast<const uint8 *>(h + 1) + col_offset +
-                        (num_cols * row_offset);
-    float min_value = h->min_value, increment = h->range * (1.0 / 255.0);
-    for (int32 row = 0; row < tgt_rows; row++) {
-      Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
-        dest_row[col] = min_value + increment * data[col];
-      data += num_cols;
-    }
-  }
+  CopyToData(row_offset, col_offset, dest->NumRows(), dest->NumCols(),
+             dest->Data(), dest->Stride());
 }
 
 // instantiate the templates.
@@ -817,22 +1113,30 @@ template void CompressedMatrix::CopyToMat(int32, int32,
 template void CompressedMatrix::CopyToMat(int32, int32,
                                           MatrixBase<double> *dest) const;
 
+MatrixIndexT CompressedMatrix::SizeInBytes() const {
+  if (data_ == NULL) return 0;
+  return DataSize(*reinterpret_cast<GlobalHeader *>(data_));
+}
+
 void CompressedMatrix::Clear() {
   if (data_ != NULL) {
-    delete[] static_cast<float *>(data_);
+    allocator_->Free(data_, capacity_);
     data_ = NULL;
   }
+  capacity_ = 0;
 }
 
-CompressedMatrix::CompressedMatrix(const CompressedMatrix &mat) : data_(NULL) {
+CompressedMatrix::CompressedMatrix(const CompressedMatrix &mat)
+    : data_(NULL), capacity_(0), allocator_(NULL) {
   *this = mat;  // use assignment operator.
 }
 
 CompressedMatrix &CompressedMatrix::operator=(const CompressedMatrix &mat) {
-  Clear();  // now this->data_ == NULL.
-  if (mat.data_ != NULL) {
+  if (mat.data_ == NULL) {
+    Clear();
+  } else if (&mat != this) {
     MatrixIndexT data_size = DataSize(*static_cast<GlobalHeader *>(mat.data_));
-    data_ = AllocateData(data_size);
+    Reallocate(data_size);
     memcpy(static_cast<void *>(data_), static_cast<void *>(mat.data_),
            data_size);
   }
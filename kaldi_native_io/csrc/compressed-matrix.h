@@ -12,6 +12,7 @@
 #include <utility>
 
 #include "kaldi_native_io/csrc/kaldi-matrix.h"
+#include "kaldi_native_io/csrc/memory-allocator.h"
 
 namespace kaldiio {
 
@@ -70,15 +71,17 @@ enum CompressionMethod {
 
 class CompressedMatrix {
  public:
-  CompressedMatrix() : data_(NULL) {}
+  CompressedMatrix() : data_(NULL), capacity_(0), allocator_(NULL) {}
 
   ~CompressedMatrix() { Clear(); }
 
+  /// See CopyFromMat() for num_threads.
   template <typename Real>
   explicit CompressedMatrix(const MatrixBase<Real> &mat,
-                            CompressionMethod method = kAutomaticMethod)
-      : data_(NULL) {
-    CopyFromMat(mat, method);
+                            CompressionMethod method = kAutomaticMethod,
+                            int32 num_threads = 1)
+      : data_(NULL), capacity_(0), allocator_(NULL) {
+    CopyFromMat(mat, method, num_threads);
   }
 
   /// Initializer that can be used to select part of an existing
@@ -100,9 +103,13 @@ class CompressedMatrix {
   void *Data() const { return this->data_; }
 
   /// This will resize *this and copy the contents of mat to *this.
+  /// If num_threads > 1, the compression is split among up to that many
+  /// threads (fewer for small matrices); the result does not depend on
+  /// num_threads.
   template <typename Real>
   void CopyFromMat(const MatrixBase<Real> &mat,
-                   CompressionMethod method = kAutomaticMethod);
+                   CompressionMethod method = kAutomaticMethod,
+                   int32 num_threads = 1);
 
   CompressedMatrix(const CompressedMatrix &mat);
 
@@ -114,15 +121,51 @@ class CompressedMatrix {
       const MatrixBase<Real> &mat);  // assignment operator.
 
   /// Copies contents to matrix.  Note: mat must have the correct size.
-  /// The kTrans case uses a temporary.
   template <typename Real>
   void CopyToMat(MatrixBase<Real> *mat,
                  MatrixTransposeType trans = kNoTrans) const;
 
+  /// Copies the num_rows by num_cols submatrix starting at (row_offset,
+  /// col_offset) to the memory at 'data', without going through a Matrix,
+  /// e.g. straight into a preallocated minibatch.  If trans == kNoTrans, row r
+  /// of the submatrix is written to data + r * stride; if trans == kTrans,
+  /// column c of the submatrix is written to data + c * stride.  T may be
+  /// float, double, or uint16 for IEEE half precision (see FloatToHalf() in
+  /// half-matrix.h).
+  template <typename T>
+  void CopyToData(int32 row_offset, int32 col_offset, int32 num_rows,
+                  int32 num_cols, T *data, MatrixIndexT stride,
+                  MatrixTransposeType trans = kNoTrans) const;
+
+  /// The same for the whole matrix.
+  template <typename T>
+  void CopyToData(T *data, MatrixIndexT stride,
+                  MatrixTransposeType trans = kNoTrans) const {
+    CopyToData(0, 0, NumRows(), NumCols(), data, stride, trans);
+  }
+
   void Write(std::ostream &os, bool binary) const;
 
   void Read(std::istream &is, bool binary);
 
+  /// The following two functions read part of a binary compressed matrix
+  /// without reading all of it, e.g. to extract a range of rows (see
+  /// ReadObjectRange() in kaldi-holder.h).  They need a stream that can seek.
+  ///
+  /// ReadSize() reads the size of the compressed matrix at the current
+  /// position of 'is', which must be at its token ("CM", "CM2" or "CM3"),
+  /// and then returns 'is' to that position.  It returns false if there is
+  /// no compressed matrix there or 'is' cannot seek.
+  static bool ReadSize(std::istream &is, int32 *num_rows, int32 *num_cols);
+
+  /// ReadRows() reads into *this the rows [row_offset, row_offset + num_rows)
+  /// of the compressed matrix at the current position of 'is', as the
+  /// constructor above that selects part of a CompressedMatrix would give
+  /// from the whole matrix, but reads only the bytes of those rows and seeks
+  /// over the rest.  It leaves 'is' at the end of the matrix.  Like Read(),
+  /// it throws on error.
+  void ReadRows(std::istream &is, int32 row_offset, int32 num_rows);
+
   /// Returns number of rows (or zero for emtpy matrix).
   inline MatrixIndexT NumRows() const {
     return (data_ == NULL)
@@ -137,6 +180,15 @@ class CompressedMatrix {
                : (*reinterpret_cast<GlobalHeader *>(data_)).num_cols;
   }
 
+  /// Returns the number of bytes of compressed data (or zero for empty
+  /// matrix).
+  MatrixIndexT SizeInBytes() const;
+
+  /// Returns the number of bytes of memory allocated for the data.  Reading
+  /// or copying a matrix into *this reuses that memory if the new data fits
+  /// in it, so this may be more than SizeInBytes().
+  MatrixIndexT CapacityInBytes() const { return capacity_; }
+
   /// Copies row #row of the matrix into vector v.
   /// Note: v must have same size as #cols.
   template <typename Real>
@@ -154,8 +206,13 @@ class CompressedMatrix {
   void CopyToMat(int32 row_offset, int32 column_offset,
                  MatrixBase<Real> *dest) const;
 
-  void Swap(CompressedMatrix *other) { std::swap(data_, other->data_); }
+  void Swap(CompressedMatrix *other) {
+    std::swap(data_, other->data_);
+    std::swap(capacity_, other->capacity_);
+    std::swap(allocator_, other->allocator_);
+  }
 
+  /// Frees the memory.
   void Clear();
 
   /// scales all elements of matrix by alpha.
@@ -187,9 +244,9 @@ class CompressedMatrix {
   //       float f = g.min_value + i * (g.range / 255.0)
   enum DataFormat { kOneByteWithColHeaders = 1, kTwoByte = 2, kOneByte = 3 };
 
-  // allocates data using new [], ensures byte alignment
-  // sufficient for float.
-  static void *AllocateData(int32 num_bytes);
+  // Makes data_ point to at least num_bytes bytes, reusing the memory it
+  // points to if it is big enough; the contents are undefined.
+  void Reallocate(int32 num_bytes);
 
   struct GlobalHeader {
     int32 format;     // Represents the enum DataFormat.
@@ -208,6 +265,10 @@ class CompressedMatrix {
                                          CompressionMethod method,
                                          GlobalHeader *header);
 
+  // Reads the token and the global header of a binary compressed matrix;
+  // throws on error.
+  static void ReadGlobalHeader(std::istream &is, GlobalHeader *header);
+
   // The number of bytes we need to request when allocating 'data_'.
   static MatrixIndexT DataSize(const GlobalHeader &header);
 
@@ -219,6 +280,15 @@ class CompressedMatrix {
     uint16 percentile_100;
   };
 
+  // Compresses the columns [col_begin, col_end) of 'mat' into the
+  // kOneByteWithColHeaders format; 'header_data' and 'byte_data' point to the
+  // data for column 0.
+  template <typename Real>
+  static void CompressColumns(const GlobalHeader &global_header,
+                              const MatrixBase<Real> &mat, int32 col_begin,
+                              int32 col_end, PerColHeader *header_data,
+                              uint8 *byte_data);
+
   template <typename Real>
   static void CompressColumn(const GlobalHeader &global_header,
                              const Real *data, MatrixIndexT stride,
@@ -229,6 +299,12 @@ class CompressedMatrix {
                                const Real *data, MatrixIndexT stride,
                                int32 num_rows, PerColHeader *header);
 
+  // Sets *header from the FloatToUint16() of the percentiles of a column,
+  // adjusting them to be strictly increasing.
+  static void SetColHeader(uint16 percentile_0, uint16 percentile_25,
+                           uint16 percentile_75, uint16 percentile_100,
+                           PerColHeader *header);
+
   static inline uint16 FloatToUint16(const GlobalHeader &global_header,
                                      float value);
 
@@ -247,11 +323,33 @@ class CompressedMatrix {
   static inline float CharToFloat(float p0, float p25, float p75, float p100,
                                   uint8 value);
 
+  // Sets table[i] = CharToFloat(p0, p25, p75, p100, i) for i = 0..255, where
+  // p0 etc. are from 'col_header'; decoding a column is then a table lookup
+  // per element instead of a branch.
+  static void ComputeCharToFloatTable(const GlobalHeader &global_header,
+                                      const PerColHeader &col_header,
+                                      float *table);
+
+  // Implements CopyToData() for the kOneByteWithColHeaders format.
+  template <typename T>
+  void CopyColHeaderFormatToData(int32 row_offset, int32 col_offset,
+                                 int32 num_rows, int32 num_cols, T *data,
+                                 MatrixIndexT stride,
+                                 MatrixTransposeType trans) const;
+
   void *data_;  // first GlobalHeader, then PerColHeader (repeated), then
   // the byte data for each column (repeated).  Note: don't intersperse
   // the byte data with the PerColHeaders, because of alignment issues.
+  int32 capacity_;  // The number of bytes data_ has room for.
+  MemoryAllocator *allocator_;  // The allocator data_ was allocated with.
 };
 
+// Returns the number of bytes of memory used by cmat; see MemoryUsage() in
+// stl-utils.h.
+inline size_t MemoryUsage(const CompressedMatrix &cmat) {
+  return sizeof(cmat) + cmat.CapacityInBytes();
+}
+
 }  // namespace kaldiio
 
 #endif  // KALDI_NATIVE_IO_CSRC_COMPRESSED_MATRIX_H_
@@ -0,0 +1,192 @@
+// kaldi_native_io/csrc/flat-vector-vector.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_FLAT_VECTOR_VECTOR_H_
+#define KALDI_NATIVE_IO_CSRC_FLAT_VECTOR_VECTOR_H_
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "kaldi_native_io/csrc/io-funcs.h"
+#include "kaldi_native_io/csrc/kaldi-holder.h"
+#include "kaldi_native_io/csrc/log.h"
+
+namespace kaldiio {
+
+/// FlatVectorVector holds the same data as std::vector<std::vector<BasicType>>
+/// in two flat arrays: vector i is Values()[k] for k in
+/// [Offsets()[i], Offsets()[i + 1]).  It is read and written in the same
+/// format as BasicVectorVectorHolder<BasicType>, with a few allocations in all
+/// instead of one per vector, and none when it is read into one that has room
+/// for the data already (see IsReusableForRead).
+template <class BasicType>
+class FlatVectorVector {
+ public:
+  FlatVectorVector() : offsets_(1, 0) {}
+
+  explicit FlatVectorVector(const std::vector<std::vector<BasicType>> &v) {
+    CopyFromVectorVector(v);
+  }
+
+  int32_t NumVectors() const {
+    return static_cast<int32_t>(offsets_.size()) - 1;
+  }
+
+  /// The total number of values.
+  int32_t NumElements() const { return offsets_.back(); }
+
+  /// Has NumVectors() + 1 elements, the first one 0 and the last one
+  /// NumElements().
+  const std::vector<int32_t> &Offsets() const { return offsets_; }
+
+  /// Has NumElements() elements.
+  const std::vector<BasicType> &Values() const { return values_; }
+
+  void CopyFromVectorVector(const std::vector<std::vector<BasicType>> &v) {
+    offsets_.resize(v.size() + 1);
+    offsets_[0] = 0;
+    values_.clear();
+    for (size_t i = 0; i < v.size(); i++) {
+      values_.insert(values_.end(), v[i].begin(), v[i].end());
+      KALDIIO_ASSERT(values_.size() <=
+                     static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+      offsets_[i + 1] = static_cast<int32_t>(values_.size());
+    }
+  }
+
+  void CopyToVectorVector(std::vector<std::vector<BasicType>> *v) const {
+    v->resize(NumVectors());
+    for (int32_t i = 0; i < NumVectors(); i++)
+      (*v)[i].assign(values_.begin() + offsets_[i],
+                     values_.begin() + offsets_[i + 1]);
+  }
+
+  void Read(std::istream &is, bool binary) {
+    offsets_.resize(1);
+    values_.clear();
+    if (!binary) {
+      ReadText(is);
+      return;
+    }
+    BinaryBasicTypeReader reader(is);
+    int32_t size;
+    reader.Expect(reader.MinBinarySize<int32_t>());
+    reader.Read(&size);
+    if (size < 0) KALDIIO_ERR << "Invalid size " << size;
+    offsets_.resize(size + 1);
+    // Each vector starts with its size.
+    reader.Expect(size * reader.MinBinarySize<int32_t>());
+    for (int32_t i = 0; i < size; i++) {
+      int32_t size2;
+      reader.Read(&size2);
+      if (size2 < 0) KALDIIO_ERR << "Invalid size " << size2;
+      size_t begin = values_.size();
+      if (begin + size2 >
+          static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        KALDIIO_ERR << "Too many elements";
+      values_.resize(begin + size2);
+      reader.Expect(size2 * reader.MinBinarySize<BasicType>());
+      reader.ReadArray<BasicType>(size2, [this, begin](size_t j, BasicType b) {
+        values_[begin + j] = b;
+      });
+      offsets_[i + 1] = static_cast<int32_t>(begin + size2);
+    }
+  }
+
+  void Write(std::ostream &os, bool binary) const {
+    if (binary) {
+      BinaryBasicTypeWriter writer(os);
+      writer.Write(NumVectors());
+      for (int32_t i = 0; i < NumVectors(); i++) {
+        int32_t begin = offsets_[i];
+        writer.Write(offsets_[i + 1] - begin);
+        writer.WriteArray<BasicType>(offsets_[i + 1] - begin,
+                                     [this, begin](size_t j) -> BasicType {
+                                       return values_[begin + j];
+                                     });
+      }
+      writer.Flush();
+    } else {
+      // The same format as BasicVectorVectorHolder, e.g. (for integers)
+      // "1 2 3 ; 4 5 ; 6 ; ; 7 8 9 ;\n".
+      TextBasicTypeWriter writer(os);
+      for (int32_t i = 0; i < NumVectors(); i++) {
+        for (int32_t k = offsets_[i]; k < offsets_[i + 1]; k++)
+          writer.Write(static_cast<BasicType>(values_[k]));
+        writer.WriteString("; ");
+      }
+      writer.WriteString("\n");
+      writer.Flush();
+    }
+    if (!os.good()) KALDIIO_ERR << "Output stream error writing vectors.";
+  }
+
+  void Swap(FlatVectorVector<BasicType> *other) {
+    offsets_.swap(other->offsets_);
+    values_.swap(other->values_);
+  }
+
+ private:
+  // Reads the text format of BasicVectorVectorHolder, which ends with a
+  // newline.
+  void ReadText(std::istream &is) {
+    size_t begin = 0;  // The first value of the vector being read.
+    while (1) {
+      int i = is.peek();
+      if (i == -1) {
+        KALDIIO_ERR << "Unexpected EOF";
+      } else if (static_cast<char>(i) == '\n') {
+        if (values_.size() != begin)
+          KALDIIO_ERR << "No semicolon before newline (wrong format)";
+        is.get();
+        return;
+      } else if (std::isspace(i)) {
+        is.get();
+      } else if (static_cast<char>(i) == ';') {
+        if (values_.size() >
+            static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+          KALDIIO_ERR << "Too many elements";
+        begin = values_.size();
+        offsets_.push_back(static_cast<int32_t>(begin));
+        is.get();
+      } else {  // some object we want to read...
+        BasicType b;
+        ReadBasicType(is, false, &b);  // throws on error.
+        values_.push_back(b);
+      }
+    }
+  }
+
+  std::vector<int32_t> offsets_;
+  std::vector<BasicType> values_;
+};
+
+// Returns the number of bytes of memory used by v; see MemoryUsage() in
+// stl-utils.h.
+template <class BasicType>
+size_t MemoryUsage(const FlatVectorVector<BasicType> &v) {
+  return sizeof(v) + v.Offsets().capacity() * sizeof(int32_t) +
+         v.Values().capacity() * sizeof(BasicType);
+}
+
+template <class BasicType>
+struct IsReusableForRead<FlatVectorVector<BasicType>> : public std::true_type {
+};
+
+/// A holder for vectors of vectors of basic types that reads and writes the
+/// same format as BasicVectorVectorHolder<BasicType>, but keeps the values in
+/// one array; see FlatVectorVector.
+template <class BasicType>
+using BasicFlatVectorVectorHolder =
+    KaldiObjectHolder<FlatVectorVector<BasicType>>;
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_FLAT_VECTOR_VECTOR_H_
@@ -0,0 +1,121 @@
+// kaldi_native_io/csrc/half-matrix.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/half-matrix.h"
+
+#include <string>
+#include <utility>
+
+#include "kaldi_native_io/csrc/io-funcs.h"
+
+namespace kaldiio {
+
+template <typename Real>
+void HalfMatrix::CopyFromMat(const MatrixBase<Real> &mat, HalfFormat format) {
+  num_rows_ = mat.NumRows();
+  num_cols_ = mat.NumCols();
+  format_ = format;
+  data_.resize(static_cast<size_t>(num_rows_) * num_cols_);
+  uint16 *data = data_.data();
+  for (MatrixIndexT r = 0; r < num_rows_; r++, data += num_cols_) {
+    const Real *row_data = mat.RowData(r);
+    if (format == kFloat16) {
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        data[c] = FloatToHalf(row_data[c]);
+    } else {
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        data[c] = FloatToBFloat16(row_data[c]);
+    }
+  }
+}
+
+template <typename Real>
+void HalfMatrix::CopyToMat(MatrixBase<Real> *mat) const {
+  KALDIIO_ASSERT(mat->NumRows() == num_rows_ && mat->NumCols() == num_cols_);
+  const uint16 *data = data_.data();
+  for (MatrixIndexT r = 0; r < num_rows_; r++, data += num_cols_) {
+    Real *row_data = mat->RowData(r);
+    if (format_ == kFloat16) {
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        row_data[c] = HalfToFloat(data[c]);
+    } else {
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        row_data[c] = BFloat16ToFloat(data[c]);
+    }
+  }
+}
+
+// Instantiate the templates for float and double.
+template void HalfMatrix::CopyFromMat(const MatrixBase<float> &mat,
+                                      HalfFormat format);
+template void HalfMatrix::CopyFromMat(const MatrixBase<double> &mat,
+                                      HalfFormat format);
+template void HalfMatrix::CopyToMat(MatrixBase<float> *mat) const;
+template void HalfMatrix::CopyToMat(MatrixBase<double> *mat) const;
+
+void HalfMatrix::Write(std::ostream &os, bool binary) const {
+  if (binary) {
+    // The same layout as MatrixBase::Write() uses for "FM", with two bytes
+    // per element.
+    WriteToken(os, binary, format_ == kFloat16 ? "HM" : "BM");
+    WriteBasicType(os, binary, num_rows_);
+    WriteBasicType(os, binary, num_cols_);
+    os.write(reinterpret_cast<const char *>(data_.data()),
+             sizeof(uint16) * data_.size());
+  } else {
+    // In text mode, just use the same format as a regular matrix.
+    Matrix<float> temp_mat(num_rows_, num_cols_, kUndefined);
+    CopyToMat(&temp_mat);
+    temp_mat.Write(os, binary);
+  }
+  if (os.fail()) KALDIIO_ERR << "Error writing half matrix to stream.";
+}
+
+void HalfMatrix::Read(std::istream &is, bool binary) {
+  if (binary) {
+    int peekval = Peek(is, binary);
+    if (peekval == 'H' || peekval == 'B') {
+      std::string token;
+      ReadToken(is, binary, &token);
+      if (token == "HM") {
+        format_ = kFloat16;
+      } else if (token == "BM") {
+        format_ = kBFloat16;
+      } else {
+        KALDIIO_ERR << "Expected token HM or BM, got " << token;
+      }
+      int32 num_rows, num_cols;
+      ReadBasicType(is, binary, &num_rows);  // throws on error.
+      ReadBasicType(is, binary, &num_cols);  // throws on error.
+      if (num_rows < 0 || num_cols < 0)
+        KALDIIO_ERR << "Invalid size " << num_rows << " x " << num_cols
+                    << " of half matrix.";
+      num_rows_ = num_rows;
+      num_cols_ = num_cols;
+      data_.resize(static_cast<size_t>(num_rows) * num_cols);
+      is.read(reinterpret_cast<char *>(data_.data()),
+              sizeof(uint16) * data_.size());
+    } else {
+      // Assume that what we're reading is a regular or compressed Matrix, as
+      // CompressedMatrix::Read() does.
+      Matrix<float> temp;
+      temp.Read(is, binary);
+      CopyFromMat(temp);
+    }
+  } else {
+    Matrix<float> temp;
+    temp.Read(is, binary);
+    CopyFromMat(temp);
+  }
+  if (is.fail()) KALDIIO_ERR << "Failed to read half matrix.";
+}
+
+void HalfMatrix::Swap(HalfMatrix *other) {
+  std::swap(num_rows_, other->num_rows_);
+  std::swap(num_cols_, other->num_cols_);
+  std::swap(format_, other->format_);
+  data_.swap(other->data_);
+}
+
+}  // namespace kaldiio
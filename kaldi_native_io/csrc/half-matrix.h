@@ -0,0 +1,150 @@
+// kaldi_native_io/csrc/half-matrix.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_HALF_MATRIX_H_
+#define KALDI_NATIVE_IO_CSRC_HALF_MATRIX_H_
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "kaldi_native_io/csrc/kaldi-matrix.h"
+#include "kaldi_native_io/csrc/log.h"
+
+namespace kaldiio {
+
+/// The 16-bit floating point formats a HalfMatrix can store its elements in.
+///
+///   kFloat16   IEEE 754 half precision: 11 bits of precision, but only values
+///              up to 65504 in magnitude (larger ones become infinity).
+///              Written with the token "HM".
+///   kBFloat16  bfloat16, i.e. the upper 16 bits of a float: only 8 bits of
+///              precision, but the same range as float.  Written with the
+///              token "BM".
+enum HalfFormat { kFloat16 = 0, kBFloat16 = 1 };
+
+// The conversions below are written without branches (the cases are selected
+// with bit masks) so that loops calling them vectorize.
+
+/// Converts a float to IEEE half precision, rounding to the nearest
+/// representable value (ties to even).  Values too large for half precision
+/// become infinity, and NaN stays NaN.
+inline uint16 FloatToHalf(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  x &= 0x7fffffff;
+  uint32_t is_large = -static_cast<uint32_t>(x >= 0x47800000),
+           is_small = -static_cast<uint32_t>(x < 0x38800000),
+           is_nan = -static_cast<uint32_t>(x > 0x7f800000);
+  // Inf, NaN or too large.
+  uint32_t large = 0x7c00 | (is_nan & 0x200);
+  // Subnormal in half precision, or zero: adding 0.5 shifts the mantissa bits
+  // we want to the bottom, and the floating point addition does the rounding.
+  float g;
+  memcpy(&g, &x, sizeof(g));
+  g += 0.5f;
+  uint32_t small;
+  memcpy(&small, &g, sizeof(small));
+  small -= 0x3f000000;
+  // Normal: rebias the exponent and round, adding 0xfff plus the lowest bit we
+  // keep.
+  uint32_t normal = (x + (static_cast<uint32_t>(15 - 127) << 23) + 0xfff +
+                     ((x >> 13) & 1)) >> 13;
+  uint32_t ans = (large & is_large) | (small & is_small) |
+                 (normal & ~(is_large | is_small));
+  return static_cast<uint16>(ans | sign);
+}
+
+/// Converts an IEEE half precision value to float; this is exact.
+inline float HalfToFloat(uint16 h) {
+  uint32_t x = static_cast<uint32_t>(h & 0x7fff) << 13;
+  uint32_t exponent = x & (0x7c00 << 13);
+  uint32_t is_inf_nan = -static_cast<uint32_t>(exponent == (0x7c00 << 13)),
+           is_subnormal = -static_cast<uint32_t>(exponent == 0);
+  // Rebias the exponent; for Inf and NaN it is all ones.
+  uint32_t normal = x + ((127 - 15) << 23) + (is_inf_nan & ((128 - 16) << 23));
+  // Zero or subnormal: renormalize.
+  uint32_t y = x + ((127 - 15 + 1) << 23);
+  float f;
+  memcpy(&f, &y, sizeof(f));
+  f -= 6.103515625e-05f;  // 2^-14
+  uint32_t subnormal;
+  memcpy(&subnormal, &f, sizeof(subnormal));
+  uint32_t ans = (normal & ~is_subnormal) | (subnormal & is_subnormal) |
+                 (static_cast<uint32_t>(h & 0x8000) << 16);
+  float ans_f;
+  memcpy(&ans_f, &ans, sizeof(ans_f));
+  return ans_f;
+}
+
+/// Converts a float to bfloat16, rounding to the nearest representable value
+/// (ties to even).
+inline uint16 FloatToBFloat16(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t is_nan = -static_cast<uint32_t>((x & 0x7fffffff) > 0x7f800000);
+  uint32_t nan = (x >> 16) | 0x40,  // Keep NaN a NaN.
+      rounded = (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+  return static_cast<uint16>((nan & is_nan) | (rounded & ~is_nan));
+}
+
+/// Converts a bfloat16 value to float; this is exact.
+inline float BFloat16ToFloat(uint16 h) {
+  uint32_t x = static_cast<uint32_t>(h) << 16;
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/// HalfMatrix stores a matrix with 16-bit floating point elements (see enum
+/// HalfFormat).  This halves the size of FM matrices on disk, with much less
+/// loss of precision than CompressedMatrix's one-byte formats, and is cheap to
+/// convert back to float.  Matrix<float>::Read() and Matrix<double>::Read()
+/// read it as a regular matrix, like a CompressedMatrix.
+class HalfMatrix {
+ public:
+  HalfMatrix() : num_rows_(0), num_cols_(0), format_(kFloat16) {}
+
+  template <typename Real>
+  explicit HalfMatrix(const MatrixBase<Real> &mat,
+                      HalfFormat format = kFloat16)
+      : num_rows_(0), num_cols_(0), format_(format) {
+    CopyFromMat(mat, format);
+  }
+
+  /// This will resize *this and copy the contents of mat to *this.
+  template <typename Real>
+  void CopyFromMat(const MatrixBase<Real> &mat, HalfFormat format = kFloat16);
+
+  /// Copies contents to matrix.  Note: mat must have the correct size.
+  template <typename Real>
+  void CopyToMat(MatrixBase<Real> *mat) const;
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Read(std::istream &is, bool binary);
+
+  MatrixIndexT NumRows() const { return num_rows_; }
+
+  MatrixIndexT NumCols() const { return num_cols_; }
+
+  HalfFormat Format() const { return format_; }
+
+  /// The elements, in row-major order.
+  const uint16 *Data() const { return data_.data(); }
+
+  void Swap(HalfMatrix *other);
+
+ private:
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  HalfFormat format_;
+  std::vector<uint16> data_;
+};
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_HALF_MATRIX_H_
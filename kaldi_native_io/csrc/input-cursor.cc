@@ -0,0 +1,130 @@
+// kaldi_native_io/csrc/input-cursor.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/input-cursor.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace kaldiio {
+
+namespace {
+
+// isspace() in the "C" locale, which operator>> uses by default.
+inline bool IsSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+}  // namespace
+
+const size_t InputCursor::kBlockSize;
+
+InputCursor::InputCursor(const char *data, size_t size)
+    : source_(NULL), offset_(0), stream_(this) {
+  char *begin = const_cast<char *>(data);
+  setg(begin, begin, begin + size);
+}
+
+InputCursor::InputCursor(std::istream &is)
+    : source_(is.rdbuf()), buf_(kBlockSize), offset_(0), stream_(this) {
+  KALDIIO_ASSERT(source_ != NULL);
+  setg(buf_.data(), buf_.data(), buf_.data());
+}
+
+bool InputCursor::ReadToken(std::string *token) {
+  token->clear();
+  while (true) {
+    if (Fill(1) == 0) return false;
+    const char *p = gptr(), *end = egptr();
+    while (p != end && IsSpace(*p)) p++;
+    Consume(p - gptr());
+    if (p != end) break;
+  }
+  while (true) {
+    const char *p = gptr(), *end = egptr();
+    while (p != end && !IsSpace(*p)) p++;
+    token->append(gptr(), p - gptr());
+    Consume(p - gptr());
+    if (p != end) return true;
+    if (Fill(1) == 0) return false;
+  }
+}
+
+size_t InputCursor::FillSlow(size_t num_bytes) {
+  size_t num_available = NumAvailable();
+  if (source_ == NULL || num_available >= num_bytes) return num_available;
+  // Moves the unread bytes to the start of the buffer.
+  size_t begin = gptr() - buf_.data();
+  offset_ += begin;
+  memmove(buf_.data(), buf_.data() + begin, num_available);
+  if (buf_.size() < num_bytes)
+    buf_.resize(std::max(num_bytes, 2 * buf_.size()));
+  size_t end = num_available;
+  while (end < num_bytes) {
+    size_t num_wanted = num_bytes - end;
+    // Takes all that the source has buffered, which it can give without
+    // waiting for input.
+    std::streamsize num_buffered = source_->in_avail();
+    if (num_buffered > 0)
+      num_wanted = std::max(
+          num_wanted,
+          std::min(static_cast<size_t>(num_buffered), buf_.size() - end));
+    std::streamsize n = source_->sgetn(buf_.data() + end, num_wanted);
+    if (n <= 0) break;
+    end += n;
+  }
+  setg(buf_.data(), buf_.data(), buf_.data() + end);
+  return end;
+}
+
+InputCursor::int_type InputCursor::underflow() {
+  if (FillSlow(1) == 0) return traits_type::eof();
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize InputCursor::xsgetn(char *s, std::streamsize n) {
+  size_t num_wanted = static_cast<size_t>(n);
+  size_t num_available = NumAvailable();
+  if (source_ == NULL || num_wanted <= num_available) {
+    size_t num_read = std::min(num_wanted, num_available);
+    memcpy(s, gptr(), num_read);
+    Consume(num_read);
+    return num_read;
+  }
+  // Reads what is not buffered straight from the source, e.g. the data of a
+  // large matrix.
+  memcpy(s, gptr(), num_available);
+  std::streamsize num_read =
+      source_->sgetn(s + num_available, num_wanted - num_available);
+  if (num_read < 0) num_read = 0;
+  offset_ += (egptr() - eback()) + num_read;
+  setg(buf_.data(), buf_.data(), buf_.data());
+  return num_available + num_read;
+}
+
+InputCursor::pos_type InputCursor::seekoff(off_type off,
+                                           std::ios_base::seekdir dir,
+                                           std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+  off_type pos;
+  if (dir == std::ios_base::beg)
+    pos = off - offset_;
+  else if (dir == std::ios_base::cur)
+    pos = (gptr() - eback()) + off;
+  else if (source_ == NULL)
+    pos = (egptr() - eback()) + off;
+  else
+    return pos_type(off_type(-1));  // The end of a stream is not known.
+  if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+  setg(eback(), eback() + pos, egptr());
+  return pos_type(offset_ + pos);
+}
+
+InputCursor::pos_type InputCursor::seekpos(pos_type pos,
+                                           std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+}  // namespace kaldiio
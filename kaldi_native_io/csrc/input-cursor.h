@@ -0,0 +1,106 @@
+// kaldi_native_io/csrc/input-cursor.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_INPUT_CURSOR_H_
+#define KALDI_NATIVE_IO_CSRC_INPUT_CURSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "kaldi_native_io/csrc/log.h"
+
+namespace kaldiio {
+
+/// InputCursor reads input from a contiguous buffer: either a block of memory
+/// that it reads in place (e.g. a memory-mapped archive), or a buffer that it
+/// fills from a stream in large blocks.  Table readers read the keys of
+/// archives with it, and decode the objects of holders that support it (see
+/// HolderReadsCursor) straight from its buffer, e.g. with
+/// BinaryBasicTypeReader, instead of going through std::istream for every few
+/// bytes.  Code that needs an istream reads the same input through Stream().
+class InputCursor : public std::streambuf {
+ public:
+  /// Reads [data, data + size), which must outlive this object.
+  InputCursor(const char *data, size_t size);
+
+  /// Reads from the stream buffer of is.  It takes what the stream has
+  /// buffered already, but never waits for more input (e.g. from a pipe)
+  /// than it needs.  The stream must not be used while this object is.
+  explicit InputCursor(std::istream &is);
+
+  /// The buffered unread bytes are [Data(), Data() + NumAvailable()).
+  const char *Data() const { return gptr(); }
+  size_t NumAvailable() const { return egptr() - gptr(); }
+
+  /// Makes at least num_bytes bytes available, unless the input ends first;
+  /// returns NumAvailable().
+  size_t Fill(size_t num_bytes) {
+    size_t num_available = NumAvailable();
+    return num_available >= num_bytes ? num_available : FillSlow(num_bytes);
+  }
+
+  /// Skips num_bytes bytes, which must be available.
+  void Consume(size_t num_bytes) {
+    setg(eback(), gptr() + num_bytes, egptr());
+  }
+
+  /// Returns the next byte, or -1 at the end of the input.
+  int Peek() {
+    return Fill(1) != 0 ? static_cast<unsigned char>(*gptr()) : -1;
+  }
+
+  /// Skips whitespace and reads the whitespace-free token after it into
+  /// *token, like "is >> *token" does.  Returns false if the input ends
+  /// before whitespace follows the token.
+  bool ReadToken(std::string *token);
+
+  /// Returns true if the input continues with the binary-mode header "\0B";
+  /// see InitKaldiInputStream().
+  bool PeekBinaryHeader() {
+    return Fill(2) >= 2 && gptr()[0] == '\0' && gptr()[1] == 'B';
+  }
+
+  /// The number of bytes read so far.
+  int64_t Position() const { return offset_ + (gptr() - eback()); }
+
+  /// An istream that reads from this object, for code that needs one, e.g.
+  /// the Read() functions of holders; reading from it moves the cursor.  Its
+  /// error state is cleared on each call.
+  std::istream &Stream() {
+    stream_.clear();
+    return stream_;
+  }
+
+ protected:
+  int_type underflow() override;
+
+  std::streamsize xsgetn(char *s, std::streamsize n) override;
+
+  // Seeking is only possible within the buffered input, which for a block of
+  // memory is all of it.
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which = std::ios_base::in) override;
+
+  pos_type seekpos(pos_type pos,
+                   std::ios_base::openmode which = std::ios_base::in) override;
+
+ private:
+  size_t FillSlow(size_t num_bytes);
+
+  static const size_t kBlockSize = 65536;
+
+  std::streambuf *source_;  // NULL when reading a block of memory.
+  std::vector<char> buf_;   // The buffer when reading from source_.
+  int64_t offset_;          // The position of eback() in the input.
+  std::istream stream_;
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(InputCursor)
+};
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_INPUT_CURSOR_H_
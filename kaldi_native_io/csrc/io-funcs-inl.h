@@ -14,6 +14,8 @@
 #include <limits>
 
 #include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/number-format.h"
+#include "kaldi_native_io/csrc/text-scanner.h"
 
 namespace kaldiio {
 
@@ -63,10 +65,10 @@ void WriteBasicType(std::ostream &os, bool binary, T t) {
     os.put(len_c);
     os.write(reinterpret_cast<const char *>(&t), sizeof(t));
   } else {
-    if (sizeof(t) == 1)
-      os << static_cast<int16_t>(t) << " ";
-    else
-      os << t << " ";
+    char buf[kMaxNumberChars + 1];
+    char *end = FormatNumber(t, buf);
+    *end++ = ' ';
+    os.write(buf, end - buf);
   }
   if (os.fail()) {
     KALDIIO_ERR << "Write failure in WriteBasicType.";
@@ -98,10 +100,10 @@ inline void ReadBasicType(std::istream &is, bool binary, T *t) {
   } else {
     if (sizeof(*t) == 1) {
       int16_t i;
-      is >> i;
+      ScanNumber(is, &i);
       *t = i;
     } else {
-      is >> *t;
+      ScanNumber(is, t);
     }
   }
   if (is.fail()) {
@@ -110,6 +112,18 @@ inline void ReadBasicType(std::istream &is, bool binary, T *t) {
   }
 }
 
+template <class T>
+inline bool ParseBasicType(const char *begin, const char *end, T *t) {
+  if (std::is_integral<T>::value && sizeof(*t) == 1) {
+    // Like ReadBasicType().
+    int16_t i;
+    if (!ParseNumber(begin, end, &i)) return false;
+    *t = static_cast<T>(i);
+    return true;
+  }
+  return ParseNumber(begin, end, t);
+}
+
 }  // namespace kaldiio
 
 #endif  // KALDI_NATIVE_IO_CSRC_IO_FUNCS_INL_H_
@@ -9,10 +9,12 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <string>
 
 #include "kaldi_native_io/csrc/kaldi-utils.h"
 #include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/text-scanner.h"
 
 namespace kaldiio {
 
@@ -47,7 +49,10 @@ void WriteBasicType<float>(std::ostream &os, bool binary, float f) {
     os.put(c);
     os.write(reinterpret_cast<const char *>(&f), sizeof(f));
   } else {
-    os << f << " ";
+    char buf[kMaxNumberChars + 1];
+    char *end = FormatNumber(f, buf);
+    *end++ = ' ';
+    os.write(buf, end - buf);
   }
 }
 
@@ -58,7 +63,10 @@ void WriteBasicType<double>(std::ostream &os, bool binary, double f) {
     os.put(c);
     os.write(reinterpret_cast<const char *>(&f), sizeof(f));
   } else {
-    os << f << " ";
+    char buf[kMaxNumberChars + 1];
+    char *end = FormatNumber(f, buf);
+    *end++ = ' ';
+    os.write(buf, end - buf);
   }
 }
 
@@ -79,7 +87,7 @@ void ReadBasicType<float>(std::istream &is, bool binary, float *f) {
                   << ", at file position " << is.tellg();
     }
   } else {
-    is >> *f;
+    ScanNumber(is, f);
   }
   if (is.fail()) {
     KALDIIO_ERR << "ReadBasicType: failed to read, at file position "
@@ -104,7 +112,7 @@ void ReadBasicType<double>(std::istream &is, bool binary, double *d) {
                   << ", at file position " << is.tellg();
     }
   } else {
-    is >> *d;
+    ScanNumber(is, d);
   }
   if (is.fail()) {
     KALDIIO_ERR << "ReadBasicType: failed to read, at file position "
@@ -206,4 +214,96 @@ int Peek(std::istream &is, bool binary) {
   return is.peek();
 }
 
+const size_t BinaryBasicTypeReader::kBufferSize;
+const size_t BinaryBasicTypeWriter::kBufferSize;
+
+void BinaryBasicTypeReader::FillSlow(size_t num_bytes) {
+  size_t num_buffered;
+  if (cursor_ != NULL) {
+    cursor_->Consume(data_ - cursor_->Data());
+    num_buffered = cursor_->Fill(num_bytes);
+    data_ = cursor_->Data();
+  } else {
+    num_buffered = end_ - data_;
+    memmove(buf_, data_, num_buffered);
+    data_ = buf_;
+    size_t target = std::max(num_bytes, std::min(kBufferSize, num_expected_));
+    is_->read(buf_ + num_buffered, target - num_buffered);
+    num_buffered += is_->gcount();
+  }
+  end_ = data_ + num_buffered;
+  if (num_buffered < num_bytes)
+    KALDIIO_ERR << "ReadBasicType: encountered end of stream.";
+}
+
+void BinaryBasicTypeReader::ReadToken(std::string *token) {
+  token->clear();
+  Fill(1);
+  while (isspace(static_cast<unsigned char>(*data_))) {
+    Consume(1);
+    Fill(1);
+  }
+  while (true) {
+    const char *p = data_;
+    while (p != end_ && !isspace(static_cast<unsigned char>(*p))) p++;
+    token->append(data_, p - data_);
+    Consume(p - data_);
+    if (data_ != end_) break;
+    Fill(1);
+  }
+  Consume(1);  // The space.
+}
+
+void BinaryBasicTypeReader::ReadBytes(size_t num_bytes, char *data) {
+  size_t num_buffered = end_ - data_;
+  if (num_bytes <= std::max(num_buffered, kBufferSize)) {
+    Fill(num_bytes);
+    memcpy(data, data_, num_bytes);
+    Consume(num_bytes);
+    return;
+  }
+  // Copies what is buffered, then reads the rest straight into data.
+  memcpy(data, data_, num_buffered);
+  Consume(num_buffered);
+  size_t num_left = num_bytes - num_buffered;
+  size_t num_read;
+  if (cursor_ != NULL) {
+    cursor_->Consume(data_ - cursor_->Data());
+    num_read = cursor_->sgetn(data + num_buffered, num_left);
+    data_ = end_ = cursor_->Data();
+  } else {
+    is_->read(data + num_buffered, num_left);
+    num_read = is_->gcount();
+  }
+  num_expected_ -= std::min(num_expected_, num_read);
+  if (num_read < num_left)
+    KALDIIO_ERR << "ReadBasicType: encountered end of stream.";
+}
+
+void BinaryBasicTypeWriter::Flush() {
+  os_.write(buf_, size_);
+  size_ = 0;
+  if (os_.fail()) KALDIIO_ERR << "Write failure in WriteBasicType.";
+}
+
+void TextBasicTypeWriter::WriteString(const char *str) {
+  size_t n = strlen(str);
+  if (size_ + n > kBufferSize) {
+    Flush();
+    if (n > kBufferSize) {
+      os_.write(str, n);
+      if (os_.fail()) KALDIIO_ERR << "Write failure in WriteBasicType.";
+      return;
+    }
+  }
+  memcpy(buf_ + size_, str, n);
+  size_ += n;
+}
+
+void TextBasicTypeWriter::Flush() {
+  os_.write(buf_, size_);
+  size_ = 0;
+  if (os_.fail()) KALDIIO_ERR << "Write failure in WriteBasicType.";
+}
+
 }  // namespace kaldiio
@@ -9,9 +9,17 @@
 #ifndef KALDI_NATIVE_IO_CSRC_IO_FUNCS_H_
 #define KALDI_NATIVE_IO_CSRC_IO_FUNCS_H_
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <type_traits>
 
+#include "kaldi_native_io/csrc/input-cursor.h"
 #include "kaldi_native_io/csrc/io-funcs-inl.h"
+#include "kaldi_native_io/csrc/kaldi-utils.h"
+#include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/number-format.h"
 
 namespace kaldiio {
 
@@ -42,6 +50,13 @@ void WriteBasicType<bool>(std::ostream &os, bool binary, bool b);
 template <>
 void ReadBasicType<bool>(std::istream &is, bool binary, bool *b);
 
+/// ParseBasicType parses [begin, end), one integer or floating-point value in
+/// the text format of WriteBasicType(), e.g. a field of a line of text.  It
+/// returns false if that is not a whole valid value.  It is much faster than
+/// ReadBasicType() from a stream holding the same text.
+template <class T>
+bool ParseBasicType(const char *begin, const char *end, T *t);
+
 // Declare specializations for float and double.
 template <>
 void WriteBasicType<float>(std::ostream &os, bool binary, float f);
@@ -104,5 +119,337 @@ void ExpectToken(std::istream &is, bool binary, const std::string &token);
 void ExpectPretty(std::istream &is, bool binary, const char *token);
 void ExpectPretty(std::istream &is, bool binary, const std::string &token);
 
+/// BinaryBasicTypeReader reads values in the binary format of
+/// WriteBasicType(), i.e. each value preceded by a byte with its size, like
+/// ReadBasicType() does, but it reads the stream in large chunks and checks
+/// and copies whole runs of values at once, instead of going through the
+/// stream for every few bytes.  The stream must be left just after the object
+/// being read, so it only reads ahead as far as the caller says the object
+/// extends; see Expect().  If the stream reads from an InputCursor, or the
+/// reader is given one, it reads from the buffer of the cursor in place
+/// instead, and need not be told how far the object extends.  All functions
+/// throw on error.
+class BinaryBasicTypeReader {
+ public:
+  explicit BinaryBasicTypeReader(std::istream &is)
+      : is_(&is),
+        cursor_(dynamic_cast<InputCursor *>(is.rdbuf())),
+        num_expected_(0) {
+    data_ = end_ = (cursor_ != NULL ? cursor_->Data() : buf_);
+  }
+
+  explicit BinaryBasicTypeReader(InputCursor *cursor)
+      : is_(NULL),
+        cursor_(cursor),
+        data_(cursor->Data()),
+        end_(cursor->Data()),
+        num_expected_(0) {}
+
+  /// Leaves the cursor, if there is one, just after what was read.
+  ~BinaryBasicTypeReader() {
+    if (cursor_ != NULL) cursor_->Consume(data_ - cursor_->Data());
+  }
+
+  /// Declares that the object extends at least num_bytes further than
+  /// declared so far (see MinBinarySize()), which lets the reader read that
+  /// far ahead.  Declaring too much would leave the stream in the wrong place.
+  void Expect(size_t num_bytes) { num_expected_ += num_bytes; }
+
+  /// Returns the smallest number of bytes a T takes in binary mode.  A float
+  /// may have been written as a double and vice versa.
+  template <class T>
+  static size_t MinBinarySize() {
+    return std::is_same<T, bool>::value
+               ? 1
+               : 1 + (std::is_floating_point<T>::value ? sizeof(float)
+                                                        : sizeof(T));
+  }
+
+  /// Reads one value, like ReadBasicType(is, true, t).
+  template <class T>
+  void Read(T *t);
+
+  /// Reads n values, calling set(i, value) with the i'th one.
+  template <class T, class Setter>
+  void ReadArray(size_t n, Setter set);
+
+  /// Reads n pairs of values, each a T1 followed by a T2, calling
+  /// set(i, first, second) with the i'th pair.  T1 and T2 must not be bool.
+  template <class T1, class T2, class Setter>
+  void ReadPairArray(size_t n, Setter set);
+
+  /// Reads a token and the space after it, like ReadToken(is, true, token).
+  void ReadToken(std::string *token);
+
+  /// Reads num_bytes bytes as they are, e.g. the data of a Vector.
+  void ReadBytes(size_t num_bytes, char *data);
+
+ private:
+  // Makes sure at least num_bytes bytes are buffered; at most kBufferSize
+  // unless reading from a cursor.
+  void Fill(size_t num_bytes) {
+    if (static_cast<size_t>(end_ - data_) < num_bytes) FillSlow(num_bytes);
+  }
+
+  void FillSlow(size_t num_bytes);
+
+  void Consume(size_t num_bytes) {
+    data_ += num_bytes;
+    num_expected_ -= std::min(num_expected_, num_bytes);
+  }
+
+  static const size_t kBufferSize = 16384;
+
+  std::istream *is_;       // NULL if reading from cursor_.
+  InputCursor *cursor_;    // NULL if reading from is_ into buf_.
+  const char *data_;       // The unread buffered bytes are [data_, end_),
+  const char *end_;        // in buf_ or in the buffer of cursor_.
+  char buf_[kBufferSize];  // Unused with cursor_.
+  // A lower bound on the number of bytes of the object not read yet,
+  // including the buffered ones.
+  size_t num_expected_;
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(BinaryBasicTypeReader)
+};
+
+/// BinaryBasicTypeWriter writes values in the binary format of
+/// WriteBasicType(), buffering them so that the stream is written in large
+/// chunks.  Call Flush() at the end.  All functions throw on error.
+class BinaryBasicTypeWriter {
+ public:
+  explicit BinaryBasicTypeWriter(std::ostream &os) : os_(os), size_(0) {}
+
+  /// Writes one value, like WriteBasicType(os, true, t).
+  template <class T>
+  void Write(T t);
+
+  /// Writes n values, get(i) returning the i'th one.
+  template <class T, class Getter>
+  void WriteArray(size_t n, Getter get);
+
+  /// Writes the buffered values to the stream.
+  void Flush();
+
+ private:
+  static const size_t kBufferSize = 16384;
+
+  std::ostream &os_;
+  char buf_[kBufferSize];
+  size_t size_;  // The number of bytes in buf_.
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(BinaryBasicTypeWriter)
+};
+
+/// TextBasicTypeWriter writes values in the text format of WriteBasicType(),
+/// formatting them into a buffer so that the stream is written in large
+/// chunks.  Call Flush() at the end.  All functions throw on error.
+class TextBasicTypeWriter {
+ public:
+  explicit TextBasicTypeWriter(std::ostream &os) : os_(os), size_(0) {}
+
+  /// Writes one value followed by a space, like WriteBasicType(os, false, t).
+  template <class T>
+  void Write(T t);
+
+  /// Writes str as it is.
+  void WriteString(const char *str);
+
+  /// Writes the buffered text to the stream.
+  void Flush();
+
+ private:
+  static const size_t kBufferSize = 16384;
+
+  std::ostream &os_;
+  char buf_[kBufferSize];
+  size_t size_;  // The number of bytes in buf_.
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(TextBasicTypeWriter)
+};
+
+// Returns the size byte WriteBasicType() writes before a T in binary mode.
+template <class T>
+inline char BinarySizeByte() {
+  return std::is_floating_point<T>::value
+             ? static_cast<char>(sizeof(T))
+             : (std::numeric_limits<T>::is_signed ? 1 : -1) *
+                   static_cast<char>(sizeof(T));
+}
+
+template <class T>
+void BinaryBasicTypeReader::Read(T *t) {
+  Fill(1);
+  char c = data_[0];
+  if (std::is_same<T, bool>::value) {
+    if (c != 'T' && c != 'F')
+      KALDIIO_ERR << "Read failure in ReadBasicType<bool>, next char is "
+                  << CharToString(c);
+    *t = (c == 'T');
+    Consume(1);
+  } else if (c == BinarySizeByte<T>()) {
+    Fill(1 + sizeof(T));
+    memcpy(t, data_ + 1, sizeof(T));
+    Consume(1 + sizeof(T));
+  } else if (std::is_floating_point<T>::value && c == sizeof(float)) {
+    float f;
+    Fill(1 + sizeof(f));
+    memcpy(&f, data_ + 1, sizeof(f));
+    *t = static_cast<T>(f);
+    Consume(1 + sizeof(f));
+  } else if (std::is_floating_point<T>::value && c == sizeof(double)) {
+    double d;
+    Fill(1 + sizeof(d));
+    memcpy(&d, data_ + 1, sizeof(d));
+    *t = static_cast<T>(d);
+    Consume(1 + sizeof(d));
+  } else if (std::is_floating_point<T>::value) {
+    KALDIIO_ERR << "ReadBasicType: expected float, saw "
+                << static_cast<int>(c);
+  } else {
+    KALDIIO_ERR << "ReadBasicType: did not get expected integer type, "
+                << static_cast<int>(c) << " vs. "
+                << static_cast<int>(BinarySizeByte<T>());
+  }
+}
+
+template <class T, class Setter>
+void BinaryBasicTypeReader::ReadArray(size_t n, Setter set) {
+  const size_t record_size = 1 + sizeof(T);
+  const char size_byte = BinarySizeByte<T>();
+  size_t i = 0;
+  while (i < n) {
+    if (!std::is_same<T, bool>::value) {
+      Fill(MinBinarySize<T>());
+      const char *p = data_;
+      size_t m = std::min((end_ - data_) / record_size, n - i);
+      // Check the size bytes of the buffered values all at once; then, if one
+      // is not the expected one, find the first such value.
+      char mismatch = 0;
+      for (size_t j = 0; j < m; j++) mismatch |= p[j * record_size] ^ size_byte;
+      if (mismatch != 0) {
+        m = 0;
+        while (p[m * record_size] == size_byte) m++;
+      }
+      for (size_t j = 0; j < m; j++) {
+        T t;
+        memcpy(&t, p + j * record_size + 1, sizeof(T));
+        set(i + j, t);
+      }
+      Consume(m * record_size);
+      i += m;
+      if (m != 0 || i == n) continue;
+    }
+    // Values that are bool, have another size (e.g. doubles read as floats)
+    // or are not all buffered.
+    T t;
+    Read(&t);
+    set(i++, t);
+  }
+}
+
+template <class T1, class T2, class Setter>
+void BinaryBasicTypeReader::ReadPairArray(size_t n, Setter set) {
+  static_assert(!std::is_same<T1, bool>::value &&
+                    !std::is_same<T2, bool>::value,
+                "ReadPairArray() does not support bool");
+  const size_t first_size = 1 + sizeof(T1);
+  const size_t record_size = first_size + 1 + sizeof(T2);
+  const char size_byte1 = BinarySizeByte<T1>();
+  const char size_byte2 = BinarySizeByte<T2>();
+  size_t i = 0;
+  while (i < n) {
+    Fill(MinBinarySize<T1>() + MinBinarySize<T2>());
+    const char *p = data_;
+    size_t m = std::min((end_ - data_) / record_size, n - i);
+    // As in ReadArray(), check the size bytes all at once first.
+    char mismatch = 0;
+    for (size_t j = 0; j < m; j++) {
+      const char *q = p + j * record_size;
+      mismatch |= (q[0] ^ size_byte1) | (q[first_size] ^ size_byte2);
+    }
+    if (mismatch != 0) {
+      m = 0;
+      while (p[m * record_size] == size_byte1 &&
+             p[m * record_size + first_size] == size_byte2)
+        m++;
+    }
+    for (size_t j = 0; j < m; j++) {
+      const char *q = p + j * record_size;
+      T1 t1;
+      T2 t2;
+      memcpy(&t1, q + 1, sizeof(T1));
+      memcpy(&t2, q + first_size + 1, sizeof(T2));
+      set(i + j, t1, t2);
+    }
+    Consume(m * record_size);
+    i += m;
+    if (m != 0 || i == n) continue;
+    // A pair with another size (e.g. a double read as a float) or not all
+    // buffered.
+    T1 t1;
+    T2 t2;
+    Read(&t1);
+    Read(&t2);
+    set(i++, t1, t2);
+  }
+}
+
+template <class T>
+void BinaryBasicTypeWriter::Write(T t) {
+  if (size_ + 1 + sizeof(T) > kBufferSize) Flush();
+  if (std::is_same<T, bool>::value) {
+    buf_[size_++] = (t ? 'T' : 'F');
+  } else {
+    buf_[size_] = BinarySizeByte<T>();
+    memcpy(buf_ + size_ + 1, &t, sizeof(T));
+    size_ += 1 + sizeof(T);
+  }
+}
+
+template <class T, class Getter>
+void BinaryBasicTypeWriter::WriteArray(size_t n, Getter get) {
+  if (std::is_same<T, bool>::value) {
+    for (size_t i = 0; i < n; i++) Write<T>(get(i));
+    return;
+  }
+  const size_t record_size = 1 + sizeof(T);
+  const char size_byte = BinarySizeByte<T>();
+  size_t i = 0;
+  while (i < n) {
+    size_t m = std::min((kBufferSize - size_) / record_size, n - i);
+    if (m == 0) {
+      Flush();
+      continue;
+    }
+    char *p = buf_ + size_;
+    for (size_t j = 0; j < m; j++) {
+      T t = get(i + j);
+      p[j * record_size] = size_byte;
+      memcpy(p + j * record_size + 1, &t, sizeof(T));
+    }
+    size_ += m * record_size;
+    i += m;
+  }
+}
+
+namespace internal {
+
+inline char *FormatBasicType(bool b, char *buf) {
+  *buf = (b ? 'T' : 'F');
+  return buf + 1;
+}
+
+template <class T>
+char *FormatBasicType(T t, char *buf) {
+  return FormatNumber(t, buf);
+}
+
+}  // namespace internal
+
+template <class T>
+void TextBasicTypeWriter::Write(T t) {
+  if (size_ + kMaxNumberChars + 1 > kBufferSize) Flush();
+  char *end = internal::FormatBasicType(t, buf_ + size_);
+  *end++ = ' ';
+  size_ = end - buf_;
+}
+
 }  // namespace kaldiio
 #endif  // KALDI_NATIVE_IO_CSRC_IO_FUNCS_H_
@@ -10,6 +10,7 @@
 #ifndef KALDI_NATIVE_IO_CSRC_KALDI_HOLDER_INL_H_
 #define KALDI_NATIVE_IO_CSRC_KALDI_HOLDER_INL_H_
 
+#include <cctype>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -19,6 +20,7 @@
 #include "kaldi_native_io/csrc/kaldi-matrix.h"
 #include "kaldi_native_io/csrc/kaldi-utils.h"
 #include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/stl-utils.h"
 #include "kaldi_native_io/csrc/text-utils.h"
 
 namespace kaldiio {
@@ -98,6 +100,20 @@ class BasicHolder {
     }
   }
 
+  // Reads into the holder from the buffer of cursor; see HolderReadsCursor.
+  bool Read(InputCursor *cursor) {
+    if (!cursor->PeekBinaryHeader()) return Read(cursor->Stream());
+    cursor->Consume(2);
+    try {
+      BinaryBasicTypeReader reader(cursor);
+      reader.Read(&t_);
+      return true;
+    } catch (const std::exception &e) {
+      KALDIIO_WARN << "Exception caught reading Table object. " << e.what();
+      return false;
+    }
+  }
+
   // Objects read/written with the Kaldi I/O functions always have the stream
   // open in binary mode for reading.
   static bool IsReadInBinary() { return true; }
@@ -112,6 +128,10 @@ class BasicHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
   ~BasicHolder() {}
 
  private:
@@ -141,18 +161,19 @@ class BasicVectorHolder {
         // Or this Write routine cannot handle such a large vector.
         // use int32_t because it's fixed size regardless of compilation.
         // change to int64 (plus in Read function) if this becomes a problem.
-        WriteBasicType(os, binary, static_cast<int32_t>(t.size()));
-        for (typename std::vector<BasicType>::const_iterator iter = t.begin();
-             iter != t.end(); ++iter)
-          WriteBasicType(os, binary, *iter);
-
+        BinaryBasicTypeWriter writer(os);
+        writer.Write(static_cast<int32_t>(t.size()));
+        writer.WriteArray<BasicType>(t.size(), [&t](size_t i) { return t[i]; });
+        writer.Flush();
       } else {
+        TextBasicTypeWriter writer(os);
         for (typename std::vector<BasicType>::const_iterator iter = t.begin();
              iter != t.end(); ++iter)
-          WriteBasicType(os, binary, *iter);
-        os << '\n';  // Makes output format more readable and
+          writer.Write(*iter);
+        writer.WriteString("\n");  // Makes output format more readable and
         // easier to manipulate.  In text mode, this function writes something
         // like "1 2 3\n".
+        writer.Flush();
       }
       return os.good();
     } catch (const std::exception &e) {
@@ -183,33 +204,31 @@ class BasicVectorHolder {
                      << (is.eof() ? "[eof]" : "");
         return false;  // probably eof.  fail in any case.
       }
-      std::istringstream line_is(line);
-      try {
-        while (1) {
-          line_is >> std::ws;  // eat up whitespace.
-          if (line_is.eof()) break;
-          BasicType bt;
-          ReadBasicType(line_is, false, &bt);
-          t_.push_back(bt);
+      // Parse the fields of the line in place.
+      const char *p = line.data(), *end = p + line.size();
+      while (1) {
+        while (p != end && std::isspace(static_cast<unsigned char>(*p))) p++;
+        if (p == end) break;
+        const char *field_end = p;
+        while (field_end != end &&
+               !std::isspace(static_cast<unsigned char>(*field_end)))
+          field_end++;
+        BasicType bt;
+        if (!ParseBasicType(p, field_end, &bt)) {
+          KALDIIO_WARN << "BasicVectorHolder::Read, could not interpret line: "
+                       << "'" << line << "'\n"
+                       << "Bad value '" << std::string(p, field_end) << "'";
+          return false;
         }
-        return true;
-      } catch (const std::exception &e) {
-        KALDIIO_WARN << "BasicVectorHolder::Read, could not interpret line: "
-                     << "'" << line << "'"
-                     << "\n"
-                     << e.what();
-        return false;
+        t_.push_back(bt);
+        p = field_end;
       }
+      return true;
     } else {  // binary mode.
       size_t filepos = is.tellg();
       try {
-        int32_t size;
-        ReadBasicType(is, true, &size);
-        t_.resize(size);
-        for (typename std::vector<BasicType>::iterator iter = t_.begin();
-             iter != t_.end(); ++iter) {
-          ReadBasicType(is, true, &(*iter));
-        }
+        BinaryBasicTypeReader reader(is);
+        ReadBinary(&reader);
         return true;
       } catch (...) {
         KALDIIO_WARN << "BasicVectorHolder::Read, read error or unexpected data"
@@ -220,6 +239,23 @@ class BasicVectorHolder {
     }
   }
 
+  // Reads into the holder from the buffer of cursor; see HolderReadsCursor.
+  bool Read(InputCursor *cursor) {
+    if (!cursor->PeekBinaryHeader()) return Read(cursor->Stream());
+    cursor->Consume(2);
+    int64_t filepos = cursor->Position();
+    try {
+      BinaryBasicTypeReader reader(cursor);
+      ReadBinary(&reader);
+      return true;
+    } catch (...) {
+      KALDIIO_WARN << "BasicVectorHolder::Read, read error or unexpected data"
+                      " at archive entry beginning at file position "
+                   << filepos;
+      return false;
+    }
+  }
+
   // Objects read/written with the Kaldi I/O functions always have the stream
   // open in binary mode for reading.
   static bool IsReadInBinary() { return true; }
@@ -234,9 +270,26 @@ class BasicVectorHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
   ~BasicVectorHolder() {}
 
  private:
+  // Reads the binary-mode object after the header; throws on error.
+  void ReadBinary(BinaryBasicTypeReader *reader) {
+    t_.clear();
+    int32_t size;
+    reader->Expect(reader->MinBinarySize<int32_t>());
+    reader->Read(&size);
+    if (size < 0) KALDIIO_ERR << "Invalid size " << size;
+    t_.resize(size);
+    reader->Expect(size * reader->MinBinarySize<BasicType>());
+    reader->template ReadArray<BasicType>(
+        size, [this](size_t i, BasicType b) { t_[i] = b; });
+  }
+
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(BasicVectorHolder)
   T t_;
 };
@@ -262,35 +315,37 @@ class BasicVectorVectorHolder {
         // Or this Write routine cannot handle such a large vector.
         // use int32_t because it's fixed size regardless of compilation.
         // change to int64 (plus in Read function) if this becomes a problem.
-        WriteBasicType(os, binary, static_cast<int32_t>(t.size()));
+        BinaryBasicTypeWriter writer(os);
+        writer.Write(static_cast<int32_t>(t.size()));
         for (typename std::vector<std::vector<BasicType>>::const_iterator iter =
                  t.begin();
              iter != t.end(); ++iter) {
           KALDIIO_ASSERT(static_cast<size_t>(static_cast<int32_t>(
                              iter->size())) == iter->size());
-          WriteBasicType(os, binary, static_cast<int32_t>(iter->size()));
-          for (typename std::vector<BasicType>::const_iterator iter2 =
-                   iter->begin();
-               iter2 != iter->end(); ++iter2) {
-            WriteBasicType(os, binary, *iter2);
-          }
+          const std::vector<BasicType> &v = *iter;
+          writer.Write(static_cast<int32_t>(v.size()));
+          writer.WriteArray<BasicType>(v.size(),
+                                       [&v](size_t i) { return v[i]; });
         }
+        writer.Flush();
       } else {  // text mode...
         // In text mode, we write out something like (for integers):
         // "1 2 3 ; 4 5 ; 6 ; ; 7 8 9 ;\n"
         // where the semicolon is a terminator, not a separator
         // (a separator would cause ambiguity between an
         // empty list, and a list containing a single empty list).
+        TextBasicTypeWriter writer(os);
         for (typename std::vector<std::vector<BasicType>>::const_iterator iter =
                  t.begin();
              iter != t.end(); ++iter) {
           for (typename std::vector<BasicType>::const_iterator iter2 =
                    iter->begin();
                iter2 != iter->end(); ++iter2)
-            WriteBasicType(os, binary, *iter2);
-          os << "; ";
+            writer.Write(*iter2);
+          writer.WriteString("; ");
         }
-        os << '\n';
+        writer.WriteString("\n");
+        writer.Flush();
       }
       return os.good();
     } catch (const std::exception &e) {
@@ -346,19 +401,8 @@ class BasicVectorVectorHolder {
     } else {  // binary mode.
       size_t filepos = is.tellg();
       try {
-        int32_t size;
-        ReadBasicType(is, true, &size);
-        t_.resize(size);
-        for (typename std::vector<std::vector<BasicType>>::iterator iter =
-                 t_.begin();
-             iter != t_.end(); ++iter) {
-          int32_t size2;
-          ReadBasicType(is, true, &size2);
-          iter->resize(size2);
-          for (typename std::vector<BasicType>::iterator iter2 = iter->begin();
-               iter2 != iter->end(); ++iter2)
-            ReadBasicType(is, true, &(*iter2));
-        }
+        BinaryBasicTypeReader reader(is);
+        ReadBinary(&reader);
         return true;
       } catch (...) {
         KALDIIO_WARN
@@ -370,6 +414,23 @@ class BasicVectorVectorHolder {
     }
   }
 
+  // Reads into the holder from the buffer of cursor; see HolderReadsCursor.
+  bool Read(InputCursor *cursor) {
+    if (!cursor->PeekBinaryHeader()) return Read(cursor->Stream());
+    cursor->Consume(2);
+    int64_t filepos = cursor->Position();
+    try {
+      BinaryBasicTypeReader reader(cursor);
+      ReadBinary(&reader);
+      return true;
+    } catch (...) {
+      KALDIIO_WARN << "Read error or unexpected data at archive entry beginning"
+                      " at file position "
+                   << filepos;
+      return false;
+    }
+  }
+
   // Objects read/written with the Kaldi I/O functions always have the stream
   // open in binary mode for reading.
   static bool IsReadInBinary() { return true; }
@@ -384,9 +445,37 @@ class BasicVectorVectorHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
   ~BasicVectorVectorHolder() {}
 
  private:
+  // Reads the binary-mode object after the header; throws on error.
+  void ReadBinary(BinaryBasicTypeReader *reader) {
+    t_.clear();
+    int32_t size;
+    reader->Expect(reader->MinBinarySize<int32_t>());
+    reader->Read(&size);
+    if (size < 0) KALDIIO_ERR << "Invalid size " << size;
+    t_.resize(size);
+    // Each vector starts with its size.
+    reader->Expect(size * reader->MinBinarySize<int32_t>());
+    for (typename std::vector<std::vector<BasicType>>::iterator iter =
+             t_.begin();
+         iter != t_.end(); ++iter) {
+      int32_t size2;
+      reader->Read(&size2);
+      if (size2 < 0) KALDIIO_ERR << "Invalid size " << size2;
+      std::vector<BasicType> &v = *iter;
+      v.resize(size2);
+      reader->Expect(size2 * reader->MinBinarySize<BasicType>());
+      reader->template ReadArray<BasicType>(
+          size2, [&v](size_t i, BasicType b) { v[i] = b; });
+    }
+  }
+
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(BasicVectorVectorHolder)
   T t_;
 };
@@ -412,23 +501,26 @@ class BasicPairVectorHolder {
         // Or this Write routine cannot handle such a large vector.
         // use int32_t because it's fixed size regardless of compilation.
         // change to int64 (plus in Read function) if this becomes a problem.
-        WriteBasicType(os, binary, static_cast<int32_t>(t.size()));
-        for (typename T::const_iterator iter = t.begin(); iter != t.end();
-             ++iter) {
-          WriteBasicType(os, binary, iter->first);
-          WriteBasicType(os, binary, iter->second);
-        }
+        BinaryBasicTypeWriter writer(os);
+        writer.Write(static_cast<int32_t>(t.size()));
+        // The elements of the pairs, one after the other.
+        writer.WriteArray<BasicType>(2 * t.size(), [&t](size_t i) {
+          return (i % 2 == 0) ? t[i / 2].first : t[i / 2].second;
+        });
+        writer.Flush();
       } else {  // text mode...
         // In text mode, we write out something like (for integers):
         // "1 2 ; 4 5 ; 6 7 ; 8 9 \n"
         // where the semicolon is a separator, not a terminator.
+        TextBasicTypeWriter writer(os);
         for (typename T::const_iterator iter = t.begin(); iter != t.end();) {
-          WriteBasicType(os, binary, iter->first);
-          WriteBasicType(os, binary, iter->second);
+          writer.Write(iter->first);
+          writer.Write(iter->second);
           ++iter;
-          if (iter != t.end()) os << "; ";
+          if (iter != t.end()) writer.WriteString("; ");
         }
-        os << '\n';
+        writer.WriteString("\n");
+        writer.Flush();
       }
       return os.good();
     } catch (const std::exception &e) {
@@ -497,13 +589,8 @@ class BasicPairVectorHolder {
     } else {  // binary mode.
       size_t filepos = is.tellg();
       try {
-        int32_t size;
-        ReadBasicType(is, true, &size);
-        t_.resize(size);
-        for (typename T::iterator iter = t_.begin(); iter != t_.end(); ++iter) {
-          ReadBasicType(is, true, &(iter->first));
-          ReadBasicType(is, true, &(iter->second));
-        }
+        BinaryBasicTypeReader reader(is);
+        ReadBinary(&reader);
         return true;
       } catch (...) {
         KALDIIO_WARN << "BasicVectorHolder::Read, read error or unexpected data"
@@ -514,6 +601,23 @@ class BasicPairVectorHolder {
     }
   }
 
+  // Reads into the holder from the buffer of cursor; see HolderReadsCursor.
+  bool Read(InputCursor *cursor) {
+    if (!cursor->PeekBinaryHeader()) return Read(cursor->Stream());
+    cursor->Consume(2);
+    int64_t filepos = cursor->Position();
+    try {
+      BinaryBasicTypeReader reader(cursor);
+      ReadBinary(&reader);
+      return true;
+    } catch (...) {
+      KALDIIO_WARN << "BasicVectorHolder::Read, read error or unexpected data"
+                      " at archive entry beginning at file position "
+                   << filepos;
+      return false;
+    }
+  }
+
   // Objects read/written with the Kaldi I/O functions always have the stream
   // open in binary mode for reading.
   static bool IsReadInBinary() { return true; }
@@ -528,9 +632,32 @@ class BasicPairVectorHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
   ~BasicPairVectorHolder() {}
 
  private:
+  // Reads the binary-mode object after the header; throws on error.
+  void ReadBinary(BinaryBasicTypeReader *reader) {
+    t_.clear();
+    int32_t size;
+    reader->Expect(reader->MinBinarySize<int32_t>());
+    reader->Read(&size);
+    if (size < 0) KALDIIO_ERR << "Invalid size " << size;
+    t_.resize(size);
+    size_t num_elements = 2 * static_cast<size_t>(size);
+    reader->Expect(num_elements * reader->MinBinarySize<BasicType>());
+    reader->template ReadArray<BasicType>(
+        num_elements, [this](size_t i, BasicType b) {
+          if (i % 2 == 0)
+            t_[i / 2].first = b;
+          else
+            t_[i / 2].second = b;
+        });
+  }
+
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(BasicPairVectorHolder)
   T t_;
 };
@@ -568,6 +695,21 @@ class TokenHolder {
     return true;
   }
 
+  // Reads into the holder from the buffer of cursor; see HolderReadsCursor.
+  bool Read(InputCursor *cursor) {
+    if (!cursor->ReadToken(&t_) && t_.empty()) return false;
+    int c;
+    while (isspace(c = cursor->Peek()) && c != '\n') cursor->Consume(1);
+    if (c != '\n') {
+      KALDIIO_WARN << "TokenHolder::Read, expected newline, got char "
+                   << CharToString(static_cast<char>(c)) << ", at stream pos "
+                   << cursor->Position();
+      return false;
+    }
+    cursor->Consume(1);  // get '\n'
+    return true;
+  }
+
   // Since this is fundamentally a text format, read in text mode (would work
   // fine either way, but doing it this way will exercise more of the code).
   static bool IsReadInBinary() { return false; }
@@ -584,6 +726,10 @@ class TokenHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(TokenHolder)
   T t_;
@@ -645,6 +791,10 @@ class TokenVectorHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(TokenVectorHolder)
   T t_;
@@ -659,7 +809,7 @@ class KaldiObjectHolder {
  public:
   typedef KaldiType T;
 
-  KaldiObjectHolder() : t_(NULL) {}
+  KaldiObjectHolder() : t_(NULL), spare_(NULL) {}
 
   static bool Write(std::ostream &os, bool binary, const T &t) {
     InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
@@ -674,17 +824,29 @@ class KaldiObjectHolder {
 
   void Clear() {
     if (t_) {
-      delete t_;
+      // Keep the object to read the next one into, if that is allowed and it
+      // does not hold on to too much memory.
+      if (IsReusableForRead<T>::value &&
+          static_cast<int64_t>(MemoryUsage(*t_)) <=
+              GetMaxRetainedObjectBytes()) {
+        delete spare_;
+        spare_ = t_;
+      } else {
+        delete t_;
+      }
       t_ = NULL;
     }
   }
 
   // Reads into the holder.
   bool Read(std::istream &is) {
-    delete t_;
-    t_ = new T;
-    // Don't want any existing state to complicate the read function: get new
-    // object.
+    if (!IsReusableForRead<T>::value || t_ == NULL) {
+      // Don't want any existing state to complicate the read function: get
+      // new object, unless the type does not care (see IsReusableForRead).
+      delete t_;
+      t_ = spare_ != NULL ? spare_ : new T;
+      spare_ = NULL;
+    }
     bool is_binary;
     if (!InitKaldiInputStream(is, &is_binary)) {
       KALDIIO_WARN << "Reading Table object, failed reading binary header\n";
@@ -713,8 +875,11 @@ class KaldiObjectHolder {
   }
 
   void Swap(KaldiObjectHolder<T> *other) {
-    // the t_ values are pointers so this is a shallow swap.
+    // the t_ values are pointers so this is a shallow swap.  The spare objects
+    // go along, so that e.g. with the "bg" option the object the main thread
+    // is done with goes back to the background thread to be read into.
     std::swap(t_, other->t_);
+    std::swap(spare_, other->spare_);
   }
 
   bool ExtractRange(const KaldiObjectHolder<T> &other,
@@ -726,11 +891,37 @@ class KaldiObjectHolder {
     return ExtractObjectRange(*(other.t_), range, t_);
   }
 
-  ~KaldiObjectHolder() { delete t_; }
+  // Reads just the part 'range' of the object in 'is' (see ExtractRange()),
+  // for the types and formats where this can be done without reading the
+  // whole object; see ReadObjectRange().  Returns false if it cannot be done,
+  // in which case the caller should Read() the object and use ExtractRange();
+  // 'is' is then left where it was.
+  bool ReadRange(std::istream &is, const std::string &range) {
+    // spare_ is only set for the types of IsReusableForRead.
+    T *t = spare_ != NULL ? spare_ : new T;
+    spare_ = NULL;
+    if (!ReadObjectRange(is, range, t)) {
+      // Keep it for the Read() the caller will do instead, if we may.
+      if (IsReusableForRead<T>::value)
+        spare_ = t;
+      else
+        delete t;
+      return false;
+    }
+    delete t_;
+    t_ = t;
+    return true;
+  }
+
+  ~KaldiObjectHolder() {
+    delete t_;
+    delete spare_;
+  }
 
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(KaldiObjectHolder)
   T *t_;
+  T *spare_;  // An object kept by Clear() to read the next object into.
 };
 
 class HtkMatrixHolder {
@@ -773,6 +964,10 @@ class HtkMatrixHolder {
     KALDIIO_ERR << "ExtractRange is not defined for this type of holder.";
     return false;
   }
+
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
   // Default destructor.
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(HtkMatrixHolder)
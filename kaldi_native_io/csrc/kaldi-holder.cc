@@ -8,7 +8,10 @@
 
 #include "kaldi_native_io/csrc/kaldi-holder.h"
 
+#include <string.h>
+
 #include <algorithm>
+#include <atomic>
 #include <vector>
 
 #include "kaldi_native_io/csrc/kaldi-matrix.h"
@@ -18,6 +21,15 @@
 
 namespace kaldiio {
 
+static std::atomic<int64_t> g_max_retained_object_bytes(16 << 20);
+
+void SetMaxRetainedObjectBytes(int64_t num_bytes) {
+  KALDIIO_ASSERT(num_bytes >= 0);
+  g_max_retained_object_bytes = num_bytes;
+}
+
+int64_t GetMaxRetainedObjectBytes() { return g_max_retained_object_bytes; }
+
 bool ExtractRangeSpecifier(const std::string &rxfilename_with_range,
                            std::string *data_rxfilename, std::string *range) {
   if (rxfilename_with_range.empty() ||
@@ -192,4 +204,110 @@ template bool ExtractObjectRange(const Matrix<double> &, const std::string &,
 template bool ExtractObjectRange(const Matrix<float> &, const std::string &,
                                  Matrix<float> *);
 
+// Reads the range 'range' of the binary "FM" or "DM" matrix at the current
+// position of 'is', which is just after the binary-mode header; see
+// ReadObjectRange().
+template <class Real>
+static bool ReadMatrixRange(std::istream &is, const std::string &range,
+                            Matrix<Real> *output) {
+  // The token "FM " or "DM ", then the number of rows and columns, each as a
+  // size byte and an int32; see MatrixBase::Write().
+  const std::streamsize header_size = 3 + 5 + 5;
+  char header[header_size];
+  is.read(header, header_size);
+  const char *token = (sizeof(Real) == 4 ? "FM " : "DM ");
+  const char int32_size = sizeof(int32);
+  int32 num_rows = 0, num_cols = 0;
+  if (is.gcount() == header_size && memcmp(header, token, 3) == 0 &&
+      header[3] == int32_size && header[8] == int32_size) {
+    memcpy(&num_rows, header + 4, sizeof(num_rows));
+    memcpy(&num_cols, header + 9, sizeof(num_cols));
+  }
+  std::vector<int32> row_range, col_range;
+  if (num_rows <= 0 || num_cols <= 0 ||
+      !ParseMatrixRangeSpecifier(range, num_rows, num_cols, &row_range,
+                                 &col_range))
+    return false;
+
+  int32 row_size =
+            std::min(row_range[1], num_rows - 1) - row_range[0] + 1,
+        col_size = col_range[1] - col_range[0] + 1;
+  std::streamoff row_bytes = static_cast<std::streamoff>(num_cols) *
+                             sizeof(Real);
+  is.seekg(row_range[0] * row_bytes, std::ios::cur);
+  output->Resize(row_size, col_size, kUndefined);
+  if (col_size == num_cols) {
+    for (int32 r = 0; r < row_size; r++)
+      is.read(reinterpret_cast<char *>(output->RowData(r)), row_bytes);
+  } else {
+    std::vector<Real> row(num_cols);
+    for (int32 r = 0; r < row_size; r++) {
+      is.read(reinterpret_cast<char *>(row.data()), row_bytes);
+      memcpy(output->RowData(r), row.data() + col_range[0],
+             col_size * sizeof(Real));
+    }
+  }
+  // Leave the stream at the end of the object, as Read() would.
+  is.seekg((num_rows - row_range[0] - row_size) * row_bytes, std::ios::cur);
+  return !is.fail();
+}
+
+// Reads the range 'range' of the binary compressed matrix at the current
+// position of 'is', which is just after the binary-mode header; see
+// ReadObjectRange().  Only the bytes of the rows in the range are read.
+template <class Real>
+static bool ReadCompressedMatrixRange(std::istream &is,
+                                      const std::string &range,
+                                      Matrix<Real> *output) {
+  int32 num_rows = 0, num_cols = 0;
+  std::vector<int32> row_range, col_range;
+  if (!CompressedMatrix::ReadSize(is, &num_rows, &num_cols) || num_rows <= 0 ||
+      num_cols <= 0 ||
+      !ParseMatrixRangeSpecifier(range, num_rows, num_cols, &row_range,
+                                 &col_range))
+    return false;
+
+  int32 row_size =
+            std::min(row_range[1], num_rows - 1) - row_range[0] + 1,
+        col_size = col_range[1] - col_range[0] + 1;
+  CompressedMatrix cmat;
+  try {
+    cmat.ReadRows(is, row_range[0], row_size);
+  } catch (const std::exception &) {
+    return false;
+  }
+  output->Resize(row_size, col_size, kUndefined);
+  cmat.CopyToMat(0, col_range[0], output);
+  return true;
+}
+
+template <class Real>
+bool ReadObjectRange(std::istream &is, const std::string &range,
+                     Matrix<Real> *output) {
+  std::streampos start = is.tellg();
+  if (start == std::streampos(-1)) return false;  // e.g. a pipe.
+
+  bool ans = false;
+  if (is.get() == '\0' && is.get() == 'B') {  // Binary mode.
+    if (is.peek() == 'C')
+      ans = ReadCompressedMatrixRange(is, range, output);
+    else
+      ans = ReadMatrixRange(is, range, output);
+  }
+  if (!ans) {
+    // Let the caller read the object the normal way, which will report the
+    // error if there is one.
+    output->Resize(0, 0);
+    is.clear();
+    is.seekg(start);
+  }
+  return ans;
+}
+
+// template instantiation
+template bool ReadObjectRange(std::istream &, const std::string &,
+                              Matrix<double> *);
+template bool ReadObjectRange(std::istream &, const std::string &,
+                              Matrix<float> *);
+
 }  // namespace kaldiio
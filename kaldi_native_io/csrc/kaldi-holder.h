@@ -10,9 +10,13 @@
 #ifndef KALDI_NATIVE_IO_CSRC_KALDI_HOLDER_H_
 #define KALDI_NATIVE_IO_CSRC_KALDI_HOLDER_H_
 
+#include <cstdint>
+#include <istream>
 #include <string>
+#include <type_traits>
 
 #include "kaldi_native_io/csrc/compressed-matrix.h"
+#include "kaldi_native_io/csrc/input-cursor.h"
 #include "kaldi_native_io/csrc/kaldi-matrix.h"
 #include "kaldi_native_io/csrc/kaldi-vector.h"
 
@@ -69,6 +73,91 @@ class KaldiObjectHolder;
 /// T == std::pair<Matrix<BaseFloat>, HtkHeader>
 class HtkMatrixHolder;
 
+/// KaldiObjectHolder<KaldiType> reads each object into the object it read the
+/// previous one into, if there is one, instead of into a new object, when
+/// this is true for KaldiType; e.g. a Matrix then reuses its memory if the
+/// new matrix fits in it (see Matrix::Resize()).  It must only be true for
+/// types whose Read() function gives the same result whatever the state of
+/// the object it reads into.
+template <class KaldiType>
+struct IsReusableForRead : public std::false_type {};
+
+template <class Real>
+struct IsReusableForRead<Matrix<Real>> : public std::true_type {};
+
+template <class Real>
+struct IsReusableForRead<Vector<Real>> : public std::true_type {};
+
+template <>
+struct IsReusableForRead<CompressedMatrix> : public std::true_type {};
+
+/// For the types above, KaldiObjectHolder keeps the object it has read after
+/// Clear(), to read the next one into, only if MemoryUsage() of the object is
+/// at most this many bytes; this caps the memory a table reader holds on to
+/// between objects.  The default is 16 MiB; 0 means never keep the object.
+/// It applies to all holders in the process.
+void SetMaxRetainedObjectBytes(int64_t num_bytes);
+
+int64_t GetMaxRetainedObjectBytes();
+
+/// For holders whose objects, in binary mode, are a header of a fixed size
+/// followed by their data, the size of the header (including the binary-mode
+/// header "\0B"); 0 for other holders.  Table writers with the "align" option
+/// use it to align the data of the objects in the archive, so that
+/// SequentialMappedMatrixReader can return them without copying.
+template <class Holder>
+struct HolderDataOffset : public std::integral_constant<size_t, 0> {};
+
+// "\0B", then "FM " or "DM ", then the numbers of rows and columns.
+template <class Real>
+struct HolderDataOffset<KaldiObjectHolder<Matrix<Real>>>
+    : public std::integral_constant<size_t, 15> {};
+
+/// Table readers that read archives through an InputCursor call
+/// "bool Read(InputCursor *cursor)" on holders for which this is true; it
+/// decodes the object straight from the buffer of the cursor.  Other holders
+/// read from the istream of the cursor (see InputCursor::Stream()).
+template <class Holder>
+struct HolderReadsCursor : public std::false_type {};
+
+template <class BasicType>
+struct HolderReadsCursor<BasicHolder<BasicType>> : public std::true_type {};
+
+template <class BasicType>
+struct HolderReadsCursor<BasicVectorHolder<BasicType>>
+    : public std::true_type {};
+
+template <class BasicType>
+struct HolderReadsCursor<BasicVectorVectorHolder<BasicType>>
+    : public std::true_type {};
+
+template <class BasicType>
+struct HolderReadsCursor<BasicPairVectorHolder<BasicType>>
+    : public std::true_type {};
+
+template <>
+struct HolderReadsCursor<TokenHolder> : public std::true_type {};
+
+namespace internal {
+
+template <class Holder>
+bool ReadHolder(InputCursor *cursor, Holder *holder, std::true_type) {
+  return holder->Read(cursor);
+}
+
+template <class Holder>
+bool ReadHolder(InputCursor *cursor, Holder *holder, std::false_type) {
+  return holder->Read(cursor->Stream());
+}
+
+}  // namespace internal
+
+/// Reads the next object from cursor into holder; see HolderReadsCursor.
+template <class Holder>
+bool ReadHolder(InputCursor *cursor, Holder *holder) {
+  return internal::ReadHolder(cursor, holder, HolderReadsCursor<Holder>());
+}
+
 // In SequentialTableReaderScriptImpl and RandomAccessTableReaderScriptImpl, for
 // cases where the scp contained 'range specifiers' (things in square brackets
 // identifying parts of objects like matrices), use this function to separate
@@ -118,6 +207,27 @@ template <class Real>
 bool ExtractObjectRange(const CompressedMatrix &input, const std::string &range,
                         Matrix<Real> *output);
 
+/// ReadObjectRange() reads the object range 'range' (see ExtractObjectRange())
+/// of the object at the current position of 'is', starting with its
+/// binary-mode header, without reading the rest of the object.  It returns
+/// false if this is not possible, in which case 'is' is left at the position
+/// it started at, so that the caller can read the whole object and use
+/// ExtractObjectRange() instead.  The generic version always returns false.
+template <class T>
+bool ReadObjectRange(std::istream & /*is*/, const std::string & /*range*/,
+                     T * /*output*/) {
+  return false;
+}
+
+/// The version for Matrix<float> and Matrix<double> handles binary matrices of
+/// the same type ("FM" or "DM") and compressed matrices, in streams that can
+/// seek: it reads only the bytes of the rows in the range, seeking over the
+/// rest.  It returns false for other formats, e.g. text, and for streams that
+/// cannot seek, such as pipes.
+template <class Real>
+bool ReadObjectRange(std::istream &is, const std::string &range,
+                     Matrix<Real> *output);
+
 }  // namespace kaldiio
 
 #include "kaldi_native_io/csrc/kaldi-holder-inl.h"
@@ -690,7 +690,7 @@ class OffsetFileInputImpl : public InputImplBase {
     else if (cur_pos < offset && cur_pos + 100 > offset) {
       // We're close enough that it may be faster to just
       // read that data, rather than seek.
-      for (size_t i = cur_pos; i < offset; i++) is_.get();
+      is_.ignore(offset - cur_pos);
       return (is_.tellg() == std::streampos(offset));
     }
     // Try to actually seek.
@@ -848,6 +848,56 @@ std::istream &Input::Stream() {
   return impl_->Stream();
 }
 
+Input *InputCache::Open(const std::string &rxfilename, bool text_mode) {
+  Input *input;
+  if (ClassifyRxfilename(rxfilename) != kOffsetFileInput) {
+    input = &other_;
+  } else {
+    std::string filename(rxfilename, 0, rxfilename.find_last_of(':'));
+    std::unordered_map<std::string, ListType::iterator>::iterator iter =
+        map_.find(filename);
+    if (iter != map_.end()) {
+      // Move it to the front of the list.
+      inputs_.splice(inputs_.begin(), inputs_, iter->second);
+    } else {
+      Evict(max_open_ - 1);
+      inputs_.push_front(std::make_pair(filename, new Input));
+      map_[filename] = inputs_.begin();
+    }
+    input = inputs_.front().second;
+  }
+  bool ans = text_mode ? input->OpenTextMode(rxfilename)
+                       : input->Open(rxfilename);
+  if (!ans) {
+    if (input != &other_) {
+      map_.erase(inputs_.front().first);
+      delete inputs_.front().second;
+      inputs_.pop_front();
+    }
+    return NULL;
+  }
+  return input;
+}
+
+void InputCache::SetMaxOpen(int32_t max_open) {
+  KALDIIO_ASSERT(max_open > 0);
+  max_open_ = max_open;
+  Evict(max_open_);
+}
+
+void InputCache::Evict(int32_t max_open) {
+  while (static_cast<int32_t>(inputs_.size()) > max_open) {
+    map_.erase(inputs_.back().first);
+    delete inputs_.back().second;
+    inputs_.pop_back();
+  }
+}
+
+void InputCache::Close() {
+  Evict(0);
+  other_.Close();
+}
+
 template <>
 void ReadKaldiObject(const std::string &filename, Matrix<float> *m) {
   if (!filename.empty() && filename[filename.size() - 1] == ']') {
@@ -9,7 +9,10 @@
 #ifndef KALDI_NATIVE_IO_CSRC_KALDI_IO_H_
 #define KALDI_NATIVE_IO_CSRC_KALDI_IO_H_
 
+#include <list>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 #include "kaldi_native_io/csrc/log.h"
 
@@ -207,6 +210,47 @@ class Input {
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(Input)
 };
 
+/// InputCache is for reading many rxfilenames of the form "foo.ark:1234", as
+/// found in scp files.  It keeps up to max_open of the files open, each in its
+/// own Input object, and closes the least recently used one when it needs to
+/// open another.  Reading objects from many archives in an interleaved order
+/// then mostly needs only a seek on a file that is already open, rather than
+/// closing one file and reopening another.  Other kinds of rxfilename (e.g.
+/// pipes, or files without an offset) are opened in a single separate Input
+/// object, as they cannot be reused.
+class InputCache {
+ public:
+  explicit InputCache(int32_t max_open = 16) : max_open_(max_open) {
+    KALDIIO_ASSERT(max_open > 0);
+  }
+
+  /// Opens 'rxfilename' as Input::Open() would (or Input::OpenTextMode(), if
+  /// text_mode == true) and returns the Input object, which belongs to this
+  /// class and is valid until the next call to Open(), SetMaxOpen() or
+  /// Close().  Returns NULL on failure.
+  Input *Open(const std::string &rxfilename, bool text_mode = false);
+
+  /// Changes the maximum number of files kept open, closing files if needed.
+  void SetMaxOpen(int32_t max_open);
+
+  /// Closes all the files.
+  void Close();
+
+  ~InputCache() { Close(); }
+
+ private:
+  // Closes the least recently used files until at most 'max_open' are open.
+  void Evict(int32_t max_open);
+
+  int32_t max_open_;
+  // (filename, Input) pairs, the most recently used first.
+  typedef std::list<std::pair<std::string, Input *>> ListType;
+  ListType inputs_;
+  std::unordered_map<std::string, ListType::iterator> map_;  // into inputs_.
+  Input other_;  // For rxfilenames that are not of the form "foo.ark:1234".
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(InputCache)
+};
+
 template <class C>
 void ReadKaldiObject(const std::string &filename, C *c) {
   bool binary_in;
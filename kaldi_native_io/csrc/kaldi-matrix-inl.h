@@ -14,7 +14,8 @@ namespace kaldiio {
 
 /// Empty constructor
 template <typename Real>
-Matrix<Real>::Matrix() : MatrixBase<Real>(NULL, 0, 0, 0) {}
+Matrix<Real>::Matrix()
+    : MatrixBase<Real>(NULL, 0, 0, 0), capacity_(0), allocator_(NULL) {}
 
 }  // namespace kaldiio
 
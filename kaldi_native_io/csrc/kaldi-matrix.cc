@@ -21,8 +21,10 @@
 #include <vector>
 
 #include "kaldi_native_io/csrc/compressed-matrix.h"
+#include "kaldi_native_io/csrc/half-matrix.h"
 #include "kaldi_native_io/csrc/io-funcs.h"
 #include "kaldi_native_io/csrc/kaldi-utils.h"
+#include "kaldi_native_io/csrc/text-scanner.h"
 
 namespace kaldiio {
 
@@ -30,7 +32,7 @@ namespace kaldiio {
 template <typename Real>
 Matrix<Real>::Matrix(const MatrixBase<Real> &M,
                      MatrixTransposeType trans /*=kNoTrans*/)
-    : MatrixBase<Real>() {
+    : MatrixBase<Real>(), capacity_(0), allocator_(NULL) {
   if (trans == kNoTrans) {
     Resize(M.num_rows_, M.num_cols_);
     this->CopyFromMat(M);
@@ -42,7 +44,8 @@ Matrix<Real>::Matrix(const MatrixBase<Real> &M,
 
 // Copy constructor.  Copies data to newly allocated memory.
 template <typename Real>
-Matrix<Real>::Matrix(const Matrix<Real> &M) : MatrixBase<Real>() {
+Matrix<Real>::Matrix(const Matrix<Real> &M)
+    : MatrixBase<Real>(), capacity_(0), allocator_(NULL) {
   Resize(M.num_rows_, M.num_cols_);
   this->CopyFromMat(M);
 }
@@ -53,6 +56,8 @@ void Matrix<Real>::Swap(Matrix<Real> *other) {
   std::swap(this->num_cols_, other->num_cols_);
   std::swap(this->num_rows_, other->num_rows_);
   std::swap(this->stride_, other->stride_);
+  std::swap(capacity_, other->capacity_);
+  std::swap(allocator_, other->allocator_);
 }
 
 template <typename Real>
@@ -120,6 +125,20 @@ SubMatrix<Real>::SubMatrix(const MatrixBase<Real> &M, const MatrixIndexT ro,
       static_cast<size_t>(ro) * static_cast<size_t>(M.Stride());
 }
 
+template <typename Real>
+SubMatrix<Real>::SubMatrix(Real *data, MatrixIndexT num_rows,
+                           MatrixIndexT num_cols, MatrixIndexT stride)
+    : MatrixBase<Real>(data, num_cols, num_rows, stride) {
+  if (data == NULL) {
+    KALDIIO_ASSERT(num_rows * num_cols == 0);
+    this->num_rows_ = 0;
+    this->num_cols_ = 0;
+    this->stride_ = 0;
+  } else {
+    KALDIIO_ASSERT(this->stride_ >= this->num_cols_);
+  }
+}
+
 template <typename Real>
 template <typename OtherReal>
 void MatrixBase<Real>::CopyFromMat(const MatrixBase<OtherReal> &M,
@@ -157,6 +176,15 @@ template void MatrixBase<float>::CopyFromMat(const MatrixBase<float> &M,
 template void MatrixBase<double>::CopyFromMat(const MatrixBase<double> &M,
                                               MatrixTransposeType Trans);
 
+// Returns the number of elements the rows of a matrix with 'cols' columns
+// take up in memory, so that each row starts at a multiple of 16 bytes.
+template <typename Real>
+static inline MatrixIndexT AlignedStride(MatrixIndexT cols) {
+  MatrixIndexT skip =
+      ((16 / sizeof(Real)) - cols % (16 / sizeof(Real))) % (16 / sizeof(Real));
+  return cols + skip;
+}
+
 template <typename Real>
 inline void Matrix<Real>::Init(const MatrixIndexT rows, const MatrixIndexT cols,
                                const MatrixStrideType stride_type) {
@@ -166,39 +194,33 @@ inline void Matrix<Real>::Init(const MatrixIndexT rows, const MatrixIndexT cols,
     this->num_cols_ = 0;
     this->stride_ = 0;
     this->data_ = NULL;
+    capacity_ = 0;
     return;
   }
   KALDIIO_ASSERT(rows > 0 && cols > 0);
-  MatrixIndexT skip, stride;
-  size_t size;
-  void *data;  // aligned memory block
-  void *temp;  // memory block to be really freed
-
-  // compute the size of skip and real cols
-  skip =
-      ((16 / sizeof(Real)) - cols % (16 / sizeof(Real))) % (16 / sizeof(Real));
-  stride = cols + skip;
-  size = static_cast<size_t>(rows) * static_cast<size_t>(stride) * sizeof(Real);
-
-  // allocate the memory and set the right dimensions and parameters
-  if (NULL != (data = KALDIIO_MEMALIGN(16, size, &temp))) {
-    MatrixBase<Real>::data_ = static_cast<Real *>(data);
-    MatrixBase<Real>::num_rows_ = rows;
-    MatrixBase<Real>::num_cols_ = cols;
-    MatrixBase<Real>::stride_ = (stride_type == kDefaultStride ? stride : cols);
-  } else {
-    throw std::bad_alloc();
-  }
+  MatrixIndexT stride = AlignedStride<Real>(cols);
+  size_t size =
+      static_cast<size_t>(rows) * static_cast<size_t>(stride) * sizeof(Real);
+
+  // allocate the memory (throws on failure) and set the right dimensions and
+  // parameters
+  allocator_ = GetMemoryAllocator();
+  MatrixBase<Real>::data_ = static_cast<Real *>(allocator_->Allocate(size));
+  MatrixBase<Real>::num_rows_ = rows;
+  MatrixBase<Real>::num_cols_ = cols;
+  MatrixBase<Real>::stride_ = (stride_type == kDefaultStride ? stride : cols);
+  capacity_ = allocator_->UsableSize(size) / sizeof(Real);
 }
 
 template <typename Real>
 void Matrix<Real>::Destroy() {
   // we need to free the data block if it was defined
   if (NULL != MatrixBase<Real>::data_)
-    KALDIIO_MEMALIGN_FREE(MatrixBase<Real>::data_);
+    allocator_->Free(MatrixBase<Real>::data_, capacity_ * sizeof(Real));
   MatrixBase<Real>::data_ = NULL;
   MatrixBase<Real>::num_rows_ = MatrixBase<Real>::num_cols_ =
       MatrixBase<Real>::stride_ = 0;
+  capacity_ = 0;
 }
 
 template <typename Real>
@@ -238,8 +260,19 @@ void Matrix<Real>::Resize(const MatrixIndexT rows, const MatrixIndexT cols,
         cols == MatrixBase<Real>::num_cols_) {
       if (resize_type == kSetZero) this->SetZero();
       return;
-    } else
-      Destroy();
+    }
+    MatrixIndexT stride = AlignedStride<Real>(cols);
+    if (rows > 0 && cols > 0 &&
+        static_cast<size_t>(rows) * stride <= capacity_) {
+      // The memory we have is big enough; reuse it.
+      MatrixBase<Real>::num_rows_ = rows;
+      MatrixBase<Real>::num_cols_ = cols;
+      MatrixBase<Real>::stride_ =
+          (stride_type == kDefaultStride ? stride : cols);
+      if (resize_type == kSetZero) this->SetZero();
+      return;
+    }
+    Destroy();
   }
   Init(rows, cols, stride_type);
   if (resize_type == kSetZero) MatrixBase<Real>::SetZero();
@@ -278,12 +311,15 @@ void MatrixBase<Real>::Write(std::ostream &os, bool binary) const {
     if (num_cols_ == 0) {
       os << " [ ]\n";
     } else {
-      os << " [";
+      TextBasicTypeWriter writer(os);
+      writer.WriteString(" [");
       for (MatrixIndexT i = 0; i < num_rows_; i++) {
-        os << "\n  ";
-        for (MatrixIndexT j = 0; j < num_cols_; j++) os << (*this)(i, j) << " ";
+        writer.WriteString("\n  ");
+        const Real *row_data = RowData(i);
+        for (MatrixIndexT j = 0; j < num_cols_; j++) writer.Write(row_data[j]);
       }
-      os << "]\n";
+      writer.WriteString("]\n");
+      writer.Flush();
     }
   }
 }
@@ -324,11 +360,20 @@ void Matrix<Real>::Read(std::istream &is, bool binary, bool add) {
       // This code enables us to read CompressedMatrix as a regular matrix.
       CompressedMatrix compressed_mat;
       compressed_mat.Read(is, binary);  // at this point, add == false.
-      this->Resize(compressed_mat.NumRows(), compressed_mat.NumCols());
+      this->Resize(compressed_mat.NumRows(), compressed_mat.NumCols(),
+                   kUndefined);
       compressed_mat.CopyToMat(this);
       return;
     }
 #endif
+    if (peekval == 'H' || peekval == 'B') {
+      // Likewise for HalfMatrix ("HM" or "BM").
+      HalfMatrix half_mat;
+      half_mat.Read(is, binary);
+      this->Resize(half_mat.NumRows(), half_mat.NumCols(), kUndefined);
+      half_mat.CopyToMat(this);
+      return;
+    }
     const char *my_token = (sizeof(Real) == 4 ? "FM" : "DM");
     char other_token_start = (sizeof(Real) == 4 ? 'D' : 'F');
     if (peekval ==
@@ -338,9 +383,9 @@ void Matrix<Real>::Read(std::istream &is, bool binary, bool add) {
           typename std::conditional<std::is_same<Real, float>::value, double,
                                     float>::type;
 
-      Matrix<OtherType> other(this->num_rows_, this->num_cols_);
+      Matrix<OtherType> other;
       other.Read(is, binary, false);  // add is false at this point anyway.
-      this->Resize(other.NumRows(), other.NumCols());
+      this->Resize(other.NumRows(), other.NumCols(), kUndefined);
       this->CopyFromMat(other);
       return;
     }
@@ -356,7 +401,7 @@ void Matrix<Real>::Read(std::istream &is, bool binary, bool add) {
     ReadBasicType(is, binary, &cols);  // throws on error.
     if ((MatrixIndexT)rows != this->num_rows_ ||
         (MatrixIndexT)cols != this->num_cols_) {
-      this->Resize(rows, cols);
+      this->Resize(rows, cols, kUndefined);
     }
     if (this->Stride() == this->NumCols() && rows * cols != 0) {
       is.read(reinterpret_cast<char *>(this->Data()),
@@ -425,7 +470,7 @@ void Matrix<Real>::Read(std::istream &is, bool binary, bool add) {
           return;
         } else {
           int32_t num_rows = data.size(), num_cols = data[0]->size();
-          this->Resize(num_rows, num_cols);
+          this->Resize(num_rows, num_cols, kUndefined);
           for (int32_t i = 0; i < num_rows; i++) {
             if (static_cast<int32_t>(data[i]->size()) != num_cols) {
               specific_error << "Matrix has inconsistent #cols: " << num_cols
@@ -450,7 +495,7 @@ void Matrix<Real>::Read(std::istream &is, bool binary, bool add) {
         }
       } else if ((i >= '0' && i <= '9') || i == '-') {  // A number...
         Real r;
-        is >> r;
+        ScanNumber(is, &r);
         if (is.fail()) {
           specific_error << "Stream failure/EOF while reading matrix data.";
           goto cleanup;
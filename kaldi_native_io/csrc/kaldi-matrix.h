@@ -15,6 +15,7 @@
 #include "kaldi_native_io/csrc/kaldi-vector.h"
 #include "kaldi_native_io/csrc/log.h"
 #include "kaldi_native_io/csrc/matrix-common.h"
+#include "kaldi_native_io/csrc/memory-allocator.h"
 
 namespace kaldiio {
 
@@ -173,7 +174,7 @@ class Matrix : public MatrixBase<Real> {
   Matrix(const MatrixIndexT r, const MatrixIndexT c,
          MatrixResizeType resize_type = kSetZero,
          MatrixStrideType stride_type = kDefaultStride)
-      : MatrixBase<Real>() {
+      : MatrixBase<Real>(), capacity_(0), allocator_(NULL) {
     Resize(r, c, resize_type, stride_type);
   }
 
@@ -204,10 +205,19 @@ class Matrix : public MatrixBase<Real> {
   /// in bytes is a multiple of 16.
   ///
   /// This function takes time proportional to the number of data elements.
+  ///
+  /// If the new data fits in the memory the matrix already has (see
+  /// Capacity()), that memory is reused instead of being freed and allocated
+  /// again, so that e.g. reading many matrices into the same Matrix does not
+  /// allocate for each one.  Resize(0, 0) always frees the memory.
   void Resize(const MatrixIndexT r, const MatrixIndexT c,
               MatrixResizeType resize_type = kSetZero,
               MatrixStrideType stride_type = kDefaultStride);
 
+  /// Returns the number of elements the allocated memory has room for, which
+  /// may be more than NumRows() * Stride() after Resize().
+  size_t Capacity() const { return capacity_; }
+
  private:
   /// Deallocates memory and sets to empty matrix (dimension 0, 0).
   void Destroy();
@@ -218,6 +228,9 @@ class Matrix : public MatrixBase<Real> {
   /// data memory contents will be undefined.
   void Init(const MatrixIndexT r, const MatrixIndexT c,
             const MatrixStrideType stride_type);
+
+  size_t capacity_;  // The number of elements data_ has room for.
+  MemoryAllocator *allocator_;  // The allocator data_ was allocated with.
 };
 
 template <typename Real>
@@ -234,6 +247,11 @@ class SubMatrix : public MatrixBase<Real> {
             const MatrixIndexT co,  // column offset, 0 < co < NumCols()
             const MatrixIndexT c);  // number of columns, c > 0
 
+  /// This initializer is for when you have memory that you don't own (e.g. a
+  /// memory-mapped archive); the SubMatrix will point to it directly.
+  SubMatrix(Real *data, MatrixIndexT num_rows, MatrixIndexT num_cols,
+            MatrixIndexT stride);
+
   /// This type of constructor is needed for Range() to work [in Matrix base
   /// class]. Cannot make it explicit.
   SubMatrix<Real>(const SubMatrix &other)
@@ -272,6 +290,13 @@ bool WriteHtk(std::ostream &os, const MatrixBase<Real> &M, HtkHeader htk_hdr);
 template <typename Real>
 bool WriteSphinx(std::ostream &os, const MatrixBase<Real> &M);
 
+// Returns the number of bytes of memory used by M; see MemoryUsage() in
+// stl-utils.h.
+template <typename Real>
+size_t MemoryUsage(const Matrix<Real> &M) {
+  return sizeof(M) + M.Capacity() * sizeof(Real);
+}
+
 }  // namespace kaldiio
 
 // we need to include the implementation and some
@@ -0,0 +1,62 @@
+// kaldi_native_io/csrc/kaldi-membuf.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_KALDI_MEMBUF_H_
+#define KALDI_NATIVE_IO_CSRC_KALDI_MEMBUF_H_
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+namespace kaldiio {
+
+// A read-only streambuf over a block of memory that it does not own, e.g. a
+// memory-mapped file.  It lets us use the usual istream-based Read()
+// functions on that memory without first copying it into a std::string.
+// The memory must outlive this object.  Seeking (and hence tellg()) is
+// supported, since some Read() functions rely on it.
+class MemoryInputBuf : public std::streambuf {
+ public:
+  MemoryInputBuf(const char *data, size_t size) {
+    char *begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+  }
+
+ protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which = std::ios_base::in) override {
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+    off_type pos;
+    if (dir == std::ios_base::beg)
+      pos = off;
+    else if (dir == std::ios_base::cur)
+      pos = (gptr() - eback()) + off;
+    else
+      pos = (egptr() - eback()) + off;
+    if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+
+  pos_type seekpos(pos_type pos,
+                   std::ios_base::openmode which = std::ios_base::in) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// An istream that reads from a block of memory; see MemoryInputBuf.
+class MemoryInputStream : public std::istream {
+ public:
+  MemoryInputStream(const char *data, size_t size)
+      : std::istream(NULL), buf_(data, size) {
+    rdbuf(&buf_);
+  }
+
+ private:
+  MemoryInputBuf buf_;
+};
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_KALDI_MEMBUF_H_
@@ -26,15 +26,28 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <sstream>
 #include <string>
 #include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "kaldi_native_io/csrc/input-cursor.h"
 #include "kaldi_native_io/csrc/kaldi-io.h"
+#include "kaldi_native_io/csrc/kaldi-membuf.h"
 #include "kaldi_native_io/csrc/kaldi-utils.h"
 #include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/mapped-file.h"
+#include "kaldi_native_io/csrc/script-table.h"
+#include "kaldi_native_io/csrc/text-utils.h"
 // #include "util/kaldi-io.h"
 // #include "util/kaldi-holder.h"
 // #include "util/text-utils.h"
@@ -89,14 +102,15 @@ class SequentialTableReaderImplBase {
 };
 
 // This is the implementation for SequentialTableReader
-// when it's actually a script file.
+// when it's actually a script file (or a compiled script file).
 template <class Holder>
 class SequentialTableReaderScriptImpl
     : public SequentialTableReaderImplBase<Holder> {
  public:
   typedef typename Holder::T T;
 
-  SequentialTableReaderScriptImpl() : state_(kUninitialized) {}
+  SequentialTableReaderScriptImpl()
+      : compiled_(false), next_index_(0), state_(kUninitialized) {}
 
   // You may call Open from states kUninitialized and kError.
   // It may leave the object in any of the states.
@@ -109,7 +123,19 @@ class SequentialTableReaderScriptImpl
     rspecifier_ = rspecifier;
     RspecifierType rs =
         ClassifyRspecifier(rspecifier, &script_rxfilename_, &opts_);
-    KALDIIO_ASSERT(rs == kScriptRspecifier);
+    KALDIIO_ASSERT(rs == kScriptRspecifier || rs == kCompiledScriptRspecifier);
+    data_inputs_.SetMaxOpen(opts_.max_open_files);
+    compiled_ = (rs == kCompiledScriptRspecifier);
+    if (compiled_) {
+      if (!compiled_script_.ReadCompiled(script_rxfilename_, false)) {
+        state_ = kUninitialized;
+        return false;
+      }
+      next_index_ = 0;
+      state_ = kFileStart;
+      Next();
+      return state_ != kError;
+    }
     if (!script_input_.Open(script_rxfilename_, &binary)) {  // Failure on Open
       KALDIIO_WARN << "Failed to open script file "
                    << PrintableRxfilename(script_rxfilename_);
@@ -137,6 +163,7 @@ class SequentialTableReaderScriptImpl
       case kHaveScpLine:
       case kHaveObject:
       case kHaveRange:
+      case kHaveRangeOnly:
         return true;
       case kUninitialized:
       case kError:
@@ -154,6 +181,7 @@ class SequentialTableReaderScriptImpl
       case kHaveScpLine:
       case kHaveObject:
       case kHaveRange:
+      case kHaveRangeOnly:
         return false;
       case kEof:
       case kError:
@@ -172,6 +200,7 @@ class SequentialTableReaderScriptImpl
       case kHaveScpLine:
       case kHaveObject:
       case kHaveRange:
+      case kHaveRangeOnly:
         break;
       default:
         // coding error.
@@ -188,8 +217,8 @@ class SequentialTableReaderScriptImpl
                   << "(p, ) option to the rspecifier.";
     // Because EnsureObjectLoaded() returned with success, we know
     // that if range_ is nonempty (i.e. a range was requested), the
-    // state will be kHaveRange.
-    if (state_ == kHaveRange) {
+    // state will be kHaveRange or kHaveRangeOnly.
+    if (state_ == kHaveRange || state_ == kHaveRangeOnly) {
       return range_holder_.Value();
     } else {
       KALDIIO_ASSERT(state_ == kHaveObject);
@@ -204,6 +233,9 @@ class SequentialTableReaderScriptImpl
     } else if (state_ == kHaveRange) {
       range_holder_.Clear();
       state_ = kHaveObject;
+    } else if (state_ == kHaveRangeOnly) {
+      range_holder_.Clear();
+      state_ = kHaveScpLine;
     } else {
       KALDIIO_WARN << "FreeCurrent called at the wrong time.";
     }
@@ -223,6 +255,9 @@ class SequentialTableReaderScriptImpl
       range_holder_.Swap(other_holder);
       state_ = kHaveObject;
       // This indicates that we still have the base object (but no range).
+    } else if (state_ == kHaveRangeOnly) {
+      range_holder_.Swap(other_holder);
+      state_ = kHaveScpLine;
     } else {
       KALDIIO_ERR << "Code error";
     }
@@ -240,7 +275,7 @@ class SequentialTableReaderScriptImpl
   //  - in non-permissive mode, status kHaveScpLine or kHaveObjecct
   //  - in permissive mode, only when we successfully have an object,
   //    which means either (kHaveObject and range_.empty()), or
-  //    kHaveRange.
+  //    kHaveRange or kHaveRangeOnly.
   void Next() {
     while (1) {
       NextScpLine();
@@ -265,7 +300,8 @@ class SequentialTableReaderScriptImpl
   virtual bool Close() {
     int32_t status = 0;
     if (script_input_.IsOpen()) status = script_input_.Close();
-    if (data_input_.IsOpen()) data_input_.Close();
+    compiled_script_.Clear();
+    data_inputs_.Close();
     range_holder_.Clear();
     holder_.Clear();
     if (!this->IsOpen())
@@ -305,9 +341,11 @@ class SequentialTableReaderScriptImpl
   // (including object range) associated with the current key, and returns true
   // on success (i.e. we have the object) and false on failure.
   //
-  // Possible entry states: kHaveScpLine, kLoadSucceeded, kRangeSucceeded
+  // Possible entry states: kHaveScpLine, kHaveObject, kHaveRange,
+  // kHaveRangeOnly.
   //
-  // Possible exit states: kHaveScpLine, kLoadSucceeded, kRangeSucceeded.
+  // Possible exit states: kHaveScpLine, kHaveObject, kHaveRange,
+  // kHaveRangeOnly.
   //
   // Note: the return status has information that cannot be deduced from
   // just the exit state.  If the object could not be loaded we go to state
@@ -315,23 +353,26 @@ class SequentialTableReaderScriptImpl
   // could not be extracted, we go to state kLoadSucceeded but return false.
   bool EnsureObjectLoaded() {
     if (!(state_ == kHaveScpLine || state_ == kHaveObject ||
-          state_ == kHaveRange))
+          state_ == kHaveRange || state_ == kHaveRangeOnly))
       KALDIIO_ERR << "Invalid state (code error)";
+    if (state_ == kHaveRangeOnly) return true;
 
     if (state_ == kHaveScpLine) {  // need to load the object into holder_.
-      bool ans;
-      // note, NULL means it doesn't read the binary-mode header
-      if (Holder::IsReadInBinary()) {
-        ans = data_input_.Open(data_rxfilename_, NULL);
-      } else {
-        ans = data_input_.OpenTextMode(data_rxfilename_);
-      }
-      if (!ans) {
+      // note, this doesn't read the binary-mode header.
+      Input *data_input =
+          data_inputs_.Open(data_rxfilename_, !Holder::IsReadInBinary());
+      if (data_input == NULL) {
         KALDIIO_WARN << "Failed to open file "
                      << PrintableRxfilename(data_rxfilename_);
         return false;
+      } else if (!range_.empty() &&
+                 range_holder_.ReadRange(data_input->Stream(), range_)) {
+        // We read just the range, e.g. the rows of a matrix that were asked
+        // for, without reading the whole object into holder_.
+        state_ = kHaveRangeOnly;
+        return true;
       } else {
-        if (holder_.Read(data_input_.Stream())) {
+        if (holder_.Read(data_input->Stream())) {
           state_ = kHaveObject;
         } else {  // holder_ will not contain data.
           KALDIIO_WARN << "Failed to load object from "
@@ -370,13 +411,15 @@ class SequentialTableReaderScriptImpl
   void SetErrorState() {
     state_ = kError;
     script_input_.Close();
-    data_input_.Close();
+    compiled_script_.Clear();
+    data_inputs_.Close();
     holder_.Clear();
     range_holder_.Clear();
   }
 
   // Reads the next line in the script file.
-  // Possible entry states: kHaveObject, kHaveRange, kHaveScpLine, kFileStart.
+  // Possible entry states: kHaveObject, kHaveRange, kHaveRangeOnly,
+  // kHaveScpLine, kFileStart.
   // Possible exit states: kEof, kError, kHaveScpLine, kHaveObject.
   void NextScpLine() {
     switch (state_) {  // Check and simplify the state.
@@ -384,6 +427,10 @@ class SequentialTableReaderScriptImpl
         range_holder_.Clear();
         state_ = kHaveObject;
         break;
+      case kHaveRangeOnly:
+        range_holder_.Clear();
+        state_ = kHaveScpLine;
+        break;
       case kHaveScpLine:
       case kHaveObject:
       case kFileStart:
@@ -393,6 +440,17 @@ class SequentialTableReaderScriptImpl
         KALDIIO_ERR << "Reading script file: Next called wrongly.";
     }
     // at this point the state will be kHaveObject, kHaveScpLine, or kFileStart.
+    if (compiled_) {
+      if (next_index_ < compiled_script_.Size()) {
+        key_ = compiled_script_.Key(next_index_);
+        range_ = compiled_script_.Range(next_index_);
+        SetDataRxfilename(compiled_script_.Rxfilename(next_index_));
+        next_index_++;
+      } else {
+        SetEofState();
+      }
+      return;
+    }
     std::string line;
     if (getline(script_input_.Stream(), line)) {
       // After extracting "key" from "line", we put the rest
@@ -414,43 +472,62 @@ class SequentialTableReaderScriptImpl
           data_rxfilename = rest;
           range_ = "";
         }
-        bool filenames_equal = (data_rxfilename_ == data_rxfilename);
-        if (!filenames_equal) data_rxfilename_ = data_rxfilename;
-        if (state_ == kHaveObject) {
-          if (!filenames_equal) {
-            holder_.Clear();
-            state_ = kHaveScpLine;
-          }
-          // else leave state_ at kHaveObject and leave the object in the
-          // holder.
-        } else {
-          state_ = kHaveScpLine;
-        }
+        SetDataRxfilename(data_rxfilename);
       } else {
         KALDIIO_WARN << "We got an invalid line in the scp file. "
                      << "It should look like: some_key 1.ark:10, got: " << line;
         SetErrorState();
       }
     } else {
-      state_ = kEof;  // there is nothing more in the scp file.  Might as well
-                      // close input streams as we don't need them.
-      script_input_.Close();
-      if (data_input_.IsOpen()) data_input_.Close();
-      holder_.Clear();        // clear the holder if it was nonempty.
-      range_holder_.Clear();  // clear the range holder if it was nonempty.
+      SetEofState();
+    }
+  }
+
+  // Called from NextScpLine() when we have read the key and range of the next
+  // line; updates data_rxfilename_ and the state, keeping the object in
+  // holder_ if the new line refers to the same object.
+  // Possible entry states: kHaveObject, kHaveScpLine, kFileStart.
+  // Possible exit states: kHaveObject, kHaveScpLine.
+  void SetDataRxfilename(const std::string &data_rxfilename) {
+    bool filenames_equal = (data_rxfilename_ == data_rxfilename);
+    if (!filenames_equal) data_rxfilename_ = data_rxfilename;
+    if (state_ == kHaveObject) {
+      if (!filenames_equal) {
+        holder_.Clear();
+        state_ = kHaveScpLine;
+      }
+      // else leave state_ at kHaveObject and leave the object in the
+      // holder.
+    } else {
+      state_ = kHaveScpLine;
     }
   }
 
+  void SetEofState() {
+    state_ = kEof;  // there is nothing more in the scp file.  Might as well
+                    // close input streams as we don't need them.
+    script_input_.Close();
+    compiled_script_.Clear();
+    data_inputs_.Close();
+    holder_.Clear();        // clear the holder if it was nonempty.
+    range_holder_.Clear();  // clear the range holder if it was nonempty.
+  }
+
   std::string rspecifier_;  // the rspecifier that this class was opened with.
   RspecifierOptions opts_;  // options.
   std::string script_rxfilename_;  // rxfilename of the script file.
 
   Input script_input_;  // Input object for the .scp file
-  Input
-      data_input_;  // Input object for the entries in the script file;
-                    // we make this a class member instead of a local variable,
-                    // so that rspecifiers of the form filename:byte-offset,
-                    // e.g. foo.ark:12345, can be handled using fseek().
+  bool compiled_;       // True if we are reading a compiled script file
+                        // ("bscp:"), in which case compiled_script_ is used
+                        // instead of script_input_.
+  ScriptTable compiled_script_;
+  size_t next_index_;  // The index in compiled_script_ of the next line.
+  InputCache data_inputs_;  // Input objects for the entries in the script
+                            // file; we keep the files open between entries,
+                            // so that rspecifiers of the form
+                            // filename:byte-offset, e.g. foo.ark:12345, can be
+                            // handled using fseek().
 
   Holder holder_;        // Holds the object.
   Holder range_holder_;  // Holds the partial object corresponding to the object
@@ -493,6 +570,10 @@ class SequentialTableReaderScriptImpl
     kHaveRange,    // yes yes yes yes           we have the range object in
                    // range_holder_ (implies
                    //                           range_ nonempty).
+    kHaveRangeOnly,  // no  yes yes yes         we have the range object in
+                     // range_holder_, read with
+                     //                         Holder::ReadRange() without
+                     //                         reading the whole object.
   } state_;
 };
 
@@ -530,11 +611,24 @@ class SequentialTableReaderArchiveImpl
     KALDIIO_ASSERT(rs == kArchiveRspecifier);
 
     bool ans;
-    // NULL means don't expect binary-mode header
-    if (Holder::IsReadInBinary())
-      ans = input_.Open(archive_rxfilename_, NULL);
-    else
-      ans = input_.OpenTextMode(archive_rxfilename_);
+    if (opts_.mmap && ClassifyRxfilename(archive_rxfilename_) != kFileInput)
+      KALDIIO_WARN << "The mmap option requires the archive to be an actual "
+                      "file; reading it as a stream: rspecifier = "
+                   << rspecifier;
+    if (opts_.mmap && ClassifyRxfilename(archive_rxfilename_) == kFileInput &&
+        mapped_.Open(archive_rxfilename_)) {
+      cursor_.reset(new InputCursor(mapped_.Data(), mapped_.Size()));
+      ans = true;
+    } else {
+      // If mmap was requested but we could not map the archive, a warning
+      // has been printed and we just read it as usual.
+      if (Holder::IsReadInBinary())
+        // NULL means don't expect binary-mode header
+        ans = input_.Open(archive_rxfilename_, NULL);
+      else
+        ans = input_.OpenTextMode(archive_rxfilename_);
+      if (ans) cursor_.reset(new InputCursor(input_.Stream()));
+    }
     if (!ans) {  // header.
       KALDIIO_WARN << "Failed to open stream "
                    << PrintableRxfilename(archive_rxfilename_);
@@ -546,7 +640,9 @@ class SequentialTableReaderArchiveImpl
     if (state_ == kError) {
       KALDIIO_WARN << "Error beginning to read archive file (wrong filename?): "
                    << PrintableRxfilename(archive_rxfilename_);
+      cursor_.reset();
       input_.Close();
+      mapped_.Close();
       state_ = kUninitialized;
       return false;
     }
@@ -565,36 +661,27 @@ class SequentialTableReaderArchiveImpl
       default:
         KALDIIO_ERR << "Next() called wrongly.";
     }
-    std::istream &is = input_.Stream();
-    is.clear();  // Clear any fail bits that may have been set... just in case
-    // this happened in the Read function.
-    is >> key_;  // This eats up any leading whitespace and gets the string.
-    if (is.eof()) {
+    InputCursor &cursor = *cursor_;
+    // This eats up any leading whitespace and gets the string.
+    if (!cursor.ReadToken(&key_)) {
       state_ = kEof;
       return;
     }
-    if (is.fail()) {  // This shouldn't really happen, barring file-system
-                      // errors.
-      KALDIIO_WARN << "Error reading archive "
-                   << PrintableRxfilename(archive_rxfilename_);
-      state_ = kError;
-      return;
-    }
     int c;
-    if ((c = is.peek()) != ' ' && c != '\t' && c != '\n') {  // We expect a
+    if ((c = cursor.Peek()) != ' ' && c != '\t' && c != '\n') {  // We expect a
       // space ' ' after the key.
       // We also allow tab [which is consumed] and newline [which is not], just
       // so we can read archives generated by scripts that may not be fully
       // aware of how this format works.
       KALDIIO_WARN << "Invalid archive file format: expected space after key "
                    << key_ << ", got character "
-                   << CharToString(static_cast<char>(is.peek())) << ", reading "
+                   << CharToString(static_cast<char>(c)) << ", reading "
                    << PrintableRxfilename(archive_rxfilename_);
       state_ = kError;
       return;
     }
-    if (c != '\n') is.get();  // Consume the space or tab.
-    if (holder_.Read(is)) {
+    if (c != '\n') cursor.Consume(1);  // Consume the space or tab.
+    if (ReadHolder(&cursor, &holder_)) {
       state_ = kHaveObject;
       return;
     } else {
@@ -690,7 +777,9 @@ class SequentialTableReaderArchiveImpl
       KALDIIO_ERR
           << "Close() called on TableReader twice or otherwise wrongly.";
     int32_t status = 0;
+    cursor_.reset();
     if (input_.IsOpen()) status = input_.Close();
+    mapped_.Close();
     if (state_ == kHaveObject) holder_.Clear();
     StateType old_state = state_;
     state_ = kUninitialized;
@@ -717,6 +806,9 @@ class SequentialTableReaderArchiveImpl
 
  private:
   Input input_;    // Input object for the archive
+  MappedFile mapped_;  // With the mmap option, the archive (instead of
+                       // input_).
+  std::unique_ptr<InputCursor> cursor_;  // Reads from input_ or mapped_.
   Holder holder_;  // Holds the object.
   std::string key_;
   std::string rspecifier_;
@@ -734,8 +826,11 @@ class SequentialTableReaderArchiveImpl
   } state_;
 };
 
-// this is for when someone adds the 'th' modifier; it wraps around the basic
+// this is for when someone adds the 'bg' modifier; it wraps around the basic
 // implementation and allows it to do the reading in a background thread.
+// The background thread reads ahead by up to 'queue_size' objects (the N in
+// "bg=N"; plain "bg" means 1), which it places in a ring of holders.  The
+// objects are handed to the main thread in the order in which they were read.
 template <class Holder>
 class SequentialTableReaderBackgroundImpl
     : public SequentialTableReaderImplBase<Holder> {
@@ -743,8 +838,19 @@ class SequentialTableReaderBackgroundImpl
   typedef typename Holder::T T;
 
   SequentialTableReaderBackgroundImpl(
-      SequentialTableReaderImplBase<Holder> *base_reader)
-      : base_reader_(base_reader) {}
+      SequentialTableReaderImplBase<Holder> *base_reader,
+      int32_t queue_size = 1)
+      : keys_(queue_size),
+        holders_(queue_size),
+        consumer_sem_(0),
+        producer_sem_(queue_size),
+        read_pos_(0),
+        stop_(false),
+        error_(false),
+        base_reader_(base_reader) {
+    KALDIIO_ASSERT(queue_size > 0);
+    for (size_t i = 0; i < holders_.size(); i++) holders_[i].reset(new Holder);
+  }
 
   // This function ignores the rxfilename argument.
   // We use the same function signature as the regular Open(),
@@ -752,12 +858,9 @@ class SequentialTableReaderBackgroundImpl
   virtual bool Open(const std::string & /*rxfilename*/) {
     KALDIIO_ASSERT(base_reader_ != NULL &&
                    base_reader_->IsOpen());  // or code error.
-    {
-      thread_ =
-          std::thread(SequentialTableReaderBackgroundImpl<Holder>::run, this);
-    }
-
-    if (!base_reader_->Done()) Next();
+    thread_ =
+        std::thread(SequentialTableReaderBackgroundImpl<Holder>::run, this);
+    Next();  // Wait for the first object (or for the end of the table).
     return true;
   }
 
@@ -768,38 +871,38 @@ class SequentialTableReaderBackgroundImpl
   }
 
   void RunInBackground() {
+    // This function is called in the background thread.  The whole point of
+    // the background thread is that we don't want to do the actual reading
+    // (inside Next()) in the foreground.  Slot i of the ring is filled with
+    // the i'th object (modulo the ring size); an empty key marks the end.
+    size_t write_pos = 0;
     try {
-      // This function is called in the background thread.  The whole point of
-      // the background thread is that we don't want to do the actual reading
-      // (inside Next()) in the foreground.
-      while (base_reader_ != NULL && !base_reader_->Done()) {
-        consumer_sem_.Signal();
-        // Here is where the consumer process (parent thread) gets to do its
-        // stuff.  Principally it calls SwapHolder()-- a shallow swap that is
-        // cheap.
+      while (true) {
+        // Wait for a free slot; Close() also signals this semaphore to
+        // tell us to stop.
         producer_sem_.Wait();
-        // we check that base_reader_ is not NULL in case Close() was
-        // called in the main thread.
-        if (base_reader_ != NULL)
-          base_reader_->Next();  //  here is where the work happens.
+        if (stop_) return;
+        size_t slot = write_pos % holders_.size();
+        if (base_reader_->Done()) {
+          keys_[slot] = "";
+          consumer_sem_.Signal();
+          return;
+        }
+        keys_[slot] = base_reader_->Key();
+        // SwapHolder() is a shallow swap that is cheap; afterwards we are
+        // free to read the next object.
+        base_reader_->SwapHolder(holders_[slot].get());
+        base_reader_->Next();  //  here is where the work happens.
+        write_pos++;
+        consumer_sem_.Signal();
       }
-      // this signal will be waited on in the Next() function of the foreground
-      // thread if it is still running, or Close() otherwise.
-      consumer_sem_.Signal();
-      // this signal may be waited on in Close().
-      consumer_sem_.Signal();
     } catch (...) {
       // There is nothing we called above that could potentially throw due to
-      // user data.  So we treat reaching this point as a code-error condition.
-      // Closing base_reader_ will trigger an exception in Next() in the main
-      // thread when it checks that base_reader_->IsOpen().
-      if (base_reader_->IsOpen()) {
-        base_reader_->Close();
-        delete base_reader_;
-        base_reader_ = NULL;
-      }
+      // user data.  So we treat reaching this point as a code-error condition,
+      // which Next() in the main thread will report.
+      keys_[write_pos % holders_.size()] = "";
+      error_ = true;
       consumer_sem_.Signal();
-      return;
     }
   }
   static void run(SequentialTableReaderBackgroundImpl<Holder> *object) {
@@ -828,18 +931,25 @@ class SequentialTableReaderBackgroundImpl
   }
   virtual void Next() {
     consumer_sem_.Wait();
-    if (base_reader_ == NULL || !base_reader_->IsOpen())
+    if (error_)
       KALDIIO_ERR << "Error detected (likely code error) in background "
                   << "reader (',bg' option)";
-    if (base_reader_->Done()) {
-      // there is nothing else to read.
+    size_t slot = read_pos_ % holders_.size();
+    if (keys_[slot].empty()) {
+      // there is nothing else to read.  The background thread has finished,
+      // and we leave the end marker in place.
       key_ = "";
-    } else {
-      key_ = base_reader_->Key();
-      base_reader_->SwapHolder(&holder_);
+      return;
     }
+    key_.swap(keys_[slot]);
+    holder_.Swap(holders_[slot].get());
+    // The slot now contains the previous object; free it so that we hold at
+    // most queue_size + 2 objects (counting the current one and the one the
+    // base reader is reading).
+    holders_[slot]->Clear();
+    read_pos_++;
     // this Signal() tells the producer thread, in the background,
-    // that it's now safe to read the next value.
+    // that there is a free slot.
     producer_sem_.Signal();
   }
 
@@ -847,8 +957,11 @@ class SequentialTableReaderBackgroundImpl
   // object will delete this object after calling Close.
   virtual bool Close() {
     KALDIIO_ASSERT(base_reader_ != NULL && thread_.joinable());
-    // wait until the producer thread is idle.
-    consumer_sem_.Wait();
+    // Tell the producer thread to stop, and wake it if it is waiting for a
+    // free slot.  It checks stop_ before each object it reads.
+    stop_ = true;
+    producer_sem_.Signal();
+    thread_.join();
     bool ans = true;
     try {
       ans = base_reader_->Close();
@@ -856,13 +969,9 @@ class SequentialTableReaderBackgroundImpl
       ans = false;
     }
     delete base_reader_;
-    // setting base_reader_ to NULL will cause the loop in the producer thread
-    // to exit.
     base_reader_ = NULL;
-    producer_sem_.Signal();
-
-    thread_.join();
-    return ans;
+    for (size_t i = 0; i < holders_.size(); i++) holders_[i]->Clear();
+    return ans && !error_;
   }
   ~SequentialTableReaderBackgroundImpl() {
     if (base_reader_) {
@@ -874,17 +983,327 @@ class SequentialTableReaderBackgroundImpl
   }
 
  private:
-  std::string key_;
-  Holder holder_;
-  // I couldn't figure out what to call these semaphores.  consumer_sem_ is the
-  // one that the consumer (main thread) waits on; producer_sem_ is the one
-  // that the producer (background thread) waits on.
+  std::string key_;  // Key of the current object; empty if Done().
+  Holder holder_;    // The current object.
+
+  // The ring of objects that have been read ahead.  Slots are filled by the
+  // background thread and emptied by the main thread, in order.
+  std::vector<std::string> keys_;
+  std::vector<std::unique_ptr<Holder>> holders_;
+
+  // consumer_sem_ counts the filled slots; the consumer (main thread) waits on
+  // it.  producer_sem_ counts the free slots; the producer (background
+  // thread) waits on it.  Besides counting, they make sure that each thread
+  // sees the other's writes to the slots.
   Semaphore consumer_sem_;
   Semaphore producer_sem_;
+  size_t read_pos_;  // Number of objects taken by the main thread.
+  std::atomic<bool> stop_;  // Set by Close() to stop the background thread.
+  bool error_;  // Set by the background thread on error.
   std::thread thread_;
   SequentialTableReaderImplBase<Holder> *base_reader_;
 };
 
+// This is the implementation of SequentialTableReader we use with the
+// "threads=N" option.  It requires the archive to have an index (see "Table
+// index" in kaldi-table.h), which tells us where each object starts and how
+// long it is.  A framing thread reads the raw bytes of each object from the
+// archive without interpreting them, and N worker threads run Holder::Read()
+// on those bytes in parallel; this helps when decoding (e.g. decompressing a
+// CompressedMatrix) rather than I/O is the bottleneck.  The objects are
+// returned in archive order.  At most 2 * N objects are in flight at a time.
+template <class Holder>
+class SequentialTableReaderParallelImpl
+    : public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  explicit SequentialTableReaderParallelImpl(int32_t num_threads)
+      : num_threads_(num_threads),
+        read_pos_(0),
+        stop_(false),
+        framing_done_(false),
+        state_(kUninitialized) {
+    KALDIIO_ASSERT(num_threads > 0);
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    KALDIIO_ASSERT(state_ == kUninitialized);  // Only called once.
+    rspecifier_ = rspecifier;
+    RspecifierType rs =
+        ClassifyRspecifier(rspecifier, &archive_rxfilename_, &opts_);
+    KALDIIO_ASSERT(rs == kArchiveRspecifier);
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDIIO_WARN << "The threads option requires the archive to be an "
+                      "actual file: rspecifier = "
+                   << rspecifier;
+      return false;
+    }
+    TableIndex index;
+    if (!ReadTableIndex(TableIndexFilename(archive_rxfilename_), &index))
+      return false;  // A warning will already have been printed.
+    // Put the entries in archive order.
+    entries_.reserve(index.size());
+    for (typename TableIndex::const_iterator iter = index.begin();
+         iter != index.end(); ++iter)
+      entries_.push_back(std::make_pair(iter->second, iter->first));
+    std::sort(entries_.begin(), entries_.end(), EntryLess);
+
+    if (!input_.Open(archive_rxfilename_)) {
+      KALDIIO_WARN << "Failed to open stream "
+                   << PrintableRxfilename(archive_rxfilename_);
+      return false;
+    }
+    slots_.resize(2 * num_threads_);
+    for (size_t i = 0; i < slots_.size(); i++) slots_[i].reset(new Slot);
+    framing_thread_ = std::thread(
+        SequentialTableReaderParallelImpl<Holder>::RunFraming, this);
+    for (int32_t i = 0; i < num_threads_; i++)
+      worker_threads_.push_back(std::thread(
+          SequentialTableReaderParallelImpl<Holder>::RunWorker, this));
+    state_ = kFileStart;
+    Next();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return state_ != kUninitialized; }
+
+  virtual bool Done() const {
+    switch (state_) {
+      case kHaveObject:
+        return false;
+      case kEof:
+      case kError:
+        return true;
+      default:
+        KALDIIO_ERR << "Done() called on TableReader object at the wrong time.";
+        return false;
+    }
+  }
+
+  virtual std::string Key() {
+    if (state_ != kHaveObject)
+      KALDIIO_ERR << "Key() called on TableReader object at the wrong time.";
+    return key_;
+  }
+
+  T &Value() {
+    if (state_ != kHaveObject)
+      KALDIIO_ERR << "Value() called on TableReader object at the wrong time.";
+    return holder_.Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (state_ == kHaveObject) {
+      holder_.Clear();
+      state_ = kFreedObject;
+    } else {
+      KALDIIO_WARN << "FreeCurrent called at the wrong time.";
+    }
+  }
+
+  void SwapHolder(Holder *other_holder) {
+    (void)Value();
+    holder_.Swap(other_holder);
+    state_ = kFreedObject;
+  }
+
+  virtual void Next() {
+    switch (state_) {
+      case kHaveObject:
+        holder_.Clear();
+        break;
+      case kFileStart:
+      case kFreedObject:
+        break;
+      default:
+        KALDIIO_ERR << "Next() called wrongly.";
+    }
+    if (read_pos_ == entries_.size()) {
+      state_ = kEof;
+      return;
+    }
+    Slot &slot = *slots_[read_pos_ % slots_.size()];
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (slot.status != Slot::kDone && slot.status != Slot::kFailed)
+      ready_cv_.wait(lock);
+    if (slot.status == Slot::kFailed) {
+      KALDIIO_WARN << "Object read failed for key "
+                   << entries_[read_pos_].second << ", reading archive "
+                   << PrintableRxfilename(archive_rxfilename_);
+      state_ = kError;
+      return;
+    }
+    key_ = entries_[read_pos_].second;
+    holder_.Swap(&slot.holder);
+    slot.status = Slot::kFree;
+    read_pos_++;
+    free_cv_.notify_one();
+    state_ = kHaveObject;
+  }
+
+  virtual bool Close() {
+    if (!IsOpen())
+      KALDIIO_ERR
+          << "Close() called on TableReader twice or otherwise wrongly.";
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    free_cv_.notify_all();
+    work_cv_.notify_all();
+    framing_thread_.join();
+    for (size_t i = 0; i < worker_threads_.size(); i++)
+      worker_threads_[i].join();
+    worker_threads_.clear();
+    slots_.clear();
+    input_.Close();
+    holder_.Clear();
+    bool error = (state_ == kError);
+    state_ = kUninitialized;
+    if (error) {
+      if (opts_.permissive) {
+        KALDIIO_WARN << "Error detected closing TableReader for archive "
+                     << PrintableRxfilename(archive_rxfilename_)
+                     << " but ignoring "
+                     << "it as permissive mode specified.";
+        return true;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  virtual ~SequentialTableReaderParallelImpl() {
+    if (this->IsOpen() && !Close())
+      KALDIIO_ERR << "TableReader: error detected closing archive "
+                  << PrintableRxfilename(archive_rxfilename_);
+  }
+
+ private:
+  typedef std::pair<TableIndexEntry, std::string> Entry;
+
+  static bool EntryLess(const Entry &a, const Entry &b) {
+    return a.first.offset < b.first.offset;
+  }
+
+  // An object on its way from the framing thread, via a worker thread, to
+  // the main thread.  Object i goes into slot i % slots_.size().
+  struct Slot {
+    enum {
+      kFree,     // The framing thread may fill it.
+      kRead,     // bytes contains the object; waiting for a worker.
+      kDone,     // holder contains the object; waiting for the main thread.
+      kFailed,   // Reading or decoding the object failed.
+    } status;
+    std::string bytes;
+    Holder holder;
+    Slot() : status(kFree) {}
+  };
+
+  static void RunFraming(SequentialTableReaderParallelImpl<Holder> *object) {
+    object->Frame();
+  }
+
+  static void RunWorker(SequentialTableReaderParallelImpl<Holder> *object) {
+    object->Work();
+  }
+
+  // Runs in the framing thread.
+  void Frame() {
+    std::istream &is = input_.Stream();
+    int64_t cur_pos = 0;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      Slot &slot = *slots_[i % slots_.size()];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && slot.status != Slot::kFree) free_cv_.wait(lock);
+        if (stop_) break;
+      }
+      // The slot is ours until we change its status, so we can fill it
+      // without holding the lock.
+      const TableIndexEntry &entry = entries_[i].first;
+      if (entry.offset != cur_pos) is.seekg(entry.offset, std::ios_base::beg);
+      slot.bytes.resize(entry.length);
+      if (entry.length != 0) is.read(&slot.bytes[0], entry.length);
+      cur_pos = entry.offset + entry.length;
+      bool ok = !is.fail();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (ok) {
+        slot.status = Slot::kRead;
+        work_queue_.push_back(i);
+        work_cv_.notify_one();
+      } else {
+        slot.status = Slot::kFailed;
+        ready_cv_.notify_all();
+        break;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    framing_done_ = true;
+    work_cv_.notify_all();
+  }
+
+  // Runs in each worker thread.
+  void Work() {
+    while (true) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && work_queue_.empty() && !framing_done_)
+          work_cv_.wait(lock);
+        if (stop_ || work_queue_.empty()) return;
+        i = work_queue_.front();
+        work_queue_.pop_front();
+      }
+      Slot &slot = *slots_[i % slots_.size()];
+      bool ok;
+      try {
+        InputCursor cursor(slot.bytes.data(), slot.bytes.size());
+        ok = ReadHolder(&cursor, &slot.holder);
+      } catch (...) {
+        ok = false;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.status = (ok ? Slot::kDone : Slot::kFailed);
+      ready_cv_.notify_all();
+    }
+  }
+
+  int32_t num_threads_;
+  Input input_;  // The archive; read by the framing thread.
+  std::string key_;
+  Holder holder_;  // The current object.
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+
+  std::vector<Entry> entries_;  // The index, sorted by offset.
+  std::vector<std::unique_ptr<Slot>> slots_;
+  size_t read_pos_;  // The number of objects taken by the main thread.
+
+  std::thread framing_thread_;
+  std::vector<std::thread> worker_threads_;
+  // mutex_ protects the status of the slots, work_queue_, stop_ and
+  // framing_done_.
+  std::mutex mutex_;
+  std::condition_variable free_cv_;   // A slot became free.
+  std::condition_variable work_cv_;   // work_queue_ became nonempty.
+  std::condition_variable ready_cv_;  // An object was decoded (or failed).
+  std::deque<size_t> work_queue_;     // Slots waiting for a worker.
+  bool stop_;                         // Set by Close().
+  bool framing_done_;                 // The framing thread has finished.
+
+  enum {
+    kUninitialized,  // Uninitialized or closed.
+    kFileStart,      // [state we use internally: just opened.]
+    kEof,            // We have returned all the objects in the index.
+    kError,          // An object could not be read.
+    kHaveObject,     // holder_ contains the object for key_.
+    kFreedObject,    // The user called FreeCurrent().
+  } state_;
+};
+
 template <class Holder>
 SequentialTableReader<Holder>::SequentialTableReader(
     const std::string &rspecifier)
@@ -902,11 +1321,23 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
 
   RspecifierOptions opts;
   RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, &opts);
+  bool opened = false;
   switch (wt) {
     case kArchiveRspecifier:
+      if (opts.num_threads > 0) {
+        impl_ = new SequentialTableReaderParallelImpl<Holder>(opts.num_threads);
+        if (impl_->Open(rspecifier)) {
+          opened = true;
+          break;
+        }
+        // A warning will have been printed, e.g. that there is no index.
+        KALDIIO_WARN << "Reading " << rspecifier << " with a single thread.";
+        delete impl_;
+      }
       impl_ = new SequentialTableReaderArchiveImpl<Holder>();
       break;
     case kScriptRspecifier:
+    case kCompiledScriptRspecifier:
       impl_ = new SequentialTableReaderScriptImpl<Holder>();
       break;
     case kNoRspecifier:
@@ -914,13 +1345,14 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
       KALDIIO_WARN << "Invalid rspecifier " << rspecifier;
       return false;
   }
-  if (!impl_->Open(rspecifier)) {
+  if (!opened && !impl_->Open(rspecifier)) {
     delete impl_;
     impl_ = NULL;
     return false;  // sub-object will have printed warnings.
   }
   if (opts.background) {
-    impl_ = new SequentialTableReaderBackgroundImpl<Holder>(impl_);
+    impl_ = new SequentialTableReaderBackgroundImpl<Holder>(
+        impl_, opts.background_queue_size);
     if (!impl_->Open("")) {
       // the rxfilename is ignored in that Open() call.
       // It should only return false on code error.
@@ -985,6 +1417,23 @@ SequentialTableReader<Holder>::~SequentialTableReader() {
   // Destructor of impl_ may throw.
 }
 
+// With the "align" option, writes to the archive 'os' the spaces that make
+// the data of the object with key 'key', which is written next, start at a
+// multiple of kArchiveDataAlignment bytes (see HolderDataOffset).
+template <class Holder>
+void WriteArchiveAlignment(std::ostream &os, const std::string &key,
+                           const WspecifierOptions &opts) {
+  const size_t data_offset = HolderDataOffset<Holder>::value;
+  if (!opts.align || !opts.binary || data_offset == 0) return;
+  int64_t pos = static_cast<int64_t>(os.tellp());
+  if (pos < 0) return;  // e.g. a pipe.
+  size_t end = static_cast<size_t>(pos) + key.size() + 1 + data_offset;
+  size_t num_spaces =
+      (kArchiveDataAlignment - end % kArchiveDataAlignment) %
+      kArchiveDataAlignment;
+  for (size_t i = 0; i < num_spaces; i++) os.put(' ');
+}
+
 template <class Holder>
 class TableWriterImplBase {
  public:
@@ -1000,6 +1449,13 @@ class TableWriterImplBase {
   // TableWriter::Write returned an exit status.
   virtual bool Write(const std::string &key, const T &value) = 0;
 
+  // As above, but the implementation may move from 'value'.  By default we
+  // just call the version above.
+  virtual bool Write(const std::string &key, T &&value) {
+    const T &const_value = value;
+    return Write(key, const_value);
+  }
+
   // Flush will flush any archive; it does not return error status,
   //  any errors will be reported on the next Write or Close.
   virtual void Flush() = 0;
@@ -1043,8 +1499,22 @@ class TableWriterArchiveImpl : public TableWriterImplBase<Holder> {
         ClassifyWspecifier(wspecifier, &archive_wxfilename_, NULL, &opts_);
     KALDIIO_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
 
+    if (opts_.write_index &&
+        ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDIIO_WARN << "The idx option requires the archive to be an actual "
+                      "file: wspecifier = "
+                   << wspecifier;
+      state_ = kUninitialized;
+      return false;
+    }
+
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false
       // means no binary header.
+      if (opts_.write_index && !OpenIndex()) {
+        output_.Close();  // Don't care about status: error anyway.
+        state_ = kUninitialized;
+        return false;
+      }
       state_ = kOpen;
       return true;
     } else {
@@ -1086,13 +1556,27 @@ class TableWriterArchiveImpl : public TableWriterImplBase<Holder> {
     // state is now kOpen or kWriteError.
     if (!IsToken(key))  // e.g. empty string or has spaces...
       KALDIIO_ERR << "Using invalid key " << key;
-    output_.Stream() << key << ' ';
-    if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
+    std::ostream &os = output_.Stream();
+    WriteArchiveAlignment<Holder>(os, key, opts_);
+    os << key << ' ';
+    int64_t offset = opts_.write_index ? static_cast<int64_t>(os.tellp()) : 0;
+    if (!Holder::Write(os, opts_.binary, value)) {
       KALDIIO_WARN << "Write failure to "
                    << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
       return false;
     }
+    if (opts_.write_index) {
+      TableIndexEntry entry(offset, static_cast<int64_t>(os.tellp()) - offset);
+      WriteTableIndexEntry(index_output_.Stream(), key, entry);
+      if (offset < 0 || entry.length < 0 || index_output_.Stream().fail()) {
+        KALDIIO_WARN << "Write failure to table index "
+                     << PrintableWxfilename(
+                            TableIndexFilename(archive_wxfilename_));
+        state_ = kWriteError;
+        return false;
+      }
+    }
     if (state_ == kWriteError) return false;  // Even if this Write seems to
     // have succeeded, we fail because a previous Write failed and the archive
     // may be corrupted and unreadable.
@@ -1108,6 +1592,7 @@ class TableWriterArchiveImpl : public TableWriterImplBase<Holder> {
       case kWriteError:
       case kOpen:
         output_.Stream().flush();  // Don't check error status.
+        if (index_output_.IsOpen()) index_output_.Stream().flush();
         return;
       default:
         KALDIIO_WARN << "Flush called on not-open writer.";
@@ -1119,6 +1604,7 @@ class TableWriterArchiveImpl : public TableWriterImplBase<Holder> {
       KALDIIO_ERR << "Close called on a stream that was not open."
                   << this->IsOpen() << ", " << output_.IsOpen();
     bool close_success = output_.Close();
+    if (index_output_.IsOpen() && !index_output_.Close()) close_success = false;
     if (!close_success) {
       KALDIIO_WARN << "Error closing stream: wspecifier is " << wspecifier_;
       state_ = kUninitialized;
@@ -1146,7 +1632,20 @@ class TableWriterArchiveImpl : public TableWriterImplBase<Holder> {
   }
 
  private:
+  // Opens index_output_ and writes the index header.
+  bool OpenIndex() {
+    std::string index_wxfilename = TableIndexFilename(archive_wxfilename_);
+    if (!index_output_.Open(index_wxfilename, true, true)) {
+      KALDIIO_WARN << "Failed to open table index "
+                   << PrintableWxfilename(index_wxfilename);
+      return false;
+    }
+    WriteTableIndexHeader(index_output_.Stream());
+    return true;
+  }
+
   Output output_;
+  Output index_output_;  // Only open if opts_.write_index.
   WspecifierOptions opts_;
   std::string wspecifier_;
   std::string archive_wxfilename_;
@@ -1357,6 +1856,21 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
       state_ = kUninitialized;
       return false;
     }
+    if (opts_.write_index) {
+      std::string index_wxfilename = TableIndexFilename(archive_wxfilename_);
+      if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput ||
+          !index_output_.Open(index_wxfilename, true, true)) {
+        KALDIIO_WARN << "Failed to open table index "
+                     << PrintableWxfilename(index_wxfilename)
+                     << " (the idx option requires the archive to be an "
+                        "actual file)";
+        archive_output_.Close();  // Don't care about status: error anyway.
+        script_output_.Close();
+        state_ = kUninitialized;
+        return false;
+      }
+      WriteTableIndexHeader(index_output_.Stream());
+    }
     state_ = kOpen;
     return true;
   }
@@ -1406,6 +1920,7 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
     if (!IsToken(key))  // e.g. empty string or has spaces...
       KALDIIO_ERR << "Using invalid key " << key;
     std::ostream &archive_os = archive_output_.Stream();
+    WriteArchiveAlignment<Holder>(archive_os, key, opts_);
     archive_os << key << ' ';
     typename std::ostream::pos_type archive_os_pos = archive_os.tellp();
     // position at start of Write() to archive.  We will record this in the
@@ -1427,6 +1942,20 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
       return false;
     }
 
+    if (opts_.write_index) {
+      int64_t offset = static_cast<int64_t>(archive_os_pos);
+      TableIndexEntry entry(offset,
+                            static_cast<int64_t>(archive_os.tellp()) - offset);
+      WriteTableIndexEntry(index_output_.Stream(), key, entry);
+      if (entry.length < 0 || index_output_.Stream().fail()) {
+        KALDIIO_WARN << "Write failure to table index "
+                     << PrintableWxfilename(
+                            TableIndexFilename(archive_wxfilename_));
+        state_ = kWriteError;
+        return false;
+      }
+    }
+
     if (script_os.fail()) {
       KALDIIO_WARN << "Write failure to script file detected: "
                    << PrintableWxfilename(script_wxfilename_);
@@ -1457,6 +1986,7 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
       case kOpen:
         archive_output_.Stream().flush();  // Don't check error status.
         script_output_.Stream().flush();   // Don't check error status.
+        if (index_output_.IsOpen()) index_output_.Stream().flush();
         return;
       default:
         KALDIIO_WARN << "Flush called on not-open writer.";
@@ -1471,6 +2001,8 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
       if (!archive_output_.Close()) close_success = false;
     if (script_output_.IsOpen())
       if (!script_output_.Close()) close_success = false;
+    if (index_output_.IsOpen())
+      if (!index_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
     state_ = kUninitialized;
     return ans;
@@ -1490,6 +2022,7 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
  private:
   Output archive_output_;
   Output script_output_;
+  Output index_output_;  // Only open if opts_.write_index.
   WspecifierOptions opts_;
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
@@ -1501,33 +2034,525 @@ class TableWriterBothImpl : public TableWriterImplBase<Holder> {
   } state_;
 };
 
+// The implementation of TableWriter we use for wspecifiers of the form
+// "ark,scp,shards=N:foo_%d.ark,foo.scp".  The objects are spread round-robin
+// over the N archives, each of which is written by its own worker thread
+// (so Holder::Write(), i.e. serialization and any compression, runs in
+// parallel).  The calling thread copies each object into a slot for the
+// worker and writes the script file, in the order of the calls to Write(),
+// as the workers report the offsets at which they wrote the objects.
 template <class Holder>
-TableWriter<Holder>::TableWriter(const std::string &wspecifier) : impl_(NULL) {
-  if (wspecifier != "" && !Open(wspecifier))
-    KALDIIO_ERR << "Failed to open table for writing with wspecifier: "
-                << wspecifier
-                << ": errno (in case it's relevant) is: " << strerror(errno);
-}
+class TableWriterShardedImpl : public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
 
-template <class Holder>
-bool TableWriter<Holder>::IsOpen() const {
-  return (impl_ != NULL);
-}
+  TableWriterShardedImpl()
+      : write_pos_(0), script_pos_(0), stop_(false), state_(kUninitialized) {}
 
-template <class Holder>
-bool TableWriter<Holder>::Open(const std::string &wspecifier) {
-  if (IsOpen()) {
-    if (!Close())  // call Close() yourself to suppress this exception.
-      KALDIIO_ERR << "Failed to close previously open writer.";
-  }
-  KALDIIO_ASSERT(impl_ == NULL);
-  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, NULL);
-  switch (wtype) {
-    case kBothWspecifier:
-      impl_ = new TableWriterBothImpl<Holder>();
-      break;
-    case kArchiveWspecifier:
-      impl_ = new TableWriterArchiveImpl<Holder>();
+  virtual bool Open(const std::string &wspecifier) {
+    KALDIIO_ASSERT(state_ == kUninitialized);  // Only called once.
+    wspecifier_ = wspecifier;
+    WspecifierType ws = ClassifyWspecifier(wspecifier, &archive_wxfilename_,
+                                           &script_wxfilename_, &opts_);
+    KALDIIO_ASSERT(ws == kBothWspecifier && opts_.num_shards > 0);
+    if (archive_wxfilename_.find("%d") == std::string::npos) {
+      KALDIIO_WARN << "The shards option requires the archive filename to "
+                      "contain %d: wspecifier = "
+                   << wspecifier;
+      return false;
+    }
+    for (int32_t i = 0; i < opts_.num_shards; i++) {
+      shards_.push_back(std::unique_ptr<Shard>(new Shard));
+      Shard &shard = *shards_.back();
+      shard.wxfilename = archive_wxfilename_;
+      std::ostringstream os;
+      os << i;
+      std::string shard_id = os.str();
+      for (size_t pos = shard.wxfilename.find("%d"); pos != std::string::npos;
+           pos = shard.wxfilename.find("%d", pos + shard_id.size()))
+        shard.wxfilename.replace(pos, 2, shard_id);
+      if (ClassifyWxfilename(shard.wxfilename) != kFileOutput) {
+        KALDIIO_WARN << "The shards option requires the archives to be "
+                        "actual files: wspecifier = "
+                     << wspecifier;
+        CloseOutputs();
+        return false;
+      }
+      if (!shard.output.Open(shard.wxfilename, opts_.binary, false)) {
+        // false means no binary header.
+        CloseOutputs();
+        return false;
+      }
+      if (opts_.write_index) {
+        std::string index_wxfilename = TableIndexFilename(shard.wxfilename);
+        if (!shard.index_output.Open(index_wxfilename, true, true)) {
+          KALDIIO_WARN << "Failed to open table index "
+                       << PrintableWxfilename(index_wxfilename);
+          CloseOutputs();
+          return false;
+        }
+        WriteTableIndexHeader(shard.index_output.Stream());
+      }
+    }
+    if (!script_output_.Open(script_wxfilename_, false, false)) {
+      // false means text mode: script files always text-mode.
+      CloseOutputs();
+      return false;
+    }
+    slots_.resize(kSlotsPerShard * shards_.size());
+    for (size_t i = 0; i < slots_.size(); i++) slots_[i].reset(new Slot);
+    for (size_t i = 0; i < shards_.size(); i++)
+      shards_[i]->thread =
+          std::thread(TableWriterShardedImpl<Holder>::RunWorker, this, i);
+    state_ = kOpen;
+    return true;
+  }
+
+  virtual bool IsOpen() const {
+    switch (state_) {
+      case kUninitialized:
+        return false;
+      case kOpen:
+      case kWriteError:
+        return true;
+      default:
+        KALDIIO_ERR << "IsOpen() called on TableWriter in invalid state.";
+    }
+    return false;
+  }
+
+  // Write returns true on success, false on failure, but
+  // some errors may not be detected till we call Flush() or Close().
+  virtual bool Write(const std::string &key, const T &value) {
+    return WriteInternal(key, std::unique_ptr<T>(new T(value)));
+  }
+
+  virtual bool Write(const std::string &key, T &&value) {
+    return WriteInternal(key, std::unique_ptr<T>(new T(std::move(value))));
+  }
+
+  // Flush waits for the workers to write all the objects and flushes the
+  // archives and the script file; it does not return error status, any
+  // errors will be reported on the next Write or Close.
+  virtual void Flush() {
+    switch (state_) {
+      case kWriteError:
+      case kOpen:
+        WaitForWorkers();
+        // The workers are now idle, so we may use their streams.
+        for (size_t i = 0; i < shards_.size(); i++) {
+          shards_[i]->output.Stream().flush();  // Don't check error status.
+          if (shards_[i]->index_output.IsOpen())
+            shards_[i]->index_output.Stream().flush();
+        }
+        script_output_.Stream().flush();
+        return;
+      default:
+        KALDIIO_WARN << "Flush called on not-open writer.";
+    }
+  }
+
+  virtual bool Close() {
+    if (!this->IsOpen())
+      KALDIIO_ERR << "Close called on a stream that was not open.";
+    WaitForWorkers();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (size_t i = 0; i < shards_.size(); i++) shards_[i]->thread.join();
+    bool close_success = CloseOutputs();
+    bool ans = close_success && (state_ != kWriteError);
+    state_ = kUninitialized;
+    return ans;
+  }
+
+  // May throw on write error if Close() was not called.
+  // User can get the error status by calling Close().
+  virtual ~TableWriterShardedImpl() {
+    if (!IsOpen())
+      return;
+    else if (!Close())
+      KALDIIO_ERR << "Write failed or stream close failed: " << wspecifier_;
+  }
+
+ private:
+  // The number of objects that may be waiting for (or being written by) each
+  // worker.
+  static const size_t kSlotsPerShard = 2;
+
+  struct Shard {
+    std::string wxfilename;  // archive_wxfilename_ with each %d replaced.
+    Output output;
+    Output index_output;  // Only open if opts_.write_index.
+    std::thread thread;
+  };
+
+  // Object number i goes into slot i % slots_.size() and is written by
+  // worker i % shards_.size(); as slots_.size() is a multiple of
+  // shards_.size(), each slot is only used by one worker.
+  struct Slot {
+    std::string key;
+    std::unique_ptr<T> value;  // Deleted by the worker once written.
+    int64_t offset;  // Where the worker wrote the object.
+    bool done;       // The worker has written (or failed to write) it.
+    bool ok;
+    Slot() : offset(-1), done(false), ok(false) {}
+  };
+
+  static void RunWorker(TableWriterShardedImpl<Holder> *object, size_t shard) {
+    object->Work(shard);
+  }
+
+  // Implements Write(); 'value' is our copy of the object.
+  bool WriteInternal(const std::string &key, std::unique_ptr<T> value) {
+    switch (state_) {
+      case kOpen:
+        break;
+      case kWriteError:
+        // user should have known from the last
+        // call to Write that there was a problem.  Warn about it.
+        KALDIIO_WARN << "Writing to non-open TableWriter object.";
+        return false;
+      case kUninitialized:
+      default:
+        KALDIIO_ERR << "Write called on invalid stream";
+    }
+    if (!IsToken(key))  // e.g. empty string or has spaces...
+      KALDIIO_ERR << "Using invalid key " << key;
+    Slot &slot = *slots_[write_pos_ % slots_.size()];
+    {
+      // The slot is free once the script line of the object that was in it
+      // (written slots_.size() objects ago) has been written.
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (true) {
+        WriteScriptLines();
+        if (script_pos_ + slots_.size() > write_pos_) break;
+        done_cv_.wait(lock);
+      }
+    }
+    // No worker looks at the slot until we increase write_pos_, so we can
+    // fill it without holding the lock.
+    slot.key = key;
+    slot.value = std::move(value);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      write_pos_++;
+      WriteScriptLines();
+    }
+    work_cv_.notify_all();
+    if (state_ == kWriteError) return false;
+    if (opts_.flush) Flush();
+    return true;
+  }
+
+  // Runs in the worker thread for shard 'shard'.
+  void Work(size_t shard) {
+    Shard &s = *shards_[shard];
+    for (size_t pos = shard;; pos += shards_.size()) {
+      Slot &slot = *slots_[pos % slots_.size()];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && write_pos_ <= pos) work_cv_.wait(lock);
+        if (write_pos_ <= pos) return;  // Close() was called.
+      }
+      int64_t offset = -1;
+      bool ok;
+      try {
+        std::ostream &os = s.output.Stream();
+        WriteArchiveAlignment<Holder>(os, slot.key, opts_);
+        os << slot.key << ' ';
+        offset = static_cast<int64_t>(os.tellp());
+        ok = Holder::Write(os, opts_.binary, *slot.value) && !os.fail() &&
+             offset >= 0;
+        if (ok && opts_.write_index) {
+          TableIndexEntry entry(offset,
+                                static_cast<int64_t>(os.tellp()) - offset);
+          WriteTableIndexEntry(s.index_output.Stream(), slot.key, entry);
+          ok = (entry.length >= 0 && !s.index_output.Stream().fail());
+        }
+      } catch (...) {
+        ok = false;
+      }
+      slot.value.reset();
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.offset = offset;
+      slot.ok = ok;
+      slot.done = true;
+      done_cv_.notify_all();
+    }
+  }
+
+  // Writes the script lines of the objects that the workers have written, in
+  // order, and frees their slots.  Must be called with mutex_ held.
+  void WriteScriptLines() {
+    std::ostream &script_os = script_output_.Stream();
+    while (script_pos_ < write_pos_) {
+      Slot &slot = *slots_[script_pos_ % slots_.size()];
+      if (!slot.done) break;
+      const Shard &shard = *shards_[script_pos_ % shards_.size()];
+      if (slot.ok) {
+        script_os << slot.key << ' ' << shard.wxfilename << ':' << slot.offset
+                  << '\n';
+      } else {
+        KALDIIO_WARN << "Write failure to "
+                     << PrintableWxfilename(shard.wxfilename) << " for key "
+                     << slot.key;
+        state_ = kWriteError;
+      }
+      slot.done = false;
+      script_pos_++;
+    }
+    if (script_os.fail() && state_ != kWriteError) {
+      KALDIIO_WARN << "Write failure to script file detected: "
+                   << PrintableWxfilename(script_wxfilename_);
+      state_ = kWriteError;
+    }
+  }
+
+  // Waits until the workers have written all the objects, and writes their
+  // script lines.
+  void WaitForWorkers() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      WriteScriptLines();
+      if (script_pos_ == write_pos_) break;
+      done_cv_.wait(lock);
+    }
+  }
+
+  // Closes whichever of the outputs are open; returns false on error.
+  bool CloseOutputs() {
+    bool ans = true;
+    for (size_t i = 0; i < shards_.size(); i++) {
+      if (shards_[i]->output.IsOpen() && !shards_[i]->output.Close())
+        ans = false;
+      if (shards_[i]->index_output.IsOpen() &&
+          !shards_[i]->index_output.Close())
+        ans = false;
+    }
+    if (script_output_.IsOpen() && !script_output_.Close()) ans = false;
+    return ans;
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  Output script_output_;  // Only used by the calling thread.
+  WspecifierOptions opts_;
+  std::string archive_wxfilename_;  // Contains %d.
+  std::string script_wxfilename_;
+  std::string wspecifier_;
+
+  std::vector<std::unique_ptr<Slot>> slots_;
+  // mutex_ protects write_pos_, script_pos_, stop_ and the done, ok and
+  // offset members of the slots.
+  std::mutex mutex_;
+  std::condition_variable work_cv_;  // write_pos_ increased, or stop_ set.
+  std::condition_variable done_cv_;  // A worker finished an object.
+  size_t write_pos_;   // The number of objects given to the workers.
+  size_t script_pos_;  // The number of objects whose script line we wrote.
+  bool stop_;          // Set by Close().
+
+  enum {             // is stream open?
+    kUninitialized,  // no
+    kOpen,           // yes
+    kWriteError,     // yes
+  } state_;
+};
+
+// This is the implementation of TableWriter we use with the "bg" option.  It
+// wraps another implementation and calls its Write() in a background thread,
+// so that serializing and writing the objects does not hold up the caller.
+// Up to 'queue_size' objects (the N in "bg=N") wait in a queue for the
+// background thread; Write() blocks while the queue is full.  Errors from
+// the background thread are reported by the next call to Write(), Flush() or
+// Close().
+template <class Holder>
+class TableWriterBackgroundImpl : public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  TableWriterBackgroundImpl(TableWriterImplBase<Holder> *base_writer,
+                            int32_t queue_size = 1)
+      : queue_size_(queue_size),
+        busy_(false),
+        stop_(false),
+        error_(false),
+        base_writer_(base_writer) {
+    KALDIIO_ASSERT(queue_size > 0);
+  }
+
+  // This function ignores the wspecifier argument.
+  // We use the same function signature as the regular Open(),
+  // for convenience.
+  virtual bool Open(const std::string & /*wspecifier*/) {
+    KALDIIO_ASSERT(base_writer_ != NULL &&
+                   base_writer_->IsOpen());  // or code error.
+    thread_ = std::thread(TableWriterBackgroundImpl<Holder>::run, this);
+    return true;
+  }
+
+  virtual bool IsOpen() const {
+    // Close() sets base_writer_ to NULL, and we never initialize this object
+    // with a non-open base_writer_, so no need to check if it's open.
+    return base_writer_ != NULL;
+  }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    return Enqueue(key, std::unique_ptr<T>(new T(value)));
+  }
+
+  virtual bool Write(const std::string &key, T &&value) {
+    return Enqueue(key, std::unique_ptr<T>(new T(std::move(value))));
+  }
+
+  // Waits for the queue to be written, then flushes the base writer; it does
+  // not return error status, any errors will be reported on the next Write
+  // or Close.
+  virtual void Flush() {
+    if (!IsOpen()) {
+      KALDIIO_WARN << "Flush called on not-open writer.";
+      return;
+    }
+    WaitForQueue();
+    // The background thread is now idle, so we may use base_writer_.
+    base_writer_->Flush();
+  }
+
+  // note: we can be sure that Close() won't be called twice, as the
+  // TableWriter object will delete this object after calling Close.
+  virtual bool Close() {
+    KALDIIO_ASSERT(base_writer_ != NULL && thread_.joinable());
+    WaitForQueue();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_one();
+    thread_.join();
+    bool ans = true;
+    try {
+      ans = base_writer_->Close();
+    } catch (...) {
+      ans = false;
+    }
+    delete base_writer_;
+    base_writer_ = NULL;
+    return ans && !error_;
+  }
+
+  static void run(TableWriterBackgroundImpl<Holder> *object) {
+    object->RunInBackground();
+  }
+
+  ~TableWriterBackgroundImpl() {
+    if (base_writer_) {
+      if (!Close()) {
+        KALDIIO_ERR << "Error detected closing background writer "
+                    << "(relates to ',bg' modifier)";
+      }
+    }
+  }
+
+ private:
+  bool Enqueue(const std::string &key, std::unique_ptr<T> value) {
+    if (!IsOpen()) KALDIIO_ERR << "Write called on invalid stream";
+    // Check the key here, so that the error is reported to the caller.
+    if (!IsToken(key))  // e.g. empty string or has spaces...
+      KALDIIO_ERR << "Using invalid key " << key;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!error_ && queue_.size() >= static_cast<size_t>(queue_size_))
+      space_cv_.wait(lock);
+    if (error_) {
+      // The background thread will have printed a more specific warning.
+      KALDIIO_WARN << "Writing to TableWriter after a write error in the "
+                   << "background thread (',bg' option).";
+      return false;
+    }
+    queue_.push_back(std::make_pair(key, std::move(value)));
+    lock.unlock();
+    work_cv_.notify_one();
+    return true;
+  }
+
+  // Waits until the background thread has written everything in the queue.
+  void WaitForQueue() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!queue_.empty() || busy_) space_cv_.wait(lock);
+  }
+
+  void RunInBackground() {
+    // This function is called in the background thread.
+    while (true) {
+      std::pair<std::string, std::unique_ptr<T>> item;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && queue_.empty()) work_cv_.wait(lock);
+        if (queue_.empty()) return;  // stop_ was set.
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true;
+      }
+      bool ok;
+      try {
+        // After an error we still take the objects from the queue, so that
+        // the main thread doesn't wait forever, but we don't write them.
+        ok = !error_ && base_writer_->Write(item.first, *item.second);
+      } catch (...) {
+        ok = false;
+      }
+      item.second.reset();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ok) error_ = true;
+      busy_ = false;
+      space_cv_.notify_all();
+    }
+  }
+
+  int32_t queue_size_;
+  // mutex_ protects queue_, busy_, stop_ and error_.
+  std::mutex mutex_;
+  std::condition_variable work_cv_;   // queue_ became nonempty, or stop_ set.
+  std::condition_variable space_cv_;  // An object was written.
+  std::deque<std::pair<std::string, std::unique_ptr<T>>> queue_;
+  bool busy_;   // The background thread is writing an object.
+  bool stop_;   // Set by Close() to stop the background thread.
+  bool error_;  // Set by the background thread on error.
+  std::thread thread_;
+  TableWriterImplBase<Holder> *base_writer_;
+};
+
+template <class Holder>
+TableWriter<Holder>::TableWriter(const std::string &wspecifier) : impl_(NULL) {
+  if (wspecifier != "" && !Open(wspecifier))
+    KALDIIO_ERR << "Failed to open table for writing with wspecifier: "
+                << wspecifier
+                << ": errno (in case it's relevant) is: " << strerror(errno);
+}
+
+template <class Holder>
+bool TableWriter<Holder>::IsOpen() const {
+  return (impl_ != NULL);
+}
+
+template <class Holder>
+bool TableWriter<Holder>::Open(const std::string &wspecifier) {
+  if (IsOpen()) {
+    if (!Close())  // call Close() yourself to suppress this exception.
+      KALDIIO_ERR << "Failed to close previously open writer.";
+  }
+  KALDIIO_ASSERT(impl_ == NULL);
+  WspecifierOptions opts;
+  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, &opts);
+  switch (wtype) {
+    case kBothWspecifier:
+      if (opts.num_shards > 0)
+        impl_ = new TableWriterShardedImpl<Holder>();
+      else
+        impl_ = new TableWriterBothImpl<Holder>();
+      break;
+    case kArchiveWspecifier:
+      impl_ = new TableWriterArchiveImpl<Holder>();
       break;
     case kScriptWspecifier:
       impl_ = new TableWriterScriptImpl<Holder>();
@@ -1537,13 +2562,22 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDIIO_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
       return false;
   }
-  if (impl_->Open(wspecifier)) {
-    return true;
-  } else {  // The class will have printed a more specific warning.
+  if (!impl_->Open(wspecifier)) {
+    // The class will have printed a more specific warning.
     delete impl_;
     impl_ = NULL;
     return false;
   }
+  if (opts.background) {
+    impl_ = new TableWriterBackgroundImpl<Holder>(impl_,
+                                                  opts.background_queue_size);
+    if (!impl_->Open("")) {
+      // the wspecifier is ignored in that Open() call.
+      // It should only return false on code error.
+      return false;
+    }
+  }
+  return true;
 }
 
 template <class Holder>
@@ -1554,6 +2588,13 @@ void TableWriter<Holder>::Write(const std::string &key, const T &value) const {
   // been printed in the Write function.
 }
 
+template <class Holder>
+void TableWriter<Holder>::Write(const std::string &key, T &&value) const {
+  CheckImpl();
+  if (!impl_->Write(key, std::move(value)))
+    KALDIIO_ERR << "Error in TableWriter::Write";
+}
+
 template <class Holder>
 void TableWriter<Holder>::Flush() {
   CheckImpl();
@@ -1577,6 +2618,148 @@ TableWriter<Holder>::~TableWriter() {
   }
 }
 
+// Where to find one object of a table, for ReadTableObjects().
+struct TableObjectLocation {
+  std::string filename;  // The file, e.g. "foo.ark".  If offset == -1, this is
+                         // any rxfilename, e.g. "foo.mat" or "gunzip -c foo|".
+  int64_t offset;        // Byte offset of the object in 'filename', or -1.
+  int64_t length;        // Size of the object in bytes, or -1 if not known.
+  TableObjectLocation() : offset(-1), length(-1) {}
+};
+
+// Reads the objects at 'locations' into 'holders' (which is resized to the
+// same size); an element of 'holders' is NULL if its object could not be read
+// (a warning is printed).  This is used by the random-access readers to read a
+// batch of objects.  We read the objects in order of (filename, offset), so
+// objects in the same file are read by a single pass over it.  Where the
+// lengths are known, objects that are next to each other (or close enough
+// that it is cheaper to read the gap than to seek over it) are fetched with a
+// single read.  With num_threads > 1, the resulting runs of objects are
+// shared among that many threads, each with its own file handles.
+template <class Holder>
+void ReadTableObjects(const std::vector<TableObjectLocation> &locations,
+                      int32_t num_threads,
+                      std::vector<std::unique_ptr<Holder>> *holders) {
+  // We merge reads across gaps of up to this many bytes.
+  const int64_t kMaxGap = 4096;
+  // And we don't merge reads beyond this many bytes in total.
+  const int64_t kMaxRunBytes = 16 << 20;
+
+  holders->clear();
+  holders->resize(locations.size());
+  std::vector<size_t> order(locations.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&locations](size_t a,
+                                                            size_t b) {
+    const TableObjectLocation &la = locations[a], &lb = locations[b];
+    int c = la.filename.compare(lb.filename);
+    return c < 0 || (c == 0 && la.offset < lb.offset);
+  });
+
+  // Split 'order' into runs [begin, end) that one thread reads in one go.  So
+  // that all the threads have something to do, a run has at most
+  // max_run_objects objects.
+  size_t max_run_objects = order.size();
+  if (num_threads > 1)
+    max_run_objects = (order.size() + num_threads - 1) / num_threads;
+  std::vector<std::pair<size_t, size_t>> runs;
+  for (size_t i = 0; i < order.size();) {
+    const TableObjectLocation &first = locations[order[i]];
+    bool merged_read = (first.offset >= 0 && first.length >= 0);
+    int64_t end = first.offset + first.length;
+    size_t j = i + 1;
+    for (; j < order.size() && j - i < max_run_objects; j++) {
+      const TableObjectLocation &loc = locations[order[j]];
+      if (first.offset < 0 || loc.filename != first.filename) break;
+      if (merged_read) {
+        if (loc.length < 0 || loc.offset > end + kMaxGap ||
+            std::max(end, loc.offset + loc.length) - first.offset >
+                kMaxRunBytes)
+          break;
+        end = std::max(end, loc.offset + loc.length);
+      }
+    }
+    runs.push_back(std::make_pair(i, j));
+    i = j;
+  }
+
+  // Reads one object from 'is' into (*holders)[index].
+  auto read_object = [&locations, holders](size_t index, std::istream &is) {
+    std::unique_ptr<Holder> holder(new Holder);
+    bool ok;
+    try {
+      ok = holder->Read(is);
+    } catch (const std::exception &e) {
+      KALDIIO_WARN << "Exception caught reading object: " << e.what();
+      ok = false;
+    }
+    if (ok) {
+      (*holders)[index] = std::move(holder);
+    } else {
+      const TableObjectLocation &loc = locations[index];
+      KALDIIO_WARN << "Error reading object from "
+                   << PrintableRxfilename(loc.filename) << " at offset "
+                   << loc.offset;
+    }
+  };
+
+  auto read_run = [&](const std::pair<size_t, size_t> &run, Input *input,
+                      std::vector<char> *buffer) {
+    const TableObjectLocation &first = locations[order[run.first]];
+    if (first.offset >= 0 && first.length >= 0) {
+      // The lengths are known: read the bytes of the whole run at once.
+      int64_t end = first.offset;
+      for (size_t k = run.first; k < run.second; k++) {
+        const TableObjectLocation &loc = locations[order[k]];
+        end = std::max(end, loc.offset + loc.length);
+      }
+      std::ostringstream rxfilename;
+      rxfilename << first.filename << ':' << first.offset;
+      buffer->resize(end - first.offset);
+      if (!input->Open(rxfilename.str()) ||
+          !input->Stream().read(buffer->data(), buffer->size())) {
+        KALDIIO_WARN << "Error reading " << buffer->size() << " bytes from "
+                     << PrintableRxfilename(rxfilename.str());
+        return;
+      }
+      for (size_t k = run.first; k < run.second; k++) {
+        const TableObjectLocation &loc = locations[order[k]];
+        MemoryInputStream is(buffer->data() + (loc.offset - first.offset),
+                             loc.length);
+        read_object(order[k], is);
+      }
+    } else {
+      // Read the objects one after another; as they are sorted by offset,
+      // the Input only ever seeks forward within the same file.
+      for (size_t k = run.first; k < run.second; k++) {
+        const TableObjectLocation &loc = locations[order[k]];
+        std::ostringstream rxfilename;
+        rxfilename << loc.filename;
+        if (loc.offset >= 0) rxfilename << ':' << loc.offset;
+        if (!input->Open(rxfilename.str())) {
+          KALDIIO_WARN << "Error opening stream "
+                       << PrintableRxfilename(rxfilename.str());
+          continue;
+        }
+        read_object(order[k], input->Stream());
+      }
+    }
+  };
+
+  std::atomic<size_t> next_run(0);
+  auto worker = [&runs, &next_run, &read_run]() {
+    Input input;
+    std::vector<char> buffer;
+    size_t r;
+    while ((r = next_run++) < runs.size()) read_run(runs[r], &input, &buffer);
+  };
+  size_t threads = std::min<size_t>(std::max(num_threads, 1), runs.size());
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < threads; t++) workers.emplace_back(worker);
+  worker();  // The calling thread does its share too.
+  for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
+
 // Types of RandomAccessTableReader:
 // In principle, we would like to have four types of RandomAccessTableReader:
 //  the 4 combinations  [scp, archive], [seekable, not-seekable],
@@ -1613,15 +2796,141 @@ class RandomAccessTableReaderImplBase {
 
   virtual const T &Value(const std::string &key) = 0;
 
+  // See RandomAccessTableReader::Prefetch().  The default does nothing; it is
+  // overridden by the implementations that can seek to an object.
+  virtual void Prefetch(const std::vector<std::string> & /*keys*/) {}
+
+  // See RandomAccessTableReader::Values().  The default looks up the keys one
+  // by one, which is only correct for implementations that keep every object
+  // they have read in memory.
+  virtual std::vector<const T *> Values(const std::vector<std::string> &keys) {
+    std::vector<const T *> ans(keys.size(), NULL);
+    for (size_t i = 0; i < keys.size(); i++)
+      if (HasKey(keys[i])) ans[i] = &Value(keys[i]);
+    return ans;
+  }
+
+  // See RandomAccessTableReader::CacheStats().  The default is for
+  // implementations that have no cache.
+  virtual TableCacheStats CacheStats() const { return TableCacheStats(); }
+
   virtual bool Close() = 0;
 
   virtual ~RandomAccessTableReaderImplBase() {}
 };
 
+// Objects read by Prefetch(), indexed by key.  A NULL pointer means that the
+// object could not be read.  Several keys may share an object if they have
+// the same rxfilename in an scp file.
+template <class Holder>
+using PrefetchedObjectMap =
+    std::unordered_map<std::string, std::shared_ptr<Holder>, StringHasher>;
+
+// Returns pointers to the objects for 'keys' in 'objects', or NULL for keys
+// that are not there or whose object could not be read.
+template <class Holder>
+std::vector<const typename Holder::T *> LookupPrefetchedObjects(
+    const PrefetchedObjectMap<Holder> &objects,
+    const std::vector<std::string> &keys) {
+  std::vector<const typename Holder::T *> ans(keys.size(), NULL);
+  for (size_t i = 0; i < keys.size(); i++) {
+    typename PrefetchedObjectMap<Holder>::const_iterator iter =
+        objects.find(keys[i]);
+    if (iter != objects.end() && iter->second != nullptr)
+      ans[i] = &(iter->second->Value());
+  }
+  return ans;
+}
+
+// An LRU cache of the objects read by a RandomAccessTableReader, limited to a
+// number of bytes as estimated by MemoryUsage() (see the "cache=N" option in
+// kaldi-table.h).  The objects are shared with the caller, so evicting an
+// object never invalidates a reference to it that the caller still holds.
+template <class Holder>
+class RandomAccessTableCache {
+ public:
+  RandomAccessTableCache() : max_bytes_(0) {}
+
+  // Empties the cache, resets the statistics and sets the size limit; 0
+  // disables the cache.
+  void Init(int64_t max_bytes) {
+    Clear();
+    max_bytes_ = max_bytes;
+    stats_ = TableCacheStats();
+  }
+
+  bool Enabled() const { return max_bytes_ > 0; }
+
+  // Returns the object for 'key' and marks it as the most recently used, or
+  // returns NULL if it is not in the cache.  Counts a hit or a miss.
+  std::shared_ptr<Holder> Find(const std::string &key) {
+    typename MapType::iterator iter = map_.find(key);
+    if (iter == map_.end()) {
+      stats_.num_misses++;
+      return nullptr;
+    }
+    stats_.num_hits++;
+    entries_.splice(entries_.begin(), entries_, iter->second);
+    return iter->second->object;
+  }
+
+  // Returns true if 'key' is in the cache, without counting a lookup.
+  bool Contains(const std::string &key) const {
+    return map_.find(key) != map_.end();
+  }
+
+  // Adds 'object' for 'key' as the most recently used, evicting the least
+  // recently used objects as needed to stay within the limit.  An object that
+  // is larger than the limit on its own is not added.
+  void Insert(const std::string &key, const std::shared_ptr<Holder> &object) {
+    if (!Enabled() || object == nullptr || Contains(key)) return;
+    int64_t bytes = MemoryUsage(object->Value()) + MemoryUsage(key);
+    if (bytes > max_bytes_) return;
+    while (stats_.num_bytes + bytes > max_bytes_) {
+      stats_.num_bytes -= entries_.back().bytes;
+      map_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+    Entry entry = {key, object, bytes};
+    entries_.push_front(entry);
+    map_[key] = entries_.begin();
+    stats_.num_bytes += bytes;
+  }
+
+  void Clear() {
+    entries_.clear();
+    map_.clear();
+    stats_.num_bytes = 0;
+  }
+
+  TableCacheStats Stats() const {
+    TableCacheStats ans = stats_;
+    ans.num_objects = map_.size();
+    return ans;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<Holder> object;
+    int64_t bytes;  // MemoryUsage() of the key and the object.
+  };
+  typedef std::list<Entry> ListType;  // The most recently used first.
+  typedef std::unordered_map<std::string, typename ListType::iterator,
+                             StringHasher>
+      MapType;
+
+  int64_t max_bytes_;
+  ListType entries_;
+  MapType map_;  // Indexes entries_ by key.
+  TableCacheStats stats_;  // num_objects is not kept up to date.
+};
+
 // Implementation of RandomAccessTableReader for a script file; for simplicity
 // we just read it in all in one go, as it's unlikely someone would generate
 // this from a pipe.  In principle we could read it on-demand as for the
-// archives, but this would probably be overkill.
+// archives, but this would probably be overkill.  Compiled script files
+// ("bscp:" rspecifiers) are memory-mapped instead; see ScriptTable.
 
 // Note: the code for this this class is similar to TableWriterScriptImpl:
 // try to keep them in sync.
@@ -1631,14 +2940,14 @@ class RandomAccessTableReaderScriptImpl
  public:
   typedef typename Holder::T T;
 
-  RandomAccessTableReaderScriptImpl()
-      : last_found_(0), state_(kUninitialized) {}
+  RandomAccessTableReaderScriptImpl() : state_(kUninitialized) {}
 
   virtual bool Open(const std::string &rspecifier) {
     switch (state_) {
       case kNotHaveObject:
       case kHaveObject:
       case kHaveRange:
+      case kHaveRangeOnly:
         KALDIIO_ERR << " Opening already open RandomAccessTableReader:"
                        " call Close first.";
       case kUninitialized:
@@ -1648,37 +2957,24 @@ class RandomAccessTableReaderScriptImpl
     rspecifier_ = rspecifier;
     RspecifierType rs =
         ClassifyRspecifier(rspecifier, &script_rxfilename_, &opts_);
-    KALDIIO_ASSERT(rs == kScriptRspecifier);  // or wrongly called.
+    KALDIIO_ASSERT(rs == kScriptRspecifier ||
+                   rs == kCompiledScriptRspecifier);  // or wrongly called.
+    inputs_.SetMaxOpen(opts_.max_open_files);
+    cache_.Init(opts_.cache_bytes);
     KALDIIO_ASSERT(
-        script_.empty());  // no way it could be nonempty at this point
+        script_.Size() == 0);  // no way it could be nonempty at this point
 
-    if (!ReadScriptFile(script_rxfilename_,
-                        true,         // print any warnings
-                        &script_)) {  // error reading script file or invalid
-                                      // format
-      state_ = kNotReadScript;
-      return false;  // no need to print further warnings.  user gets the error.
-    }
-
-    rspecifier_ = rspecifier;
     // If opts_.sorted, the user has asserted that the keys are already sorted.
-    // Although we could easily sort them, we want to let the user know of this
+    // We don't need them sorted, but we want to let the user know of this
     // mistake.  This same mistake could have serious effects if used with an
     // archive rather than a script.
-    if (!opts_.sorted) std::sort(script_.begin(), script_.end());
-    for (size_t i = 0; i + 1 < script_.size(); i++) {
-      if (script_[i].first.compare(script_[i + 1].first) >= 0) {
-        // script[i] not < script[i+1] in lexical order...
-        bool same = (script_[i].first == script_[i + 1].first);
-        KALDIIO_WARN
-            << "Script file " << PrintableRxfilename(script_rxfilename_)
-            << (same ? " contains duplicate key: "
-                     : " is not sorted (remove s, option or add ns, option):"
-                       " key is ")
-            << script_[i].first;
-        state_ = kNotReadScript;
-        return false;
-      }
+    bool ok = (rs == kCompiledScriptRspecifier
+                   ? script_.ReadCompiled(script_rxfilename_, opts_.sorted)
+                   : script_.Read(script_rxfilename_, opts_.sorted));
+    if (!ok) {
+      // error reading script file, invalid format or duplicate keys.
+      state_ = kNotReadScript;
+      return false;  // no need to print further warnings.  user gets the error.
     }
     state_ = kNotHaveObject;
     key_ = "";  // make sure we don't have a key set
@@ -1687,7 +2983,7 @@ class RandomAccessTableReaderScriptImpl
 
   virtual bool IsOpen() const {
     return (state_ == kNotHaveObject || state_ == kHaveObject ||
-            state_ == kHaveRange);
+            state_ == kHaveRange || state_ == kHaveRangeOnly);
   }
 
   virtual bool Close() {
@@ -1696,9 +2992,12 @@ class RandomAccessTableReaderScriptImpl
                      " open.";
     holder_.Clear();
     range_holder_.Clear();
+    prefetched_.clear();
+    cache_.Clear();
+    current_.reset();
+    inputs_.Close();
     state_ = kUninitialized;
-    last_found_ = 0;
-    script_.clear();
+    script_.Clear();
     key_ = "";
     range_ = "";
     data_rxfilename_ = "";
@@ -1708,6 +3007,10 @@ class RandomAccessTableReaderScriptImpl
   }
 
   virtual bool HasKey(const std::string &key) {
+    typename PrefetchedObjectMap<Holder>::const_iterator iter =
+        prefetched_.find(key);
+    if (iter != prefetched_.end() && iter->second != nullptr) return true;
+    if (cache_.Contains(key)) return true;
     bool preload = opts_.permissive;
     // In permissive mode, we have to check that we can read
     // the scp entry before we assert that the key is there.
@@ -1717,19 +3020,97 @@ class RandomAccessTableReaderScriptImpl
   // Write returns true on success, false on failure, but
   // some errors may not be detected till we call Close().
   virtual const T &Value(const std::string &key) {
+    typename PrefetchedObjectMap<Holder>::const_iterator iter =
+        prefetched_.find(key);
+    if (iter != prefetched_.end() && iter->second != nullptr)
+      return iter->second->Value();
+    if (cache_.Enabled()) {
+      current_ = cache_.Find(key);
+      if (current_ != nullptr) return current_->Value();
+    }
     if (!HasKeyInternal(key, true))  // true == preload.
       KALDIIO_ERR << "Could not get item for key " << key << ", rspecifier is "
                   << rspecifier_ << " [to ignore this, "
                   << "add the p, (permissive) option to the rspecifier.";
     KALDIIO_ASSERT(key_ == key);
+    if (cache_.Enabled()) {
+      current_ = TakeObject();
+      cache_.Insert(key, current_);
+      return current_->Value();
+    }
     if (state_ == kHaveObject) {
       return holder_.Value();
     } else {
-      KALDIIO_ASSERT(state_ == kHaveRange);
+      KALDIIO_ASSERT(state_ == kHaveRange || state_ == kHaveRangeOnly);
       return range_holder_.Value();
     }
   }
 
+  virtual void Prefetch(const std::vector<std::string> &keys) {
+    if (!IsOpen())
+      KALDIIO_ERR << "Prefetch() called on RandomAccessTableReader object that"
+                     " is not open.";
+    prefetched_.clear();
+    // We read each distinct data rxfilename once, even if several keys (e.g.
+    // with different ranges) refer to it.
+    std::vector<TableObjectLocation> locations;
+    std::unordered_map<std::string, size_t, StringHasher> location_index;
+    // For each key that we will read: (key, index into locations, range).
+    std::vector<std::pair<std::string, std::pair<size_t, std::string>>> todo;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (cache_.Enabled() && prefetched_.count(keys[i]) == 0) {
+        std::shared_ptr<Holder> object = cache_.Find(keys[i]);
+        if (object != nullptr) {
+          prefetched_[keys[i]] = object;
+          continue;
+        }
+      }
+      size_t key_pos;
+      if (!script_.Find(keys[i], &key_pos)) continue;
+      std::pair<std::unordered_map<std::string, size_t,
+                                   StringHasher>::iterator,
+                bool>
+          pr = location_index.insert(
+              std::make_pair(script_.Rxfilename(key_pos), locations.size()));
+      if (pr.second) {
+        TableObjectLocation location;
+        location.filename = script_.Filename(key_pos);
+        location.offset = script_.Offset(key_pos);
+        locations.push_back(location);
+      }
+      todo.push_back(std::make_pair(
+          keys[i], std::make_pair(pr.first->second, script_.Range(key_pos))));
+    }
+    std::vector<std::unique_ptr<Holder>> holders;
+    ReadTableObjects(locations, opts_.num_threads, &holders);
+    std::vector<std::shared_ptr<Holder>> objects(
+        std::make_move_iterator(holders.begin()),
+        std::make_move_iterator(holders.end()));
+    for (size_t i = 0; i < todo.size(); i++) {
+      const std::string &key = todo[i].first, &range = todo[i].second.second;
+      std::shared_ptr<Holder> object = objects[todo[i].second.first];
+      if (object != nullptr && !range.empty()) {
+        std::shared_ptr<Holder> range_holder(new Holder);
+        if (range_holder->ExtractRange(*object, range)) {
+          object = range_holder;
+        } else {
+          KALDIIO_WARN << "Failed to load object for key " << key << "["
+                       << range << "]";
+          object = nullptr;
+        }
+      }
+      prefetched_[key] = object;
+      cache_.Insert(key, object);
+    }
+  }
+
+  virtual std::vector<const T *> Values(const std::vector<std::string> &keys) {
+    Prefetch(keys);
+    return LookupPrefetchedObjects(prefetched_, keys);
+  }
+
+  virtual TableCacheStats CacheStats() const { return cache_.Stats(); }
+
   virtual ~RandomAccessTableReaderScriptImpl() {}
 
  private:
@@ -1750,6 +3131,7 @@ class RandomAccessTableReaderScriptImpl
         if (key == key_ && range_.empty()) return true;
         break;
       case kHaveRange:
+      case kHaveRangeOnly:
         if (key == key_) return true;
         break;
       case kNotHaveObject:
@@ -1758,7 +3140,7 @@ class RandomAccessTableReaderScriptImpl
     }
     KALDIIO_ASSERT(IsToken(key));
     size_t key_pos = 0;
-    if (!LookupKey(key, &key_pos)) {
+    if (!script_.Find(key, &key_pos)) {
       return false;
     } else {
       if (!preload) {
@@ -1766,20 +3148,9 @@ class RandomAccessTableReaderScriptImpl
                       // object could be read.
       } else {  // preload specified, so we have to attempt to pre-load the
                 // object before returning.
-        std::string data_rxfilename, range;  // We will split
-        // script_[key_pos].second (e.g. "1.ark:100[0:2]" into data_rxfilename
-        // (e.g. "1.ark:100") and range (if any), e.g. "0:2".
-        if (script_[key_pos].second[script_[key_pos].second.size() - 1] ==
-            ']') {
-          if (!ExtractRangeSpecifier(script_[key_pos].second, &data_rxfilename,
-                                     &range)) {
-            KALDIIO_ERR << "TableReader: failed to parse range in '"
-                        << script_[key_pos].second << "'";
-          }
-        } else {
-          data_rxfilename = script_[key_pos].second;
-        }
-        if (state_ == kHaveRange) {
+        std::string data_rxfilename = script_.Rxfilename(key_pos),
+                    range = script_.Range(key_pos);
+        if (state_ == kHaveRange || state_ == kHaveRangeOnly) {
           if (data_rxfilename_ == data_rxfilename && range_ == range) {
             // the odd situation where two keys had the same rxfilename and
             // range: just change the key and keep the object.
@@ -1787,7 +3158,7 @@ class RandomAccessTableReaderScriptImpl
             return true;
           } else {
             range_holder_.Clear();
-            state_ = kHaveObject;
+            state_ = (state_ == kHaveRange ? kHaveObject : kNotHaveObject);
           }
         }
         // OK, at this point the state will be kHaveObject or kNotHaveObject.
@@ -1806,12 +3177,19 @@ class RandomAccessTableReaderScriptImpl
         range_ = range;
         if (state_ == kNotHaveObject) {
           // we need to read the object.
-          if (!input_.Open(data_rxfilename)) {
+          Input *input = inputs_.Open(data_rxfilename);
+          if (input == NULL) {
             KALDIIO_WARN << "Error opening stream "
                          << PrintableRxfilename(data_rxfilename);
             return false;
+          } else if (!range.empty() &&
+                     range_holder_.ReadRange(input->Stream(), range)) {
+            // We read just the range, e.g. the rows of a matrix that were
+            // asked for, without reading the whole object into holder_.
+            state_ = kHaveRangeOnly;
+            return true;
           } else {
-            if (holder_.Read(input_.Stream())) {
+            if (holder_.Read(input->Stream())) {
               state_ = kHaveObject;
             } else {
               KALDIIO_WARN << "Error reading object from "
@@ -1837,40 +3215,27 @@ class RandomAccessTableReaderScriptImpl
     }
   }
 
-  // This function attempts to look up the key "key" in the sorted array
-  // script_.  If it was found it returns true and puts the array offset into
-  // 'script_offset'; otherwise it returns false.
-  bool LookupKey(const std::string &key, size_t *script_offset) {
-    // First, an optimization: if we're going consecutively, this will
-    // make the lookup very fast.  Since we may call HasKey and then
-    // Value(), which both may look up the key, we test if either the
-    // current or next position are correct.
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
-      *script_offset = last_found_;
-      return true;
-    }
-    last_found_++;
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
-      *script_offset = last_found_;
-      return true;
-    }
-    std::pair<std::string, std::string> pr(key, "");  // Important that ""
-    // compares less than or equal to any string, so lower_bound points to the
-    // element that has the same key.
-    typedef typename std::vector<
-        std::pair<std::string, std::string>>::const_iterator IterType;
-    IterType iter = std::lower_bound(script_.begin(), script_.end(), pr);
-    if (iter != script_.end() && iter->first == key) {
-      last_found_ = *script_offset = iter - script_.begin();
-      return true;
+  // Moves the object for key_, which must have been loaded, out of holder_
+  // or range_holder_ so that it can go in the cache.
+  std::shared_ptr<Holder> TakeObject() {
+    std::shared_ptr<Holder> ans(new Holder);
+    if (state_ == kHaveRange) {
+      ans->Swap(&range_holder_);
+      state_ = kHaveObject;  // holder_ still has the object the range is of.
+    } else if (state_ == kHaveRangeOnly) {
+      ans->Swap(&range_holder_);
+      state_ = kNotHaveObject;
     } else {
-      return false;
+      KALDIIO_ASSERT(state_ == kHaveObject);
+      ans->Swap(&holder_);
+      state_ = kNotHaveObject;
     }
+    return ans;
   }
 
-  Input input_;  // Use the same input_ object for reading each file, in case
-                 // the scp specifies offsets in an archive so we can keep the
-                 // same file open.
+  InputCache inputs_;  // Keeps the files we read open, in case the scp
+                       // specifies offsets in archives, so that we can seek
+                       // in a file that is already open.
   RspecifierOptions opts_;
   std::string rspecifier_;  // rspecifier used to open this object; used in
                             // debug messages
@@ -1889,15 +3254,14 @@ class RandomAccessTableReaderScriptImpl
   std::string data_rxfilename_;  // the rxfilename corresponding to key_,
                                  // always set when key_ is set.
 
-  // the script_ variable contains pairs of (key, filename), sorted using
-  // std::sort.  This can be used with binary_search to look up filenames for
-  // writing.  If this becomes inefficient we can use std::unordered_map (but I
-  // suspect this wouldn't be significantly faster & would use more memory).
-  // If memory becomes a problem here, the user should probably be passing
-  // only the relevant part of the scp file rather than expecting us to get too
-  // clever in the code.
-  std::vector<std::pair<std::string, std::string>> script_;
-  size_t last_found_;  // This is for an optimization used in FindFilename.
+  // The contents of the scp file, indexed by key.
+  ScriptTable script_;
+
+  PrefetchedObjectMap<Holder> prefetched_;  // Objects read by Prefetch().
+  RandomAccessTableCache<Holder> cache_;  // Used with the "cache=N" option.
+  std::shared_ptr<Holder> current_;  // The object last returned by Value()
+                                     // from cache_, so that it stays valid
+                                     // even if it is evicted.
 
   enum {
     //                   (*) is script_ set up?
@@ -1910,12 +3274,14 @@ class RandomAccessTableReaderScriptImpl
     kNotHaveObject,  //    yes   no    no
     kHaveObject,     //    yes   yes   no
     kHaveRange,      //    yes   yes   yes
+    kHaveRangeOnly,  //    yes   no    yes
 
     // If we are in a state where holder_ contains an object, it always contains
     // the object from 'key_', and the corresponding rxfilename is always
     // 'data_rxfilename_'.  If range_holder_ contains an object, it always
-    // corresponds to the range 'range_' of the object in 'holder_', and always
-    // corresponds to the current key.
+    // corresponds to the range 'range_' of the object in 'holder_' (or, in
+    // state kHaveRangeOnly, of the object in 'data_rxfilename_', which was read
+    // with Holder::ReadRange()), and always corresponds to the current key.
   } state_;
 };
 
@@ -1958,6 +3324,7 @@ class RandomAccessTableReaderArchiveImplBase
       state_ = kUninitialized;  // Failure on Open
       return false;             // User should print the error message.
     } else {
+      cursor_.reset(new InputCursor(input_.Stream()));
       state_ = kNoObject;
     }
     return true;
@@ -1972,36 +3339,28 @@ class RandomAccessTableReaderArchiveImplBase
     if (state_ != kNoObject)
       KALDIIO_ERR << "ReadNextObject() called from wrong state.";
     // Code error somewhere in this class or a child class.
-    std::istream &is = input_.Stream();
-    is.clear();  // Clear any fail bits that may have been set... just in case
-    // this happened in the Read function.
-    is >> cur_key_;  // This eats up any leading whitespace and gets the string.
-    if (is.eof()) {
+    InputCursor &cursor = *cursor_;
+    // This eats up any leading whitespace and gets the string.
+    if (!cursor.ReadToken(&cur_key_)) {
       state_ = kEof;
       return;
     }
-    if (is.fail()) {  // This shouldn't really happen, barring file-system
-                      // errors.
-      KALDIIO_WARN << "Error reading archive: rspecifier is " << rspecifier_;
-      state_ = kError;
-      return;
-    }
     int c;
-    if ((c = is.peek()) != ' ' && c != '\t' && c != '\n') {  // We expect a
+    if ((c = cursor.Peek()) != ' ' && c != '\t' && c != '\n') {  // We expect a
       // space ' ' after the key.
       // We also allow tab, just so we can read archives generated by scripts
       // that may not be fully aware of how this format works.
       KALDIIO_WARN << "Invalid archive file format: expected space after key "
                    << cur_key_ << ", got character "
-                   << CharToString(static_cast<char>(is.peek()))
+                   << CharToString(static_cast<char>(c))
                    << ", reading archive "
                    << PrintableRxfilename(archive_rxfilename_);
       state_ = kError;
       return;
     }
-    if (c != '\n') is.get();  // Consume the space or tab.
+    if (c != '\n') cursor.Consume(1);  // Consume the space or tab.
     holder_ = new Holder;
-    if (holder_->Read(is)) {
+    if (ReadHolder(&cursor, holder_)) {
       state_ = kHaveObject;
       return;
     } else {
@@ -2014,6 +3373,15 @@ class RandomAccessTableReaderArchiveImplBase
     }
   }
 
+  virtual std::vector<const T *> Values(const std::vector<std::string> &keys) {
+    if (opts_.once || (opts_.sorted && opts_.called_sorted))
+      KALDIIO_ERR << "Values() needs all the objects it returns to be in "
+                     "memory at once, so it cannot be used with the once (o) "
+                     "option or with both the s and cs options: rspecifier is "
+                  << rspecifier_;
+    return RandomAccessTableReaderImplBase<Holder>::Values(keys);
+  }
+
   virtual bool IsOpen() const {
     switch (state_) {
       case kEof:
@@ -2035,6 +3403,7 @@ class RandomAccessTableReaderArchiveImplBase
     if (!this->IsOpen())
       KALDIIO_ERR
           << "Close() called on TableReader twice or otherwise wrongly.";
+    cursor_.reset();
     if (input_.IsOpen()) input_.Close();
     if (state_ == kHaveObject) {
       KALDIIO_ASSERT(holder_ != NULL);
@@ -2060,6 +3429,7 @@ class RandomAccessTableReaderArchiveImplBase
 
  private:
   Input input_;  // Input object for the archive
+  std::unique_ptr<InputCursor> cursor_;  // Reads from input_.
  protected:
   // The variables below are accessed by child classes.
 
@@ -2538,6 +3908,189 @@ class RandomAccessTableReaderUnsortedArchiveImpl
   // "once" option isn't being used incorrectly.
 };
 
+// Implementation of RandomAccessTableReader for an archive that has a sidecar
+// index (the "idx" option, see "Table index" in kaldi-table.h).  We load only
+// the index, so the time to open the table and the memory used depend on the
+// number of keys, not on the size of the archive; each object is read by
+// seeking directly to its offset in the archive.  The sorting and "once"
+// options make no difference here.
+template <class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl
+    : public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl() : state_(kUninitialized) {}
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (state_ != kUninitialized)
+      KALDIIO_ERR << "Opening already open RandomAccessTableReader:"
+                     " call Close first.";
+    rspecifier_ = rspecifier;
+    RspecifierType rs =
+        ClassifyRspecifier(rspecifier, &archive_rxfilename_, &opts_);
+    KALDIIO_ASSERT(rs == kArchiveRspecifier && opts_.indexed);  // or wrongly
+                                                                // called.
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDIIO_WARN << "The idx option requires the archive to be an actual "
+                      "file: rspecifier = "
+                   << rspecifier;
+      return false;
+    }
+    if (!ReadTableIndex(TableIndexFilename(archive_rxfilename_), &index_))
+      return false;  // A warning will already have been printed.
+    cache_.Init(opts_.cache_bytes);
+    state_ = kNotHaveObject;
+    key_ = "";
+    return true;
+  }
+
+  virtual bool Close() {
+    if (state_ == kUninitialized)
+      KALDIIO_ERR << "Close() called on RandomAccessTableReader that was not"
+                     " open.";
+    holder_.Clear();
+    prefetched_.clear();
+    cache_.Clear();
+    current_.reset();
+    index_.clear();
+    input_.Close();
+    state_ = kUninitialized;
+    key_ = "";
+    // Errors reading individual objects are reported when they happen, so
+    // this cannot fail.
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    typename PrefetchedObjectMap<Holder>::const_iterator iter =
+        prefetched_.find(key);
+    if (iter != prefetched_.end() && iter->second != nullptr) return true;
+    if (cache_.Contains(key)) return true;
+    // In permissive mode, we have to check that we can read the object
+    // before we assert that the key is there.
+    return HasKeyInternal(key, opts_.permissive);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    typename PrefetchedObjectMap<Holder>::const_iterator iter =
+        prefetched_.find(key);
+    if (iter != prefetched_.end() && iter->second != nullptr)
+      return iter->second->Value();
+    if (cache_.Enabled()) {
+      current_ = cache_.Find(key);
+      if (current_ != nullptr) return current_->Value();
+    }
+    if (!HasKeyInternal(key, true))  // true == preload.
+      KALDIIO_ERR << "Could not get item for key " << key << ", rspecifier is "
+                  << rspecifier_ << " [to ignore this, "
+                  << "add the p, (permissive) option to the rspecifier.";
+    if (cache_.Enabled()) {
+      // Move the object into the cache.
+      current_.reset(new Holder);
+      current_->Swap(&holder_);
+      state_ = kNotHaveObject;
+      cache_.Insert(key, current_);
+      return current_->Value();
+    }
+    return holder_.Value();
+  }
+
+  virtual void Prefetch(const std::vector<std::string> &keys) {
+    if (state_ == kUninitialized)
+      KALDIIO_ERR << "Prefetch() called on RandomAccessTableReader object that"
+                     " is not open.";
+    prefetched_.clear();
+    std::vector<std::string> found_keys;
+    std::vector<TableObjectLocation> locations;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (cache_.Enabled() && prefetched_.count(keys[i]) == 0) {
+        std::shared_ptr<Holder> object = cache_.Find(keys[i]);
+        if (object != nullptr) {
+          prefetched_[keys[i]] = object;
+          continue;
+        }
+      }
+      typename TableIndex::const_iterator iter = index_.find(keys[i]);
+      if (iter == index_.end()) continue;
+      TableObjectLocation loc;
+      loc.filename = archive_rxfilename_;
+      loc.offset = iter->second.offset;
+      loc.length = iter->second.length;
+      found_keys.push_back(keys[i]);
+      locations.push_back(loc);
+    }
+    std::vector<std::unique_ptr<Holder>> holders;
+    ReadTableObjects(locations, opts_.num_threads, &holders);
+    for (size_t i = 0; i < found_keys.size(); i++) {
+      std::shared_ptr<Holder> object(std::move(holders[i]));
+      prefetched_[found_keys[i]] = object;
+      cache_.Insert(found_keys[i], object);
+    }
+  }
+
+  virtual std::vector<const T *> Values(const std::vector<std::string> &keys) {
+    Prefetch(keys);
+    return LookupPrefetchedObjects(prefetched_, keys);
+  }
+
+  virtual TableCacheStats CacheStats() const { return cache_.Stats(); }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() {}
+
+ private:
+  // If preload == false, just tells us whether the key is in the index.  If
+  // preload == true, also reads the object into holder_ (if it is not there
+  // already) and returns true only if this succeeded.
+  bool HasKeyInternal(const std::string &key, bool preload) {
+    if (state_ == kUninitialized)
+      KALDIIO_ERR << "HasKey called on RandomAccessTableReader object that is"
+                     " not open.";
+    if (state_ == kHaveObject && key == key_) return true;
+    typename TableIndex::const_iterator iter = index_.find(key);
+    if (iter == index_.end()) return false;
+    if (!preload) return true;
+
+    holder_.Clear();
+    state_ = kNotHaveObject;
+    std::ostringstream ss;
+    ss << archive_rxfilename_ << ':' << iter->second.offset;
+    // input_ keeps the archive open between calls, so this is just a seek.
+    if (!input_.Open(ss.str())) {
+      KALDIIO_WARN << "Error opening stream " << PrintableRxfilename(ss.str());
+      return false;
+    }
+    if (!holder_.Read(input_.Stream())) {
+      KALDIIO_WARN << "Error reading object from stream "
+                   << PrintableRxfilename(ss.str());
+      return false;
+    }
+    key_ = key;
+    state_ = kHaveObject;
+    return true;
+  }
+
+  Input input_;  // The archive, kept open so we can seek within it.
+  RspecifierOptions opts_;
+  std::string rspecifier_;  // used in debug messages.
+  std::string archive_rxfilename_;
+  TableIndex index_;
+
+  std::string key_;  // The key of the object in holder_, if state_ ==
+                     // kHaveObject.
+  Holder holder_;
+  PrefetchedObjectMap<Holder> prefetched_;  // Objects read by Prefetch().
+  RandomAccessTableCache<Holder> cache_;  // Used with the "cache=N" option.
+  std::shared_ptr<Holder> current_;  // The object last returned by Value()
+                                     // from cache_.
+
+  enum {
+    kUninitialized,  // not open.
+    kNotHaveObject,  // index loaded; holder_ is empty.
+    kHaveObject,     // index loaded; holder_ contains the object for key_.
+  } state_;
+};
+
 template <class Holder>
 RandomAccessTableReader<Holder>::RandomAccessTableReader(
     const std::string &rspecifier)
@@ -2555,10 +4108,18 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
   RspecifierType rs = ClassifyRspecifier(rspecifier, NULL, &opts);
   switch (rs) {
     case kScriptRspecifier:
+    case kCompiledScriptRspecifier:
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
-      if (opts.sorted) {
+      if (opts.mmap)
+        KALDIIO_WARN << "The mmap option has no effect for random-access "
+                        "readers; reading the archive as a stream: "
+                        "rspecifier = "
+                     << rspecifier;
+      if (opts.indexed) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+      } else if (opts.sorted) {
         if (opts.called_sorted)  // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
         else
@@ -2595,6 +4156,30 @@ RandomAccessTableReader<Holder>::Value(const std::string &key) {
   return impl_->Value(key);
 }
 
+template <class Holder>
+void RandomAccessTableReader<Holder>::Prefetch(
+    const std::vector<std::string> &keys) {
+  CheckImpl();
+  for (size_t i = 0; i < keys.size(); i++)
+    if (!IsToken(keys[i])) KALDIIO_ERR << "Invalid key \"" << keys[i] << '"';
+  impl_->Prefetch(keys);
+}
+
+template <class Holder>
+std::vector<const typename RandomAccessTableReader<Holder>::T *>
+RandomAccessTableReader<Holder>::Values(const std::vector<std::string> &keys) {
+  CheckImpl();
+  for (size_t i = 0; i < keys.size(); i++)
+    if (!IsToken(keys[i])) KALDIIO_ERR << "Invalid key \"" << keys[i] << '"';
+  return impl_->Values(keys);
+}
+
+template <class Holder>
+TableCacheStats RandomAccessTableReader<Holder>::CacheStats() const {
+  CheckImpl();
+  return impl_->CacheStats();
+}
+
 template <class Holder>
 bool RandomAccessTableReader<Holder>::Close() {
   CheckImpl();
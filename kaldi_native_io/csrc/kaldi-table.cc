@@ -7,20 +7,51 @@
 
 #include "kaldi_native_io/csrc/kaldi-table.h"
 
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
 
+#include "kaldi_native_io/csrc/io-funcs.h"
 #include "kaldi_native_io/csrc/kaldi-io.h"
 #include "kaldi_native_io/csrc/text-utils.h"
 namespace kaldiio {
 
+// Parses a number of bytes with an optional suffix K, M, G or T (powers of
+// 1024), e.g. "2G".  Returns false if it is not valid.
+static bool ParseByteSize(const std::string &str, int64_t *num_bytes) {
+  if (str.empty()) return false;
+  int64_t scale = 1;
+  std::string number(str);
+  switch (str[str.size() - 1]) {
+    case 'T':
+      scale *= 1024;  // fall through
+    case 'G':
+      scale *= 1024;  // fall through
+    case 'M':
+      scale *= 1024;  // fall through
+    case 'K':
+      scale *= 1024;
+      number.resize(number.size() - 1);
+      break;
+    default:
+      break;
+  }
+  int64_t n;
+  if (!ConvertStringToInteger(number, &n) || n < 0 ||
+      n > INT64_MAX / scale)
+    return false;
+  *num_bytes = n * scale;
+  return true;
+}
+
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   std::string *rxfilename,
                                   RspecifierOptions *opts) {
   // Examples
   // ark:rxfilename  ->  kArchiveRspecifier
   // scp:rxfilename  -> kScriptRspecifier
+  // bscp:filename  -> kCompiledScriptRspecifier
   //
   // We also allow the meaningless prefixes b, and t,
   // plus the options o (once), no (not-once),
@@ -88,6 +119,33 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strncmp(c, "bg=", 3)) {
+      int32_t queue_size;
+      if (!ConvertStringToInteger(c + 3, &queue_size) || queue_size <= 0)
+        return kNoRspecifier;
+      if (opts) {
+        opts->background = true;
+        opts->background_queue_size = queue_size;
+      }
+    } else if (!strncmp(c, "threads=", 8)) {
+      int32_t num_threads;
+      if (!ConvertStringToInteger(c + 8, &num_threads) || num_threads <= 0)
+        return kNoRspecifier;
+      if (opts) opts->num_threads = num_threads;
+    } else if (!strncmp(c, "files=", 6)) {
+      int32_t max_open_files;
+      if (!ConvertStringToInteger(c + 6, &max_open_files) ||
+          max_open_files <= 0)
+        return kNoRspecifier;
+      if (opts) opts->max_open_files = max_open_files;
+    } else if (!strncmp(c, "cache=", 6)) {
+      int64_t cache_bytes;
+      if (!ParseByteSize(c + 6, &cache_bytes)) return kNoRspecifier;
+      if (opts) opts->cache_bytes = cache_bytes;
+    } else if (!strcmp(c, "mmap")) {
+      if (opts) opts->mmap = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->indexed = true;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier)
         rs = kArchiveRspecifier;
@@ -100,11 +158,17 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       else
         return kNoRspecifier;  // Repeated or combined ark and scp options
       // invalid.
+    } else if (!strcmp(c, "bscp")) {
+      if (rs == kNoRspecifier)
+        rs = kCompiledScriptRspecifier;
+      else
+        return kNoRspecifier;
     } else {
       return kNoRspecifier;  // Could not interpret this option.
     }
   }
-  if ((rs == kArchiveRspecifier || rs == kScriptRspecifier) &&
+  if ((rs == kArchiveRspecifier || rs == kScriptRspecifier ||
+       rs == kCompiledScriptRspecifier) &&
       rxfilename != NULL)
     *rxfilename = after_colon;
   return rs;
@@ -143,6 +207,8 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   // don't omit empty strings between commas.
 
   WspecifierType ws = kNoWspecifier;
+  bool write_index = false;
+  bool sharded = false;
 
   if (opts != NULL)
     *opts = WspecifierOptions();  // Make sure all the defaults are as in the
@@ -162,6 +228,27 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "idx")) {
+      write_index = true;
+      if (opts) opts->write_index = true;
+    } else if (!strcmp(c, "align")) {
+      if (opts) opts->align = true;
+    } else if (!strncmp(c, "shards=", 7)) {
+      int32_t num_shards;
+      if (!ConvertStringToInteger(c + 7, &num_shards) || num_shards <= 0)
+        return kNoWspecifier;
+      sharded = true;
+      if (opts) opts->num_shards = num_shards;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strncmp(c, "bg=", 3)) {
+      int32_t queue_size;
+      if (!ConvertStringToInteger(c + 3, &queue_size) || queue_size <= 0)
+        return kNoWspecifier;
+      if (opts) {
+        opts->background = true;
+        opts->background_queue_size = queue_size;
+      }
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier)
         ws = kArchiveWspecifier;
@@ -180,6 +267,11 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
     }
   }
 
+  // An index only makes sense if we are writing an archive.
+  if (write_index && ws == kScriptWspecifier) return kNoWspecifier;
+  // Sharding needs the scp file to say where each object went.
+  if (sharded && ws != kBothWspecifier) return kNoWspecifier;
+
   switch (ws) {
     case kArchiveWspecifier:
       if (archive_wxfilename) *archive_wxfilename = after_colon;
@@ -309,4 +401,63 @@ bool WriteScriptFile(
   return true;
 }
 
+std::string TableIndexFilename(const std::string &archive_filename) {
+  return archive_filename + ".idx";
+}
+
+void WriteTableIndexHeader(std::ostream &os) {
+  WriteToken(os, true, "<TableIndex2>");
+}
+
+void WriteTableIndexEntry(std::ostream &os, const std::string &key,
+                          const TableIndexEntry &entry) {
+  WriteToken(os, true, key);
+  WriteBasicType(os, true, entry.offset);
+  WriteBasicType(os, true, entry.length);
+}
+
+bool ReadTableIndex(const std::string &rxfilename, TableIndex *index) {
+  KALDIIO_ASSERT(index != NULL);
+  index->clear();
+  bool is_binary;
+  Input input;
+  if (!input.Open(rxfilename, &is_binary)) {
+    KALDIIO_WARN << "Error opening table index "
+                 << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  if (!is_binary) {
+    KALDIIO_WARN << "Table index is not in binary format: "
+                 << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  std::istream &is = input.Stream();
+  try {
+    std::string token;
+    ReadToken(is, true, &token);
+    if (token == "<TableIndex>")
+      ReadToken(is, true, &token);  // The Holder type, in the old format.
+    else if (token != "<TableIndex2>")
+      KALDIIO_ERR << "Expected token \"<TableIndex2>\", got instead \""
+                  << token << "\".";
+    std::string key;
+    TableIndexEntry entry;
+    while (is.peek() != EOF) {
+      ReadToken(is, true, &key);
+      ReadBasicType(is, true, &entry.offset);
+      ReadBasicType(is, true, &entry.length);
+      if (entry.offset < 0 || entry.length < 0)
+        KALDIIO_ERR << "Invalid entry for key " << key;
+      if (!index->insert(std::make_pair(key, entry)).second)
+        KALDIIO_ERR << "Duplicate key " << key;
+    }
+  } catch (const std::exception &e) {
+    KALDIIO_WARN << "Error reading table index "
+                 << PrintableRxfilename(rxfilename) << ": " << e.what();
+    index->clear();
+    return false;
+  }
+  return true;
+}
+
 }  // namespace kaldiio
@@ -9,10 +9,12 @@
 #ifndef KALDI_NATIVE_IO_CSRC_KALDI_TABLE_H_
 #define KALDI_NATIVE_IO_CSRC_KALDI_TABLE_H_
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "kaldi_native_io/csrc/kaldi-holder.h"
+#include "kaldi_native_io/csrc/stl-utils.h"
 
 namespace kaldiio {
 
@@ -41,6 +43,13 @@ class TableWriterImplBase;
 //
 // ark:rxfilename
 // scp:rxfilename
+// bscp:filename
+//
+// bscp means a compiled scp file, as written by CompileScriptFile() in
+// script-table.h (or the compile-scp program) from an scp file.  It is read
+// like the scp file it was compiled from, but instead of being parsed it is
+// memory-mapped, so that opening it takes no time however large it is.  It
+// must be an actual file (not a pipe or stdin).
 //
 // We also allow various modifiers:
 //   o   means the program will only ask for each key once, which enables
@@ -64,6 +73,48 @@ class TableWriterImplBase;
 //       value, in a background thread.  Recommended when reading larger objects
 //       such as neural-net training examples, especially when you want to
 //       maximize GPU usage.
+//   bg=N is like bg, but reads ahead by up to N objects (bg is the same as
+//       bg=1).  A larger N smooths over bursts of I/O latency, at the cost of
+//       holding up to N + 2 objects in memory: the current one, the N queued
+//       ones and the one being read.
+//
+//   mmap means "memory-mapped".  For sequential readers of archives that are
+//       actual files, the archive is memory-mapped and objects are read from
+//       the mapping rather than through a file stream; this shares the page
+//       cache between processes.  See also SequentialMappedMatrixReader in
+//       mapped-matrix-reader.h, which returns matrices without copying them.
+//       Random-access readers, and archives that are not actual files, are
+//       read as streams (with a warning).
+//
+//   threads=N means that, for sequential readers of archives, N worker
+//       threads decode the objects (run Holder::Read()) in parallel while
+//       another thread reads the bytes from the archive.  This requires the
+//       index <archive>.idx (see idx below); without it we read the archive
+//       in the usual way.  Objects are still returned in archive order.
+//       For random-access readers of scripts and indexed archives, it is the
+//       number of threads used by Prefetch() and Values() to read a batch of
+//       objects.
+//
+//   files=N means that readers of scp files keep up to N of the files that
+//       the scp file refers to open at once (16 by default), closing the least
+//       recently used one when they need another.  This matters when the scp
+//       file interleaves entries from many archives: most lookups are then a
+//       seek on a file that is already open.
+//
+//   cache=N means that random-access readers of scp files and indexed
+//       archives keep the objects they have read in an LRU cache of at most N
+//       bytes (N may have a suffix K, M, G or T, e.g. cache=2G), so that keys
+//       asked for again are returned without reading or decoding anything.
+//       Other archives keep what they have read in memory anyway.  See
+//       RandomAccessTableReader::CacheStats().
+//
+//   idx means "indexed".  It only makes a difference for random-access
+//       readers of archives: instead of scanning the archive, we load the
+//       sidecar index <archive>.idx written by a TableWriter with the "idx"
+//       option and seek directly to the requested object.  The archive must
+//       be an actual file (not a pipe or stdin).  The index does not record
+//       the type of the objects, so it may be read with any Holder that can
+//       read them, e.g. an archive of CompressedMatrix read as Matrix<float>.
 //
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
@@ -86,18 +137,41 @@ struct RspecifierOptions {
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
                     // background thread.
+  int32_t background_queue_size;  // The number of objects to read ahead
+                                  // with "bg=N"; 1 for "bg".
+  int32_t num_threads;  // For sequential readers of archives, the number of
+                        // threads used to decode objects ("threads=N"); 0
+                        // means decode them in the reading thread.  For
+                        // random-access readers, the number of threads used
+                        // to read a batch of objects.
+  int32_t max_open_files;  // For readers of scp files, the maximum number of
+                           // data files kept open ("files=N").
+  int64_t cache_bytes;  // For random-access readers, the size in bytes of
+                        // the object cache ("cache=N"); 0 means no cache.
+  bool mmap;  // For sequential readers of archives, if the "mmap" option is
+              // provided, the archive is memory-mapped.
+  bool indexed;  // For random-access readers of archives, if the "idx" option
+                 // is provided, objects are located via the sidecar index
+                 // <archive>.idx rather than by reading the archive.
   RspecifierOptions()
       : once(false),
         sorted(false),
         called_sorted(false),
         permissive(false),
-        background(false) {}
+        background(false),
+        background_queue_size(1),
+        num_threads(0),
+        max_open_files(16),
+        cache_bytes(0),
+        mmap(false),
+        indexed(false) {}
 };
 
 enum RspecifierType {
   kNoRspecifier,
   kArchiveRspecifier,
   kScriptRspecifier,
+  kCompiledScriptRspecifier,
 };
 
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
@@ -122,6 +196,33 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  align means, in binary mode, to write spaces before the key of each
+//     uncompressed matrix so that its data starts at a multiple of
+//     kArchiveDataAlignment bytes in the archive.  Readers skip whitespace
+//     before keys, so the archive can be read as usual; the point is that
+//     SequentialMappedMatrixReader can then return every matrix without
+//     copying it.  It has no effect if the position in the output is not
+//     known (e.g. for a pipe).
+//  idx means also write a binary index <archive>.idx next to the archive, with
+//     the byte offset and length of each object; see "Table index" below.
+//     Only valid if we are writing an archive that is an actual file.
+//  shards=N means, when writing both an archive and an scp file, to spread
+//     the objects round-robin over N archives, each written (serialized,
+//     including any compression) by its own thread.  The archive filename
+//     must contain %d; each %d is replaced by the shard number 0 ... N-1,
+//     and each archive must be an actual file.  The scp file lists the objects
+//     in the order they were written, with offsets into their archives.
+//     E.g. "ark,scp,shards=8:out_%d.ark,out.scp".  With idx, each archive
+//     gets its own index.
+//  bg means "background": Write() only queues the object, and the objects
+//     are serialized and written by a background thread, so the caller does
+//     not wait for the disk.  Write() blocks while the queue is full.  A write
+//     error is reported by the next call to Write(), Flush() or Close();
+//     Flush() and Close() wait for the queue to be written.
+//  bg=N is like bg, but queues up to N objects (bg is the same as bg=1).
+//     Note: Write() copies the object into the queue, unless it is passed an
+//     rvalue, e.g. writer.Write(key, std::move(value)), which moves it (for
+//     types that can be moved).
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
@@ -154,6 +255,9 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
 //  as we can't see a situation where an extended filename would make sense
 //  for this (we can't fseek() in pipes).
 
+// The alignment of the data of matrices written with the "align" option.
+const size_t kArchiveDataAlignment = 16;
+
 enum WspecifierType {
   kNoWspecifier,
   kArchiveWspecifier,
@@ -164,8 +268,23 @@ enum WspecifierType {
 struct WspecifierOptions {
   bool binary;
   bool flush;
-  bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions() : binary(true), flush(false), permissive(false) {}
+  bool permissive;     // will ignore absent scp entries.
+  bool write_index;    // will write the index <archive>.idx.
+  bool align;          // will align the data of matrices ("align").
+  int32_t num_shards;  // The number of archives with "shards=N"; 0 means
+                       // write a single archive.
+  bool background;     // will write in a background thread ("bg").
+  int32_t background_queue_size;  // The number of objects that may be
+                                  // queued with "bg=N"; 1 for "bg".
+  WspecifierOptions()
+      : binary(true),
+        flush(false),
+        permissive(false),
+        write_index(false),
+        align(false),
+        num_shards(0),
+        background(false),
+        background_queue_size(1) {}
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -210,6 +329,57 @@ bool WriteScriptFile(
     std::ostream &os,
     const std::vector<std::pair<std::string, std::string>> &script);
 
+// Table index.
+// An index is a binary file written alongside an archive (by a TableWriter
+// opened with the "idx" option), that lets a RandomAccessTableReader opened
+// with the "idx" option find objects without reading the archive.  The format
+// is the binary-mode header, the token <TableIndex2>, and then for each
+// object: the key (as a token), and the byte offset and byte length of the
+// object in the archive (as int64_t).  The offset is the position just after
+// "key ", as in the scp file written by "ark,scp".  The index does not record
+// the type of the objects, which, as for the archive itself, is up to the
+// reader.  Indexes in the older format, whose <TableIndex> token is followed
+// by a (compiler-dependent) name of the Holder type, are still read.
+
+struct TableIndexEntry {
+  int64_t offset;  // byte offset of the object in the archive.
+  int64_t length;  // number of bytes the object occupies in the archive.
+  TableIndexEntry() : offset(0), length(0) {}
+  TableIndexEntry(int64_t offset, int64_t length)
+      : offset(offset), length(length) {}
+};
+
+typedef std::unordered_map<std::string, TableIndexEntry, StringHasher>
+    TableIndex;
+
+// Returns the filename of the index that goes with the archive
+// 'archive_filename', i.e. archive_filename + ".idx".
+std::string TableIndexFilename(const std::string &archive_filename);
+
+// Writes the start of an index to the binary-mode stream 'os'.
+void WriteTableIndexHeader(std::ostream &os);
+
+// Appends one entry to an index whose header was written by
+// WriteTableIndexHeader().
+void WriteTableIndexEntry(std::ostream &os, const std::string &key,
+                          const TableIndexEntry &entry);
+
+// Reads an index from 'rxfilename'.  Returns true on success; on failure
+// (e.g. the file does not exist, is corrupted or contains a duplicate key) it
+// prints a warning and returns false.
+bool ReadTableIndex(const std::string &rxfilename, TableIndex *index);
+
+/// Statistics for the object cache of a RandomAccessTableReader (the "cache=N"
+/// option in the rspecifier).
+struct TableCacheStats {
+  int64_t num_hits;     // Lookups that were served from the cache.
+  int64_t num_misses;   // Lookups that had to read the object.
+  int64_t num_objects;  // The number of objects in the cache.
+  int64_t num_bytes;    // Their size in bytes, as estimated by MemoryUsage().
+  TableCacheStats()
+      : num_hits(0), num_misses(0), num_objects(0), num_bytes(0) {}
+};
+
 /// Allows random access to a collection
 /// of objects in an archive or script file; see \ref io_sec_tables.
 template <class Holder>
@@ -247,6 +417,27 @@ class RandomAccessTableReader {
   // want to catch this error.
   const T &Value(const std::string &key);
 
+  // Reads the objects for all of 'keys' in one batch, so that Value() can
+  // return them without any further I/O until the next call to Prefetch(),
+  // Values() or Close().  For scripts and indexed archives, the objects are
+  // read in order of (file, offset), objects that are next to each other in a
+  // file are read together, and with the "threads=N" option they are read by
+  // N threads in parallel.  Keys that are not present are ignored.  For other
+  // archives this does nothing, since they have to be read in order anyway.
+  void Prefetch(const std::vector<std::string> &keys);
+
+  // Returns pointers to the objects for 'keys', in the same order, reading
+  // them in one batch as Prefetch() does.  An element is NULL if the key is
+  // not present or its object could not be read.  The pointers are valid
+  // until the next call to Prefetch(), Values() or Close().  Archives that
+  // are not indexed must not be read with the once (o) option or with both
+  // the s and cs options, since all the objects must be in memory at once.
+  std::vector<const T *> Values(const std::vector<std::string> &keys);
+
+  // Returns statistics for the object cache (see the "cache=N" option); they
+  // are all zero if there is no cache.
+  TableCacheStats CacheStats() const;
+
   ~RandomAccessTableReader();
 
   // Allow copy-constructor only for non-opened readers (needed for inclusion in
@@ -371,6 +562,10 @@ class TableWriter {
   // Write the object. Throws KaldiFatalError on error via the KALDI_ERR macro.
   inline void Write(const std::string &key, const T &value) const;
 
+  // As above, but the object may be moved from; with the "bg" option this
+  // avoids copying it into the queue.
+  inline void Write(const std::string &key, T &&value) const;
+
   // Flush will flush any archive; it does not return error status
   // or throw, any errors will be reported on the next Write or Close.
   // Useful if we may be writing to a command in a pipe and want
@@ -14,6 +14,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <limits>
@@ -24,6 +25,7 @@
 #include "kaldi_native_io/csrc/kaldi-utils.h"
 #include "kaldi_native_io/csrc/log.h"
 #include "kaldi_native_io/csrc/matrix-common.h"
+#include "kaldi_native_io/csrc/text-scanner.h"
 
 namespace kaldiio {
 
@@ -78,6 +80,8 @@ template <typename Real>
 void Vector<Real>::Swap(Vector<Real> *other) {
   std::swap(this->data_, other->data_);
   std::swap(this->dim_, other->dim_);
+  std::swap(capacity_, other->capacity_);
+  std::swap(allocator_, other->allocator_);
 }
 
 template <typename Real>
@@ -108,7 +112,9 @@ void Vector<Real>::Resize(const MatrixIndexT dim,
   // At this point, resize_type == kSetZero or kUndefined.
 
   if (this->data_ != NULL) {
-    if (this->dim_ == dim) {
+    if (this->dim_ == dim || (dim > 0 && dim <= capacity_)) {
+      // The memory we have is big enough; reuse it.
+      this->dim_ = dim;
       if (resize_type == kSetZero) this->SetZero();
       return;
     } else {
@@ -125,29 +131,30 @@ inline void Vector<Real>::Init(const MatrixIndexT dim) {
   if (dim == 0) {
     this->dim_ = 0;
     this->data_ = NULL;
+    capacity_ = 0;
     return;
   }
-  MatrixIndexT size;
-  void *data;
-  void *free_data;
+  size_t size = static_cast<size_t>(dim) * sizeof(Real);
 
-  size = dim * sizeof(Real);
-
-  if ((data = KALDIIO_MEMALIGN(16, size, &free_data)) != NULL) {
-    this->data_ = static_cast<Real *>(data);
-    this->dim_ = dim;
-  } else {
-    throw std::bad_alloc();
-  }
+  // Allocate() throws on failure.
+  allocator_ = GetMemoryAllocator();
+  this->data_ = static_cast<Real *>(allocator_->Allocate(size));
+  this->dim_ = dim;
+  capacity_ = static_cast<MatrixIndexT>(
+      std::min<size_t>(allocator_->UsableSize(size) / sizeof(Real),
+                       std::numeric_limits<MatrixIndexT>::max()));
 }
 
 /// Deallocates memory and sets object to empty vector.
 template <typename Real>
 void Vector<Real>::Destroy() {
   /// we need to free the data block if it was defined
-  if (this->data_ != NULL) KALDIIO_MEMALIGN_FREE(this->data_);
+  if (this->data_ != NULL)
+    allocator_->Free(this->data_,
+                     static_cast<size_t>(capacity_) * sizeof(Real));
   this->data_ = NULL;
   this->dim_ = 0;
+  capacity_ = 0;
 }
 
 template <typename Real>
@@ -187,9 +194,12 @@ void VectorBase<Real>::Write(std::ostream &os, bool binary) const {
     WriteBasicType(os, binary, size);
     os.write(reinterpret_cast<const char *>(Data()), sizeof(Real) * size);
   } else {
-    os << " [ ";
-    for (MatrixIndexT i = 0; i < Dim(); i++) os << (*this)(i) << " ";
-    os << "]\n";
+    TextBasicTypeWriter writer(os);
+    writer.WriteString(" [ ");
+    const Real *data = Data();
+    for (MatrixIndexT i = 0; i < Dim(); i++) writer.Write(data[i]);
+    writer.WriteString("]\n");
+    writer.Flush();
   }
   if (!os.good()) KALDIIO_ERR << "Failed to write vector to stream";
 }
@@ -222,9 +232,9 @@ void Vector<Real>::Read(std::istream &is, bool binary, bool add) {
           typename std::conditional<std::is_same<Real, float>::value, double,
                                     float>::type;
 
-      Vector<OtherType> other(this->Dim());
+      Vector<OtherType> other;
       other.Read(is, binary, false);  // add is false at this point.
-      if (this->Dim() != other.Dim()) this->Resize(other.Dim());
+      if (this->Dim() != other.Dim()) this->Resize(other.Dim(), kUndefined);
       this->CopyFromVec(other);
       return;
     }
@@ -237,7 +247,7 @@ void Vector<Real>::Read(std::istream &is, bool binary, bool add) {
     }
     int32_t size;
     ReadBasicType(is, binary, &size);  // throws on error.
-    if ((MatrixIndexT)size != this->Dim()) this->Resize(size);
+    if ((MatrixIndexT)size != this->Dim()) this->Resize(size, kUndefined);
     if (size > 0)
       is.read(reinterpret_cast<char *>(this->data_), sizeof(Real) * size);
     if (is.fail()) {
@@ -273,7 +283,7 @@ void Vector<Real>::Read(std::istream &is, bool binary, bool add) {
       int i = is.peek();
       if (i == '-' || (i >= '0' && i <= '9')) {  // common cases first.
         Real r;
-        is >> r;
+        ScanNumber(is, &r);
         if (is.fail()) {
           specific_error << "Failed to read number.";
           goto bad;
@@ -289,7 +299,7 @@ void Vector<Real>::Read(std::istream &is, bool binary, bool add) {
         is.get();
       } else if (i == ']') {
         is.get();  // eat the ']'
-        this->Resize(data.size());
+        this->Resize(data.size(), kUndefined);
         for (size_t j = 0; j < data.size(); j++) this->data_[j] = data[j];
         i = is.peek();
         if (static_cast<char>(i) == '\r') {
@@ -18,6 +18,7 @@
 #include "kaldi_native_io/csrc/io-funcs.h"
 #include "kaldi_native_io/csrc/log.h"
 #include "kaldi_native_io/csrc/matrix-common.h"
+#include "kaldi_native_io/csrc/memory-allocator.h"
 
 namespace kaldiio {
 
@@ -114,23 +115,25 @@ template <typename Real>
 class Vector : public VectorBase<Real> {
  public:
   /// Constructor that takes no arguments.  Initializes to empty.
-  Vector() : VectorBase<Real>() {}
+  Vector() : VectorBase<Real>(), capacity_(0), allocator_(NULL) {}
 
   /// Constructor with specific size.  Sets to all-zero by default
   /// if set_zero == false, memory contents are undefined.
   explicit Vector(const MatrixIndexT s, MatrixResizeType resize_type = kSetZero)
-      : VectorBase<Real>() {
+      : VectorBase<Real>(), capacity_(0), allocator_(NULL) {
     Resize(s, resize_type);
   }
 
   /// Copy constructor.  The need for this is controversial.
-  Vector(const Vector<Real> &v) : VectorBase<Real>() {  //  (cannot be explicit)
+  Vector(const Vector<Real> &v)  //  (cannot be explicit)
+      : VectorBase<Real>(), capacity_(0), allocator_(NULL) {
     Resize(v.Dim(), kUndefined);
     this->CopyFromVec(v);
   }
 
   /// Copy-constructor from base-class, needed to copy from SubVector.
-  explicit Vector(const VectorBase<Real> &v) : VectorBase<Real>() {
+  explicit Vector(const VectorBase<Real> &v)
+      : VectorBase<Real>(), capacity_(0), allocator_(NULL) {
     Resize(v.Dim(), kUndefined);
     this->CopyFromVec(v);
   }
@@ -152,8 +155,16 @@ class Vector : public VectorBase<Real> {
   ///   -if kCopyData, the new data will be the same as the old data in any
   ///      shared positions, and zero elsewhere.
   /// This function takes time proportional to the number of data elements.
+  ///
+  /// If the new data fits in the memory the vector already has (see
+  /// Capacity()), that memory is reused instead of being freed and allocated
+  /// again.  Resize(0) always frees the memory.
   void Resize(MatrixIndexT length, MatrixResizeType resize_type = kSetZero);
 
+  /// Returns the number of elements the allocated memory has room for, which
+  /// may be more than Dim() after Resize().
+  MatrixIndexT Capacity() const { return capacity_; }
+
  private:
   /// Init assumes the current contents of the class are invalid (i.e. junk or
   /// has already been freed), and it sets the vector to newly allocated memory
@@ -163,6 +174,9 @@ class Vector : public VectorBase<Real> {
 
   /// Destroy function, called internally.
   void Destroy();
+
+  MatrixIndexT capacity_;  // The number of elements data_ has room for.
+  MemoryAllocator *allocator_;  // The allocator data_ was allocated with.
 };
 
 template <typename Real>
@@ -205,6 +219,13 @@ class SubVector : public VectorBase<Real> {
   SubVector &operator=(const SubVector &other) {}
 };
 
+// Returns the number of bytes of memory used by v; see MemoryUsage() in
+// stl-utils.h.
+template <typename Real>
+size_t MemoryUsage(const Vector<Real> &v) {
+  return sizeof(v) + static_cast<size_t>(v.Capacity()) * sizeof(Real);
+}
+
 }  // namespace kaldiio
 
 #endif  // KALDI_NATIVE_IO_CSRC_KALDI_VECTOR_H_
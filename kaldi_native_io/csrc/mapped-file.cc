@@ -0,0 +1,67 @@
+// kaldi_native_io/csrc/mapped-file.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/mapped-file.h"
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <string>
+
+namespace kaldiio {
+
+#ifndef _MSC_VER
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    KALDIIO_WARN << "Failed to open " << filename << ": " << strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    KALDIIO_WARN << "Failed to stat " << filename << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ != 0) {  // mmap() does not accept a length of zero.
+    void *p = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      KALDIIO_WARN << "Failed to mmap " << filename << ": " << strerror(errno);
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<char *>(p);
+  }
+  close(fd);  // The mapping stays valid after the descriptor is closed.
+  is_open_ = true;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != NULL) munmap(data_, size_);
+  data_ = NULL;
+  size_ = 0;
+  is_open_ = false;
+}
+#else
+bool MappedFile::Open(const std::string &filename) {
+  KALDIIO_WARN << "Memory-mapping files is not supported on Windows: "
+               << filename;
+  return false;
+}
+
+void MappedFile::Close() {}
+#endif
+
+}  // namespace kaldiio
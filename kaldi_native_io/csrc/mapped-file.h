@@ -0,0 +1,48 @@
+// kaldi_native_io/csrc/mapped-file.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_MAPPED_FILE_H_
+#define KALDI_NATIVE_IO_CSRC_MAPPED_FILE_H_
+
+#include <string>
+
+#include "kaldi_native_io/csrc/log.h"
+
+namespace kaldiio {
+
+// MappedFile maps a whole file into memory.  Pages are mapped copy-on-write,
+// so the file itself is never modified, but pages that are only read are
+// shared (via the page cache) with any other process reading the same file.
+class MappedFile {
+ public:
+  MappedFile() : data_(NULL), size_(0), is_open_(false) {}
+
+  ~MappedFile() { Close(); }
+
+  // Maps the file 'filename' (an actual filename, not an rxfilename).
+  // Returns true on success; on failure prints a warning and returns false.
+  // Mapping is not supported on Windows, where it always fails.
+  bool Open(const std::string &filename);
+
+  // Unmaps the file, if it is open.  Pointers into it become invalid.
+  void Close();
+
+  bool IsOpen() const { return is_open_; }
+
+  // Returns the start of the mapping (NULL if the file is empty).
+  char *Data() const { return data_; }
+
+  // Returns the size of the file in bytes.
+  size_t Size() const { return size_; }
+
+ private:
+  char *data_;
+  size_t size_;
+  bool is_open_;
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(MappedFile)
+};
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_MAPPED_FILE_H_
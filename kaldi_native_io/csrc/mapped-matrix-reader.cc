@@ -0,0 +1,226 @@
+// kaldi_native_io/csrc/mapped-matrix-reader.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/mapped-matrix-reader.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "kaldi_native_io/csrc/io-funcs.h"
+#include "kaldi_native_io/csrc/kaldi-io.h"
+#include "kaldi_native_io/csrc/kaldi-membuf.h"
+
+namespace kaldiio {
+
+template <typename Real>
+SequentialMappedMatrixReader<Real>::SequentialMappedMatrixReader(
+    const std::string &rspecifier)
+    : pos_(0), num_mapped_(0), num_copied_(0), state_(kUninitialized) {
+  if (rspecifier != "" && !Open(rspecifier))
+    KALDIIO_ERR << "Error constructing SequentialMappedMatrixReader: "
+                << "rspecifier is " << rspecifier;
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::Open(const std::string &rspecifier) {
+  if (IsOpen() && !Close()) KALDIIO_ERR << "Error closing previous input.";
+  rspecifier_ = rspecifier;
+  RspecifierType rs =
+      ClassifyRspecifier(rspecifier, &archive_rxfilename_, &opts_);
+  if (rs != kArchiveRspecifier ||
+      ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+    KALDIIO_WARN << "SequentialMappedMatrixReader requires an archive that is "
+                    "an actual file, e.g. ark,mmap:foo.ark; rspecifier is "
+                 << rspecifier;
+    return false;
+  }
+  if (!file_.Open(archive_rxfilename_)) return false;
+  pos_ = 0;
+  num_mapped_ = 0;
+  num_copied_ = 0;
+  state_ = kEof;  // So that Next() does not complain.
+  Next();
+  if (state_ == kError) {
+    KALDIIO_WARN << "Error beginning to read archive file (wrong filename?): "
+                 << PrintableRxfilename(archive_rxfilename_);
+    file_.Close();
+    state_ = kUninitialized;
+    return false;
+  }
+  return true;
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::Done() const {
+  switch (state_) {
+    case kHaveMapped:
+    case kHaveCopy:
+      return false;
+    case kEof:
+    case kError:
+      return true;
+    default:
+      KALDIIO_ERR << "Done() called on reader that is not open.";
+      return true;
+  }
+}
+
+template <typename Real>
+std::string SequentialMappedMatrixReader<Real>::Key() const {
+  if (Done()) KALDIIO_ERR << "Key() called at the wrong time.";
+  return key_;
+}
+
+template <typename Real>
+SubMatrix<Real> SequentialMappedMatrixReader<Real>::Value() {
+  if (Done()) KALDIIO_ERR << "Value() called at the wrong time.";
+  if (state_ == kHaveMapped)
+    return SubMatrix<Real>(const_cast<Real *>(data_), num_rows_, num_cols_,
+                           num_cols_);
+  return SubMatrix<Real>(copy_.Data(), copy_.NumRows(), copy_.NumCols(),
+                         copy_.Stride());
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::IsMapped() const {
+  if (Done()) KALDIIO_ERR << "IsMapped() called at the wrong time.";
+  return state_ == kHaveMapped;
+}
+
+template <typename Real>
+void SequentialMappedMatrixReader<Real>::Next() {
+  switch (state_) {
+    case kHaveMapped:
+    case kHaveCopy:
+    case kEof:
+      break;
+    default:
+      KALDIIO_ERR << "Next() called wrongly.";
+  }
+  const char *data = file_.Data();
+  size_t size = file_.Size();
+  size_t pos = pos_;
+  // Read the key, as "is >> key_" would: skip leading whitespace, then read
+  // until the next whitespace.
+  while (pos < size && isspace(static_cast<unsigned char>(data[pos]))) pos++;
+  if (pos == size) {
+    state_ = kEof;
+    return;
+  }
+  size_t key_start = pos;
+  while (pos < size && !isspace(static_cast<unsigned char>(data[pos]))) pos++;
+  key_.assign(data + key_start, pos - key_start);
+  if (pos == size || (data[pos] != ' ' && data[pos] != '\t' &&
+                      data[pos] != '\n')) {
+    KALDIIO_WARN << "Invalid archive file format: expected space after key "
+                 << key_ << ", reading "
+                 << PrintableRxfilename(archive_rxfilename_);
+    state_ = kError;
+    return;
+  }
+  if (data[pos] != '\n') pos++;  // Consume the space or tab.
+
+  if (MapObject(pos)) {
+    state_ = kHaveMapped;
+    num_mapped_++;
+  } else if (CopyObject(pos)) {
+    state_ = kHaveCopy;
+    num_copied_++;
+  } else {
+    KALDIIO_WARN << "Object read failed, reading archive "
+                 << PrintableRxfilename(archive_rxfilename_);
+    state_ = kError;
+  }
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::MapObject(size_t pos) {
+  const char *data = file_.Data();
+  size_t size = file_.Size();
+  // "\0B" + "FM " + size byte + int32 rows + size byte + int32 cols.
+  const size_t header_size = 2 + 3 + 5 + 5;
+  if (size - pos < header_size) return false;
+  const char *p = data + pos;
+  if (p[0] != '\0' || p[1] != 'B') return false;  // not binary.
+  const char *token = (sizeof(Real) == 4 ? "FM " : "DM ");
+  if (memcmp(p + 2, token, 3) != 0) return false;
+  if (p[5] != sizeof(int32_t) || p[10] != sizeof(int32_t)) return false;
+  int32_t num_rows, num_cols;
+  memcpy(&num_rows, p + 6, sizeof(num_rows));
+  memcpy(&num_cols, p + 11, sizeof(num_cols));
+  if (num_rows < 0 || num_cols < 0) return false;  // let CopyObject complain.
+  size_t num_bytes = static_cast<size_t>(num_rows) *
+                     static_cast<size_t>(num_cols) * sizeof(Real);
+  if (size - pos - header_size < num_bytes) return false;
+  const char *begin = p + header_size;
+  if (reinterpret_cast<uintptr_t>(begin) % alignof(Real) != 0)
+    return false;  // We cannot point a Real* at it.
+  if (num_bytes == 0) {
+    data_ = NULL;
+    num_rows_ = 0;
+    num_cols_ = 0;
+  } else {
+    data_ = reinterpret_cast<const Real *>(begin);
+    num_rows_ = num_rows;
+    num_cols_ = num_cols;
+  }
+  pos_ = pos + header_size + num_bytes;
+  return true;
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::CopyObject(size_t pos) {
+  MemoryInputStream is(file_.Data() + pos, file_.Size() - pos);
+  try {
+    bool binary;
+    if (!InitKaldiInputStream(is, &binary)) return false;
+    copy_.Read(is, binary);
+  } catch (const std::exception &e) {
+    KALDIIO_WARN << "Exception caught reading matrix: " << e.what();
+    return false;
+  }
+  if (is.fail()) return false;
+  if (is.eof()) {
+    pos_ = file_.Size();
+  } else {
+    std::streamoff consumed = is.tellg();
+    if (consumed < 0) return false;
+    pos_ = pos + static_cast<size_t>(consumed);
+  }
+  return true;
+}
+
+template <typename Real>
+bool SequentialMappedMatrixReader<Real>::Close() {
+  if (!IsOpen()) KALDIIO_ERR << "Close() called on reader that is not open.";
+  bool error = (state_ == kError);
+  file_.Close();
+  copy_.Resize(0, 0);
+  state_ = kUninitialized;
+  if (error) {
+    if (opts_.permissive) {
+      KALDIIO_WARN << "Error detected closing reader for archive "
+                   << PrintableRxfilename(archive_rxfilename_)
+                   << " but ignoring it as permissive mode specified.";
+      return true;
+    }
+    return false;
+  }
+  return true;
+}
+
+template <typename Real>
+SequentialMappedMatrixReader<Real>::~SequentialMappedMatrixReader() {
+  if (IsOpen() && !Close())
+    KALDIIO_ERR << "Error detected closing archive "
+                << PrintableRxfilename(archive_rxfilename_);
+}
+
+template class SequentialMappedMatrixReader<float>;
+template class SequentialMappedMatrixReader<double>;
+
+}  // namespace kaldiio
@@ -0,0 +1,121 @@
+// kaldi_native_io/csrc/mapped-matrix-reader.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_MAPPED_MATRIX_READER_H_
+#define KALDI_NATIVE_IO_CSRC_MAPPED_MATRIX_READER_H_
+
+#include <string>
+
+#include "kaldi_native_io/csrc/kaldi-matrix.h"
+#include "kaldi_native_io/csrc/kaldi-table.h"
+#include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/mapped-file.h"
+
+namespace kaldiio {
+
+// SequentialMappedMatrixReader reads an archive of matrices sequentially, like
+// SequentialTableReader<KaldiObjectHolder<Matrix<Real>>>, but it memory-maps
+// the archive and, for uncompressed binary matrices of the same type as Real
+// ("FM" for float, "DM" for double), Value() returns a SubMatrix that points
+// directly into the mapping: there is no allocation and no copy.  Other
+// objects (compressed, text-mode or of the other floating-point type) are
+// decoded into a buffer as usual.
+//
+// A matrix can only be returned without copying if its data is aligned for
+// Real in the file, which depends on the length of its key and on what comes
+// before it.  In an archive written with the "align" wspecifier option (e.g.
+// "ark,align:foo.ark"; see kaldi-table.h) the data of all matrices is
+// aligned; in other archives only some of them are (about a quarter for
+// float and an eighth for double, for random key lengths), and the rest are
+// copied.  IsMapped() tells which applies to the current matrix, and
+// NumMapped() and NumCopied() count them.
+//
+// The rspecifier must be an archive that is an actual file, e.g.
+// "ark,mmap:foo.ark" (the "mmap" option is implied here).
+//
+// The mapping is copy-on-write, so writing to Value() never modifies the
+// archive on disk.
+template <typename Real>
+class SequentialMappedMatrixReader {
+ public:
+  SequentialMappedMatrixReader()
+      : pos_(0), num_mapped_(0), num_copied_(0), state_(kUninitialized) {}
+
+  // This constructor is equivalent to default constructor + "open", but
+  // throws on error.
+  explicit SequentialMappedMatrixReader(const std::string &rspecifier);
+
+  // Opens the table.  Returns true on success.
+  bool Open(const std::string &rspecifier);
+
+  bool IsOpen() const { return state_ != kUninitialized; }
+
+  // Returns true if we're done (or if there was an error; call Close() to
+  // find out which).
+  bool Done() const;
+
+  // Only valid to call Key() if Done() returned false.
+  std::string Key() const;
+
+  // Only valid to call Value() if Done() returned false.  The returned
+  // SubMatrix is valid until the next call to Next() or Close().
+  SubMatrix<Real> Value();
+
+  // Returns true if the current Value() points into the mapped archive,
+  // i.e. it was not copied.
+  bool IsMapped() const;
+
+  void Next();
+
+  // The numbers of matrices that were returned without copying and that had
+  // to be copied, since Open().
+  int64_t NumMapped() const { return num_mapped_; }
+  int64_t NumCopied() const { return num_copied_; }
+
+  // Returns false if Done() became true because of an error rather than
+  // because we reached the end of the archive (unless the "p" option was
+  // given).
+  bool Close();
+
+  // Throws if there was an error and Close() was not called.
+  ~SequentialMappedMatrixReader();
+
+ private:
+  // Tries to point data_ at an uncompressed binary matrix of type Real that
+  // starts at offset 'pos' in the mapping.  Returns true on success and sets
+  // pos_ to the end of the object.
+  bool MapObject(size_t pos);
+
+  // Reads the object starting at offset 'pos' into copy_.  Returns true on
+  // success and sets pos_ to the end of the object.
+  bool CopyObject(size_t pos);
+
+  MappedFile file_;
+  size_t pos_;  // Offset in file_ at which the next key starts.
+  std::string key_;
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+
+  const Real *data_;  // If state_ == kHaveMapped, the data of the object.
+  int32_t num_rows_;
+  int32_t num_cols_;
+  Matrix<Real> copy_;  // If state_ == kHaveCopy, the object.
+  int64_t num_mapped_;
+  int64_t num_copied_;
+
+  enum {
+    kUninitialized,
+    kEof,
+    kError,
+    kHaveMapped,  // data_, num_rows_ and num_cols_ describe the object.
+    kHaveCopy,    // copy_ contains the object.
+  } state_;
+
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(SequentialMappedMatrixReader)
+};
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_MAPPED_MATRIX_READER_H_
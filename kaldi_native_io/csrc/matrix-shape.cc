@@ -62,8 +62,9 @@ void MatrixShape::ReadNonCompressedBinary(std::istream &is) {
   bool binary = true;
   std::string token;
   ReadToken(is, binary, &token);
-  if (token != "FM" && token != "DM") {
-    KALDIIO_ERR << "Expect token FM or DM. Given: " << token;
+  // HalfMatrix ("HM" or "BM") has the same header as a regular matrix.
+  if (token != "FM" && token != "DM" && token != "HM" && token != "BM") {
+    KALDIIO_ERR << "Expect token FM, DM, HM or BM. Given: " << token;
   }
 
   ReadBasicType(is, binary, &num_rows_);  // throws on error.
@@ -0,0 +1,309 @@
+// kaldi_native_io/csrc/memory-allocator.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/memory-allocator.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <new>
+#include <vector>
+
+#include "kaldi_native_io/csrc/kaldi-utils.h"
+
+namespace kaldiio {
+
+constexpr size_t MemoryAllocator::kAlignment;
+
+// The size of the smallest size class.
+static const size_t kMinBlockBytes = 64;
+
+static const size_t kHugePageBytes = 2 << 20;
+
+static int32_t FloorLog2(size_t n) {
+  int32_t ans = 0;
+  while (n >>= 1) ans++;
+  return ans;
+}
+
+// Returns the smallest size class with blocks of at least num_bytes bytes.
+// The size classes are 64 bytes, and then four per power of two: 80, 96,
+// 112, 128, 160, 192, and so on.
+static int32_t SizeClass(size_t num_bytes) {
+  if (num_bytes <= kMinBlockBytes) return 0;
+  int32_t log2 = FloorLog2(num_bytes - 1);
+  int32_t sub = static_cast<int32_t>(((num_bytes - 1) >> (log2 - 2)) & 3);
+  return (log2 - 6) * 4 + sub + 1;
+}
+
+// Returns the size of the blocks of size class c.
+static size_t ClassSize(int32_t c) {
+  if (c == 0) return kMinBlockBytes;
+  int32_t log2 = (c - 1) / 4 + 6, sub = (c - 1) % 4;
+  return (static_cast<size_t>(1) << log2) +
+         (sub + 1) * (static_cast<size_t>(1) << (log2 - 2));
+}
+
+static size_t RoundUpToHugePage(size_t num_bytes) {
+  return (num_bytes + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+}
+
+static void *SystemAllocate(size_t num_bytes) {
+  void *temp;
+  void *p = KALDIIO_MEMALIGN(MemoryAllocator::kAlignment, num_bytes, &temp);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+#ifdef __linux__
+// Maps num_bytes bytes, a multiple of kHugePageBytes, aligned to
+// kHugePageBytes so that the kernel can back them with huge pages.
+static void *MapHugePages(size_t num_bytes) {
+  size_t length = num_bytes + kHugePageBytes;
+  void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) throw std::bad_alloc();
+  char *begin = static_cast<char *>(p), *end = begin + length;
+  size_t offset = reinterpret_cast<uintptr_t>(begin) % kHugePageBytes;
+  char *aligned = begin + (offset == 0 ? 0 : kHugePageBytes - offset);
+  // Unmap the parts before and after the aligned range.
+  if (aligned != begin) munmap(begin, aligned - begin);
+  if (aligned + num_bytes != end)
+    munmap(aligned + num_bytes, end - (aligned + num_bytes));
+  // This is only advice: failure (e.g. if transparent huge pages are
+  // disabled) just means we get normal pages.
+  madvise(aligned, num_bytes, MADV_HUGEPAGE);
+  return aligned;
+}
+#endif
+
+void *MallocAllocator::Allocate(size_t num_bytes) {
+  return SystemAllocate(num_bytes);
+}
+
+void MallocAllocator::Free(void *p, size_t /*num_bytes*/) {
+  KALDIIO_MEMALIGN_FREE(p);
+}
+
+struct PooledAllocator::State {
+  struct FreeList {
+    std::mutex mutex;
+    std::vector<void *> blocks;
+  };
+
+  PooledAllocatorOptions opts;
+  // Allocations in size classes from num_classes up are not pooled.
+  int32_t num_classes;
+  std::unique_ptr<FreeList[]> lists;
+  std::atomic<size_t> pooled_bytes;
+
+  explicit State(const PooledAllocatorOptions &options)
+      : opts(options),
+        num_classes(SizeClass(options.max_block_bytes) + 1),
+        lists(new FreeList[num_classes]),
+        pooled_bytes(0) {}
+
+  ~State() {
+    for (int32_t c = 0; c < num_classes; c++)
+      for (void *p : lists[c].blocks) DeleteBlock(p, ClassSize(c));
+  }
+
+  bool UsesHugePages(size_t num_bytes) const {
+#ifdef __linux__
+    return opts.use_huge_pages && num_bytes >= kHugePageBytes;
+#else
+    return false;
+#endif
+  }
+
+  // Allocates a block from the system.
+  void *NewBlock(size_t num_bytes) const {
+#ifdef __linux__
+    if (UsesHugePages(num_bytes))
+      return MapHugePages(RoundUpToHugePage(num_bytes));
+#endif
+    return SystemAllocate(num_bytes);
+  }
+
+  // Returns a block from NewBlock(num_bytes) to the system.
+  void DeleteBlock(void *p, size_t num_bytes) const {
+#ifdef __linux__
+    if (UsesHugePages(num_bytes)) {
+      munmap(p, RoundUpToHugePage(num_bytes));
+      return;
+    }
+#endif
+    KALDIIO_MEMALIGN_FREE(p);
+  }
+
+  // Takes a free block of size class c from the pool; returns NULL if there
+  // is none.
+  void *Pop(int32_t c) {
+    FreeList &list = lists[c];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (list.blocks.empty()) return NULL;
+    void *p = list.blocks.back();
+    list.blocks.pop_back();
+    pooled_bytes -= ClassSize(c);
+    return p;
+  }
+
+  // Puts a free block of size class c in the pool, or returns it to the
+  // system if the pool is full.
+  void Push(int32_t c, void *p) {
+    size_t size = ClassSize(c);
+    // Reserve the room for the block first, so that concurrent calls cannot
+    // take the pool over max_pooled_bytes between the check and the add.
+    size_t num_bytes = pooled_bytes.load();
+    do {
+      if (num_bytes + size > opts.max_pooled_bytes) {
+        DeleteBlock(p, size);
+        return;
+      }
+    } while (!pooled_bytes.compare_exchange_weak(num_bytes, num_bytes + size));
+    FreeList &list = lists[c];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    list.blocks.push_back(p);
+  }
+
+  void Trim() {
+    for (int32_t c = 0; c < num_classes; c++) {
+      std::vector<void *> blocks;
+      {
+        std::lock_guard<std::mutex> lock(lists[c].mutex);
+        blocks.swap(lists[c].blocks);
+        pooled_bytes -= blocks.size() * ClassSize(c);
+      }
+      for (void *p : blocks) DeleteBlock(p, ClassSize(c));
+    }
+  }
+};
+
+namespace {
+
+// The free blocks a thread keeps for itself.  A thread caches blocks for one
+// PooledAllocator at a time: the one it used last.
+struct ThreadCache {
+  std::shared_ptr<PooledAllocator::State> state;
+  std::vector<std::vector<void *>> lists;  // Indexed by size class.
+  size_t num_bytes = 0;
+
+  ~ThreadCache();
+
+  // Moves all the blocks to the shared pool.
+  void Flush() {
+    for (size_t c = 0; c < lists.size(); c++) {
+      for (void *p : lists[c]) state->Push(static_cast<int32_t>(c), p);
+      lists[c].clear();
+    }
+    num_bytes = 0;
+  }
+};
+
+thread_local ThreadCache tl_cache;
+
+// Set when tl_cache is destroyed at thread exit, after which objects
+// destroyed later in the same thread must not use it.
+thread_local bool tl_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+  if (state) Flush();
+  tl_cache_destroyed = true;
+}
+
+// Returns the calling thread's cache, bound to 'state', or NULL if it cannot
+// be used.
+ThreadCache *GetThreadCache(
+    const std::shared_ptr<PooledAllocator::State> &state) {
+  if (tl_cache_destroyed || state->opts.max_thread_cache_bytes == 0)
+    return NULL;
+  ThreadCache *cache = &tl_cache;
+  if (cache->state != state) {
+    if (cache->state) cache->Flush();
+    cache->state = state;
+    cache->lists.clear();
+    cache->lists.resize(state->num_classes);
+  }
+  return cache;
+}
+
+}  // namespace
+
+PooledAllocator::PooledAllocator(const PooledAllocatorOptions &opts)
+    : state_(std::make_shared<State>(opts)) {}
+
+// Blocks still in thread caches are freed when the threads exit, or use
+// another allocator.
+PooledAllocator::~PooledAllocator() = default;
+
+void *PooledAllocator::Allocate(size_t num_bytes) {
+  KALDIIO_ASSERT(num_bytes > 0);
+  int32_t c = SizeClass(num_bytes);
+  if (c >= state_->num_classes) return state_->NewBlock(num_bytes);
+
+  ThreadCache *cache = GetThreadCache(state_);
+  if (cache != NULL && !cache->lists[c].empty()) {
+    void *p = cache->lists[c].back();
+    cache->lists[c].pop_back();
+    cache->num_bytes -= ClassSize(c);
+    return p;
+  }
+  void *p = state_->Pop(c);
+  if (p != NULL) return p;
+  return state_->NewBlock(ClassSize(c));
+}
+
+void PooledAllocator::Free(void *p, size_t num_bytes) {
+  int32_t c = SizeClass(num_bytes);
+  if (c >= state_->num_classes) {
+    state_->DeleteBlock(p, num_bytes);
+    return;
+  }
+  size_t size = ClassSize(c);
+  ThreadCache *cache = GetThreadCache(state_);
+  if (cache != NULL &&
+      cache->num_bytes + size <= state_->opts.max_thread_cache_bytes) {
+    cache->lists[c].push_back(p);
+    cache->num_bytes += size;
+    return;
+  }
+  state_->Push(c, p);
+}
+
+size_t PooledAllocator::UsableSize(size_t num_bytes) const {
+  int32_t c = SizeClass(num_bytes);
+  if (c < state_->num_classes) return ClassSize(c);
+  return state_->UsesHugePages(num_bytes) ? RoundUpToHugePage(num_bytes)
+                                          : num_bytes;
+}
+
+size_t PooledAllocator::PooledBytes() const { return state_->pooled_bytes; }
+
+void PooledAllocator::Trim() {
+  if (!tl_cache_destroyed && tl_cache.state == state_) tl_cache.Flush();
+  state_->Trim();
+}
+
+static std::atomic<MemoryAllocator *> g_memory_allocator(NULL);
+
+MemoryAllocator *GetMemoryAllocator() {
+  MemoryAllocator *allocator = g_memory_allocator.load();
+  if (allocator != NULL) return allocator;
+  // Never destroyed, so that objects can free their data during static
+  // destruction.
+  static PooledAllocator *default_allocator = new PooledAllocator();
+  return default_allocator;
+}
+
+void SetMemoryAllocator(MemoryAllocator *allocator) {
+  g_memory_allocator = allocator;
+}
+
+}  // namespace kaldiio
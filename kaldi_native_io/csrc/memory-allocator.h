@@ -0,0 +1,112 @@
+// kaldi_native_io/csrc/memory-allocator.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_MEMORY_ALLOCATOR_H_
+#define KALDI_NATIVE_IO_CSRC_MEMORY_ALLOCATOR_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "kaldi_native_io/csrc/log.h"
+
+namespace kaldiio {
+
+// MemoryAllocator allocates the data of Matrix, Vector and CompressedMatrix.
+// Each object frees its data with the allocator it allocated it with, so an
+// allocator must outlive all the objects allocated with it.  Implementations
+// must be thread-safe.
+class MemoryAllocator {
+ public:
+  // The alignment in bytes of the memory Allocate() returns.
+  static constexpr size_t kAlignment = 64;
+
+  virtual ~MemoryAllocator() = default;
+
+  // Returns memory with room for UsableSize(num_bytes) bytes, where
+  // num_bytes > 0.  Throws std::bad_alloc on failure.
+  virtual void *Allocate(size_t num_bytes) = 0;
+
+  // Frees memory returned by Allocate(n); num_bytes must be in the range
+  // [n, UsableSize(n)].
+  virtual void Free(void *p, size_t num_bytes) = 0;
+
+  // Returns the number of bytes Allocate(num_bytes) gives room for, which is
+  // at least num_bytes.  Objects use the extra room when they are resized.
+  virtual size_t UsableSize(size_t num_bytes) const { return num_bytes; }
+};
+
+// Allocates each block with the system's aligned malloc.
+class MallocAllocator : public MemoryAllocator {
+ public:
+  void *Allocate(size_t num_bytes) override;
+  void Free(void *p, size_t num_bytes) override;
+};
+
+struct PooledAllocatorOptions {
+  // Allocations larger than this are not pooled; they go straight to the
+  // system.
+  size_t max_block_bytes;
+  // The maximum number of bytes of free blocks kept in the pool shared by all
+  // threads; further freed blocks are returned to the system.
+  size_t max_pooled_bytes;
+  // The maximum number of bytes of free blocks each thread keeps for itself,
+  // so that most allocations and frees take no lock.
+  size_t max_thread_cache_bytes;
+  // If true, blocks of 2 MiB or more are mapped with mmap() and marked for
+  // transparent huge pages with madvise(), which reduces TLB misses on large
+  // matrices.  Only has an effect on Linux.
+  bool use_huge_pages;
+
+  PooledAllocatorOptions()
+      : max_block_bytes(16 << 20),
+        max_pooled_bytes(64 << 20),
+        max_thread_cache_bytes(4 << 20),
+        use_huge_pages(false) {}
+};
+
+// PooledAllocator rounds allocations up to size classes (four per power of
+// two) and keeps freed blocks in per-class free lists to reuse them: first in
+// a cache private to the freeing thread, then in a pool shared by all threads.
+// This avoids contention in the system allocator when many threads decode
+// objects in parallel, and keeps the memory of long-running processes from
+// fragmenting into blocks of many different sizes.
+class PooledAllocator : public MemoryAllocator {
+ public:
+  explicit PooledAllocator(
+      const PooledAllocatorOptions &opts = PooledAllocatorOptions());
+
+  ~PooledAllocator() override;
+
+  void *Allocate(size_t num_bytes) override;
+  void Free(void *p, size_t num_bytes) override;
+  size_t UsableSize(size_t num_bytes) const override;
+
+  // Returns the number of bytes of free blocks in the shared pool.
+  size_t PooledBytes() const;
+
+  // Returns the free blocks in the shared pool, and in the calling thread's
+  // cache, to the system.
+  void Trim();
+
+  // The state shared with the thread caches, which may outlive *this.
+  struct State;
+
+ private:
+  std::shared_ptr<State> state_;
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(PooledAllocator)
+};
+
+// Returns the allocator Matrix, Vector and CompressedMatrix allocate new data
+// with.  By default this is a PooledAllocator with default options that lives
+// until the process exits.
+MemoryAllocator *GetMemoryAllocator();
+
+// Sets the allocator returned by GetMemoryAllocator(); NULL restores the
+// default one.  Objects allocated before keep using the allocator they were
+// allocated with.  *allocator is not owned.
+void SetMemoryAllocator(MemoryAllocator *allocator);
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_MEMORY_ALLOCATOR_H_
@@ -0,0 +1,352 @@
+// kaldi_native_io/csrc/number-format.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+// The shortest decimal representation of floating point numbers is found with
+// the Grisu2 algorithm from Florian Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers", PLDI 2010.  Its output always reads
+// back as the number it was given, and is the shortest such output for all
+// but a tiny fraction of numbers, for which it is one digit longer.
+
+#include "kaldi_native_io/csrc/number-format.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace kaldiio {
+
+namespace {
+
+// A floating point number f * 2^e with a 64-bit significand.
+struct DiyFp {
+  uint64_t f;
+  int32_t e;
+};
+
+DiyFp Normalize(DiyFp x) {
+  while ((x.f >> 54) == 0) {
+    x.f <<= 10;
+    x.e -= 10;
+  }
+  while ((x.f >> 63) == 0) {
+    x.f <<= 1;
+    x.e -= 1;
+  }
+  return x;
+}
+
+// Returns x * y, rounded to 64 bits.
+DiyFp Multiply(DiyFp x, DiyFp y) {
+  const uint64_t kMask32 = 0xFFFFFFFF;
+  uint64_t a = x.f >> 32, b = x.f & kMask32;
+  uint64_t c = y.f >> 32, d = y.f & kMask32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & kMask32) + (bc & kMask32);
+  mid += static_cast<uint64_t>(1) << 31;  // Rounds to nearest.
+  DiyFp r;
+  r.f = ac + (ad >> 32) + (bc >> 32) + (mid >> 32);
+  r.e = x.e + y.e + 64;
+  return r;
+}
+
+// Normalized approximations of 10^k for k = -348, -340, ..., 340.
+const uint64_t kCachedPowersF[] = {
+    0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+    0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+    0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+    0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+    0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+    0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+    0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+    0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+    0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+    0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+    0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+    0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+    0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+    0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+    0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+    0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+    0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+    0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+    0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+    0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+    0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+    0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+    0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+    0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+    0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+    0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+    0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+    0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+    0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+const int16_t kCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+    -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635,
+    -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316,
+    -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56,
+    83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+    481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853,
+    880, 907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+// Returns the cached power of ten c = 10^-k such that w * c, for a normalized
+// w with exponent e, has an exponent in [-60, -32], and sets *k.
+DiyFp CachedPower(int32_t e, int32_t *k) {
+  // 0.30102999566398114 is log10(2).
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int32_t ik = static_cast<int32_t>(dk);
+  if (dk - ik > 0.0) ik++;
+  int32_t index = (ik >> 3) + 1;
+  *k = 348 - index * 8;
+  DiyFp c;
+  c.f = kCachedPowersF[index];
+  c.e = kCachedPowersE[index];
+  return c;
+}
+
+const uint32_t kPowersOfTen32[] = {1,         10,        100,     1000,
+                                   10000,     100000,    1000000, 10000000,
+                                   100000000, 1000000000};
+
+int32_t CountDigits(uint32_t n) {
+  int32_t count = 1;
+  while (count < 10 && n >= kPowersOfTen32[count]) count++;
+  return count;
+}
+
+// Moves the last digit of buf[0, len) down, towards w, while the number stays
+// within the rounding interval and gets closer to w.  rest is the distance
+// from the number to the upper end of the interval, delta the size of the
+// interval, ten_kappa the value of one unit of the last digit and wp_w the
+// distance from w to the upper end.
+void Round(char *buf, int32_t len, uint64_t delta, uint64_t rest,
+           uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+// Writes the digits of a number in [wp - delta, wp], close to w, to buf; the
+// number is then buf[0, *len) * 10^*k.
+void GenerateDigits(DiyFp w, DiyFp wp, uint64_t delta, char *buf,
+                    int32_t *len, int32_t *k) {
+  const int32_t shift = -wp.e;
+  const uint64_t one = static_cast<uint64_t>(1) << shift;
+  const uint64_t wp_w = wp.f - w.f;
+  uint32_t p1 = static_cast<uint32_t>(wp.f >> shift);  // The integral part.
+  uint64_t p2 = wp.f & (one - 1);  // The fractional part.
+  int32_t kappa = CountDigits(p1);
+  *len = 0;
+  while (kappa > 0) {
+    uint32_t pow = kPowersOfTen32[kappa - 1];
+    uint32_t d = p1 / pow;
+    p1 %= pow;
+    if (d != 0 || *len != 0) buf[(*len)++] = static_cast<char>('0' + d);
+    kappa--;
+    uint64_t rest = (static_cast<uint64_t>(p1) << shift) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      Round(buf, *len, delta, rest,
+            static_cast<uint64_t>(kPowersOfTen32[kappa]) << shift, wp_w);
+      return;
+    }
+  }
+  uint64_t unit = 1;  // Scales wp_w like delta; 0 once it would overflow.
+  while (true) {
+    p2 *= 10;
+    delta *= 10;
+    unit = unit > std::numeric_limits<uint64_t>::max() / 10 ? 0 : unit * 10;
+    uint32_t d = static_cast<uint32_t>(p2 >> shift);
+    if (d != 0 || *len != 0) buf[(*len)++] = static_cast<char>('0' + d);
+    p2 &= one - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      Round(buf, *len, delta, p2, one, wp_w * unit);
+      return;
+    }
+  }
+}
+
+// The bits of float or double.
+template <class Real>
+struct FloatBits;
+
+template <>
+struct FloatBits<float> {
+  typedef uint32_t Bits;
+  static const int32_t kSignificandBits = 23;
+  static const int32_t kExponentBias = 127 + 23;
+};
+
+template <>
+struct FloatBits<double> {
+  typedef uint64_t Bits;
+  static const int32_t kSignificandBits = 52;
+  static const int32_t kExponentBias = 1023 + 52;
+};
+
+// Writes the digits of the shortest decimal number that rounds to value,
+// which must be positive and finite, to buf; the number is then
+// buf[0, *len) * 10^*k.
+template <class Real>
+void Grisu2(Real value, char *buf, int32_t *len, int32_t *k) {
+  typedef FloatBits<Real> Traits;
+  typename Traits::Bits bits;
+  memcpy(&bits, &value, sizeof(value));
+  const uint64_t hidden = static_cast<uint64_t>(1) << Traits::kSignificandBits;
+  const uint64_t significand = bits & (hidden - 1);
+  const int32_t biased_exponent =
+      static_cast<int32_t>(bits >> Traits::kSignificandBits);
+  DiyFp v;
+  if (biased_exponent != 0) {
+    v.f = significand + hidden;
+    v.e = biased_exponent - Traits::kExponentBias;
+  } else {  // Subnormal.
+    v.f = significand;
+    v.e = 1 - Traits::kExponentBias;
+  }
+  // The numbers halfway to the neighbours of v bound the decimal numbers
+  // that round to it.  The lower neighbour is closer if v is a power of two
+  // other than the smallest normal number.
+  DiyFp plus = {(v.f << 1) + 1, v.e - 1};
+  plus = Normalize(plus);
+  DiyFp minus;
+  if (v.f == hidden && biased_exponent > 1) {
+    minus.f = (v.f << 2) - 1;
+    minus.e = v.e - 2;
+  } else {
+    minus.f = (v.f << 1) - 1;
+    minus.e = v.e - 1;
+  }
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  DiyFp c = CachedPower(plus.e, k);
+  DiyFp w = Multiply(Normalize(v), c);
+  DiyFp wp = Multiply(plus, c);
+  DiyFp wm = Multiply(minus, c);
+  // Shrinks the interval by the largest error of the multiplications, so
+  // that everything in it rounds to value.
+  wm.f++;
+  wp.f--;
+  GenerateDigits(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+char *WriteExponent(int32_t exponent, char *buf) {
+  *buf++ = 'e';
+  if (exponent < 0) {
+    *buf++ = '-';
+    exponent = -exponent;
+  } else {
+    *buf++ = '+';
+  }
+  if (exponent >= 100) {
+    *buf++ = static_cast<char>('0' + exponent / 100);
+    exponent %= 100;
+  }
+  *buf++ = static_cast<char>('0' + exponent / 10);
+  *buf++ = static_cast<char>('0' + exponent % 10);
+  return buf;
+}
+
+// Lays out the number digits[0, len) * 10^k like printf's "%g" would with
+// enough precision, except that integral values, up to the number of digits
+// of the number or 7 if larger, are written in full.
+char *WriteDecimal(const char *digits, int32_t len, int32_t k, char *buf) {
+  const int32_t exponent = len + k - 1;  // Of the first digit.
+  if (exponent < -4 || exponent >= (len > 7 ? len : 7)) {
+    *buf++ = digits[0];
+    if (len > 1) {
+      *buf++ = '.';
+      memcpy(buf, digits + 1, len - 1);
+      buf += len - 1;
+    }
+    return WriteExponent(exponent, buf);
+  }
+  if (k >= 0) {  // An integer.
+    memcpy(buf, digits, len);
+    buf += len;
+    memset(buf, '0', k);
+    return buf + k;
+  }
+  if (exponent >= 0) {  // The decimal point is within the digits.
+    memcpy(buf, digits, exponent + 1);
+    buf += exponent + 1;
+    *buf++ = '.';
+    memcpy(buf, digits + exponent + 1, len - exponent - 1);
+    return buf + len - exponent - 1;
+  }
+  *buf++ = '0';
+  *buf++ = '.';
+  memset(buf, '0', -exponent - 1);
+  buf += -exponent - 1;
+  memcpy(buf, digits, len);
+  return buf + len;
+}
+
+template <class Real>
+char *FormatReal(Real t, char *buf) {
+  if (std::signbit(t)) *buf++ = '-';
+  if (std::isnan(t)) {
+    memcpy(buf, "nan", 3);
+    return buf + 3;
+  }
+  if (std::isinf(t)) {
+    memcpy(buf, "inf", 3);
+    return buf + 3;
+  }
+  if (t == 0) {
+    *buf++ = '0';
+    return buf;
+  }
+  char digits[20];
+  int32_t len, k;
+  Grisu2(std::fabs(t), digits, &len, &k);
+  return WriteDecimal(digits, len, k, buf);
+}
+
+}  // namespace
+
+char *FormatNumber(float t, char *buf) { return FormatReal(t, buf); }
+
+char *FormatNumber(double t, char *buf) { return FormatReal(t, buf); }
+
+namespace internal {
+
+char *FormatDecimalInteger(bool negative, uint64_t magnitude, char *buf) {
+  static const char kDigitPairs[] =
+      "000102030405060708091011121314151617181920212223242526272829"
+      "303132333435363738394041424344454647484950515253545556575859"
+      "606162636465666768697071727374757677787980818283848586878889"
+      "90919293949596979899";
+  if (negative) *buf++ = '-';
+  char tmp[20];  // 2^64 has 20 digits.
+  char *p = tmp + sizeof(tmp);
+  while (magnitude >= 100) {
+    const char *pair = kDigitPairs + (magnitude % 100) * 2;
+    magnitude /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if (magnitude >= 10) {
+    const char *pair = kDigitPairs + magnitude * 2;
+    *--p = pair[1];
+    *--p = pair[0];
+  } else {
+    *--p = static_cast<char>('0' + magnitude);
+  }
+  size_t n = tmp + sizeof(tmp) - p;
+  memcpy(buf, p, n);
+  return buf + n;
+}
+
+}  // namespace internal
+
+}  // namespace kaldiio
@@ -0,0 +1,48 @@
+// kaldi_native_io/csrc/number-format.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_NUMBER_FORMAT_H_
+#define KALDI_NATIVE_IO_CSRC_NUMBER_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace kaldiio {
+
+/// The most characters FormatNumber() writes.
+const size_t kMaxNumberChars = 32;
+
+/// Writes t in decimal to buf, which must have room for kMaxNumberChars
+/// characters, and returns the end of what it wrote; no terminating null is
+/// written.  The output is the shortest (in nearly all cases) decimal number
+/// that reads back as exactly t with ParseNumber() or strtod(), in the layout
+/// of printf's "%g": e.g. "0.1", "-3.1415927", "12345678", "1e+08" and
+/// "1.5e-07".  Integral values have no decimal point.  Infinities and NaNs
+/// are written as "inf", "-inf", "nan" and "-nan".
+char *FormatNumber(float t, char *buf);
+char *FormatNumber(double t, char *buf);
+
+namespace internal {
+
+// Writes magnitude in decimal, preceded by '-' if negative.
+char *FormatDecimalInteger(bool negative, uint64_t magnitude, char *buf);
+
+}  // namespace internal
+
+template <class Int>
+char *FormatNumber(Int t, char *buf) {
+  static_assert(std::is_integral<Int>::value && !std::is_same<Int, bool>::value,
+                "");
+  if (std::is_signed<Int>::value && t < 0) {
+    // Avoids overflow for the most negative value.
+    uint64_t magnitude = static_cast<uint64_t>(-(static_cast<int64_t>(t) + 1));
+    return internal::FormatDecimalInteger(true, magnitude + 1, buf);
+  }
+  return internal::FormatDecimalInteger(false, static_cast<uint64_t>(t), buf);
+}
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_NUMBER_FORMAT_H_
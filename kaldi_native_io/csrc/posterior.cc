@@ -10,69 +10,95 @@
 
 #include "kaldi_native_io/csrc/posterior.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include "kaldi_native_io/csrc/io-funcs.h"
+#include "kaldi_native_io/csrc/text-scanner.h"
 #include "kaldi_native_io/csrc/text-utils.h"
 
 namespace kaldiio {
 
 void WritePosterior(std::ostream &os, bool binary, const Posterior &post) {
   if (binary) {
+    BinaryBasicTypeWriter writer(os);
     int32_t sz = post.size();
-    WriteBasicType(os, binary, sz);
+    writer.Write(sz);
     for (Posterior::const_iterator iter = post.begin(); iter != post.end();
          ++iter) {
-      int32_t sz2 = iter->size();
-      WriteBasicType(os, binary, sz2);
-      for (std::vector<std::pair<int32_t, float>>::const_iterator iter2 =
-               iter->begin();
-           iter2 != iter->end(); ++iter2) {
-        WriteBasicType(os, binary, iter2->first);
-        WriteBasicType(os, binary, iter2->second);
+      const std::vector<std::pair<int32_t, float>> &frame = *iter;
+      int32_t sz2 = frame.size();
+      writer.Write(sz2);
+      for (size_t i = 0; i < frame.size(); i++) {
+        writer.Write(frame[i].first);
+        writer.Write(frame[i].second);
       }
     }
+    writer.Flush();
   } else {  // In text-mode, choose a human-friendly, script-friendly format.
     // format is [ 1235 0.6 12 0.4 ] [ 34 1.0 ] ...
     // We could have used the same code as in the binary case above,
     // but this would have resulted in less readable output.
+    TextBasicTypeWriter writer(os);
     for (Posterior::const_iterator iter = post.begin(); iter != post.end();
          ++iter) {
-      os << "[ ";
+      writer.WriteString("[ ");
       for (std::vector<std::pair<int32_t, float>>::const_iterator iter2 =
                iter->begin();
            iter2 != iter->end(); iter2++) {
-        os << iter2->first << ' ' << iter2->second << ' ';
+        writer.Write(iter2->first);
+        writer.Write(iter2->second);
       }
-      os << "] ";
+      writer.WriteString("] ");
     }
-    os << '\n';  // newline terminates the Posterior.
+    writer.WriteString("\n");  // newline terminates the Posterior.
+    writer.Flush();
   }
   if (!os.good()) KALDIIO_ERR << "Output stream error writing Posterior.";
 }
 
+// Reads the number of frames of a Posterior in binary mode, and declares the
+// bytes of their sizes to the reader.
+static int32_t ReadNumFrames(BinaryBasicTypeReader *reader) {
+  int32_t sz = 0;
+  reader->Expect(reader->MinBinarySize<int32_t>());
+  reader->Read(&sz);
+  if (sz < 0 || sz > 10000000)
+    KALDIIO_ERR << "Reading posterior: got negative or improbably large size"
+                << sz;
+  reader->Expect(sz * reader->MinBinarySize<int32_t>());
+  return sz;
+}
+
+// Reads the number of pairs of a frame of a Posterior in binary mode, and
+// declares the bytes of the pairs to the reader.
+static int32_t ReadFrameSize(BinaryBasicTypeReader *reader) {
+  int32_t sz2;
+  reader->Read(&sz2);
+  if (sz2 < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
+  reader->Expect(sz2 * (reader->MinBinarySize<int32_t>() +
+                        reader->MinBinarySize<float>()));
+  return sz2;
+}
+
 void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
   post->clear();
   if (binary) {
-    int32_t sz;
-    ReadBasicType(is, true, &sz);
-    if (sz < 0 || sz > 10000000)
-      KALDIIO_ERR << "Reading posterior: got negative or improbably large size"
-                  << sz;
+    BinaryBasicTypeReader reader(is);
+    int32_t sz = ReadNumFrames(&reader);
     post->resize(sz);
     for (Posterior::iterator iter = post->begin(); iter != post->end();
          ++iter) {
-      int32_t sz2;
-      ReadBasicType(is, true, &sz2);
-      if (sz2 < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
-      iter->resize(sz2);
-      for (std::vector<std::pair<int32_t, float>>::iterator iter2 =
-               iter->begin();
-           iter2 != iter->end(); iter2++) {
-        ReadBasicType(is, true, &(iter2->first));
-        ReadBasicType(is, true, &(iter2->second));
-      }
+      int32_t sz2 = ReadFrameSize(&reader);
+      std::vector<std::pair<int32_t, float>> &frame = *iter;
+      frame.resize(sz2);
+      reader.ReadPairArray<int32_t, float>(
+          sz2, [&frame](size_t i, int32_t id, float weight) {
+            frame[i].first = id;
+            frame[i].second = weight;
+          });
     }
   } else {
     std::string line;
@@ -106,7 +132,8 @@ void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
         }
         int32_t i;
         float p;
-        line_is >> i >> p;
+        ScanNumber(line_is, &i);
+        ScanNumber(line_is, &p);
         if (line_is.fail())
           KALDIIO_ERR << "Error reading Posterior object (could not get data "
                          "after \"[\");";
@@ -117,6 +144,265 @@ void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
   }
 }
 
+void FlatPosterior::CopyFromPosterior(const Posterior &post) {
+  offsets_.resize(post.size() + 1);
+  offsets_[0] = 0;
+  ids_.clear();
+  weights_.clear();
+  for (size_t t = 0; t < post.size(); t++) {
+    for (size_t i = 0; i < post[t].size(); i++) {
+      ids_.push_back(post[t][i].first);
+      weights_.push_back(post[t][i].second);
+    }
+    KALDIIO_ASSERT(ids_.size() <=
+                   static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+    offsets_[t + 1] = static_cast<int32_t>(ids_.size());
+  }
+}
+
+void FlatPosterior::CopyToPosterior(Posterior *post) const {
+  post->resize(NumFrames());
+  for (int32_t t = 0; t < NumFrames(); t++) {
+    std::vector<std::pair<int32_t, float>> &frame = (*post)[t];
+    frame.clear();
+    for (int32_t k = offsets_[t]; k < offsets_[t + 1]; k++)
+      frame.push_back(std::make_pair(ids_[k], weights_[k]));
+  }
+}
+
+void FlatPosterior::Read(std::istream &is, bool binary) {
+  if (!binary) {
+    Posterior post;
+    ReadPosterior(is, binary, &post);
+    CopyFromPosterior(post);
+    return;
+  }
+  BinaryBasicTypeReader reader(is);
+  int32_t sz = ReadNumFrames(&reader);
+  offsets_.resize(sz + 1);
+  offsets_[0] = 0;
+  ids_.clear();
+  weights_.clear();
+  for (int32_t t = 0; t < sz; t++) {
+    int32_t sz2 = ReadFrameSize(&reader);
+    size_t begin = ids_.size();
+    if (begin + sz2 > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+      KALDIIO_ERR << "Reading posterior: too many elements";
+    ids_.resize(begin + sz2);
+    weights_.resize(begin + sz2);
+    int32_t *ids = ids_.data() + begin;
+    float *weights = weights_.data() + begin;
+    reader.ReadPairArray<int32_t, float>(
+        sz2, [ids, weights](size_t i, int32_t id, float weight) {
+          ids[i] = id;
+          weights[i] = weight;
+        });
+    offsets_[t + 1] = static_cast<int32_t>(begin + sz2);
+  }
+}
+
+void FlatPosterior::Write(std::ostream &os, bool binary) const {
+  if (binary) {
+    BinaryBasicTypeWriter writer(os);
+    writer.Write(NumFrames());
+    for (int32_t t = 0; t < NumFrames(); t++) {
+      writer.Write(offsets_[t + 1] - offsets_[t]);
+      for (int32_t k = offsets_[t]; k < offsets_[t + 1]; k++) {
+        writer.Write(ids_[k]);
+        writer.Write(weights_[k]);
+      }
+    }
+    writer.Flush();
+  } else {
+    // The same format as WritePosterior().
+    TextBasicTypeWriter writer(os);
+    for (int32_t t = 0; t < NumFrames(); t++) {
+      writer.WriteString("[ ");
+      for (int32_t k = offsets_[t]; k < offsets_[t + 1]; k++) {
+        writer.Write(ids_[k]);
+        writer.Write(weights_[k]);
+      }
+      writer.WriteString("] ");
+    }
+    writer.WriteString("\n");
+    writer.Flush();
+  }
+  if (!os.good()) KALDIIO_ERR << "Output stream error writing Posterior.";
+}
+
+// Reads the number of pairs of a frame of a GaussPost in binary mode, and
+// declares the bytes of the pairs to the reader: each has at least an id, and
+// the token and size its vector starts with.
+static int32_t ReadGaussFrameSize(BinaryBasicTypeReader *reader) {
+  int32_t sz2;
+  reader->Read(&sz2);
+  if (sz2 < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
+  reader->Expect(sz2 * (2 * reader->MinBinarySize<int32_t>() + 3));
+  return sz2;
+}
+
+// Reads the token and size of a vector of a GaussPost in binary mode, which
+// may have been written as a Vector<double>, in which case it sets
+// *is_double; declares the bytes of its data to the reader.
+static int32_t ReadGaussVectorHeader(BinaryBasicTypeReader *reader,
+                                     bool *is_double) {
+  std::string token;
+  reader->ReadToken(&token);
+  if (token != "FV" && token != "DV")
+    KALDIIO_ERR << "Reading posteriors: expected token FV or DV, got "
+                << token;
+  *is_double = (token == "DV");
+  int32_t size;
+  reader->Read(&size);
+  if (size < 0) KALDIIO_ERR << "Reading posteriors: got negative vector size";
+  reader->Expect(size * (*is_double ? sizeof(double) : sizeof(float)));
+  return size;
+}
+
+// Reads the data of the vector whose header ReadGaussVectorHeader() read.
+static void ReadGaussVectorData(BinaryBasicTypeReader *reader, int32_t size,
+                                bool is_double, float *data) {
+  if (!is_double) {
+    reader->ReadBytes(size * sizeof(float), reinterpret_cast<char *>(data));
+    return;
+  }
+  std::vector<double> tmp(size);
+  reader->ReadBytes(size * sizeof(double),
+                    reinterpret_cast<char *>(tmp.data()));
+  std::copy(tmp.begin(), tmp.end(), data);
+}
+
+// Reads a GaussPost in the format GaussPostHolder::Write() writes.
+static void ReadGaussPost(std::istream &is, bool binary, GaussPost *post) {
+  post->clear();
+  if (binary) {
+    BinaryBasicTypeReader reader(is);
+    int32_t sz = ReadNumFrames(&reader);
+    post->resize(sz);
+    for (GaussPost::iterator iter = post->begin(); iter != post->end();
+         ++iter) {
+      iter->resize(ReadGaussFrameSize(&reader));
+      for (std::vector<std::pair<int32_t, Vector<float>>>::iterator iter2 =
+               iter->begin();
+           iter2 != iter->end(); iter2++) {
+        reader.Read(&(iter2->first));
+        bool is_double;
+        int32_t size = ReadGaussVectorHeader(&reader, &is_double);
+        iter2->second.Resize(size, kUndefined);
+        ReadGaussVectorData(&reader, size, is_double, iter2->second.Data());
+      }
+    }
+    return;
+  }
+  int32_t sz;
+  ReadBasicType(is, binary, &sz);
+  if (sz < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
+  post->resize(sz);
+  for (GaussPost::iterator iter = post->begin(); iter != post->end(); ++iter) {
+    int32_t sz2;
+    ReadBasicType(is, binary, &sz2);
+    if (sz2 < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
+    iter->resize(sz2);
+    for (std::vector<std::pair<int32_t, Vector<float>>>::iterator iter2 =
+             iter->begin();
+         iter2 != iter->end(); iter2++) {
+      ReadBasicType(is, binary, &(iter2->first));
+      iter2->second.Read(is, binary);
+    }
+  }
+}
+
+void FlatGaussPost::CopyFromGaussPost(const GaussPost &post) {
+  offsets_.resize(post.size() + 1);
+  offsets_[0] = 0;
+  ids_.clear();
+  weight_offsets_.assign(1, 0);
+  weights_.clear();
+  for (size_t t = 0; t < post.size(); t++) {
+    for (size_t i = 0; i < post[t].size(); i++) {
+      const Vector<float> &weights = post[t][i].second;
+      ids_.push_back(post[t][i].first);
+      weights_.insert(weights_.end(), weights.Data(),
+                      weights.Data() + weights.Dim());
+      KALDIIO_ASSERT(weights_.size() <=
+                     static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+      weight_offsets_.push_back(static_cast<int32_t>(weights_.size()));
+    }
+    KALDIIO_ASSERT(ids_.size() <=
+                   static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+    offsets_[t + 1] = static_cast<int32_t>(ids_.size());
+  }
+}
+
+void FlatGaussPost::CopyToGaussPost(GaussPost *post) const {
+  post->resize(NumFrames());
+  for (int32_t t = 0; t < NumFrames(); t++) {
+    std::vector<std::pair<int32_t, Vector<float>>> &frame = (*post)[t];
+    frame.resize(offsets_[t + 1] - offsets_[t]);
+    for (int32_t k = offsets_[t]; k < offsets_[t + 1]; k++) {
+      std::pair<int32_t, Vector<float>> &pair = frame[k - offsets_[t]];
+      pair.first = ids_[k];
+      pair.second.Resize(weight_offsets_[k + 1] - weight_offsets_[k],
+                         kUndefined);
+      std::copy(weights_.begin() + weight_offsets_[k],
+                weights_.begin() + weight_offsets_[k + 1], pair.second.Data());
+    }
+  }
+}
+
+void FlatGaussPost::Read(std::istream &is, bool binary) {
+  if (!binary) {
+    GaussPost post;
+    ReadGaussPost(is, binary, &post);
+    CopyFromGaussPost(post);
+    return;
+  }
+  BinaryBasicTypeReader reader(is);
+  int32_t sz = ReadNumFrames(&reader);
+  offsets_.resize(sz + 1);
+  offsets_[0] = 0;
+  ids_.clear();
+  weight_offsets_.assign(1, 0);
+  weights_.clear();
+  for (int32_t t = 0; t < sz; t++) {
+    int32_t sz2 = ReadGaussFrameSize(&reader);
+    if (ids_.size() + sz2 >
+        static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+      KALDIIO_ERR << "Reading posteriors: too many elements";
+    for (int32_t i = 0; i < sz2; i++) {
+      int32_t id;
+      reader.Read(&id);
+      ids_.push_back(id);
+      bool is_double;
+      int32_t size = ReadGaussVectorHeader(&reader, &is_double);
+      size_t begin = weights_.size();
+      if (begin + size >
+          static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        KALDIIO_ERR << "Reading posteriors: too many elements";
+      weights_.resize(begin + size);
+      ReadGaussVectorData(&reader, size, is_double, weights_.data() + begin);
+      weight_offsets_.push_back(static_cast<int32_t>(begin + size));
+    }
+    offsets_[t + 1] = static_cast<int32_t>(ids_.size());
+  }
+}
+
+void FlatGaussPost::Write(std::ostream &os, bool binary) const {
+  // The same format as GaussPostHolder::Write().
+  WriteBasicType(os, binary, NumFrames());
+  for (int32_t t = 0; t < NumFrames(); t++) {
+    WriteBasicType(os, binary, offsets_[t + 1] - offsets_[t]);
+    for (int32_t k = offsets_[t]; k < offsets_[t + 1]; k++) {
+      WriteBasicType(os, binary, ids_[k]);
+      SubVector<float>(weights_.data() + weight_offsets_[k],
+                       weight_offsets_[k + 1] - weight_offsets_[k])
+          .Write(os, binary);
+    }
+  }
+  if (!binary) os << '\n';
+  if (!os.good()) KALDIIO_ERR << "Output stream error writing posteriors.";
+}
+
 // static
 bool PosteriorHolder::Write(std::ostream &os, bool binary, const T &t) {
   InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
@@ -184,22 +470,7 @@ bool GaussPostHolder::Read(std::istream &is) {
     return false;
   }
   try {
-    int32_t sz;
-    ReadBasicType(is, is_binary, &sz);
-    if (sz < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
-    t_.resize(sz);
-    for (GaussPost::iterator iter = t_.begin(); iter != t_.end(); ++iter) {
-      int32_t sz2;
-      ReadBasicType(is, is_binary, &sz2);
-      if (sz2 < 0) KALDIIO_ERR << "Reading posteriors: got negative size";
-      iter->resize(sz2);
-      for (std::vector<std::pair<int32_t, Vector<float>>>::iterator iter2 =
-               iter->begin();
-           iter2 != iter->end(); iter2++) {
-        ReadBasicType(is, is_binary, &(iter2->first));
-        iter2->second.Read(is, is_binary);
-      }
-    }
+    ReadGaussPost(is, is_binary, &t_);
     return true;
   } catch (std::exception &e) {
     KALDIIO_WARN << "Exception caught reading table of posteriors. "
@@ -10,10 +10,14 @@
 #ifndef KALDI_NATIVE_IO_CSRC_POSTERIOR_H_
 #define KALDI_NATIVE_IO_CSRC_POSTERIOR_H_
 
+#include <cstddef>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "kaldi_native_io/csrc/kaldi-holder.h"
 #include "kaldi_native_io/csrc/kaldi-vector.h"
 #include "kaldi_native_io/csrc/log.h"
 
@@ -33,6 +37,69 @@ typedef std::vector<std::vector<std::pair<int32_t, float>>> Posterior;
 /// un-noticed in downstream code.
 typedef std::vector<std::vector<std::pair<int32_t, Vector<float>>>> GaussPost;
 
+/// FlatPosterior holds the same data as Posterior in three flat arrays, in the
+/// compressed sparse row (CSR) layout: the pairs of frame t are
+/// (Ids()[k], Weights()[k]) for k in [Offsets()[t], Offsets()[t + 1]).  It
+/// is read and written in the same format as Posterior, with a few
+/// allocations in all instead of one per frame, and none when it is read into
+/// one that has room for the data already (see IsReusableForRead).
+class FlatPosterior {
+ public:
+  FlatPosterior() : offsets_(1, 0) {}
+
+  explicit FlatPosterior(const Posterior &post) { CopyFromPosterior(post); }
+
+  int32_t NumFrames() const {
+    return static_cast<int32_t>(offsets_.size()) - 1;
+  }
+
+  /// The total number of pairs.
+  int32_t NumElements() const { return offsets_.back(); }
+
+  /// Has NumFrames() + 1 elements, the first one 0 and the last one
+  /// NumElements().
+  const std::vector<int32_t> &Offsets() const { return offsets_; }
+
+  /// The transition-ids (or pdf-ids); has NumElements() elements.
+  const std::vector<int32_t> &Ids() const { return ids_; }
+
+  /// The weights, e.g. probabilities; has NumElements() elements.
+  const std::vector<float> &Weights() const { return weights_; }
+
+  void CopyFromPosterior(const Posterior &post);
+
+  void CopyToPosterior(Posterior *post) const;
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Swap(FlatPosterior *other) {
+    offsets_.swap(other->offsets_);
+    ids_.swap(other->ids_);
+    weights_.swap(other->weights_);
+  }
+
+ private:
+  std::vector<int32_t> offsets_;
+  std::vector<int32_t> ids_;
+  std::vector<float> weights_;
+};
+
+// Returns the number of bytes of memory used by post; see MemoryUsage() in
+// stl-utils.h.
+inline size_t MemoryUsage(const FlatPosterior &post) {
+  return sizeof(post) +
+         (post.Offsets().capacity() + post.Ids().capacity()) *
+             sizeof(int32_t) +
+         post.Weights().capacity() * sizeof(float);
+}
+
+template <>
+struct IsReusableForRead<FlatPosterior> : public std::true_type {};
+
+typedef KaldiObjectHolder<FlatPosterior> FlatPosteriorHolder;
+
 // PosteriorHolder is a holder for Posterior, which is
 // std::vector<std::vector<std::pair<int32_t, float>>>
 // This is used for storing posteriors of transition id's for an
@@ -68,6 +135,10 @@ class PosteriorHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(PosteriorHolder)
   T t_;
@@ -108,11 +179,85 @@ class GaussPostHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   KALDIIO_DISALLOW_COPY_AND_ASSIGN(GaussPostHolder)
   T t_;
 };
 
+/// FlatGaussPost holds the same data as GaussPost in four flat arrays, in the
+/// CSR layout twice over: the pairs of frame t are those with index k in
+/// [Offsets()[t], Offsets()[t + 1]), and the Gaussian posteriors of pair k are
+/// Weights()[j] for j in [WeightOffsets()[k], WeightOffsets()[k + 1]).  It is
+/// read and written in the same format as GaussPost, without the one Vector
+/// per pair that GaussPostHolder allocates.
+class FlatGaussPost {
+ public:
+  FlatGaussPost() : offsets_(1, 0), weight_offsets_(1, 0) {}
+
+  explicit FlatGaussPost(const GaussPost &post) { CopyFromGaussPost(post); }
+
+  int32_t NumFrames() const {
+    return static_cast<int32_t>(offsets_.size()) - 1;
+  }
+
+  /// The total number of pairs.
+  int32_t NumPairs() const { return offsets_.back(); }
+
+  /// Has NumFrames() + 1 elements, the first one 0 and the last one
+  /// NumPairs().
+  const std::vector<int32_t> &Offsets() const { return offsets_; }
+
+  /// The pdf-ids of the pairs; has NumPairs() elements.
+  const std::vector<int32_t> &Ids() const { return ids_; }
+
+  /// Has NumPairs() + 1 elements, the first one 0 and the last one
+  /// Weights().size().
+  const std::vector<int32_t> &WeightOffsets() const { return weight_offsets_; }
+
+  /// The Gaussian posteriors of all the pairs, one after the other.
+  const std::vector<float> &Weights() const { return weights_; }
+
+  void CopyFromGaussPost(const GaussPost &post);
+
+  void CopyToGaussPost(GaussPost *post) const;
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Swap(FlatGaussPost *other) {
+    offsets_.swap(other->offsets_);
+    ids_.swap(other->ids_);
+    weight_offsets_.swap(other->weight_offsets_);
+    weights_.swap(other->weights_);
+  }
+
+ private:
+  std::vector<int32_t> offsets_;
+  std::vector<int32_t> ids_;
+  std::vector<int32_t> weight_offsets_;
+  std::vector<float> weights_;
+};
+
+// Returns the number of bytes of memory used by post; see MemoryUsage() in
+// stl-utils.h.
+inline size_t MemoryUsage(const FlatGaussPost &post) {
+  return sizeof(post) +
+         (post.Offsets().capacity() + post.Ids().capacity() +
+          post.WeightOffsets().capacity()) *
+             sizeof(int32_t) +
+         post.Weights().capacity() * sizeof(float);
+}
+
+template <>
+struct IsReusableForRead<FlatGaussPost> : public std::true_type {};
+
+typedef KaldiObjectHolder<FlatGaussPost> FlatGaussPostHolder;
+
 }  // namespace kaldiio
 
 #endif  // KALDI_NATIVE_IO_CSRC_POSTERIOR_H_
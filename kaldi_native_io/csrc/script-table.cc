@@ -0,0 +1,438 @@
+// kaldi_native_io/csrc/script-table.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/script-table.h"
+
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kaldi_native_io/csrc/kaldi-holder.h"
+#include "kaldi_native_io/csrc/kaldi-io.h"
+#include "kaldi_native_io/csrc/text-utils.h"
+
+namespace kaldiio {
+
+// Compiled scp file format.  The file is the header below followed by the
+// arrays entries_ (num_entries elements), files_ (num_files elements),
+// slots_ (num_slots elements) and strings_ (strings_size bytes), with no
+// padding, all in the byte order of the machine that wrote it.  The magic
+// string starts with the binary-mode header "\0B", so that it is rejected
+// if read as a text scp file.
+namespace {
+
+const char kCompiledMagic[8] = {'\0', 'B', '<', 'B', 'S', 'C', 'P', '>'};
+const uint32_t kCompiledVersion = 1;
+const uint32_t kCompiledByteOrder = 0x01020304;
+const uint32_t kCompiledSortedFlag = 1;  // The keys are sorted.
+
+struct CompiledHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;  // kCompiledByteOrder in the byte order of the file.
+  uint32_t flags;
+  uint32_t unused;
+  uint64_t num_entries;
+  uint64_t num_files;
+  uint64_t num_slots;
+  uint64_t strings_size;
+};
+
+}  // namespace
+
+ScriptTable::ScriptTable() { Clear(); }
+
+bool ScriptTable::Read(const std::string &rxfilename, bool check_sorted) {
+  Clear();
+  bool is_binary;
+  Input input;
+  if (!input.Open(rxfilename, &is_binary)) {
+    KALDIIO_WARN << "Error opening script file: "
+                 << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  if (is_binary) {
+    KALDIIO_WARN << "Error: script file appears to be binary: "
+                 << PrintableRxfilename(rxfilename);
+    return false;
+  }
+
+  std::istream &is = input.Stream();
+  std::string line, key, rest, prev_key;
+  int line_number = 0;
+  bool ans = true;
+  while (ans && getline(is, line)) {
+    line_number++;
+    if (line.empty()) {
+      KALDIIO_WARN << "Empty " << line_number << "'th line in script file";
+      ans = false;
+      break;
+    }
+    SplitStringOnFirstSpace(line, &key, &rest);
+    if (key.empty() || rest.empty()) {
+      KALDIIO_WARN << "Invalid " << line_number << "'th line in script file"
+                   << ":\"" << line << '"';
+      ans = false;
+      break;
+    }
+    if (line_number > 1 && key.compare(prev_key) <= 0) {
+      is_sorted_ = false;
+      if (check_sorted) {
+        KALDIIO_WARN << "Script file " << PrintableRxfilename(rxfilename)
+                     << (key == prev_key
+                             ? " contains duplicate key: "
+                             : " is not sorted (remove s, option or add ns, "
+                               "option): key is ")
+                     << key;
+        ans = false;
+        break;
+      }
+    }
+    if (!AddLine(key, rest)) {
+      KALDIIO_WARN << "Invalid range in " << line_number
+                   << "'th line in script file:\"" << line << '"';
+      ans = false;
+      break;
+    }
+    prev_key.swap(key);
+  }
+  // file_index_ is only needed while reading.
+  std::unordered_map<std::string, uint32_t, StringHasher>().swap(file_index_);
+  if (ans && !BuildIndex()) ans = false;
+  if (!ans) {
+    KALDIIO_WARN << "[script file was: " << PrintableRxfilename(rxfilename)
+                 << "]";
+    Clear();
+    return false;
+  }
+  // Give back the memory that the vectors reserved for growth.
+  std::string(string_storage_).swap(string_storage_);
+  std::vector<Entry>(entry_storage_).swap(entry_storage_);
+  UseStorage();
+  return true;
+}
+
+bool ScriptTable::ReadCompiled(const std::string &filename,
+                               bool check_sorted) {
+  Clear();
+  const char *data;
+  size_t size;
+#ifndef _MSC_VER
+  if (!mapped_file_.Open(filename)) return false;
+  data = mapped_file_.Data();
+  size = mapped_file_.Size();
+#else
+  {
+    std::ifstream is(filename, std::ios::binary);
+    if (is) {
+      is.seekg(0, std::ios::end);
+      file_buffer_.resize(static_cast<size_t>(is.tellg()));
+      is.seekg(0, std::ios::beg);
+      is.read(file_buffer_.data(), file_buffer_.size());
+    }
+    if (!is) {
+      KALDIIO_WARN << "Failed to read " << filename;
+      Clear();
+      return false;
+    }
+  }
+  data = file_buffer_.data();
+  size = file_buffer_.size();
+#endif
+
+  CompiledHeader header;
+  if (size >= sizeof(header)) memcpy(&header, data, sizeof(header));
+  if (size < sizeof(header) ||
+      memcmp(header.magic, kCompiledMagic, sizeof(kCompiledMagic)) != 0) {
+    KALDIIO_WARN << "Not a compiled scp file: " << filename;
+    Clear();
+    return false;
+  }
+  if (header.byte_order != kCompiledByteOrder ||
+      header.version != kCompiledVersion) {
+    KALDIIO_WARN << "Compiled scp file " << filename
+                 << (header.byte_order != kCompiledByteOrder
+                         ? " was written on a machine with a different "
+                           "byte order"
+                         : " has an unsupported version")
+                 << "; please compile it again.";
+    Clear();
+    return false;
+  }
+  // Check that the sizes of the arrays add up to the size of the file.
+  uint64_t remaining = size - sizeof(header);
+  bool ok = header.num_entries <= remaining / sizeof(Entry);
+  if (ok) {
+    remaining -= header.num_entries * sizeof(Entry);
+    ok = header.num_files <= remaining / sizeof(File);
+  }
+  if (ok) {
+    remaining -= header.num_files * sizeof(File);
+    ok = header.num_slots <= remaining / sizeof(uint32_t);
+  }
+  if (ok) {
+    remaining -= header.num_slots * sizeof(uint32_t);
+    ok = header.strings_size == remaining &&
+         (header.num_slots & (header.num_slots - 1)) == 0 &&
+         header.num_slots > header.num_entries;
+  }
+  if (!ok) {
+    KALDIIO_WARN << "Compiled scp file " << filename
+                 << " is truncated or corrupted.";
+    Clear();
+    return false;
+  }
+  is_sorted_ = (header.flags & kCompiledSortedFlag) != 0;
+  if (check_sorted && !is_sorted_) {
+    KALDIIO_WARN << "Compiled scp file " << filename
+                 << " is not sorted (remove s, option or add ns, option)";
+    Clear();
+    return false;
+  }
+  const char *p = data + sizeof(header);
+  entries_ = reinterpret_cast<const Entry *>(p);
+  num_entries_ = header.num_entries;
+  p += num_entries_ * sizeof(Entry);
+  files_ = reinterpret_cast<const File *>(p);
+  num_files_ = header.num_files;
+  p += num_files_ * sizeof(File);
+  slots_ = reinterpret_cast<const uint32_t *>(p);
+  num_slots_ = header.num_slots;
+  p += num_slots_ * sizeof(uint32_t);
+  strings_ = p;
+  strings_size_ = header.strings_size;
+  return true;
+}
+
+bool ScriptTable::WriteCompiled(const std::string &wxfilename) const {
+  CompiledHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCompiledMagic, sizeof(kCompiledMagic));
+  header.version = kCompiledVersion;
+  header.byte_order = kCompiledByteOrder;
+  header.flags = (is_sorted_ ? kCompiledSortedFlag : 0);
+  header.num_entries = num_entries_;
+  header.num_files = num_files_;
+  header.num_slots = num_slots_;
+  header.strings_size = strings_size_;
+
+  Output output;
+  if (!output.Open(wxfilename, true, false)) {  // binary, no header.
+    KALDIIO_WARN << "Failed to open " << PrintableWxfilename(wxfilename);
+    return false;
+  }
+  std::ostream &os = output.Stream();
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (num_entries_ != 0)
+    os.write(reinterpret_cast<const char *>(entries_),
+             num_entries_ * sizeof(Entry));
+  if (num_files_ != 0)
+    os.write(reinterpret_cast<const char *>(files_),
+             num_files_ * sizeof(File));
+  if (num_slots_ != 0)
+    os.write(reinterpret_cast<const char *>(slots_),
+             num_slots_ * sizeof(uint32_t));
+  if (strings_size_ != 0) os.write(strings_, strings_size_);
+  if (!os.good() || !output.Close()) {
+    KALDIIO_WARN << "Failed to write compiled scp file "
+                 << PrintableWxfilename(wxfilename);
+    return false;
+  }
+  return true;
+}
+
+void ScriptTable::Clear() {
+  strings_ = NULL;
+  strings_size_ = 0;
+  entries_ = NULL;
+  num_entries_ = 0;
+  files_ = NULL;
+  num_files_ = 0;
+  slots_ = NULL;
+  num_slots_ = 0;
+  is_sorted_ = true;
+  std::string().swap(string_storage_);
+  std::vector<Entry>().swap(entry_storage_);
+  std::vector<File>().swap(file_storage_);
+  std::vector<uint32_t>().swap(slot_storage_);
+  std::unordered_map<std::string, uint32_t, StringHasher>().swap(file_index_);
+  mapped_file_.Close();
+  std::vector<char>().swap(file_buffer_);
+}
+
+bool ScriptTable::AddLine(const std::string &key, const std::string &rest) {
+  std::string rxfilename, range;
+  if (rest[rest.size() - 1] == ']') {
+    if (!ExtractRangeSpecifier(rest, &rxfilename, &range)) return false;
+  } else {
+    rxfilename = rest;
+  }
+
+  Entry entry;
+  memset(&entry, 0, sizeof(entry));
+  std::string filename;
+  size_t pos = rxfilename.find_last_of(':');
+  if (ClassifyRxfilename(rxfilename) == kOffsetFileInput &&
+      ConvertStringToInteger(rxfilename.substr(pos + 1), &entry.offset)) {
+    filename = rxfilename.substr(0, pos);
+  } else {
+    filename = rxfilename;
+    entry.offset = -1;
+  }
+
+  uint32_t file;
+  const File *last_file =
+      (entry_storage_.empty() ? NULL
+                              : &file_storage_[entry_storage_.back().file]);
+  if (last_file != NULL && last_file->size == filename.size() &&
+      string_storage_.compare(last_file->begin, last_file->size, filename) ==
+          0) {
+    file = entry_storage_.back().file;  // The usual case: same file as last
+                                        // line.
+  } else {
+    std::pair<std::unordered_map<std::string, uint32_t, StringHasher>::iterator,
+              bool>
+        pr = file_index_.insert(std::make_pair(filename, file_storage_.size()));
+    if (pr.second) {
+      File f;
+      f.begin = string_storage_.size();
+      f.size = filename.size();
+      string_storage_.append(filename);
+      file_storage_.push_back(f);
+    }
+    file = pr.first->second;
+  }
+  entry.file = file;
+  entry.key_begin = string_storage_.size();
+  entry.key_size = key.size();
+  string_storage_.append(key);
+  entry.range_begin = string_storage_.size();
+  entry.range_size = range.size();
+  string_storage_.append(range);
+  entry_storage_.push_back(entry);
+  return true;
+}
+
+void ScriptTable::UseStorage() {
+  strings_ = string_storage_.data();
+  strings_size_ = string_storage_.size();
+  entries_ = entry_storage_.data();
+  num_entries_ = entry_storage_.size();
+  files_ = file_storage_.data();
+  num_files_ = file_storage_.size();
+  slots_ = slot_storage_.data();
+  num_slots_ = slot_storage_.size();
+}
+
+uint64_t ScriptTable::Hash(const char *data, size_t size) {
+  // FNV-1a.  Note: this is part of the compiled file format.
+  uint64_t ans = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    ans ^= static_cast<unsigned char>(data[i]);
+    ans *= 1099511628211ULL;
+  }
+  return ans;
+}
+
+const ScriptTable::Entry &ScriptTable::GetEntry(size_t index) const {
+  KALDIIO_ASSERT(index < num_entries_);
+  const Entry &entry = entries_[index];
+  if (entry.key_begin > strings_size_ ||
+      entry.key_size > strings_size_ - entry.key_begin ||
+      entry.range_begin > strings_size_ ||
+      entry.range_size > strings_size_ - entry.range_begin ||
+      entry.file >= num_files_ || files_[entry.file].begin > strings_size_ ||
+      files_[entry.file].size > strings_size_ - files_[entry.file].begin)
+    KALDIIO_ERR << "Corrupted compiled scp file: invalid entry " << index;
+  return entry;
+}
+
+bool ScriptTable::KeyEquals(const Entry &entry, const char *key,
+                            size_t size) const {
+  return entry.key_size == size &&
+         memcmp(strings_ + entry.key_begin, key, size) == 0;
+}
+
+bool ScriptTable::BuildIndex() {
+  size_t num_slots = 1;
+  while (num_slots < 2 * entry_storage_.size()) num_slots *= 2;
+  slot_storage_.assign(num_slots, 0);
+  const size_t mask = num_slots - 1;
+  const char *strings = string_storage_.data();
+  for (size_t i = 0; i < entry_storage_.size(); i++) {
+    const Entry &entry = entry_storage_[i];
+    const char *key = strings + entry.key_begin;
+    size_t s = Hash(key, entry.key_size) & mask;
+    while (slot_storage_[s] != 0) {
+      const Entry &other = entry_storage_[slot_storage_[s] - 1];
+      if (other.key_size == entry.key_size &&
+          memcmp(strings + other.key_begin, key, entry.key_size) == 0) {
+        KALDIIO_WARN << "Script file contains duplicate key: "
+                     << std::string(key, entry.key_size);
+        return false;
+      }
+      s = (s + 1) & mask;
+    }
+    slot_storage_[s] = i + 1;
+  }
+  return true;
+}
+
+bool ScriptTable::Find(const std::string &key, size_t *index) const {
+  if (num_slots_ == 0) return false;
+  const size_t mask = num_slots_ - 1;
+  size_t s = Hash(key.data(), key.size()) & mask;
+  // The table always has empty slots, but we bound the number of probes in
+  // case a compiled file is corrupted.
+  for (size_t n = 0; n < num_slots_ && slots_[s] != 0; n++) {
+    if (slots_[s] > num_entries_)
+      KALDIIO_ERR << "Corrupted compiled scp file: invalid slot " << s;
+    if (KeyEquals(GetEntry(slots_[s] - 1), key.data(), key.size())) {
+      *index = slots_[s] - 1;
+      return true;
+    }
+    s = (s + 1) & mask;
+  }
+  return false;
+}
+
+std::string ScriptTable::Key(size_t index) const {
+  const Entry &entry = GetEntry(index);
+  return std::string(strings_ + entry.key_begin, entry.key_size);
+}
+
+std::string ScriptTable::Rxfilename(size_t index) const {
+  const Entry &entry = GetEntry(index);
+  if (entry.offset < 0) return Filename(index);
+  std::ostringstream os;
+  os << Filename(index) << ':' << entry.offset;
+  return os.str();
+}
+
+std::string ScriptTable::Range(size_t index) const {
+  const Entry &entry = GetEntry(index);
+  return std::string(strings_ + entry.range_begin, entry.range_size);
+}
+
+std::string ScriptTable::Filename(size_t index) const {
+  const File &file = files_[GetEntry(index).file];
+  return std::string(strings_ + file.begin, file.size);
+}
+
+int64_t ScriptTable::Offset(size_t index) const {
+  return GetEntry(index).offset;
+}
+
+bool CompileScriptFile(const std::string &scp_rxfilename,
+                       const std::string &wxfilename) {
+  ScriptTable table;
+  return table.Read(scp_rxfilename, false) && table.WriteCompiled(wxfilename);
+}
+
+}  // namespace kaldiio
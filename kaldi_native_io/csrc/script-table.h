@@ -0,0 +1,154 @@
+// kaldi_native_io/csrc/script-table.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_SCRIPT_TABLE_H_
+#define KALDI_NATIVE_IO_CSRC_SCRIPT_TABLE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kaldi_native_io/csrc/log.h"
+#include "kaldi_native_io/csrc/mapped-file.h"
+#include "kaldi_native_io/csrc/stl-utils.h"
+
+namespace kaldiio {
+
+// ScriptTable holds the contents of an scp file in a compact form, for
+// looking up keys in RandomAccessTableReader.  Instead of a pair of
+// std::string objects per line, all the keys, filenames and ranges are stored
+// in one string, each distinct filename is stored once, lines of the form
+// "key foo.ark:1234[0:9]" are split into (filename, offset, range) when the
+// file is read, and keys are looked up with an open-addressing hash table.
+// For scp files with millions of lines this uses a fraction of the memory and
+// no per-line heap allocations, and lookups take constant time.
+//
+// The table can also be written to a "compiled" scp file (see
+// WriteCompiled()), which is these arrays as they are in memory.  Such a file
+// is loaded by memory-mapping it (see ReadCompiled()), so that opening even a
+// very large table takes no time and its pages are shared by all the
+// processes that read it.  Compiled scp files are read with the "bscp:"
+// rspecifier type, e.g. "bscp:foo.bscp"; see kaldi-table.h.
+class ScriptTable {
+ public:
+  ScriptTable();
+
+  // Reads the scp file 'rxfilename', replacing any previous contents.
+  // Returns false (after printing a warning) if it cannot be read, if a line
+  // is invalid or has an invalid range, or if a key is duplicated; and, if
+  // check_sorted == true, if the keys are not in sorted order.
+  bool Read(const std::string &rxfilename, bool check_sorted);
+
+  // Memory-maps the compiled scp file 'filename' (an actual filename, not an
+  // rxfilename), replacing any previous contents.  Returns false (after
+  // printing a warning) if it cannot be read or is not a valid compiled scp
+  // file.  If check_sorted == true, also returns false if the keys were not
+  // in sorted order in the scp file it was compiled from.
+  bool ReadCompiled(const std::string &filename, bool check_sorted);
+
+  // Writes the table as a compiled scp file to 'wxfilename'.  Returns false
+  // (after printing a warning) on error.
+  bool WriteCompiled(const std::string &wxfilename) const;
+
+  void Clear();
+
+  // Returns the number of lines (keys).
+  size_t Size() const { return num_entries_; }
+
+  // Returns true if the keys are in sorted order (without duplicates).
+  bool IsSorted() const { return is_sorted_; }
+
+  // Looks up 'key'; if found, sets *index to its line number (counting from
+  // 0) and returns true.
+  bool Find(const std::string &key, size_t *index) const;
+
+  std::string Key(size_t index) const;
+
+  // Returns the rxfilename of line 'index' without its range, e.g.
+  // "foo.ark:1234".
+  std::string Rxfilename(size_t index) const;
+
+  // Returns the range of line 'index' (e.g. "0:9"), or "" if it has none.
+  std::string Range(size_t index) const;
+
+  // Returns the filename of line 'index' (e.g. "foo.ark"), or, if the
+  // rxfilename is not of the form "foo.ark:1234", the whole rxfilename.
+  std::string Filename(size_t index) const;
+
+  // Returns the byte offset of line 'index' (e.g. 1234), or -1 if the
+  // rxfilename is not of the form "foo.ark:1234".
+  int64_t Offset(size_t index) const;
+
+ private:
+  // The layout of these structs is part of the compiled file format.
+  struct Entry {
+    uint64_t key_begin;    // Position of the key in strings_.
+    uint64_t range_begin;  // Position of the range in strings_.
+    int64_t offset;        // See Offset().
+    uint32_t key_size;
+    uint32_t range_size;   // 0 if there is no range.
+    uint32_t file;         // Index into files_.
+    uint32_t unused;       // Always 0.
+  };
+
+  struct File {
+    uint64_t begin;  // Position of the filename in strings_.
+    uint64_t size;
+  };
+
+  // Adds one line of the scp file, with the key and the rest of the line
+  // already separated.  Returns false if the range is invalid.
+  bool AddLine(const std::string &key, const std::string &rest);
+
+  // Builds slot_storage_.  Returns false if there is a duplicate key.
+  bool BuildIndex();
+
+  // Points the arrays below at the *_storage_ members.
+  void UseStorage();
+
+  // Returns entries_[index], checking that it is valid (a compiled file
+  // could be corrupted).
+  const Entry &GetEntry(size_t index) const;
+
+  static uint64_t Hash(const char *data, size_t size);
+
+  bool KeyEquals(const Entry &entry, const char *key, size_t size) const;
+
+  // The table.  These point either into the *_storage_ members or, for a
+  // compiled file, into mapped_file_.
+  const char *strings_;  // The keys, ranges and filenames, concatenated.
+  uint64_t strings_size_;
+  const Entry *entries_;  // One per line, in the order of the scp file.
+  uint64_t num_entries_;
+  const File *files_;  // The distinct filenames.
+  uint64_t num_files_;
+  const uint32_t *slots_;  // Hash table: 0 for an empty slot, else 1 + an
+                           // index into entries_.
+  uint64_t num_slots_;     // A power of 2, or 0 if the table is empty.
+  bool is_sorted_;
+
+  std::string string_storage_;
+  std::vector<Entry> entry_storage_;
+  std::vector<File> file_storage_;
+  std::vector<uint32_t> slot_storage_;
+  // Indexes file_storage_ by filename; only used while reading.
+  std::unordered_map<std::string, uint32_t, StringHasher> file_index_;
+
+  MappedFile mapped_file_;
+  std::vector<char> file_buffer_;  // The compiled file, where it cannot be
+                                   // memory-mapped.
+
+  KALDIIO_DISALLOW_COPY_AND_ASSIGN(ScriptTable)
+};
+
+// Reads the scp file 'scp_rxfilename' and writes it as a compiled scp file
+// to 'wxfilename'.  Returns true on success.
+bool CompileScriptFile(const std::string &scp_rxfilename,
+                       const std::string &wxfilename);
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_SCRIPT_TABLE_H_
@@ -8,6 +8,8 @@
 #ifndef KALDI_NATIVE_IO_CSRC_STL_UTILS_H_
 #define KALDI_NATIVE_IO_CSRC_STL_UTILS_H_
 #include <string>
+#include <utility>
+#include <vector>
 namespace kaldiio {
 
 /// A hashing function object for strings.
@@ -26,6 +28,38 @@ struct StringHasher {  // hashing function for std::string
   static const int kPrime = 7853;
 };
 
+/// MemoryUsage() returns an estimate of the number of bytes of memory used by
+/// an object, including what it owns on the heap; it is used by caches whose
+/// size is limited in bytes.  The default is sizeof(T); classes that own
+/// memory have overloads next to their definitions (e.g. for Matrix in
+/// kaldi-matrix.h).
+template <class T>
+size_t MemoryUsage(const T &) {
+  return sizeof(T);
+}
+
+inline size_t MemoryUsage(const std::string &str) {
+  return sizeof(str) + str.capacity();
+}
+
+template <class A, class B>
+size_t MemoryUsage(const std::pair<A, B> &pr);
+
+template <class T, class Alloc>
+size_t MemoryUsage(const std::vector<T, Alloc> &vec) {
+  size_t ans = sizeof(vec) + (vec.capacity() - vec.size()) * sizeof(T);
+  for (typename std::vector<T, Alloc>::const_iterator iter = vec.begin();
+       iter != vec.end(); ++iter)
+    ans += MemoryUsage(*iter);
+  return ans;
+}
+
+template <class A, class B>
+size_t MemoryUsage(const std::pair<A, B> &pr) {
+  return sizeof(pr) - sizeof(pr.first) - sizeof(pr.second) +
+         MemoryUsage(pr.first) + MemoryUsage(pr.second);
+}
+
 }  // namespace kaldiio
 
 #endif  // KALDI_NATIVE_IO_CSRC_STL_UTILS_H_
@@ -0,0 +1,258 @@
+// kaldi_native_io/csrc/text-scanner.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/text-scanner.h"
+
+#include <locale.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#include <xlocale.h>
+#endif
+
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+#define KALDIIO_HAVE_STRTOD_L
+#endif
+
+namespace kaldiio {
+
+namespace {
+
+inline bool IsDigit(int c) { return c >= '0' && c <= '9'; }
+
+// A decimal number, split into its parts: its value is
+// (negative ? -1 : 1) * mantissa * 10^exponent, except that if truncated is
+// true, digits were dropped from the end of the mantissa.
+struct DecimalNumber {
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int64_t exponent = 0;
+  bool truncated = false;
+};
+
+// Splits [begin, end) into its parts; returns false if it is not a valid
+// floating point number.
+bool ParseDecimal(const char *begin, const char *end, DecimalNumber *num) {
+  const char *p = begin;
+  if (p != end && (*p == '+' || *p == '-')) num->negative = (*p++ == '-');
+  // The mantissa keeps the first 19 significant digits, which always fit in
+  // 64 bits.
+  int32_t num_digits = 0;
+  bool found_digit = false;
+  for (; p != end && IsDigit(*p); ++p) {
+    found_digit = true;
+    int32_t d = *p - '0';
+    if (num_digits < 19) {
+      num->mantissa = num->mantissa * 10 + d;
+      if (num->mantissa != 0) num_digits++;
+    } else {
+      num->exponent++;
+      if (d != 0) num->truncated = true;
+    }
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && IsDigit(*p); ++p) {
+      found_digit = true;
+      int32_t d = *p - '0';
+      if (num_digits < 19) {
+        num->mantissa = num->mantissa * 10 + d;
+        num->exponent--;
+        if (num->mantissa != 0) num_digits++;
+      } else if (d != 0) {
+        num->truncated = true;
+      }
+    }
+  }
+  if (!found_digit) return false;
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exponent = false;
+    if (p != end && (*p == '+' || *p == '-'))
+      negative_exponent = (*p++ == '-');
+    if (p == end || !IsDigit(*p)) return false;
+    int64_t exponent = 0;
+    for (; p != end && IsDigit(*p); ++p) {
+      // Any larger exponent gives zero or infinity anyway.
+      if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+    }
+    num->exponent += negative_exponent ? -exponent : exponent;
+  }
+  return p == end;
+}
+
+const double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Computes the correctly rounded double value of num if that can be done
+// exactly with one floating point operation (Clinger's fast path): the
+// mantissa and the power of ten are then both exact doubles.
+bool FastPathToDouble(const DecimalNumber &num, double *d) {
+  if (num.truncated || num.mantissa > (static_cast<uint64_t>(1) << 53) ||
+      num.exponent < -22 || num.exponent > 22)
+    return false;
+  double value = static_cast<double>(num.mantissa);
+  if (num.exponent < 0)
+    value /= kPowersOfTen[-num.exponent];
+  else
+    value *= kPowersOfTen[num.exponent];
+  *d = num.negative ? -value : value;
+  return true;
+}
+
+// Plain strtod() is no use in the slow paths below: it uses the decimal point
+// of the global C locale, which a program (e.g. Python after
+// setlocale(LC_ALL, "")) may have set to one that is not '.'.
+
+// Converts str, a valid number, with stream extraction in the "C" locale;
+// returns false if it is too large for Real.
+template <class Real>
+bool ClassicStreamToReal(const std::string &str, Real *t) {
+  thread_local std::istringstream is;
+  thread_local bool imbued = false;
+  if (!imbued) {
+    is.imbue(std::locale::classic());
+    imbued = true;
+  }
+  is.clear();
+  is.str(str);
+  Real value;
+  is >> value;
+  if (is.fail() || is.peek() != std::char_traits<char>::eof() ||
+      std::isinf(value))
+    return false;
+  *t = value;
+  return true;
+}
+
+#ifdef KALDIIO_HAVE_STRTOD_L
+// Returns the "C" locale, or 0 if it could not be created.
+locale_t CLocale() {
+  static locale_t locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+  return locale;
+}
+#endif
+
+// Converts [begin, end), a valid number, the way stream extraction does in
+// the "C" locale, whatever the global locale is; returns false if it is too
+// large for Real.
+template <class Real>
+bool SlowPath(const char *begin, const char *end, Real *t) {
+  std::string str(begin, end);
+#ifdef KALDIIO_HAVE_STRTOD_L
+  locale_t locale = CLocale();
+  if (locale != (locale_t)0) {
+    char *str_end;
+    Real value = std::is_same<Real, float>::value
+                     ? strtof_l(str.c_str(), &str_end, locale)
+                     : strtod_l(str.c_str(), &str_end, locale);
+    if (str_end != str.c_str() + str.size() || std::isinf(value))
+      return false;
+    *t = value;
+    return true;
+  }
+#endif
+  return ClassicStreamToReal(str, t);
+}
+
+}  // namespace
+
+bool ParseNumber(const char *begin, const char *end, double *t) {
+  DecimalNumber num;
+  if (!ParseDecimal(begin, end, &num)) return false;
+  if (FastPathToDouble(num, t)) return true;
+  return SlowPath(begin, end, t);
+}
+
+bool ParseNumber(const char *begin, const char *end, float *t) {
+  DecimalNumber num;
+  if (!ParseDecimal(begin, end, &num)) return false;
+  double d;
+  // Values out of the range of normal floats are left to strtof().
+  if (FastPathToDouble(num, &d) &&
+      (d == 0 ||
+       (std::fabs(d) >= std::numeric_limits<float>::min() &&
+        std::fabs(d) <= std::numeric_limits<float>::max()))) {
+    // d is the correctly rounded double; rounding it to float gives the
+    // correctly rounded float unless d lies exactly halfway between two
+    // floats, i.e. the 29 bits a double has beyond a float are 100...0.
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(d));
+    const uint64_t low_bits = (static_cast<uint64_t>(1) << 29) - 1;
+    if ((bits & low_bits) != (static_cast<uint64_t>(1) << 28)) {
+      *t = static_cast<float>(d);
+      return true;
+    }
+  }
+  return SlowPath(begin, end, t);
+}
+
+namespace internal {
+
+bool ParseDecimalInteger(const char *begin, const char *end, bool *negative,
+                         uint64_t *magnitude) {
+  const char *p = begin;
+  *negative = false;
+  if (p != end && (*p == '+' || *p == '-')) *negative = (*p++ == '-');
+  if (p == end) return false;
+  uint64_t value = 0;
+  const uint64_t max = std::numeric_limits<uint64_t>::max();
+  for (; p != end; ++p) {
+    if (!IsDigit(*p)) return false;
+    uint64_t d = *p - '0';
+    if (value > (max - d) / 10) return false;
+    value = value * 10 + d;
+  }
+  *magnitude = value;
+  return true;
+}
+
+bool NumberChars::Scan(std::istream &is, bool floating) {
+  size_ = 0;
+  // Skips whitespace, and sets failbit if the stream is not good.
+  std::istream::sentry sentry(is);
+  if (!sentry) return false;
+  std::streambuf *sb = is.rdbuf();
+  // The characters operator>> accepts: a sign, then digits, with (for
+  // floating point) a decimal point, and an exponent after at least one
+  // digit, which may have a sign.
+  bool found_digit = false, found_point = false, found_exponent = false;
+  int c = sb->sgetc();
+  for (; c != std::char_traits<char>::eof(); c = sb->snextc()) {
+    if (IsDigit(c)) {
+      found_digit = true;
+    } else if (c == '+' || c == '-') {
+      if (size_ != 0) {
+        char prev = end()[-1];
+        if (!found_exponent || (prev != 'e' && prev != 'E')) break;
+      }
+    } else if (!floating) {
+      break;
+    } else if (c == '.') {
+      if (found_point || found_exponent) break;
+      found_point = true;
+    } else if (c == 'e' || c == 'E') {
+      if (found_exponent || !found_digit) break;
+      found_exponent = true;
+    } else {
+      break;
+    }
+    Append(static_cast<char>(c));
+  }
+  std::ios_base::iostate state = std::ios_base::goodbit;
+  if (c == std::char_traits<char>::eof()) state |= std::ios_base::eofbit;
+  if (size_ == 0) state |= std::ios_base::failbit;
+  if (state != std::ios_base::goodbit) is.setstate(state);
+  return size_ != 0;
+}
+
+}  // namespace internal
+
+}  // namespace kaldiio
@@ -0,0 +1,110 @@
+// kaldi_native_io/csrc/text-scanner.h
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#ifndef KALDI_NATIVE_IO_CSRC_TEXT_SCANNER_H_
+#define KALDI_NATIVE_IO_CSRC_TEXT_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace kaldiio {
+
+/// Parses the decimal number in [begin, end), e.g. "-12", "0.25" or
+/// "1.5e-07", the way "is >> *t" parses it in the "C" locale: the result is
+/// the correctly rounded value, and numbers too large for T are errors.
+/// Returns false, without setting *t, if [begin, end) is not a whole valid
+/// number.  Most numbers are parsed without calling strtod(), which makes
+/// this several times faster than stream extraction; the rest (e.g. 17-digit
+/// doubles) are parsed in the "C" locale too, whatever the global locale of
+/// the process is.
+bool ParseNumber(const char *begin, const char *end, float *t);
+bool ParseNumber(const char *begin, const char *end, double *t);
+
+namespace internal {
+
+// Parses an optionally signed decimal integer; returns false if it is not
+// one or its magnitude does not fit in 64 bits.
+bool ParseDecimalInteger(const char *begin, const char *end, bool *negative,
+                         uint64_t *magnitude);
+
+// The characters of a number read from a stream.  Short numbers, which are
+// nearly all of them, are kept in a fixed buffer.
+class NumberChars {
+ public:
+  NumberChars() : size_(0) {}
+
+  // Skips whitespace and reads the longest prefix of the stream that can
+  // start a number (an integer if !floating), like operator>> does, and sets
+  // eofbit and failbit like it does.  Returns false if there was nothing to
+  // read.
+  bool Scan(std::istream &is, bool floating);
+
+  const char *begin() const { return size_ <= kSize ? buf_ : long_.data(); }
+  const char *end() const { return begin() + size_; }
+
+ private:
+  void Append(char c) {
+    if (size_ < kSize) {
+      buf_[size_] = c;
+    } else {
+      if (size_ == kSize) long_.assign(buf_, kSize);
+      long_.push_back(c);
+    }
+    size_++;
+  }
+
+  static const size_t kSize = 64;
+  char buf_[kSize];
+  size_t size_;
+  std::string long_;  // Used instead of buf_ if size_ > kSize.
+};
+
+}  // namespace internal
+
+template <class Int>
+bool ParseNumber(const char *begin, const char *end, Int *t) {
+  static_assert(std::is_integral<Int>::value && !std::is_same<Int, bool>::value,
+                "");
+  bool negative;
+  uint64_t magnitude;
+  if (!internal::ParseDecimalInteger(begin, end, &negative, &magnitude))
+    return false;
+  const uint64_t max = std::numeric_limits<Int>::max();
+  if (std::is_signed<Int>::value) {
+    // The magnitude of the most negative value is max + 1.
+    if (magnitude > max + (negative ? 1 : 0)) return false;
+    *t = negative ? static_cast<Int>(-static_cast<int64_t>(magnitude - 1) - 1)
+                  : static_cast<Int>(magnitude);
+  } else {
+    // Like stream extraction, accept "-n" for unsigned types as the value
+    // of -n modulo 2^N.
+    if (magnitude > max) return false;
+    *t = static_cast<Int>(negative ? 0 - magnitude : magnitude);
+  }
+  return true;
+}
+
+/// ScanNumber() is a faster replacement for "is >> *t", for integer and
+/// floating point types T other than bool: it skips whitespace, reads the
+/// characters of the number straight from the stream's buffer and parses them
+/// with ParseNumber().  It consumes the same characters as operator>>, and
+/// sets failbit and eofbit like it does.  Returns !is.fail().
+template <class T>
+bool ScanNumber(std::istream &is, T *t) {
+  internal::NumberChars chars;
+  if (!chars.Scan(is, std::is_floating_point<T>::value)) return false;
+  if (!ParseNumber(chars.begin(), chars.end(), t)) {
+    is.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace kaldiio
+
+#endif  // KALDI_NATIVE_IO_CSRC_TEXT_SCANNER_H_
@@ -135,6 +135,12 @@ class WaveData {
   float samp_freq_;
 };
 
+// Returns the number of bytes of memory used by wave; see MemoryUsage() in
+// stl-utils.h.
+inline size_t MemoryUsage(const WaveData &wave) {
+  return sizeof(wave) - sizeof(wave.Data()) + MemoryUsage(wave.Data());
+}
+
 // Holder class for .wav files that enables us to read (but not write) .wav
 // files. c.f. util/kaldi-holder.h we don't use the KaldiObjectHolder template
 // because we don't want to check for the \0B binary header. We could have faked
@@ -191,6 +197,10 @@ class WaveHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   T t_;
 };
@@ -223,6 +233,10 @@ class WaveInfoHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   WaveInfo info_;
 };
@@ -157,6 +157,10 @@ class BlobHolder {
     return false;
   }
 
+  bool ReadRange(std::istream & /*is*/, const std::string & /*range*/) {
+    return false;
+  }
+
  private:
   py::bytes value_;
 
@@ -0,0 +1,37 @@
+// kaldi_native_io/python/csrc/compile-scp.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/kaldi-io.h"
+#include "kaldi_native_io/csrc/script-table.h"
+#include "kaldi_native_io/python/csrc/parse-options.h"
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Compile an scp file into a binary file that can be memory-mapped, "
+      "so that\n"
+      "opening it takes no time however large it is.  Read it with the "
+      "bscp:\n"
+      "rspecifier type, which supports the same options as scp:.\n"
+      "\n"
+      "Usage: compile-scp [options] <scp-rxfilename> <bscp-wxfilename>\n"
+      " e.g.: compile-scp feats.scp feats.bscp\n"
+      "   and then read it with e.g. \"bscp:feats.bscp\"\n";
+
+  kaldiio::ParseOptions po(usage);
+  po.Read(argc, argv);
+  if (po.NumArgs() != 2) {
+    po.PrintUsage();
+    exit(1);
+  }
+
+  std::string scp_rxfilename = po.GetArg(1);
+  std::string bscp_wxfilename = po.GetArg(2);
+
+  if (!kaldiio::CompileScriptFile(scp_rxfilename, bscp_wxfilename))
+    KALDIIO_ERR << "Failed to compile "
+                << kaldiio::PrintableRxfilename(scp_rxfilename);
+  KALDIIO_LOG << "Compiled " << kaldiio::PrintableRxfilename(scp_rxfilename)
+              << " to " << kaldiio::PrintableWxfilename(bscp_wxfilename);
+  return 0;
+}
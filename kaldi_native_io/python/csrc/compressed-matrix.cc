@@ -4,6 +4,11 @@
 
 #include "kaldi_native_io/csrc/compressed-matrix.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "kaldi_native_io/csrc/half-matrix.h"
 #include "kaldi_native_io/python/csrc/compressed-matrix.h"
 #include "kaldi_native_io/python/csrc/kaldi-matrix.h"
 
@@ -53,17 +58,125 @@ static void PybindCompressionMethod(py::module &m) {  // NOLINT
       .export_values();
 }
 
+// Returns true if 'dtype' is float16 and false if it is float32.
+static bool IsFloat16(const py::object &dtype) {
+  py::dtype d = py::dtype::from_args(dtype);
+  if (d.equal(py::dtype::of<float>())) return false;
+  if (d.equal(py::dtype::from_args(py::str("float16")))) return true;
+  KALDIIO_ERR << "Unsupported dtype " << std::string(py::str(d))
+              << ". Expect float32 or float16";
+  return false;
+}
+
+// Returns an uninitialized array with the given shape of float32, or of
+// float16 if 'half' is true.
+static py::array NewArray(const std::vector<py::ssize_t> &shape, bool half) {
+  if (half) return py::array(py::dtype::from_args(py::str("float16")), shape);
+  return py::array_t<float>(shape);
+}
+
+// Decompresses 'mats', which must have num_cols columns and at most max_rows
+// rows, into consecutive max_rows by num_cols blocks of 'data' (num_cols by
+// max_rows if 'transpose' is true), and sets the rest of each block to
+// 'padding'.
+template <typename T>
+static void CopyToPadded(const std::vector<const CompressedMatrix *> &mats,
+                         int32 max_rows, int32 num_cols, bool transpose,
+                         T padding, T *data) {
+  size_t size = static_cast<size_t>(max_rows) * num_cols;
+  for (const CompressedMatrix *mat : mats) {
+    int32 num_rows = mat->NumRows();
+    if (!transpose) {
+      mat->CopyToData(data, num_cols, kNoTrans);
+      std::fill(data + static_cast<size_t>(num_rows) * num_cols, data + size,
+                padding);
+    } else {
+      mat->CopyToData(data, max_rows, kTrans);
+      for (int32 c = 0; c < num_cols; c++)
+        std::fill(data + c * max_rows + num_rows, data + (c + 1) * max_rows,
+                  padding);
+    }
+    data += size;
+  }
+}
+
+static py::array PadCompressedMatrices(
+    const std::vector<const CompressedMatrix *> &mats, py::object dtype,
+    bool transpose, float padding_value) {
+  bool half = IsFloat16(dtype);
+  int32 max_rows = 0, num_cols = mats.empty() ? 0 : mats[0]->NumCols();
+  for (const CompressedMatrix *mat : mats) {
+    if (mat->NumCols() != num_cols)
+      KALDIIO_ERR << "All matrices should have the same number of columns. "
+                  << "Given " << mat->NumCols() << " vs " << num_cols;
+    max_rows = std::max(max_rows, mat->NumRows());
+  }
+  py::ssize_t num_mats = mats.size();
+  py::array ans =
+      transpose ? NewArray({num_mats, num_cols, max_rows}, half)
+                : NewArray({num_mats, max_rows, num_cols}, half);
+  void *data = ans.mutable_data();
+  {
+    py::gil_scoped_release release;
+    if (half)
+      CopyToPadded(mats, max_rows, num_cols, transpose,
+                   FloatToHalf(padding_value), static_cast<uint16 *>(data));
+    else
+      CopyToPadded(mats, max_rows, num_cols, transpose, padding_value,
+                   static_cast<float *>(data));
+  }
+  return ans;
+}
+
 void PybindCompressedMatrix(py::module &m) {  // NOLINT
   PybindCompressionMethod(m);
   {
     using PyClass = CompressedMatrix;
     py::class_<PyClass>(m, "_CompressedMatrix")
         .def(py::init<>())
-        .def(py::init<const Matrix<float> &, CompressionMethod>(),
-             py::arg("mat"), py::arg("method") = kAutomaticMethod)
-        .def(py::init<const Matrix<double> &, CompressionMethod>(),
-             py::arg("mat"), py::arg("method") = kAutomaticMethod);
+        .def(py::init<const PyClass &>(), py::arg("other"))
+        .def(py::init<const Matrix<float> &, CompressionMethod, int32>(),
+             py::arg("mat"), py::arg("method") = kAutomaticMethod,
+             py::arg("num_threads") = 1)
+        .def(py::init<const Matrix<double> &, CompressionMethod, int32>(),
+             py::arg("mat"), py::arg("method") = kAutomaticMethod,
+             py::arg("num_threads") = 1)
+        .def_property_readonly("shape",
+                               [](const PyClass &self) -> py::tuple {
+                                 return py::make_tuple(self.NumRows(),
+                                                       self.NumCols());
+                               })
+        .def(
+            "numpy",
+            [](const PyClass &self, py::object dtype,
+               bool transpose) -> py::array {
+              bool half = IsFloat16(dtype);
+              py::ssize_t num_rows = self.NumRows(),
+                          num_cols = self.NumCols();
+              py::array ans =
+                  transpose ? NewArray({num_cols, num_rows}, half)
+                            : NewArray({num_rows, num_cols}, half);
+              void *data = ans.mutable_data();
+              MatrixTransposeType trans = transpose ? kTrans : kNoTrans;
+              if (half) {
+                self.CopyToData(static_cast<uint16 *>(data),
+                                transpose ? num_rows : num_cols, trans);
+              } else {
+                int32 rows = transpose ? num_cols : num_rows,
+                      cols = transpose ? num_rows : num_cols;
+                SubMatrix<float> mat(static_cast<float *>(data), rows, cols,
+                                     cols);
+                self.CopyToMat(&mat, trans);
+              }
+              return ans;
+            },
+            py::arg("dtype") = py::dtype::of<float>(),
+            py::arg("transpose") = false);
   }
+
+  m.def("_pad_compressed_matrices", &PadCompressedMatrices, py::arg("mats"),
+        py::arg("dtype") = py::dtype::of<float>(),
+        py::arg("transpose") = false, py::arg("padding_value") = 0.0f);
 }
 
 }  // namespace kaldiio
@@ -0,0 +1,34 @@
+// kaldi_native_io/python/csrc/flat-vector-vector.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/flat-vector-vector.h"
+
+#include <string>
+#include <vector>
+
+#include "kaldi_native_io/python/csrc/flat-vector-vector.h"
+
+namespace kaldiio {
+
+template <typename BasicType>
+static void PybindFlatVectorVectorTpl(py::module &m,  // NOLINT
+                                      const std::string &class_name) {
+  using PyClass = FlatVectorVector<BasicType>;
+  py::class_<PyClass>(m, class_name.c_str())
+      .def(py::init<>())
+      .def(py::init<const std::vector<std::vector<BasicType>> &>(),
+           py::arg("v"))
+      .def_property_readonly("num_vectors", &PyClass::NumVectors)
+      .def("numpy", [](py::object obj) {
+        auto *v = obj.cast<PyClass *>();
+        return py::make_tuple(ToNumpy(v->Offsets(), obj),
+                              ToNumpy(v->Values(), obj));
+      });
+}
+
+void PybindFlatVectorVector(py::module &m) {  // NOLINT
+  PybindFlatVectorVectorTpl<int32_t>(m, "_FlatInt32VectorVector");
+}
+
+}  // namespace kaldiio
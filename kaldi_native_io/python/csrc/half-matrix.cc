@@ -0,0 +1,39 @@
+// kaldi_native_io/python/csrc/half-matrix.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/half-matrix.h"
+
+#include "kaldi_native_io/python/csrc/half-matrix.h"
+#include "kaldi_native_io/python/csrc/kaldi-matrix.h"
+
+namespace kaldiio {
+
+static void PybindHalfFormat(py::module &m) {  // NOLINT
+  py::enum_<HalfFormat>(
+      m, "HalfFormat", py::arithmetic(),
+      "The 16-bit floating point formats a matrix can be written in with "
+      "HalfMatrixWriter.")
+      .value("kFloat16", kFloat16,
+             "IEEE half precision: 11 bits of precision, but only values up "
+             "to 65504 in magnitude (larger ones become infinity).")
+      .value("kBFloat16", kBFloat16,
+             "bfloat16: only 8 bits of precision, but the same range as "
+             "float32.")
+      .export_values();
+}
+
+void PybindHalfMatrix(py::module &m) {  // NOLINT
+  PybindHalfFormat(m);
+  {
+    using PyClass = HalfMatrix;
+    py::class_<PyClass>(m, "_HalfMatrix")
+        .def(py::init<>())
+        .def(py::init<const Matrix<float> &, HalfFormat>(), py::arg("mat"),
+             py::arg("format") = kFloat16)
+        .def(py::init<const Matrix<double> &, HalfFormat>(), py::arg("mat"),
+             py::arg("format") = kFloat16);
+  }
+}
+
+}  // namespace kaldiio
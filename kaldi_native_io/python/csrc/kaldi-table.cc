@@ -7,12 +7,16 @@
 #include <string>
 
 #include "kaldi_native_io/csrc/compressed-matrix.h"
+#include "kaldi_native_io/csrc/flat-vector-vector.h"
+#include "kaldi_native_io/csrc/half-matrix.h"
 #include "kaldi_native_io/csrc/kaldi-holder.h"
 #include "kaldi_native_io/csrc/kaldi-io.h"
 #include "kaldi_native_io/csrc/kaldi-matrix.h"
 #include "kaldi_native_io/csrc/kaldi-vector.h"
 #include "kaldi_native_io/csrc/matrix-shape.h"
+#include "kaldi_native_io/csrc/memory-allocator.h"
 #include "kaldi_native_io/csrc/posterior.h"
+#include "kaldi_native_io/csrc/script-table.h"
 #include "kaldi_native_io/csrc/wave-reader.h"
 #include "kaldi_native_io/python/csrc/blob.h"
 #include "kaldi_native_io/python/csrc/kaldi-table.h"
@@ -30,7 +34,11 @@ void PybindTableWriter(py::module &m,  // NOLINT
       .def(py::init<const std::string &>(), py::arg("wspecifier"))
       .def("open", &PyClass::Open, py::arg("wspecifier"))
       .def_property_readonly("is_open", &PyClass::IsOpen)
-      .def("write", &PyClass::Write, py::arg("key"), py::arg("value"))
+      .def("write",
+           static_cast<void (PyClass::*)(const std::string &,
+                                         const typename Holder::T &) const>(
+               &PyClass::Write),
+           py::arg("key"), py::arg("value"))
       .def("flush", &PyClass::Flush)
       .def("close", &PyClass::Close);
 }
@@ -47,7 +55,39 @@ void PybindSequentialTableReader(py::module &m,  // NOLINT
       .def_property_readonly("done", &PyClass::Done)
       .def_property_readonly("key", &PyClass::Key)
       .def("free_current", &PyClass::FreeCurrent)
-      .def_property_readonly("value", &PyClass::Value)
+      // Return a copy: the reader reads the next value into the memory of
+      // the current one (see SetMaxRetainedObjectBytes()), and numpy arrays
+      // returned to Python may outlive it.
+      .def_property_readonly("value", &PyClass::Value,
+                             py::return_value_policy::copy)
+      .def("next", &PyClass::Next)
+      .def_property_readonly("is_open", &PyClass::IsOpen)
+      .def("close", &PyClass::Close);
+}
+
+// Like PybindSequentialTableReader(), but "value" takes the current object
+// out of the reader, leaving it empty, instead of copying it.  It is for
+// types such as FlatVectorVector whose numpy() returns arrays that share the
+// memory of the object, so reading them into numpy arrays copies nothing.
+// "value" must be taken only once per key; the Python classes cache it.
+template <class Holder>
+void PybindSequentialFlatTableReader(py::module &m,  // NOLINT
+                                     const std::string &class_name) {
+  using PyClass = SequentialTableReader<Holder>;
+  using T = typename Holder::T;
+  py::class_<PyClass>(m, class_name.c_str())
+      .def(py::init<>())
+      .def(py::init<const std::string &>(), py::arg("rspecifier"))
+      .def("open", &PyClass::Open, py::arg("rspecifier"))
+      .def_property_readonly("done", &PyClass::Done)
+      .def_property_readonly("key", &PyClass::Key)
+      .def("free_current", &PyClass::FreeCurrent)
+      .def_property_readonly("value",
+                             [](PyClass &self) -> T {
+                               T ans;
+                               ans.Swap(&self.Value());
+                               return ans;
+                             })
       .def("next", &PyClass::Next)
       .def_property_readonly("is_open", &PyClass::IsOpen)
       .def("close", &PyClass::Close);
@@ -65,8 +105,19 @@ void PybindRandomAccessTableReader(py::module &m,  // NOLINT
       .def_property_readonly("is_open", &PyClass::IsOpen)
       .def("close", &PyClass::Close)
       .def("__contains__", &PyClass::HasKey)
+      // Return a copy; see the comment for "value" above.
       .def("__getitem__", &PyClass::Value, py::arg("key"),
-           py::return_value_policy::reference);
+           py::return_value_policy::copy)
+      .def("prefetch", &PyClass::Prefetch, py::arg("keys"))
+      .def_property_readonly("cache_stats", [](const PyClass &self) {
+        TableCacheStats stats = self.CacheStats();
+        py::dict ans;
+        ans["num_hits"] = stats.num_hits;
+        ans["num_misses"] = stats.num_misses;
+        ans["num_objects"] = stats.num_objects;
+        ans["num_bytes"] = stats.num_bytes;
+        return ans;
+      });
 }
 
 template <typename Holder>
@@ -122,6 +173,11 @@ void PybindKaldiTable(py::module &m) {  // NOLINT
   PybindRandomAccessTableReader<BasicVectorVectorHolder<int32_t>>(
       m, "_RandomAccessInt32VectorVectorReader");
 
+  PybindSequentialFlatTableReader<BasicFlatVectorVectorHolder<int32_t>>(
+      m, "_SequentialFlatInt32VectorVectorReader");
+  PybindRandomAccessTableReader<BasicFlatVectorVectorHolder<int32_t>>(
+      m, "_RandomAccessFlatInt32VectorVectorReader");
+
   PybindTableWriter<BasicPairVectorHolder<int32_t>>(m,
                                                     "_Int32PairVectorWriter");
   PybindSequentialTableReader<BasicPairVectorHolder<int32_t>>(
@@ -206,8 +262,16 @@ void PybindKaldiTable(py::module &m) {  // NOLINT
     PybindRandomAccessTableReader<PyClass>(m, "_RandomAccessHtkMatrixReader");
   }
 
-  PybindTableWriter<KaldiObjectHolder<CompressedMatrix>>(
-      m, "_CompressedMatrixWriter");
+  {
+    using PyClass = KaldiObjectHolder<CompressedMatrix>;
+    PybindTableWriter<PyClass>(m, "_CompressedMatrixWriter");
+    PybindSequentialTableReader<PyClass>(m,
+                                         "_SequentialCompressedMatrixReader");
+    PybindRandomAccessTableReader<PyClass>(
+        m, "_RandomAccessCompressedMatrixReader");
+  }
+
+  PybindTableWriter<KaldiObjectHolder<HalfMatrix>>(m, "_HalfMatrixWriter");
 
   {
     using PyClass = PosteriorHolder;
@@ -216,6 +280,14 @@ void PybindKaldiTable(py::module &m) {  // NOLINT
     PybindRandomAccessTableReader<PyClass>(m, "_RandomAccessPosteriorReader");
   }
 
+  {
+    using PyClass = FlatPosteriorHolder;
+    PybindSequentialFlatTableReader<PyClass>(m,
+                                             "_SequentialFlatPosteriorReader");
+    PybindRandomAccessTableReader<PyClass>(m,
+                                           "_RandomAccessFlatPosteriorReader");
+  }
+
   {
     using PyClass = KaldiObjectHolder<MatrixShape>;
     PybindSequentialTableReader<PyClass>(m, "_SequentialMatrixShapeReader");
@@ -229,6 +301,14 @@ void PybindKaldiTable(py::module &m) {  // NOLINT
     PybindRandomAccessTableReader<PyClass>(m, "_RandomAccessGaussPostReader");
   }
 
+  {
+    using PyClass = FlatGaussPostHolder;
+    PybindSequentialFlatTableReader<PyClass>(m,
+                                             "_SequentialFlatGaussPostReader");
+    PybindRandomAccessTableReader<PyClass>(m,
+                                           "_RandomAccessFlatGaussPostReader");
+  }
+
   {
     using PyClass = WaveHolder;
     PybindTableWriter<PyClass>(m, "_WaveWriter");
@@ -241,6 +321,43 @@ void PybindKaldiTable(py::module &m) {  // NOLINT
     PybindSequentialTableReader<PyClass>(m, "_SequentialWaveInfoReader");
     PybindRandomAccessTableReader<PyClass>(m, "_RandomAccessWaveInfoReader");
   }
+
+  m.def(
+      "compile_scp",
+      [](const std::string &scp_rxfilename, const std::string &wxfilename) {
+        if (!CompileScriptFile(scp_rxfilename, wxfilename))
+          KALDIIO_ERR << "Failed to compile "
+                      << PrintableRxfilename(scp_rxfilename);
+      },
+      py::arg("scp_rxfilename"), py::arg("wxfilename"),
+      "Compile an scp file into a binary file that can be read with the "
+      "bscp: rspecifier type");
+
+  m.def("set_max_retained_object_bytes", &SetMaxRetainedObjectBytes,
+        py::arg("num_bytes"),
+        "Matrix, vector and compressed matrix readers keep the last object "
+        "they read, if it is at most this many bytes, and read the next one "
+        "into its memory. 0 disables this. The default is 16 MiB.");
+
+  m.def("get_max_retained_object_bytes", &GetMaxRetainedObjectBytes);
+
+  m.def(
+      "get_pooled_memory_bytes",
+      []() -> size_t {
+        auto *allocator = dynamic_cast<PooledAllocator *>(GetMemoryAllocator());
+        return allocator != NULL ? allocator->PooledBytes() : 0;
+      },
+      "Return the number of bytes of free blocks that the memory allocator of "
+      "matrices and vectors keeps in its shared pool for reuse.");
+
+  m.def(
+      "trim_memory_pool",
+      []() {
+        auto *allocator = dynamic_cast<PooledAllocator *>(GetMemoryAllocator());
+        if (allocator != NULL) allocator->Trim();
+      },
+      "Return the free blocks in the shared pool of the memory allocator, and "
+      "in the cache of the calling thread, to the system.");
 }
 
 }  // namespace kaldiio
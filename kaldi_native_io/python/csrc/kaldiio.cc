@@ -5,10 +5,14 @@
 #include "kaldi_native_io/python/csrc/kaldiio.h"
 
 #include "kaldi_native_io/python/csrc/compressed-matrix.h"
+#include "kaldi_native_io/python/csrc/flat-vector-vector.h"
+#include "kaldi_native_io/python/csrc/half-matrix.h"
 #include "kaldi_native_io/python/csrc/kaldi-matrix.h"
 #include "kaldi_native_io/python/csrc/kaldi-table.h"
 #include "kaldi_native_io/python/csrc/kaldi-vector.h"
+#include "kaldi_native_io/python/csrc/mapped-matrix-reader.h"
 #include "kaldi_native_io/python/csrc/matrix-shape.h"
+#include "kaldi_native_io/python/csrc/posterior.h"
 #include "kaldi_native_io/python/csrc/wave-reader.h"
 
 namespace kaldiio {
@@ -19,8 +23,12 @@ PYBIND11_MODULE(_kaldi_native_io, m) {
   PybindKaldiVector(m);
   PybindKaldiMatrix(m);
   PybindCompressedMatrix(m);
+  PybindHalfMatrix(m);
   PybindWaveReader(m);
   PybindMatrixShape(m);
+  PybindPosterior(m);
+  PybindFlatVectorVector(m);
+  PybindMappedMatrixReader(m);
 }
 
 }  // namespace kaldiio
@@ -5,6 +5,8 @@
 #ifndef KALDI_NATIVE_IO_PYTHON_CSRC_KALDIIO_H_
 #define KALDI_NATIVE_IO_PYTHON_CSRC_KALDIIO_H_
 
+#include <vector>
+
 #include "pybind11/numpy.h"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
@@ -14,4 +16,17 @@ namespace py = pybind11;
 template <typename... Args>
 using overload_cast_ = py::detail::overload_cast_impl<Args...>;
 
+namespace kaldiio {
+
+// Returns a 1-D array sharing the memory of v, which obj owns.
+template <typename T>
+py::array_t<T> ToNumpy(const std::vector<T> &v, py::object obj) {
+  return py::array_t<T>({v.size()},   // shape
+                        {sizeof(T)},  // stride in bytes
+                        v.data(),     // ptr
+                        obj);  // it will increase the reference count of obj
+}
+
+}  // namespace kaldiio
+
 #endif  // KALDI_NATIVE_IO_PYTHON_CSRC_KALDIIO_H_
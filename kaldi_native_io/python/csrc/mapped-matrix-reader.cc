@@ -0,0 +1,47 @@
+// kaldi_native_io/python/csrc/mapped-matrix-reader.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/mapped-matrix-reader.h"
+
+#include <string>
+
+#include "kaldi_native_io/python/csrc/mapped-matrix-reader.h"
+
+namespace kaldiio {
+
+template <typename Real>
+static void PybindMappedMatrixReaderTpl(py::module &m,  // NOLINT
+                                        const std::string &class_name) {
+  using PyClass = SequentialMappedMatrixReader<Real>;
+  py::class_<PyClass>(m, class_name.c_str())
+      .def(py::init<>())
+      .def(py::init<const std::string &>(), py::arg("rspecifier"))
+      .def("open", &PyClass::Open, py::arg("rspecifier"))
+      .def_property_readonly("done", &PyClass::Done)
+      .def_property_readonly("key", &PyClass::Key)
+      // Return a copy: the matrix may point into the mapping, which is only
+      // valid until the next call to next().
+      .def_property_readonly("value",
+                             [](PyClass &self) {
+                               SubMatrix<Real> v = self.Value();
+                               return py::array_t<Real>(
+                                   {v.NumRows(), v.NumCols()},
+                                   {sizeof(Real) * v.Stride(), sizeof(Real)},
+                                   v.Data());
+                             })
+      .def_property_readonly("is_mapped", &PyClass::IsMapped)
+      .def_property_readonly("num_mapped", &PyClass::NumMapped)
+      .def_property_readonly("num_copied", &PyClass::NumCopied)
+      .def("next", &PyClass::Next)
+      .def_property_readonly("is_open", &PyClass::IsOpen)
+      .def("close", &PyClass::Close);
+}
+
+void PybindMappedMatrixReader(py::module &m) {  // NOLINT
+  PybindMappedMatrixReaderTpl<float>(m, "_SequentialMappedFloatMatrixReader");
+  PybindMappedMatrixReaderTpl<double>(m,
+                                      "_SequentialMappedDoubleMatrixReader");
+}
+
+}  // namespace kaldiio
@@ -0,0 +1,41 @@
+// kaldi_native_io/python/csrc/posterior.cc
+//
+// Copyright (c)  2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+#include "kaldi_native_io/csrc/posterior.h"
+
+#include "kaldi_native_io/python/csrc/posterior.h"
+
+namespace kaldiio {
+
+void PybindPosterior(py::module &m) {  // NOLINT
+  {
+    using PyClass = FlatPosterior;
+    py::class_<PyClass>(m, "_FlatPosterior")
+        .def(py::init<>())
+        .def(py::init<const Posterior &>(), py::arg("post"))
+        .def_property_readonly("num_frames", &PyClass::NumFrames)
+        .def("numpy", [](py::object obj) {
+          auto *post = obj.cast<PyClass *>();
+          return py::make_tuple(ToNumpy(post->Offsets(), obj),
+                                ToNumpy(post->Ids(), obj),
+                                ToNumpy(post->Weights(), obj));
+        });
+  }
+
+  {
+    using PyClass = FlatGaussPost;
+    py::class_<PyClass>(m, "_FlatGaussPost")
+        .def(py::init<>())
+        .def_property_readonly("num_frames", &PyClass::NumFrames)
+        .def("numpy", [](py::object obj) {
+          auto *post = obj.cast<PyClass *>();
+          return py::make_tuple(ToNumpy(post->Offsets(), obj),
+                                ToNumpy(post->Ids(), obj),
+                                ToNumpy(post->WeightOffsets(), obj),
+                                ToNumpy(post->Weights(), obj));
+        });
+  }
+}
+
+}  // namespace kaldiio
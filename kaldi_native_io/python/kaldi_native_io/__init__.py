@@ -1,19 +1,32 @@
 from pathlib import Path as _Path
 from typing import List
 
+import numpy as np
+
 import _kaldi_native_io
 from _kaldi_native_io import (
     CompressionMethod,
+    HalfFormat,
     HtkHeader,
     MatrixShape,
     WaveData,
     WaveInfo,
 )
+from _kaldi_native_io import _CompressedMatrix as CompressedMatrix
 from _kaldi_native_io import _DoubleMatrix as DoubleMatrix
 from _kaldi_native_io import _DoubleVector as DoubleVector
 from _kaldi_native_io import _FloatMatrix as FloatMatrix
 from _kaldi_native_io import _FloatVector as FloatVector
-from _kaldi_native_io import read_blob, read_wave, read_wave_info
+from _kaldi_native_io import (
+    compile_scp,
+    get_max_retained_object_bytes,
+    get_pooled_memory_bytes,
+    read_blob,
+    read_wave,
+    read_wave_info,
+    set_max_retained_object_bytes,
+    trim_memory_pool,
+)
 
 from .table_types import (
     BoolWriter,
@@ -26,6 +39,7 @@ from .table_types import (
     FloatVectorWriter,
     FloatWriter,
     GaussPostWriter,
+    HalfMatrixWriter,
     HtkMatrixWriter,
     Int8VectorWriter,
     Int32PairVectorWriter,
@@ -35,10 +49,14 @@ from .table_types import (
     Int32Writer,
     PosteriorWriter,
     RandomAccessBoolReader,
+    RandomAccessCompressedMatrixReader,
     RandomAccessBlobReader,
     RandomAccessDoubleMatrixReader,
     RandomAccessDoubleReader,
     RandomAccessDoubleVectorReader,
+    RandomAccessFlatGaussPostReader,
+    RandomAccessFlatInt32VectorVectorReader,
+    RandomAccessFlatPosteriorReader,
     RandomAccessFloatMatrixReader,
     RandomAccessFloatPairVectorReader,
     RandomAccessFloatReader,
@@ -57,9 +75,13 @@ from .table_types import (
     RandomAccessWaveInfoReader,
     RandomAccessWaveReader,
     SequentialBoolReader,
+    SequentialCompressedMatrixReader,
     SequentialDoubleMatrixReader,
     SequentialDoubleReader,
     SequentialDoubleVectorReader,
+    SequentialFlatGaussPostReader,
+    SequentialFlatInt32VectorVectorReader,
+    SequentialFlatPosteriorReader,
     SequentialFloatMatrixReader,
     SequentialFloatPairVectorReader,
     SequentialFloatReader,
@@ -72,6 +94,8 @@ from .table_types import (
     SequentialBlobReader,
     SequentialInt32VectorReader,
     SequentialInt32VectorVectorReader,
+    SequentialMappedDoubleMatrixReader,
+    SequentialMappedFloatMatrixReader,
     SequentialMatrixShapeReader,
     SequentialPosteriorReader,
     SequentialTokenReader,
@@ -95,3 +119,31 @@ def read_int32_vector(rxfilename: str) -> List[int]:
 def read_int8_vector(rxfilename: str) -> List[int]:
     """Read a vector of int8 from an rxfilename"""
     return _kaldi_native_io.read_int8_vector(rxfilename)
+
+
+def pad_compressed_matrices(
+    mats: List[CompressedMatrix],
+    dtype: np.dtype = np.float32,
+    transpose: bool = False,
+    padding_value: float = 0,
+) -> np.ndarray:
+    """Decompress a batch of matrices directly into one padded array, e.g.,
+    the matrices read by :class:`SequentialCompressedMatrixReader`.
+
+    Args:
+      mats:
+        The matrices. They must have the same number of columns.
+      dtype:
+        np.float32 or np.float16.
+      transpose:
+        If ``True``, each matrix is transposed.
+      padding_value:
+        The value for the rows after the end of the shorter matrices.
+    Returns:
+      Return an array of shape ``(len(mats), max_rows, num_cols)``, or
+      ``(len(mats), num_cols, max_rows)`` if ``transpose`` is ``True``, where
+      ``max_rows`` is the largest number of rows of the matrices.
+    """
+    return _kaldi_native_io._pad_compressed_matrices(
+        mats, np.dtype(dtype), transpose, padding_value
+    )
@@ -2,11 +2,12 @@
 # See ../../../LICENSE for clarification regarding multiple authors
 
 
-from typing import Any, List, Tuple, Union
+from typing import Any, Dict, List, Tuple, Union
 
 import numpy as np
 from _kaldi_native_io import (
     CompressionMethod,
+    HalfFormat,
     HtkHeader,
     _BlobWriter,
     _BoolWriter,
@@ -24,6 +25,8 @@ from _kaldi_native_io import (
     _FloatVectorWriter,
     _FloatWriter,
     _GaussPostWriter,
+    _HalfMatrix,
+    _HalfMatrixWriter,
     _HtkMatrixWriter,
     _Int8VectorWriter,
     _Int32PairVectorWriter,
@@ -33,9 +36,13 @@ from _kaldi_native_io import (
     _PosteriorWriter,
     _RandomAccessBlobReader,
     _RandomAccessBoolReader,
+    _RandomAccessCompressedMatrixReader,
     _RandomAccessDoubleMatrixReader,
     _RandomAccessDoubleReader,
     _RandomAccessDoubleVectorReader,
+    _RandomAccessFlatGaussPostReader,
+    _RandomAccessFlatInt32VectorVectorReader,
+    _RandomAccessFlatPosteriorReader,
     _RandomAccessFloatMatrixReader,
     _RandomAccessFloatPairVectorReader,
     _RandomAccessFloatReader,
@@ -55,9 +62,13 @@ from _kaldi_native_io import (
     _RandomAccessWaveReader,
     _SequentialBlobReader,
     _SequentialBoolReader,
+    _SequentialCompressedMatrixReader,
     _SequentialDoubleMatrixReader,
     _SequentialDoubleReader,
     _SequentialDoubleVectorReader,
+    _SequentialFlatGaussPostReader,
+    _SequentialFlatInt32VectorVectorReader,
+    _SequentialFlatPosteriorReader,
     _SequentialFloatMatrixReader,
     _SequentialFloatPairVectorReader,
     _SequentialFloatReader,
@@ -69,6 +80,8 @@ from _kaldi_native_io import (
     _SequentialInt32Reader,
     _SequentialInt32VectorReader,
     _SequentialInt32VectorVectorReader,
+    _SequentialMappedDoubleMatrixReader,
+    _SequentialMappedFloatMatrixReader,
     _SequentialMatrixShapeReader,
     _SequentialPosteriorReader,
     _SequentialTokenReader,
@@ -242,6 +255,42 @@ class _RandomAccessTableReader(object):
         """The actual return type depends on the type of `self._impl`."""
         return self._impl[key]
 
+    @property
+    def cache_stats(self) -> Dict[str, int]:
+        """Statistics for the object cache, which is enabled by the
+        ``cache=N`` option of the rspecifier, e.g., ``scp,cache=2G:foo.scp``.
+        It returns a dict with the keys ``num_hits``, ``num_misses``,
+        ``num_objects`` and ``num_bytes``; they are all 0 if there is no
+        cache.
+        """
+        return self._impl.cache_stats
+
+    def prefetch(self, keys: List[str]) -> None:
+        """Read the values for a batch of keys, so that looking them up
+        afterwards needs no I/O. For scp files and archives opened with the
+        ``idx`` option, the values are read in the order in which they are
+        stored on disk, using ``N`` threads if the rspecifier has the
+        ``threads=N`` option. Keys that are not present are ignored.
+
+        Args:
+          keys:
+            The keys to read.
+        """
+        self._impl.prefetch(keys)
+
+    def values(self, keys: List[str]) -> List[Any]:
+        """Return the values for a batch of keys, read as in
+        :meth:`prefetch`. The value for a key that is not present is ``None``.
+        The returned values are valid until the next call to
+        :meth:`prefetch` or :meth:`values`.
+
+        Args:
+          keys:
+            The keys to look up.
+        """
+        self.prefetch(keys)
+        return [self[key] if key in self else None for key in keys]
+
     def __enter__(self):
         return self
 
@@ -328,6 +377,57 @@ class RandomAccessInt32VectorVectorReader(_RandomAccessTableReader):
         self._impl = _RandomAccessInt32VectorVectorReader(rspecifier)
 
 
+class _SequentialFlatTableReader(_SequentialTableReader):
+    """Base class of the sequential readers whose values are tuples of 1-D
+    arrays. The reader hands the memory it read the object into over to the
+    arrays, so nothing is copied."""
+
+    def _current_value(self) -> Tuple[np.ndarray, ...]:
+        # The object can be handed over only once, so keep the arrays until
+        # the reader moves on.
+        if getattr(self, "_value_impl", None) is not self._impl:
+            self._value = self._impl.value.numpy()
+            self._value_impl = self._impl
+        return self._value
+
+    def next(self) -> None:
+        self._value_impl = None
+        self._impl.next()
+
+
+class SequentialFlatInt32VectorVectorReader(_SequentialFlatTableReader):
+    """Read vectors of vectors written by :class:`Int32VectorVectorWriter`
+    into two arrays, without the Python list and int objects that
+    :class:`SequentialInt32VectorVectorReader` creates for each vector and
+    element."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialFlatInt32VectorVectorReader(rspecifier)
+
+    @property
+    def value(self) -> Tuple[np.ndarray, np.ndarray]:
+        """Return a tuple containing:
+          - offsets, a 1-D array with dtype np.int32 and num_vectors + 1
+            elements
+          - values, a 1-D array with dtype np.int32
+        Vector i is values[offsets[i]:offsets[i + 1]].
+        """
+        return self._current_value()
+
+
+class RandomAccessFlatInt32VectorVectorReader(_RandomAccessTableReader):
+    """See :class:`SequentialFlatInt32VectorVectorReader`."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _RandomAccessFlatInt32VectorVectorReader(rspecifier)
+
+    def __getitem__(self, key) -> Tuple[np.ndarray, np.ndarray]:
+        """Return (offsets, values) for the key; see
+        :meth:`SequentialFlatInt32VectorVectorReader.value`. The reader may
+        return the same object again, so the arrays use a copy of it."""
+        return self._impl[key].numpy()
+
+
 class Int32PairVectorWriter(_TableWriter):
     def open(self, wspecifier: str) -> None:
         self._impl = _Int32PairVectorWriter(wspecifier)
@@ -577,6 +677,45 @@ class RandomAccessDoubleMatrixReader(_RandomAccessTableReader):
         return self._impl[key].numpy()
 
 
+class _SequentialMappedMatrixReader(_SequentialTableReader):
+    """Read an archive of matrices from a memory-mapped file, e.g.,
+    ``ark:foo.ark``. Uncompressed binary matrices of the reader's type are
+    read without decoding them; write the archive with the ``align`` option,
+    e.g., ``ark,align:foo.ark``, so that this is possible for all of them.
+    """
+
+    @property
+    def value(self) -> np.ndarray:
+        """Return a 2-D array; it is a copy of the matrix in the archive."""
+        return self._impl.value
+
+    @property
+    def is_mapped(self) -> bool:
+        """Return ``True`` if the current matrix was read without copying it
+        from the mapping."""
+        return self._impl.is_mapped
+
+    @property
+    def num_mapped(self) -> int:
+        """Return the number of matrices read without copying."""
+        return self._impl.num_mapped
+
+    @property
+    def num_copied(self) -> int:
+        """Return the number of matrices that had to be copied or decoded."""
+        return self._impl.num_copied
+
+
+class SequentialMappedFloatMatrixReader(_SequentialMappedMatrixReader):
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialMappedFloatMatrixReader(rspecifier)
+
+
+class SequentialMappedDoubleMatrixReader(_SequentialMappedMatrixReader):
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialMappedDoubleMatrixReader(rspecifier)
+
+
 class HtkMatrixWriter(_TableWriter):
     def open(self, wspecifier: str) -> None:
         self._impl = _HtkMatrixWriter(wspecifier)
@@ -631,6 +770,7 @@ class CompressedMatrixWriter(_TableWriter):
         key: str,
         value: np.ndarray,
         method: CompressionMethod.kAutomaticMethod,
+        num_threads: int = 1,
     ) -> None:
         """
         Args:
@@ -640,14 +780,17 @@ class CompressedMatrixWriter(_TableWriter):
             A 2-D array with dtype torch.float32 or torch.float64.
           method:
             See the documentation for :enum:`CompressionMethod`.
+          num_threads:
+            The number of threads to compress large matrices with. The
+            result is the same for any number of threads.
         """
         assert value.ndim == 2
         assert value.dtype in (np.float32, np.float64)
 
         if value.dtype == np.float32:
-            m = _CompressedMatrix(_FloatMatrix(value), method)
+            m = _CompressedMatrix(_FloatMatrix(value), method, num_threads)
         else:
-            m = _CompressedMatrix(_DoubleMatrix(value), method)
+            m = _CompressedMatrix(_DoubleMatrix(value), method, num_threads)
 
         super().write(key, m)
 
@@ -672,6 +815,81 @@ class CompressedMatrixWriter(_TableWriter):
         self.write(key, *value)
 
 
+class SequentialCompressedMatrixReader(_SequentialTableReader):
+    """Read matrices without decompressing them, e.g., to decompress a batch
+    of them into one array with :func:`pad_compressed_matrices`. Matrices that
+    are not compressed are compressed with ``kAutomaticMethod`` when read."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialCompressedMatrixReader(rspecifier)
+
+    @property
+    def value(self) -> _CompressedMatrix:
+        """Return a copy of the current matrix, which stays valid after
+        :meth:`next`."""
+        return _CompressedMatrix(self._impl.value)
+
+
+class RandomAccessCompressedMatrixReader(_RandomAccessTableReader):
+    """See :class:`SequentialCompressedMatrixReader`."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _RandomAccessCompressedMatrixReader(rspecifier)
+
+    def __getitem__(self, key) -> _CompressedMatrix:
+        """Return a copy of the matrix for the key."""
+        return _CompressedMatrix(self._impl[key])
+
+
+class HalfMatrixWriter(_TableWriter):
+    def open(self, wspecifier: str) -> None:
+        self._impl = _HalfMatrixWriter(wspecifier)
+
+    def write(
+        self,
+        key: str,
+        value: np.ndarray,
+        format: HalfFormat = HalfFormat.kFloat16,
+    ) -> None:
+        """
+        Args:
+          key:
+            Key of the value.
+          value:
+            A 2-D array with dtype np.float32 or np.float64.
+          format:
+            See the documentation for :enum:`HalfFormat`.
+        """
+        assert value.ndim == 2
+        assert value.dtype in (np.float32, np.float64)
+
+        if value.dtype == np.float32:
+            m = _HalfMatrix(_FloatMatrix(value), format)
+        else:
+            m = _HalfMatrix(_DoubleMatrix(value), format)
+
+        super().write(key, m)
+
+    def __setitem__(
+        self,
+        key: str,
+        value: Union[np.ndarray, Tuple[np.ndarray, HalfFormat]],
+    ) -> None:
+        """
+        Args:
+          key:
+            Key of the value.
+          value:
+            Either a 2-D array with dtype np.float32 or np.float64, or a tuple
+            containing such an array and the format.
+        """
+        if isinstance(value, np.ndarray):
+            value = (value, HalfFormat.kFloat16)
+        else:
+            assert isinstance(value, tuple)
+        self.write(key, *value)
+
+
 class PosteriorWriter(_TableWriter):
     def open(self, wspecifier: str) -> None:
         self._impl = _PosteriorWriter(wspecifier)
@@ -699,6 +917,40 @@ class RandomAccessPosteriorReader(_RandomAccessTableReader):
         self._impl = _RandomAccessPosteriorReader(rspecifier)
 
 
+class SequentialFlatPosteriorReader(_SequentialFlatTableReader):
+    """Read posteriors written by :class:`PosteriorWriter` as three arrays in
+    the CSR layout. Unlike :class:`SequentialPosteriorReader`, it creates no
+    Python tuple for each pair, so it suits posteriors with many frames."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialFlatPosteriorReader(rspecifier)
+
+    @property
+    def value(self) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+        """Return a tuple containing:
+          - offsets, a 1-D array with dtype np.int32 and num_frames + 1
+            elements
+          - ids, a 1-D array with dtype np.int32
+          - weights, a 1-D array with dtype np.float32
+        The pairs of frame t are (ids[k], weights[k]) for k in
+        range(offsets[t], offsets[t + 1]).
+        """
+        return self._current_value()
+
+
+class RandomAccessFlatPosteriorReader(_RandomAccessTableReader):
+    """See :class:`SequentialFlatPosteriorReader`."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _RandomAccessFlatPosteriorReader(rspecifier)
+
+    def __getitem__(self, key) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+        """Return (offsets, ids, weights) for the key; see
+        :meth:`SequentialFlatPosteriorReader.value`. As the reader may return
+        the same posterior again, the arrays use a copy of it."""
+        return self._impl[key].numpy()
+
+
 class GaussPostWriter(_TableWriter):
     def open(self, wspecifier: str) -> None:
         self._impl = _GaussPostWriter(wspecifier)
@@ -760,6 +1012,46 @@ class RandomAccessGaussPostReader(_RandomAccessTableReader):
         return value
 
 
+class SequentialFlatGaussPostReader(_SequentialFlatTableReader):
+    """Read Gaussian posteriors written by :class:`GaussPostWriter` as four
+    arrays. Unlike :class:`SequentialGaussPostReader`, it creates no tuple
+    and no array for each pair."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _SequentialFlatGaussPostReader(rspecifier)
+
+    @property
+    def value(self) -> Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+        """Return a tuple containing:
+          - offsets, a 1-D array with dtype np.int32 and num_frames + 1
+            elements
+          - ids, a 1-D array with dtype np.int32, the pdf-ids
+          - weight_offsets, a 1-D array with dtype np.int32 and len(ids) + 1
+            elements
+          - weights, a 1-D array with dtype np.float32
+        The pairs of frame t are those with index k in
+        range(offsets[t], offsets[t + 1]). Pair k has the pdf-id ids[k] and
+        the Gaussian posteriors
+        weights[weight_offsets[k]:weight_offsets[k + 1]].
+        """
+        return self._current_value()
+
+
+class RandomAccessFlatGaussPostReader(_RandomAccessTableReader):
+    """See :class:`SequentialFlatGaussPostReader`."""
+
+    def open(self, rspecifier: str) -> None:
+        self._impl = _RandomAccessFlatGaussPostReader(rspecifier)
+
+    def __getitem__(
+        self, key
+    ) -> Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+        """Return (offsets, ids, weight_offsets, weights) for the key; see
+        :meth:`SequentialFlatGaussPostReader.value`. As the reader may return
+        the same posteriors again, the arrays use a copy of them."""
+        return self._impl[key].numpy()
+
+
 class SequentialWaveInfoReader(_SequentialTableReader):
     """Caution: It does not support pipe input yet since it
     closes the pipe as soon as it reads the header, which
@@ -64,10 +64,194 @@ def test_random_access_compressed_matrix_reader():
             )
 
 
+def test_compressed_matrix_row_ranges():
+    mat = np.random.rand(200, 4).astype(np.float32)
+    methods = [
+        kaldi_native_io.CompressionMethod.kSpeechFeature,
+        kaldi_native_io.CompressionMethod.kTwoByteAuto,
+        kaldi_native_io.CompressionMethod.kOneByteAuto,
+    ]
+    with kaldi_native_io.CompressedMatrixWriter(
+        "ark,scp:range.ark,range.scp"
+    ) as ko:
+        for i, method in enumerate(methods):
+            ko.write(f"m{i}", mat, method=method)
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader("scp:range.scp") as ki:
+        whole = [ki[f"m{i}"] for i in range(len(methods))]
+
+    with open("range.scp") as f:
+        lines = [line.split() for line in f]
+    with open("range2.scp", "w") as f:
+        for key, rxfilename in lines:
+            f.write(f"{key} {rxfilename}[150:199,1:2]\n")
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader("scp:range2.scp") as ki:
+        for i in range(len(methods)):
+            assert np.array_equal(ki[f"m{i}"], whole[i][150:200, 1:3])
+
+    os.remove("range.ark")
+    os.remove("range.scp")
+    os.remove("range2.scp")
+
+
+def test_compressed_matrix_num_threads():
+    # Large enough to be split among threads.
+    mat = np.random.randn(3000, 80).astype(np.float32)
+    methods = [
+        kaldi_native_io.CompressionMethod.kSpeechFeature,
+        kaldi_native_io.CompressionMethod.kTwoByteAuto,
+        kaldi_native_io.CompressionMethod.kOneByteAuto,
+    ]
+    with kaldi_native_io.CompressedMatrixWriter("ark:threads.ark") as ko:
+        for i, method in enumerate(methods):
+            ko.write(f"m{i}", mat, method=method)
+            ko.write(f"t{i}", mat, method=method, num_threads=4)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("ark:threads.ark") as ki:
+        values = {key: value for key, value in ki}
+
+    for i in range(len(methods)):
+        assert np.array_equal(values[f"m{i}"], values[f"t{i}"])
+
+    os.remove("threads.ark")
+
+
+def test_pad_compressed_matrices():
+    mats = [
+        np.random.randn(n, 5).astype(np.float32) for n in (100, 30, 70)
+    ]
+    methods = [
+        kaldi_native_io.CompressionMethod.kSpeechFeature,
+        kaldi_native_io.CompressionMethod.kTwoByteAuto,
+        kaldi_native_io.CompressionMethod.kOneByteAuto,
+    ]
+    with kaldi_native_io.CompressedMatrixWriter("ark:pad.ark") as ko:
+        for i, (mat, method) in enumerate(zip(mats, methods)):
+            ko.write(f"m{i}", mat, method=method)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("ark:pad.ark") as ki:
+        expected = [value for key, value in ki]
+
+    with kaldi_native_io.SequentialCompressedMatrixReader("ark:pad.ark") as ki:
+        cmats = [value for key, value in ki]
+
+    with kaldi_native_io.RandomAccessCompressedMatrixReader(
+        "ark:pad.ark"
+    ) as ki:
+        assert np.array_equal(ki["m1"].numpy(), expected[1])
+
+    for cmat, value in zip(cmats, expected):
+        assert cmat.shape == value.shape
+        assert np.array_equal(cmat.numpy(), value)
+        assert np.array_equal(cmat.numpy(transpose=True), value.T)
+        assert np.array_equal(
+            cmat.numpy(dtype=np.float16), value.astype(np.float16)
+        )
+
+    padded = kaldi_native_io.pad_compressed_matrices(cmats, padding_value=-1)
+    assert padded.shape == (3, 100, 5)
+    assert padded.dtype == np.float32
+    for i, value in enumerate(expected):
+        n = value.shape[0]
+        assert np.array_equal(padded[i, :n], value)
+        assert np.all(padded[i, n:] == -1)
+
+    padded = kaldi_native_io.pad_compressed_matrices(
+        cmats, dtype=np.float16, transpose=True
+    )
+    assert padded.shape == (3, 5, 100)
+    assert padded.dtype == np.float16
+    for i, value in enumerate(expected):
+        n = value.shape[0]
+        assert np.array_equal(padded[i, :, :n], value.T.astype(np.float16))
+        assert np.all(padded[i, :, n:] == 0)
+
+    os.remove("pad.ark")
+
+
+def test_compressed_matrix_transpose():
+    # Matrices of 64 rows or more are decompressed with a table; check the
+    # sizes around that boundary, transposed too, with non-square matrices.
+    # numpy() decompresses float32 with CopyToMat().
+    methods = [
+        kaldi_native_io.CompressionMethod.kSpeechFeature,
+        kaldi_native_io.CompressionMethod.kTwoByteAuto,
+        kaldi_native_io.CompressionMethod.kOneByteAuto,
+    ]
+    mats = [np.random.randn(n, 40).astype(np.float32) for n in (63, 64, 65)]
+    with kaldi_native_io.CompressedMatrixWriter(
+        "ark,scp:trans.ark,trans.scp"
+    ) as ko:
+        for i, mat in enumerate(mats):
+            for j, method in enumerate(methods):
+                ko.write(f"m{i}_{j}", mat, method=method)
+
+    with kaldi_native_io.SequentialCompressedMatrixReader(
+        "scp:trans.scp"
+    ) as ki:
+        cmats = {key: value for key, value in ki}
+
+    # Ranges of fewer than 64 rows are decompressed one element at a time.
+    with open("trans.scp") as f:
+        lines = [line.split() for line in f]
+    with open("trans2.scp", "w") as f:
+        for key, rxfilename in lines:
+            n = cmats[key].shape[0]
+            f.write(f"{key}_0 {rxfilename}[0:31]\n")
+            f.write(f"{key}_1 {rxfilename}[32:{n - 1}]\n")
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader("scp:trans2.scp") as ki:
+        for key, cmat in cmats.items():
+            a = cmat.numpy()
+            assert np.array_equal(cmat.numpy(transpose=True), a.T), key
+            assert np.array_equal(
+                np.concatenate([ki[f"{key}_0"], ki[f"{key}_1"]]), a
+            ), key
+
+    os.remove("trans.ark")
+    os.remove("trans.scp")
+    os.remove("trans2.scp")
+
+
+def test_compressed_matrix_index():
+    mats = [np.random.randn(n, 7).astype(np.float32) for n in (5, 40, 13)]
+    with kaldi_native_io.CompressedMatrixWriter("ark,idx:cidx.ark") as ko:
+        for i, mat in enumerate(mats):
+            ko.write(f"m{i}", mat)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("ark:cidx.ark") as ki:
+        expected = {key: value for key, value in ki}
+
+    # The index does not record the holder type, so an archive of compressed
+    # matrices can be read through its index as float matrices.
+    with kaldi_native_io.RandomAccessFloatMatrixReader(
+        "ark,idx:cidx.ark"
+    ) as ki:
+        for key, value in expected.items():
+            assert np.array_equal(ki[key], value)
+
+    with kaldi_native_io.SequentialFloatMatrixReader(
+        "ark,threads=2:cidx.ark"
+    ) as ki:
+        read = [(key, value) for key, value in ki]
+    assert [key for key, _ in read] == ["m0", "m1", "m2"]
+    for key, value in read:
+        assert np.array_equal(value, expected[key])
+
+    os.remove("cidx.ark.idx")
+    os.remove("cidx.ark")
+
+
 def main():
     test_compressed_matrix_writer()
     test_sequential_compressed_matrix_reader()
     test_random_access_compressed_matrix_reader()
+    test_compressed_matrix_row_ranges()
+    test_compressed_matrix_num_threads()
+    test_pad_compressed_matrices()
+    test_compressed_matrix_transpose()
+    test_compressed_matrix_index()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
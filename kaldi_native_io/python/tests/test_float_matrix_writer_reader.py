@@ -35,6 +35,20 @@ def test_sequential_float_matrix_reader():
                 raise ValueError(f"Unknown key {key} with value {value}")
 
 
+def test_background_float_matrix_reader():
+    keys = []
+    with kaldi_native_io.SequentialFloatMatrixReader(
+        f"scp,bg=4:{base}.scp"
+    ) as ki:
+        for key, value in ki:
+            keys.append(key)
+            if key == "a":
+                assert np.array_equal(
+                    value, np.array([[1, 2], [3, 4]], dtype=np.float32)
+                )
+    assert keys == ["a", "b"]
+
+
 def test_random_access_float_matrix_reader():
     with kaldi_native_io.RandomAccessFloatMatrixReader(rspecifier) as ki:
         assert "b" in ki
@@ -47,6 +61,37 @@ def test_random_access_float_matrix_reader():
         )
 
 
+def test_batched_values():
+    a = np.array([[1, 2], [3, 4]], dtype=np.float32)
+    b = np.array([[10, 20, 30], [40, 50, 60]], dtype=np.float32)
+    with kaldi_native_io.RandomAccessFloatMatrixReader(
+        f"scp,threads=2:{base}.scp"
+    ) as ki:
+        values = ki.values(["b", "c", "a"])
+        assert len(values) == 3
+        assert np.array_equal(values[0], b)
+        assert values[1] is None
+        assert np.array_equal(values[2], a)
+
+        ki.prefetch(["a", "b"])
+        assert np.array_equal(ki["a"], a)
+        assert np.array_equal(ki["b"], b)
+
+
+def test_cached_reader():
+    a = np.array([[1, 2], [3, 4]], dtype=np.float32)
+    with kaldi_native_io.RandomAccessFloatMatrixReader(
+        f"scp,cache=1M:{base}.scp"
+    ) as ki:
+        for i in range(3):
+            assert np.array_equal(ki["a"], a)
+        stats = ki.cache_stats
+        assert stats["num_hits"] == 2
+        assert stats["num_misses"] == 1
+        assert stats["num_objects"] == 1
+        assert stats["num_bytes"] > 0
+
+
 def test_read_write_single_mat():
     arr = np.array(
         [
@@ -102,12 +147,242 @@ def test_read_write_single_mat():
     os.remove("m.ark")
 
 
+def test_indexed_archive():
+    a = np.array([[1, 2], [3, 4]], dtype=np.float32)
+    b = np.array([[10, 20, 30], [40, 50, 60]], dtype=np.float32)
+    with kaldi_native_io.FloatMatrixWriter("ark,idx:idx.ark") as ko:
+        ko.write("a", a)
+        ko["b"] = b
+
+    assert os.path.isfile("idx.ark.idx")
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader("ark,idx:idx.ark") as ki:
+        assert "c" not in ki
+        assert np.array_equal(ki["b"], b)
+        assert np.array_equal(ki["a"], a)
+
+    keys = []
+    with kaldi_native_io.SequentialFloatMatrixReader(
+        "ark,threads=2:idx.ark"
+    ) as ki:
+        for key, value in ki:
+            keys.append(key)
+            assert np.array_equal(value, a if key == "a" else b)
+    assert keys == ["a", "b"]
+
+    os.remove("idx.ark.idx")
+    os.remove("idx.ark")
+
+
+def test_mapped_reader():
+    mats = {
+        "k" * (1 + i % 5) + str(i): np.random.randn(i % 4 + 1, 3).astype(
+            np.float32
+        )
+        for i in range(20)
+    }
+    for wspecifier in ["ark:mapped.ark", "ark,align:mapped.ark"]:
+        with kaldi_native_io.FloatMatrixWriter(wspecifier) as ko:
+            for key, value in mats.items():
+                ko.write(key, value)
+
+        with kaldi_native_io.SequentialMappedFloatMatrixReader(
+            "ark:mapped.ark"
+        ) as ki:
+            read = {key: value for key, value in ki}
+            num_mapped = ki.num_mapped
+            num_copied = ki.num_copied
+        assert read.keys() == mats.keys()
+        for key, value in mats.items():
+            assert np.array_equal(read[key], value)
+        assert num_mapped + num_copied == len(mats)
+        if wspecifier.startswith("ark,align"):
+            assert num_copied == 0
+
+        # Matrices of the other type are converted.
+        with kaldi_native_io.SequentialMappedDoubleMatrixReader(
+            "ark:mapped.ark"
+        ) as ki:
+            for key, value in ki:
+                assert value.dtype == np.float64
+                assert np.array_equal(value, mats[key])
+            assert ki.num_mapped == 0
+
+        # An aligned archive can be read as usual.
+        with kaldi_native_io.SequentialFloatMatrixReader(
+            "ark:mapped.ark"
+        ) as ki:
+            for key, value in ki:
+                assert np.array_equal(value, mats[key])
+
+    os.remove("mapped.ark")
+
+
+def test_compiled_scp():
+    kaldi_native_io.compile_scp(f"{base}.scp", f"{base}.bscp")
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader(
+        f"bscp:{base}.bscp"
+    ) as ki:
+        assert "c" not in ki
+        assert np.array_equal(
+            ki["b"], np.array([[10, 20, 30], [40, 50, 60]], dtype=np.float32)
+        )
+        assert np.array_equal(
+            ki["a"], np.array([[1, 2], [3, 4]], dtype=np.float32)
+        )
+
+    keys = []
+    with kaldi_native_io.SequentialFloatMatrixReader(f"bscp:{base}.bscp") as ki:
+        for key, value in ki:
+            keys.append(key)
+    assert keys == ["a", "b"]
+
+    os.remove(f"{base}.bscp")
+
+
+def test_sharded_writer():
+    mats = [np.random.rand(i + 1, 3).astype(np.float32) for i in range(10)]
+    with kaldi_native_io.FloatMatrixWriter(
+        "ark,scp,shards=3:shard_%d.ark,shard.scp"
+    ) as ko:
+        for i, m in enumerate(mats):
+            ko.write(f"k{i}", m)
+
+    for i in range(3):
+        assert os.path.isfile(f"shard_{i}.ark")
+
+    keys = []
+    with kaldi_native_io.SequentialFloatMatrixReader("scp:shard.scp") as ki:
+        for key, value in ki:
+            assert np.array_equal(value, mats[len(keys)])
+            keys.append(key)
+    assert keys == [f"k{i}" for i in range(10)]
+
+    for i in range(3):
+        os.remove(f"shard_{i}.ark")
+    os.remove("shard.scp")
+
+    # Each %d is replaced, e.g. in a directory name too.
+    for i in range(2):
+        os.makedirs(f"shard_{i}", exist_ok=True)
+    with kaldi_native_io.FloatMatrixWriter(
+        "ark,scp,shards=2:shard_%d/foo_%d.ark,shard.scp"
+    ) as ko:
+        for i, m in enumerate(mats):
+            ko.write(f"k{i}", m)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("scp:shard.scp") as ki:
+        for i, (key, value) in enumerate(ki):
+            assert key == f"k{i}"
+            assert np.array_equal(value, mats[i])
+
+    for i in range(2):
+        os.remove(f"shard_{i}/foo_{i}.ark")
+        os.rmdir(f"shard_{i}")
+    os.remove("shard.scp")
+
+
+def test_background_writer():
+    mats = [np.random.rand(i + 1, 3).astype(np.float32) for i in range(10)]
+    with kaldi_native_io.FloatMatrixWriter("ark,scp,bg=4:bg.ark,bg.scp") as ko:
+        for i, m in enumerate(mats):
+            ko.write(f"k{i}", m)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("scp:bg.scp") as ki:
+        for i, (key, value) in enumerate(ki):
+            assert key == f"k{i}"
+            assert np.array_equal(value, mats[i])
+
+    os.remove("bg.ark")
+    os.remove("bg.scp")
+
+
+def test_scp_row_ranges():
+    mat = np.random.rand(100, 5).astype(np.float32)
+    with kaldi_native_io.FloatMatrixWriter("ark,scp:range.ark,range.scp") as ko:
+        ko.write("a", mat)
+
+    with open("range.scp") as f:
+        rxfilename = f.read().split()[1]
+    with open("range2.scp", "w") as f:
+        f.write(f"b {rxfilename}[10:19]\n")
+        f.write(f"c {rxfilename}[90:99,1:2]\n")
+
+    with kaldi_native_io.RandomAccessFloatMatrixReader("scp:range2.scp") as ki:
+        assert np.array_equal(ki["b"], mat[10:20])
+        assert np.array_equal(ki["c"], mat[90:100, 1:3])
+
+    with kaldi_native_io.SequentialFloatMatrixReader("scp:range2.scp") as ki:
+        values = [value for _, value in ki]
+        assert np.array_equal(values[0], mat[10:20])
+        assert np.array_equal(values[1], mat[90:100, 1:3])
+
+    os.remove("range.ark")
+    os.remove("range.scp")
+    os.remove("range2.scp")
+
+
+def test_retained_values():
+    mats = [np.random.rand(10 - i, 4).astype(np.float32) for i in range(5)]
+    with kaldi_native_io.FloatMatrixWriter("ark,scp:reuse.ark,reuse.scp") as ko:
+        for i, m in enumerate(mats):
+            ko.write(f"k{i}", m)
+
+    saved = kaldi_native_io.get_max_retained_object_bytes()
+    for num_bytes in [saved, 0]:
+        kaldi_native_io.set_max_retained_object_bytes(num_bytes)
+        for rspecifier in ["ark:reuse.ark", "scp:reuse.scp"]:
+            # The values stay valid after the reader reads the next ones.
+            with kaldi_native_io.SequentialFloatMatrixReader(rspecifier) as ki:
+                values = [value for _, value in ki]
+            assert len(values) == len(mats)
+            for value, m in zip(values, mats):
+                assert np.array_equal(value, m)
+
+        with kaldi_native_io.RandomAccessFloatMatrixReader(
+            "scp:reuse.scp"
+        ) as ki:
+            values = [ki[f"k{i}"] for i in range(len(mats))]
+            for value, m in zip(values, mats):
+                assert np.array_equal(value, m)
+    kaldi_native_io.set_max_retained_object_bytes(saved)
+
+    os.remove("reuse.ark")
+    os.remove("reuse.scp")
+
+
+def test_text_round_trip():
+    # Text mode writes as many digits as are needed to read back exactly.
+    m = np.random.randn(20, 8).astype(np.float32)
+    m[0, :4] = [1e30, -1e-40, 0, 123456789]
+    with kaldi_native_io.FloatMatrixWriter("ark,t:text.ark") as ko:
+        ko.write("a", m)
+
+    with kaldi_native_io.SequentialFloatMatrixReader("ark:text.ark") as ki:
+        for _, value in ki:
+            assert np.array_equal(value, m)
+
+    os.remove("text.ark")
+
+
 def main():
     test_float_matrix_writer()
     test_sequential_float_matrix_reader()
+    test_background_float_matrix_reader()
     test_random_access_float_matrix_reader()
+    test_batched_values()
+    test_cached_reader()
 
     test_read_write_single_mat()
+    test_indexed_archive()
+    test_mapped_reader()
+    test_compiled_scp()
+    test_sharded_writer()
+    test_background_writer()
+    test_scp_row_ranges()
+    test_retained_values()
+    test_text_round_trip()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
@@ -3,6 +3,7 @@
 # Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
 
 import os
+import struct
 
 import kaldi_native_io
 
@@ -36,10 +37,72 @@ def test_random_access_float_pair_vector_reader():
         assert ki["b"] == [(1, 2.5)]
 
 
+def read_all(rspecifier: str):
+    with kaldi_native_io.SequentialFloatPairVectorReader(rspecifier) as ki:
+        return [(key, value) for key, value in ki]
+
+
+def test_binary_float_pair_vector():
+    # Vectors longer than the 16 KiB buffers of the binary readers and
+    # writers, and empty ones.
+    values = {
+        "a": [(i + 0.5, -i - 0.25) for i in range(5000)],
+        "b": [],
+        "c": [(1, 2.5)],
+        "d": [(i * 0.5, i) for i in range(20000)],
+    }
+    with kaldi_native_io.FloatPairVectorWriter("ark,scp:fpv.ark,fpv.scp") as ko:
+        for key, value in values.items():
+            ko.write(key, value)
+
+    expected = list(values.items())
+    # Archives are read in place from a buffer; the pipe is never read past
+    # the end of an object, or the following keys would be lost.  Objects
+    # listed in scp files are read from a stream.
+    for rspecifier in ["ark:fpv.ark", "ark:cat fpv.ark |", "scp:fpv.scp"]:
+        assert read_all(rspecifier) == expected, rspecifier
+
+    with kaldi_native_io.RandomAccessFloatPairVectorReader("scp:fpv.scp") as ki:
+        for key in ["d", "b", "a", "c"]:
+            assert ki[key] == values[key]
+
+    os.remove("fpv.ark")
+    os.remove("fpv.scp")
+
+
+def test_double_as_float_pair_vector():
+    # Floats written as doubles are read, like ReadBasicType() reads them,
+    # here mixed with floats so that the reader switches between them.
+    pairs = [(i + 0.5, i * 0.25) for i in range(3000)]
+    with open("dpv.ark", "wb") as f:
+        for key in ["a", "b"]:
+            f.write(key.encode() + b" \0B")
+            f.write(b"\x04" + struct.pack("<i", len(pairs)))
+            for i, (first, second) in enumerate(pairs):
+                f.write(b"\x08" + struct.pack("<d", first))
+                if i % 3 == 0:
+                    f.write(b"\x08" + struct.pack("<d", second))
+                else:
+                    f.write(b"\x04" + struct.pack("<f", second))
+    size = os.path.getsize("dpv.ark") // 2
+    with open("dpv.scp", "w") as f:
+        f.write("a dpv.ark:2\n")
+        f.write(f"b dpv.ark:{size + 2}\n")
+
+    expected = [("a", pairs), ("b", pairs)]
+    for rspecifier in ["ark:dpv.ark", "ark:cat dpv.ark |", "scp:dpv.scp"]:
+        assert read_all(rspecifier) == expected, rspecifier
+
+    os.remove("dpv.ark")
+    os.remove("dpv.scp")
+
+
 def main():
     test_float_pair_vector_writer()
     test_sequential_float_pair_vector_reader()
     test_random_access_float_pair_vector_reader()
+    test_binary_float_pair_vector()
+    test_double_as_float_pair_vector()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
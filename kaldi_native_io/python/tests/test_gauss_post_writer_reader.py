@@ -3,6 +3,7 @@
 # Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
 
 import os
+import struct
 from typing import List, Tuple
 
 import numpy as np
@@ -116,13 +117,149 @@ def test_random_access_gauss_post_reader():
         assert_gauss_post_equal(ki["b"], expected_b_value)
 
 
+def flat_to_gauss_post(
+    value: Tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]
+) -> List[List[Tuple[int, np.ndarray]]]:
+    offsets, ids, weight_offsets, weights = value
+    assert offsets.dtype == np.int32
+    assert ids.dtype == np.int32
+    assert weight_offsets.dtype == np.int32
+    assert weights.dtype == np.float32
+    assert offsets[0] == 0
+    assert offsets[-1] == len(ids) == len(weight_offsets) - 1
+    assert weight_offsets[0] == 0
+    assert weight_offsets[-1] == len(weights)
+    return [
+        [
+            (int(ids[k]), weights[weight_offsets[k] : weight_offsets[k + 1]])
+            for k in range(offsets[t], offsets[t + 1])
+        ]
+        for t in range(len(offsets) - 1)
+    ]
+
+
+def test_flat_gauss_post_reader():
+    with kaldi_native_io.SequentialGaussPostReader(rspecifier) as ki:
+        expected = dict(ki)
+
+    with kaldi_native_io.SequentialFlatGaussPostReader(rspecifier) as ki:
+        values = dict(ki)
+    assert list(values.keys()) == ["a", "b"]
+    for key, value in values.items():
+        assert_gauss_post_equal(flat_to_gauss_post(value), expected[key])
+
+    with kaldi_native_io.RandomAccessFlatGaussPostReader(rspecifier) as ki:
+        assert "a" in ki
+        assert_gauss_post_equal(flat_to_gauss_post(ki["b"]), expected["b"])
+        assert_gauss_post_equal(flat_to_gauss_post(ki["a"]), expected["a"])
+
+
+def weights(n: int, base: float) -> np.ndarray:
+    return (np.arange(n) % 50 * 0.25 + base).astype(np.float32)
+
+
+# "a" has vectors larger than the readers buffer at once, and "d" many small
+# frames and vectors, some empty.
+binary_values = {
+    "a": [
+        [(7, weights(6000, 1)), (8, weights(0, 0))],
+        [],
+        [(9, weights(5000, -3))],
+    ],
+    "b": [],
+    "c": [[], []],
+    "d": [
+        [(t + i, weights(i * 3, t % 7)) for i in range(t % 4)]
+        for t in range(3000)
+    ],
+}
+
+
+def check_gauss_post_archive(rspecifiers: List[str], expected: dict):
+    for spec in rspecifiers:
+        with kaldi_native_io.SequentialGaussPostReader(spec) as ki:
+            values = dict(ki)
+        assert list(values.keys()) == list(expected.keys()), spec
+        for key, value in values.items():
+            assert_gauss_post_equal(value, expected[key])
+
+        with kaldi_native_io.SequentialFlatGaussPostReader(spec) as ki:
+            values = {}
+            for key, value in ki:
+                # The arrays use the memory the posteriors were read into.
+                assert ki.value is value
+                assert value[0].base is not None
+                values[key] = value
+        assert list(values.keys()) == list(expected.keys()), spec
+        for key, value in values.items():
+            assert_gauss_post_equal(flat_to_gauss_post(value), expected[key])
+
+        with kaldi_native_io.RandomAccessFlatGaussPostReader(spec) as ki:
+            for key in reversed(list(expected.keys())):
+                value = flat_to_gauss_post(ki[key])
+                assert_gauss_post_equal(value, expected[key])
+                value = flat_to_gauss_post(ki[key])
+                assert_gauss_post_equal(value, expected[key])
+
+
+def test_binary_gauss_post():
+    with kaldi_native_io.GaussPostWriter(
+        f"ark,scp:{base}_binary.ark,{base}_binary.scp"
+    ) as ko:
+        for key, value in binary_values.items():
+            # The writer replaces the arrays in the frames it is given.
+            ko[key] = [list(frame) for frame in value]
+
+    check_gauss_post_archive(
+        [
+            f"ark:{base}_binary.ark",
+            f"ark:cat {base}_binary.ark |",
+            f"scp:{base}_binary.scp",
+        ],
+        binary_values,
+    )
+
+
+def test_double_gauss_post():
+    def int32(i: int) -> bytes:
+        return b"\x04" + struct.pack("<i", i)
+
+    # The first vector was written as a Vector<double>.
+    with open(f"{base}_double.ark", "wb") as f:
+        f.write(b"x \0B" + int32(1) + int32(2))
+        f.write(int32(4) + b"DV " + int32(3))
+        f.write(struct.pack("<3d", 0.5, -2, 1.25))
+        f.write(int32(5) + b"FV " + int32(2))
+        f.write(struct.pack("<2f", 1, 1.25))
+        f.write(b"y \0B" + int32(0))
+
+    expected = {
+        "x": [
+            [
+                (4, np.array([0.5, -2, 1.25], dtype=np.float32)),
+                (5, np.array([1, 1.25], dtype=np.float32)),
+            ]
+        ],
+        "y": [],
+    }
+    check_gauss_post_archive(
+        [f"ark:{base}_double.ark", f"ark:cat {base}_double.ark |"], expected
+    )
+
+
 def main():
     test_gauss_post_writer()
     test_sequential_gauss_post_reader()
     test_random_access_gauss_post_reader()
+    test_flat_gauss_post_reader()
+    test_binary_gauss_post()
+    test_double_gauss_post()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
+    os.remove(f"{base}_binary.scp")
+    os.remove(f"{base}_binary.ark")
+    os.remove(f"{base}_double.ark")
 
 
 if __name__ == "__main__":
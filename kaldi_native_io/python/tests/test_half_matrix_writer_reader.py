@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+
+# Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+import os
+
+import numpy as np
+
+import kaldi_native_io
+
+base = "half_matrix"
+wspecifier = f"ark,scp:{base}.ark,{base}.scp"
+rspecifier = f"scp:{base}.scp"
+
+mat = np.random.randn(100, 40).astype(np.float32) * 100
+
+
+def test_half_matrix_writer():
+    with kaldi_native_io.HalfMatrixWriter(wspecifier) as ko:
+        ko.write("a", mat)
+        ko.write("b", mat, format=kaldi_native_io.HalfFormat.kBFloat16)
+        ko["c"] = np.array([[1, 2.5], [-3, 1e10]], dtype=np.float64)
+        ko["d"] = (mat[:2], kaldi_native_io.HalfFormat.kBFloat16)
+
+
+def test_sequential_half_matrix_reader():
+    for dtype in (np.float32, np.float64):
+        if dtype == np.float32:
+            reader = kaldi_native_io.SequentialFloatMatrixReader
+        else:
+            reader = kaldi_native_io.SequentialDoubleMatrixReader
+        with reader(rspecifier) as ki:
+            values = {key: value for key, value in ki}
+        assert values["a"].dtype == dtype
+        # The same rounding as numpy's float16.
+        assert np.array_equal(values["a"], mat.astype(np.float16))
+        # bfloat16 keeps 8 bits of precision.
+        assert np.allclose(values["b"], mat, rtol=1.0 / 256, atol=0)
+        assert values["d"].shape == (2, 40)
+        assert np.array_equal(
+            values["c"],
+            np.array([[1, 2.5], [-3, np.inf]], dtype=dtype),
+        )
+
+
+def test_random_access_half_matrix_reader():
+    with kaldi_native_io.RandomAccessFloatMatrixReader(rspecifier) as ki:
+        assert "a" in ki
+        assert np.array_equal(ki["a"], mat.astype(np.float16))
+
+
+def test_half_matrix_shape_reader():
+    with kaldi_native_io.RandomAccessMatrixShapeReader(rspecifier) as ki:
+        assert ki["a"].num_rows == 100
+        assert ki["a"].num_cols == 40
+        assert ki["d"].num_rows == 2
+
+
+def main():
+    test_half_matrix_writer()
+    test_sequential_half_matrix_reader()
+    test_random_access_half_matrix_reader()
+    test_half_matrix_shape_reader()
+
+    os.remove(f"{base}.scp")
+    os.remove(f"{base}.ark")
+
+
+if __name__ == "__main__":
+    main()
@@ -3,6 +3,7 @@
 # Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
 
 import os
+import struct
 
 import kaldi_native_io
 
@@ -36,10 +37,59 @@ def test_random_access_int32_pair_vector_reader():
         assert ki["b"] == [(1, 2)]
 
 
+def read_all(rspecifier: str):
+    with kaldi_native_io.SequentialInt32PairVectorReader(rspecifier) as ki:
+        return [(key, value) for key, value in ki]
+
+
+def test_binary_int32_pair_vector():
+    # Vectors longer than the 16 KiB buffers of the binary readers and
+    # writers, and empty ones.
+    values = {
+        "a": [(i, -i) for i in range(5000)],
+        "b": [],
+        "c": [(2**31 - 1, -(2**31))],
+        "d": [(i * 7, i // 3) for i in range(20000)],
+    }
+    with kaldi_native_io.Int32PairVectorWriter("ark,scp:ipv.ark,ipv.scp") as ko:
+        for key, value in values.items():
+            ko.write(key, value)
+
+    expected = list(values.items())
+    # Archives are read in place from a buffer; the pipe is never read past
+    # the end of an object, or the following keys would be lost.  Objects
+    # listed in scp files are read from a stream.
+    for rspecifier in ["ark:ipv.ark", "ark:cat ipv.ark |", "scp:ipv.scp"]:
+        assert read_all(rspecifier) == expected, rspecifier
+
+    with kaldi_native_io.RandomAccessInt32PairVectorReader("scp:ipv.scp") as ki:
+        for key in ["d", "b", "a", "c"]:
+            assert ki[key] == values[key]
+
+    os.remove("ipv.ark")
+    os.remove("ipv.scp")
+
+
+def test_wrong_size_int32_pair_vector():
+    # Unlike floats and doubles, integers of the wrong size are errors.
+    with open("bad.ark", "wb") as f:
+        f.write(b"a \0B\x04" + struct.pack("<i", 1))
+        f.write(b"\x04" + struct.pack("<i", 1) + b"\x04" + struct.pack("<i", 2))
+        f.write(b"b \0B\x04" + struct.pack("<i", 1))
+        f.write(b"\x04" + struct.pack("<i", 1) + b"\x08" + struct.pack("<q", 2))
+
+    for rspecifier in ["ark:bad.ark", "ark:cat bad.ark |"]:
+        assert read_all(rspecifier) == [("a", [(1, 2)])], rspecifier
+
+    os.remove("bad.ark")
+
+
 def main():
     test_int32_pair_vector_writer()
     test_sequential_int32_pair_vector_reader()
     test_random_access_int32_pair_vector_reader()
+    test_binary_int32_pair_vector()
+    test_wrong_size_int32_pair_vector()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
@@ -5,6 +5,7 @@
 import os
 
 import kaldi_native_io
+import numpy as np
 
 base = "int32_vector_vector"
 wspecifier = f"ark,scp,t:{base}.ark,{base}.scp"
@@ -36,13 +37,90 @@ def test_random_access_int32_vector_vector_reader():
         assert ki["b"] == [[100, 200, 300], [3, 5]]
 
 
+# Vectors longer than the 16 KiB buffers of the binary readers and writers,
+# and empty ones, inside and outside.
+binary_values = {
+    "a": [[i] * (i % 5) for i in range(3000)],
+    "b": [],
+    "c": [[], [1], []],
+    "d": [[j - i for j in range(4000 * (i % 3))] for i in range(10)],
+}
+
+
+def test_binary_int32_vector_vector():
+    with kaldi_native_io.Int32VectorVectorWriter(
+        "ark,scp:ivv.ark,ivv.scp"
+    ) as ko:
+        for key, value in binary_values.items():
+            ko.write(key, value)
+
+    expected = list(binary_values.items())
+    # Archives are read in place from a buffer; the pipe is never read past
+    # the end of an object, or the following keys would be lost.  Objects
+    # listed in scp files are read from a stream.
+    for rspecifier in ["ark:ivv.ark", "ark:cat ivv.ark |", "scp:ivv.scp"]:
+        with kaldi_native_io.SequentialInt32VectorVectorReader(
+            rspecifier
+        ) as ki:
+            assert [(key, value) for key, value in ki] == expected, rspecifier
+
+
+def flat_to_lists(value):
+    offsets, values = value
+    assert offsets.dtype == np.int32
+    assert values.dtype == np.int32
+    assert offsets[0] == 0
+    assert offsets[-1] == len(values)
+    return [
+        values[offsets[i] : offsets[i + 1]].tolist()
+        for i in range(len(offsets) - 1)
+    ]
+
+
+def test_flat_int32_vector_vector_reader():
+    text_values = {
+        "a": [[10, 20], [-2]],
+        "b": [[100, 200, 300], [3, 5]],
+    }
+    for spec, expected in [
+        (rspecifier, text_values),
+        ("scp:ivv.scp", binary_values),
+        ("ark:ivv.ark", binary_values),
+        ("ark:cat ivv.ark |", binary_values),
+    ]:
+        with kaldi_native_io.SequentialFlatInt32VectorVectorReader(spec) as ki:
+            values = {}
+            for key, value in ki:
+                # The arrays use the memory the object was read into, which
+                # the reader does not reuse for the next object.
+                assert ki.value is value
+                assert value[0].base is not None
+                values[key] = value
+        assert list(values.keys()) == list(expected.keys()), spec
+        for key, value in values.items():
+            assert flat_to_lists(value) == expected[key], (spec, key)
+
+        with kaldi_native_io.RandomAccessFlatInt32VectorVectorReader(
+            spec
+        ) as ki:
+            for key in reversed(list(expected.keys())):
+                assert key in ki
+                assert flat_to_lists(ki[key]) == expected[key]
+                # Looking the key up again gives the same values.
+                assert flat_to_lists(ki[key]) == expected[key]
+
+
 def main():
     test_int32_vector_vector_writer()
     test_sequential_int32_vector_vector_reader()
     test_random_access_int32_vector_vector_reader()
+    test_binary_int32_vector_vector()
+    test_flat_int32_vector_vector_reader()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
+    os.remove("ivv.scp")
+    os.remove("ivv.ark")
 
 
 if __name__ == "__main__":
@@ -2,9 +2,11 @@
 
 # Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
 
+import operator
 import os
 
 import kaldi_native_io
+import numpy as np
 
 base = "int32_vector"
 wspecifier = f"ark,scp,t:{base}.ark,{base}.scp"
@@ -61,11 +63,109 @@ def test_read_single_item():
     os.remove("v.ark")
 
 
+def check_archive_inputs(writer, sequential_reader, random_reader, values):
+    equal = (
+        np.array_equal if isinstance(values[0], np.ndarray) else operator.eq
+    )
+    # Sorted, for the "s" option below.
+    keys = [f"k{i:04d}" for i in range(len(values))]
+    for wspecifier in ["ark:many.ark", "ark,t:many.ark"]:
+        with writer(wspecifier) as ko:
+            for key, value in zip(keys, values):
+                ko.write(key, value)
+
+        # Archives are read through a buffer filled from a file or a pipe,
+        # or in place from a memory-mapped file.
+        for rspecifier in [
+            "ark:many.ark",
+            "ark:cat many.ark |",
+            "ark,mmap:many.ark",
+        ]:
+            with sequential_reader(rspecifier) as ki:
+                read = [(key, value) for key, value in ki]
+            assert [key for key, _ in read] == keys, rspecifier
+            for (key, value), expected in zip(read, values):
+                assert equal(value, expected), (rspecifier, key)
+
+        with random_reader("ark,s,cs:many.ark") as ki:
+            for i in [10, len(values) - 1]:
+                assert equal(ki[keys[i]], values[i])
+
+    os.remove("many.ark")
+
+
+def test_archive_inputs():
+    check_archive_inputs(
+        kaldi_native_io.Int32VectorWriter,
+        kaldi_native_io.SequentialInt32VectorReader,
+        kaldi_native_io.RandomAccessInt32VectorReader,
+        [list(range(i % 7)) for i in range(1000)],
+    )
+
+    # The other holders that decode binary objects from the buffer in place.
+    check_archive_inputs(
+        kaldi_native_io.Int32Writer,
+        kaldi_native_io.SequentialInt32Reader,
+        kaldi_native_io.RandomAccessInt32Reader,
+        [i * 7 - 3000 for i in range(1000)],
+    )
+    check_archive_inputs(
+        kaldi_native_io.FloatWriter,
+        kaldi_native_io.SequentialFloatReader,
+        kaldi_native_io.RandomAccessFloatReader,
+        [i * 0.5 - 100 for i in range(1000)],
+    )
+    check_archive_inputs(
+        kaldi_native_io.BoolWriter,
+        kaldi_native_io.SequentialBoolReader,
+        kaldi_native_io.RandomAccessBoolReader,
+        [i % 3 == 0 for i in range(1000)],
+    )
+    # Some vectors are longer than the blocks the buffer is filled in.
+    check_archive_inputs(
+        kaldi_native_io.Int32PairVectorWriter,
+        kaldi_native_io.SequentialInt32PairVectorReader,
+        kaldi_native_io.RandomAccessInt32PairVectorReader,
+        [
+            [(j, -j) for j in range(8000 if i % 100 == 50 else i % 7)]
+            for i in range(1000)
+        ],
+    )
+    check_archive_inputs(
+        kaldi_native_io.Int32VectorVectorWriter,
+        kaldi_native_io.SequentialInt32VectorVectorReader,
+        kaldi_native_io.RandomAccessInt32VectorVectorReader,
+        [
+            [list(range(j)) for j in range(300 if i % 100 == 50 else i % 5)]
+            for i in range(1000)
+        ],
+    )
+
+    # Matrices are read from an istream on top of the buffer; reads larger
+    # than what is buffered, e.g. the rows of the wide matrix, go straight to
+    # the file or pipe.  The values are exact in text mode too.
+    shapes = [(1 + i % 5, 3) for i in range(50)]
+    shapes[20] = (3, 30000)
+    shapes[30] = (2000, 40)
+    check_archive_inputs(
+        kaldi_native_io.FloatMatrixWriter,
+        kaldi_native_io.SequentialFloatMatrixReader,
+        kaldi_native_io.RandomAccessFloatMatrixReader,
+        [
+            (np.arange(r * c).reshape(r, c) % 1000 * 0.25 - i).astype(
+                np.float32
+            )
+            for i, (r, c) in enumerate(shapes)
+        ],
+    )
+
+
 def main():
     test_int32_vector_writer()
     test_sequential_int32_vector_reader()
     test_random_access_int32_vector_reader()
     test_read_single_item()
+    test_archive_inputs()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+
+# Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+import os
+import threading
+
+import numpy as np
+
+import kaldi_native_io
+
+# The data of matrices and vectors is allocated with a pooled allocator that
+# rounds sizes up to size classes and reuses freed blocks. Its pool is capped
+# at 64 MiB, and blocks larger than 16 MiB are not pooled.
+max_pooled_bytes = 64 << 20
+
+
+def test_size_classes():
+    # From the smallest size class to sizes that are not pooled, including
+    # sizes on both sides of class boundaries.
+    sizes = [1, 15, 16, 17, 20, 24, 100, 1000, 4095, 4097, 100000]
+    sizes += [1000000, 5000000]
+    vectors = {
+        f"v{i}": np.arange(n, dtype=np.float32) * (i + 1)
+        for i, n in enumerate(sizes)
+    }
+    with kaldi_native_io.FloatVectorWriter("ark:alloc.ark") as ko:
+        for key, value in vectors.items():
+            ko.write(key, value)
+
+    # Read the archive a few times, so that the later reads reuse the blocks
+    # freed by the earlier ones.
+    for _ in range(3):
+        with kaldi_native_io.SequentialFloatVectorReader("ark:alloc.ark") as ki:
+            for key, value in ki:
+                assert np.array_equal(value, vectors[key])
+        with kaldi_native_io.RandomAccessFloatVectorReader(
+            "ark:alloc.ark"
+        ) as ki:
+            for key in reversed(list(vectors.keys())):
+                assert np.array_equal(ki[key], vectors[key])
+
+    assert kaldi_native_io.get_pooled_memory_bytes() <= max_pooled_bytes
+
+    os.remove("alloc.ark")
+
+
+def test_threads():
+    mats = {
+        f"m{i}": np.random.randn(1 + (i * 37) % 500, 1 + i % 80).astype(
+            np.float32
+        )
+        for i in range(200)
+    }
+    with kaldi_native_io.FloatMatrixWriter("ark,idx:alloc.ark") as ko:
+        for key, value in mats.items():
+            ko.write(key, value)
+
+    errors = []
+
+    def read(rspecifier):
+        try:
+            for _ in range(3):
+                with kaldi_native_io.SequentialFloatMatrixReader(
+                    rspecifier
+                ) as ki:
+                    for key, value in ki:
+                        assert np.array_equal(value, mats[key]), key
+        except Exception as e:
+            errors.append(e)
+
+    # With threads=4, matrices are allocated by the worker threads and freed
+    # by the thread that reads them. Several readers run at once, and each
+    # thread frees blocks that other threads allocated.
+    threads = [
+        threading.Thread(target=read, args=(rspecifier,))
+        for rspecifier in [
+            "ark:alloc.ark",
+            "ark,threads=4:alloc.ark",
+            "ark,bg=2:alloc.ark",
+            "ark,threads=2:alloc.ark",
+        ]
+    ]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert not errors, errors
+
+    # The threads have exited and moved the blocks they cached to the shared
+    # pool.
+    assert 0 < kaldi_native_io.get_pooled_memory_bytes() <= max_pooled_bytes
+
+    kaldi_native_io.trim_memory_pool()
+    assert kaldi_native_io.get_pooled_memory_bytes() == 0
+
+    os.remove("alloc.ark.idx")
+    os.remove("alloc.ark")
+
+
+def main():
+    test_size_classes()
+    test_threads()
+
+
+if __name__ == "__main__":
+    main()
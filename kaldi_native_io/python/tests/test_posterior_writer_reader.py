@@ -6,6 +6,7 @@ import os
 from typing import List, Tuple
 
 import kaldi_native_io
+import numpy as np
 
 base = "posterior"
 wspecifier = f"ark,scp,t:{base}.ark,{base}.scp"
@@ -79,13 +80,112 @@ def test_random_access_posterior_reader():
         assert_posterior_equal(ki["b"], expected_b_value)
 
 
+def flat_to_posterior(
+    value: Tuple[np.ndarray, np.ndarray, np.ndarray]
+) -> List[List[Tuple[int, float]]]:
+    offsets, ids, weights = value
+    assert offsets.dtype == np.int32
+    assert ids.dtype == np.int32
+    assert weights.dtype == np.float32
+    assert offsets[0] == 0
+    assert offsets[-1] == len(ids) == len(weights)
+    ids = ids.tolist()
+    weights = weights.tolist()
+    return [
+        list(zip(ids[begin:end], weights[begin:end]))
+        for begin, end in zip(offsets[:-1].tolist(), offsets[1:].tolist())
+    ]
+
+
+def test_flat_posterior_reader():
+    expected_a_value = [
+        [(1, 0.5), (2, 0.3)],
+        [(9, 0.8)],
+        [(10, 0.1), (11, 0.2), (12, 0.9)],
+    ]
+
+    expected_b_value = [
+        [(3, 0.1), (4, 0.5), (8, 0.2)],
+        [(3, 0.1)],
+    ]
+
+    with kaldi_native_io.SequentialFlatPosteriorReader(rspecifier) as ki:
+        values = dict(ki)
+    assert_posterior_equal(flat_to_posterior(values["a"]), expected_a_value)
+    assert_posterior_equal(flat_to_posterior(values["b"]), expected_b_value)
+
+    with kaldi_native_io.RandomAccessFlatPosteriorReader(rspecifier) as ki:
+        assert "a" in ki
+        assert_posterior_equal(flat_to_posterior(ki["b"]), expected_b_value)
+        assert_posterior_equal(flat_to_posterior(ki["a"]), expected_a_value)
+
+
+# Weights that are exact in float32, so that they can be compared with ==.
+# "a" has frames with more pairs than the readers buffer at once, and "d" many
+# small frames, some empty.
+binary_values = {
+    "a": [
+        [(i * 7 % 5000, (i % 97) * 0.125) for i in range(5000)],
+        [],
+        [(3, 0.5)],
+        [(-i, i * 0.25) for i in range(3000)],
+    ],
+    "b": [],
+    "c": [[], [], []],
+    "d": [
+        [(t, t % 8 * 0.25), (t + 1, -0.5)] if t % 3 else []
+        for t in range(4000)
+    ],
+}
+
+
+def test_binary_posterior():
+    with kaldi_native_io.PosteriorWriter(
+        f"ark,scp:{base}_binary.ark,{base}_binary.scp"
+    ) as ko:
+        for key, value in binary_values.items():
+            ko[key] = value
+
+    for spec in [
+        f"ark:{base}_binary.ark",
+        f"ark:cat {base}_binary.ark |",
+        f"scp:{base}_binary.scp",
+    ]:
+        with kaldi_native_io.SequentialPosteriorReader(spec) as ki:
+            assert dict(ki) == binary_values, spec
+
+        with kaldi_native_io.SequentialFlatPosteriorReader(spec) as ki:
+            values = {}
+            for key, value in ki:
+                # The arrays use the memory the posterior was read into.
+                assert ki.value is value
+                assert value[0].base is not None
+                values[key] = value
+        assert list(values.keys()) == list(binary_values.keys()), spec
+        for key, value in values.items():
+            assert flat_to_posterior(value) == binary_values[key], (spec, key)
+
+        with kaldi_native_io.RandomAccessPosteriorReader(spec) as ki:
+            for key in reversed(list(binary_values.keys())):
+                assert ki[key] == binary_values[key], (spec, key)
+
+        with kaldi_native_io.RandomAccessFlatPosteriorReader(spec) as ki:
+            for key in reversed(list(binary_values.keys())):
+                assert flat_to_posterior(ki[key]) == binary_values[key]
+                assert flat_to_posterior(ki[key]) == binary_values[key]
+
+
 def main():
     test_posterior_writer()
     test_sequential_posterior_reader()
     test_random_access_posterior_reader()
+    test_flat_posterior_reader()
+    test_binary_posterior()
 
     os.remove(f"{base}.scp")
     os.remove(f"{base}.ark")
+    os.remove(f"{base}_binary.scp")
+    os.remove(f"{base}_binary.ark")
 
 
 if __name__ == "__main__":
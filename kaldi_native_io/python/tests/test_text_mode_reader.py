@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+
+# Copyright      2022  Xiaomi Corporation (authors: Fangjun Kuang)
+
+import locale
+import os
+
+import kaldi_native_io
+import numpy as np
+
+# Numbers that are not parsed with a single floating point operation: long
+# mantissas, large exponents and subnormals.
+float_numbers = [
+    "0.12345678901234567890123",
+    "-3.4028235e+38",
+    "1.1754944e-38",
+    "1e-40",
+    "-1.5e-45",
+    "123456789012345678901234567890",
+]
+
+double_numbers = [
+    "0.12345678901234567890123",
+    "3.141592653589793238462643383279",
+    "1e300",
+    "-1.7976931348623157e+308",
+    "2.5e-310",
+    "4.9e-324",
+]
+
+# Fields that are not numbers, or are too large for their type.
+malformed_floats = ["1e", "1.2.3", "--5", "1e39", "."]
+malformed_ints = ["1e", "1.2.3", "--5", "2147483648", "-2147483649"]
+
+
+def write_text(filename: str, text: str):
+    with open(filename, "w") as f:
+        f.write(text)
+
+
+def check_numbers():
+    write_text("float.txt", " [\n {} ]\n".format(" ".join(float_numbers)))
+    expected = np.array([float(s) for s in float_numbers], dtype=np.float32)
+    m = kaldi_native_io.FloatMatrix.read("float.txt")
+    assert np.array_equal(m.numpy(), expected.reshape(1, -1))
+
+    write_text("float.txt", " [ {} ]\n".format(" ".join(float_numbers)))
+    v = kaldi_native_io.FloatVector.read("float.txt")
+    assert np.array_equal(v.numpy(), expected)
+
+    write_text("double.txt", " [\n {} ]\n".format(" ".join(double_numbers)))
+    expected = np.array([float(s) for s in double_numbers], dtype=np.float64)
+    m = kaldi_native_io.DoubleMatrix.read("double.txt")
+    assert np.array_equal(m.numpy(), expected.reshape(1, -1))
+
+    write_text(
+        "text.ark",
+        "a [\n {} ]\nb [ {} ]\n".format(
+            " ".join(float_numbers), " ".join(float_numbers)
+        ),
+    )
+    expected = np.array([float(s) for s in float_numbers], dtype=np.float32)
+    with kaldi_native_io.SequentialFloatMatrixReader("ark:text.ark") as ki:
+        key, value = next(iter(ki))
+        assert key == "a"
+        assert np.array_equal(value, expected.reshape(1, -1))
+
+    write_text(
+        "text.ark",
+        "a [ 1 {} 2147483647 1e-40 ] [ -2147483648 {} ]\n".format(
+            float_numbers[0], float_numbers[2]
+        ),
+    )
+    with kaldi_native_io.SequentialPosteriorReader("ark:text.ark") as ki:
+        key, value = next(iter(ki))
+        assert key == "a"
+        expected = [
+            [(1, float(float_numbers[0])), (2147483647, 1e-40)],
+            [(-2147483648, float(float_numbers[2]))],
+        ]
+        assert len(value) == len(expected)
+        for p, q in zip(value, expected):
+            assert [i for i, _ in p] == [i for i, _ in q]
+            assert np.array_equal(
+                np.array([w for _, w in p], dtype=np.float32),
+                np.array([w for _, w in q], dtype=np.float32),
+            )
+
+
+def test_numbers():
+    check_numbers()
+
+    # The numbers must be parsed with '.' as the decimal point, even if the
+    # program has set a locale that uses ','.
+    for name in ["de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"]:
+        try:
+            old = locale.setlocale(locale.LC_NUMERIC, name)
+        except locale.Error:
+            continue
+        try:
+            check_numbers()
+        finally:
+            locale.setlocale(locale.LC_NUMERIC, old)
+        break
+
+    for f in ["float.txt", "double.txt", "text.ark"]:
+        os.remove(f)
+
+
+def test_malformed_numbers():
+    for field in malformed_floats:
+        write_text("bad.txt", f" [\n 1 {field} ]\n")
+        try:
+            kaldi_native_io.FloatMatrix.read("bad.txt")
+            assert False, f"{field} read as a number"
+        except RuntimeError:
+            pass
+
+        write_text("bad.txt", f" [ 1 {field} ]\n")
+        try:
+            kaldi_native_io.FloatVector.read("bad.txt")
+            assert False, f"{field} read as a number"
+        except RuntimeError:
+            pass
+
+        write_text("bad.ark", f"a [ 1 0.5 ]\nb [ 2 {field} ]\n")
+        with kaldi_native_io.RandomAccessPosteriorReader("ark:bad.ark") as ki:
+            assert "a" in ki
+            assert "b" not in ki
+
+    for field in malformed_ints:
+        write_text("bad.ark", f"a [ 1 0.5 ]\nb [ {field} 0.5 ]\n")
+        with kaldi_native_io.RandomAccessPosteriorReader("ark:bad.ark") as ki:
+            assert "a" in ki
+            assert "b" not in ki
+
+        # Reading stops at the malformed object.
+        with kaldi_native_io.SequentialPosteriorReader("ark:bad.ark") as ki:
+            assert [key for key, _ in ki] == ["a"]
+
+    os.remove("bad.txt")
+    os.remove("bad.ark")
+
+
+def main():
+    test_numbers()
+    test_malformed_numbers()
+
+
+if __name__ == "__main__":
+    main()